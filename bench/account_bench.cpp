@@ -0,0 +1,1415 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <accountExecutor.h>
+#include <accountMgr.h>
+#include <accountId.h>
+#include <accountMetrics.h>
+#include <atomicBalance.h>
+#include <flatHashMap.h>
+#include <journal.h>
+#include <objectPool.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/** The number of calls to the global operator new, to count the allocations of an operation. */
+std::atomic<std::uint64_t> g_allocations(0);
+
+/**
+ * The global allocation functions are all replaced, so every form of new and delete goes
+ * through the pair below and the compiler never sees memory of one family freed by the other.
+ */
+void* countedAllocate(std::size_t size, std::size_t alignment) {
+
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) return std::malloc(size);
+    //aligned_alloc() wants a size multiple of the alignment.
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* countedAllocateOrThrow(std::size_t size, std::size_t alignment) {
+
+    if (void* p = countedAllocate(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void countedFree(void* p) noexcept {
+
+    std::free(p);
+}
+
+}
+
+void* operator new(std::size_t size) { return countedAllocateOrThrow(size, 0); }
+void* operator new[](std::size_t size) { return countedAllocateOrThrow(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAllocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAllocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocate(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocate(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+
+namespace {
+
+const int benchAccountCount = 100000;
+
+std::unique_ptr<AccountMgr> g_mgr;
+std::vector<accountIdType> g_ids;
+
+void setUpAccounts(std::size_t shardCount) {
+
+    g_mgr.reset(new AccountMgr(shardCount));
+    g_ids.clear();
+    g_ids.reserve(benchAccountCount);
+    for (int i = 0; i < benchAccountCount; ++i) {
+        g_ids.push_back(g_mgr->insertNewPersonAccount("FirstName", "LastName"));
+    }
+}
+
+void tearDownAccounts() {
+
+    g_ids.clear();
+    g_mgr.reset();
+}
+
+}
+
+//AccountMgr: top-ups and withdrawals on random accounts. Arg is the shard count.
+static void BM_ShardedBalanceOperations(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(static_cast<std::size_t>(state.range(0)));
+    }
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    for (auto _ : state) {
+        const accountIdType& id = g_ids[i % g_ids.size()];
+        benchmark::DoNotOptimize(g_mgr->topUpAccount(id, 2));
+        benchmark::DoNotOptimize(g_mgr->withdrawFromAccount(id, 1));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+
+    if (state.thread_index() == 0) {
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_ShardedBalanceOperations)
+    ->Arg(1)->Arg(256)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+//Transfers between random account pairs. Arg is the shard count.
+static void BM_Transfer(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(static_cast<std::size_t>(state.range(0)));
+        for (const accountIdType& id : g_ids) {
+            g_mgr->topUpAccount(id, 1000000);
+        }
+    }
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_mgr->transfer(g_ids[i % g_ids.size()], g_ids[(i + 52361) % g_ids.size()], 1));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_Transfer)
+    ->Arg(1)->Arg(256)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+//Top-ups logged to a journal flushed to the disk. Arg is the group commit delay in microseconds.
+namespace {
+
+std::unique_ptr<Journal> g_journal;
+const char* const benchJournalPath = "tech_task_bench.journal";
+
+}
+
+static void BM_JournaledTopUp(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(64);
+        std::remove(benchJournalPath);
+        JournalOptions options;
+        options.maxDelay = std::chrono::microseconds(state.range(0));
+        g_journal.reset(new Journal(benchJournalPath, options));
+        g_mgr->attachJournal(g_journal.get());
+    }
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_mgr->topUpAccount(g_ids[i % g_ids.size()], 1));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        g_mgr->attachJournal(nullptr);
+        JournalStats stats = g_journal->stats();
+        state.counters["records_per_flush"] = static_cast<double>(stats.records) / static_cast<double>(stats.batches);
+        g_journal.reset();
+        std::remove(benchJournalPath);
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_JournaledTopUp)
+    ->Arg(0)->Arg(500)
+    ->Threads(1)->Threads(4)->Threads(16)
+    ->UseRealTime();
+
+//Contention on a single hot account: the lock-free balance against a mutex protected one.
+static void BM_HotAccountLockFree(benchmark::State& state) {
+
+    static PersonAccount<AccountId_IdPartType> account;
+
+    for (auto _ : state) {
+        account.addToBalance(2);
+        benchmark::DoNotOptimize(account.decreaseFromBalance(1));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_HotAccountLockFree)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+static void BM_HotAccountMutex(benchmark::State& state) {
+
+    static std::mutex mutex;
+    static int balance = 0;
+
+    for (auto _ : state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            balance += 2;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (balance >= 1) {
+                balance -= 1;
+            }
+        }
+        benchmark::DoNotOptimize(balance);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_HotAccountMutex)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+//Top-ups of a single account from every thread, the load of a payment collector: one atomic
+//balance against a hot, striped one. Every thread withdraws what it added now and then.
+static void BM_HotAccountTopUp(benchmark::State& state) {
+
+    static AtomicBalance balance;
+
+    std::uint64_t credits = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(balance.add(1));
+        if ((++credits & 0xffff) == 0) {
+            balance.decrease(0x10000);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HotAccountTopUp)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+static void BM_HotAccountTopUpStriped(benchmark::State& state) {
+
+    static AtomicBalance balance;
+    static const bool hot = balance.makeHot();
+    benchmark::DoNotOptimize(hot);
+
+    std::uint64_t credits = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(balance.add(1));
+        if ((++credits & 0xffff) == 0) {
+            balance.decrease(0x10000);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HotAccountTopUpStriped)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+static void BM_HotAccountStriped(benchmark::State& state) {
+
+    static PersonAccount<AccountId_IdPartType> account;
+    static const bool hot = account.makeBalanceHot();
+    benchmark::DoNotOptimize(hot);
+
+    for (auto _ : state) {
+        account.addToBalance(2);
+        benchmark::DoNotOptimize(account.decreaseFromBalance(1));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_HotAccountStriped)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+//The same hot account reached through AccountMgr.
+static void BM_HotAccountThroughMgr(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(1);
+    }
+
+    const accountIdType& id = g_ids[0];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_mgr->topUpAccount(id, 2));
+        benchmark::DoNotOptimize(g_mgr->withdrawFromAccount(id, 1));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+
+    if (state.thread_index() == 0) {
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_HotAccountThroughMgr)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+//Account store containers: FlatHashMap against std::unordered_map. Arg is the number of accounts.
+typedef std::unique_ptr<AbstractAccount<AccountId_IdPartType>> BenchAccountPtr;
+typedef FlatHashMap<accountIdType, BenchAccountPtr, AccountIdHashFunctor<AccountId_IdPartType> > BenchFlatMap;
+typedef std::unordered_map<accountIdType, BenchAccountPtr, AccountIdHashFunctor<AccountId_IdPartType> > BenchUnorderedMap;
+
+namespace {
+
+const std::uint32_t benchDate = 20230101u;
+
+template<typename T_Map>
+void fillMap(T_Map& map, AccountId_IdPartType count) {
+
+    for (AccountId_IdPartType i = 0; i < count; ++i) {
+        map[accountIdType(i, benchDate)];
+    }
+}
+
+}
+
+template<typename T_Map>
+static void BM_MapInsert(benchmark::State& state) {
+
+    const AccountId_IdPartType count = state.range(0);
+    for (auto _ : state) {
+        T_Map map;
+        fillMap(map, count);
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_MapInsert, BenchFlatMap)->Arg(1000000)->Arg(10000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_MapInsert, BenchUnorderedMap)->Arg(1000000)->Arg(10000000)->Unit(benchmark::kMillisecond);
+
+template<typename T_Map>
+static void BM_MapLookupHit(benchmark::State& state) {
+
+    const AccountId_IdPartType count = state.range(0);
+    T_Map map;
+    fillMap(map, count);
+
+    AccountId_IdPartType i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.find(accountIdType(i, benchDate)));
+        i = (i + 1000003) % count;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_MapLookupHit, BenchFlatMap)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_MapLookupHit, BenchUnorderedMap)->Arg(1000000)->Arg(10000000);
+
+template<typename T_Map>
+static void BM_MapLookupMiss(benchmark::State& state) {
+
+    const AccountId_IdPartType count = state.range(0);
+    T_Map map;
+    fillMap(map, count);
+
+    AccountId_IdPartType i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.find(accountIdType(count + i, benchDate)));
+        i = (i + 1000003) % count;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_MapLookupMiss, BenchFlatMap)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_MapLookupMiss, BenchUnorderedMap)->Arg(1000000)->Arg(10000000);
+
+//Account allocation: the object pool against one new per account. Arg is the number of accounts.
+static void BM_AllocateAccountsNew(benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<PersonAccount<AccountId_IdPartType>*> accounts(count);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < count; ++i) {
+            accounts[i] = new PersonAccount<AccountId_IdPartType>;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            delete accounts[i];
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["allocations"] = static_cast<double>(count);
+}
+BENCHMARK(BM_AllocateAccountsNew)->Arg(1000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_AllocateAccountsPool(benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    PoolStats stats;
+    for (auto _ : state) {
+        ObjectPool<PersonAccount<AccountId_IdPartType>> pool;
+        for (std::size_t i = 0; i < count; ++i) {
+            benchmark::DoNotOptimize(pool.create());
+        }
+        stats = pool.stats();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["allocations"] = static_cast<double>(stats.systemAllocations);
+    state.counters["bytes_per_account"] = static_cast<double>(stats.bytesAllocated) / static_cast<double>(count);
+}
+BENCHMARK(BM_AllocateAccountsPool)->Arg(1000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+//Account creation through AccountMgr.
+static void BM_InsertAccounts(benchmark::State& state) {
+
+    const int count = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        AccountMgr mgr;
+        for (int i = 0; i < count; ++i) {
+            benchmark::DoNotOptimize(mgr.insertNewPersonAccount("FirstName", "LastName"));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_InsertAccounts)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+//Object per account against the data oriented layout: random balance updates and a full
+//balance scan. Arg is the number of accounts.
+template<typename T_Mgr>
+static void BM_LayoutBalanceOperations(benchmark::State& state) {
+
+    const int count = static_cast<int>(state.range(0));
+    T_Mgr mgr(16);
+    std::vector<accountIdType> ids;
+    ids.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+    }
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const accountIdType& id = ids[i % ids.size()];
+        benchmark::DoNotOptimize(mgr.topUpAccount(id, 2));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LayoutBalanceOperations, AccountMgr)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_LayoutBalanceOperations, DataOrientedAccountMgr)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_LayoutBalanceOperations, VariantAccountMgr)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_LayoutBalanceOperations, NodeAccountMgr)->Arg(1000000);
+
+template<typename T_Mgr>
+static void BM_LayoutTotalBalance(benchmark::State& state) {
+
+    const int count = static_cast<int>(state.range(0));
+    T_Mgr mgr(16);
+    for (int i = 0; i < count; ++i) {
+        mgr.topUpAccount(mgr.insertNewPersonAccount("FirstName", "LastName"), 1);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mgr.totalBalance());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_LayoutTotalBalance, AccountMgr)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_LayoutTotalBalance, DataOrientedAccountMgr)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_LayoutTotalBalance, VariantAccountMgr)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+//Virtual dispatch (AbstractAccount and Visitor) against static dispatch (VariantAccount),
+//on handles already looked up so only the dispatch and the access to the account are
+//measured. Arg is the number of accounts, half of them enterprises.
+namespace {
+
+template<typename T_Store>
+struct DispatchFixture {
+    explicit DispatchFixture(std::size_t count) {
+        handles.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            accountIdType id(static_cast<AccountId_IdPartType>(i + 1), "20230115");
+            if (i % 2 == 0) {
+                handles.push_back(store.insertPersonAccount(id, "FirstName", "LastName"));
+            } else {
+                handles.push_back(store.insertEnterpriseAccount(id, "1234567-8", "CompanyName"));
+            }
+        }
+    }
+
+    T_Store store;
+    std::vector<typename T_Store::Handle> handles;
+};
+
+}
+
+template<typename T_Store>
+static void BM_DispatchUpdate(benchmark::State& state) {
+
+    DispatchFixture<T_Store> fixture(static_cast<std::size_t>(state.range(0)));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.store.addToBalance(fixture.handles[i % fixture.handles.size()], 2));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_DispatchUpdate, ObjectAccountStore)->Arg(1000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_DispatchUpdate, VariantAccountStore)->Arg(1000)->Arg(1000000);
+
+template<typename T_Store>
+static void BM_DispatchDetails(benchmark::State& state) {
+
+    DispatchFixture<T_Store> fixture(static_cast<std::size_t>(state.range(0)));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.store.accountDetails(fixture.handles[i % fixture.handles.size()]));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_DispatchDetails, ObjectAccountStore)->Arg(1000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_DispatchDetails, VariantAccountStore)->Arg(1000)->Arg(1000000);
+
+//Batches of random top-ups and withdrawals over 1M accounts: applyOperations() against the
+//single-shot methods called in a loop. Arg is the batch size. The batches are generated
+//beforehand and cycled, so the accounts touched by a batch are usually not in the cache.
+namespace {
+
+template<typename T_Mgr>
+struct BatchFixture {
+    T_Mgr m_mgr;
+    std::vector<accountIdType> m_ids;
+
+    BatchFixture() : m_mgr(16), m_ids() {
+
+        m_ids.reserve(1000000);
+        for (int i = 0; i < 1000000; ++i) {
+            m_ids.push_back(m_mgr.insertNewPersonAccount("FirstName", "LastName"));
+        }
+    }
+
+    static BatchFixture& instance() {
+
+        static BatchFixture fixture;
+        return fixture;
+    }
+
+    std::vector<std::vector<AccountOperation>> batches(std::size_t batchSize) const {
+
+        std::vector<std::vector<AccountOperation>> result(std::max<std::size_t>(1, (1 << 20) / batchSize));
+        std::size_t cursor = 0;
+        for (std::vector<AccountOperation>& batch : result) {
+            batch.reserve(batchSize);
+            for (std::size_t i = 0; i < batchSize; ++i) {
+                cursor += 104729;
+                batch.push_back({m_ids[cursor % m_ids.size()], (i % 2 == 0) ? 2 : -1});
+            }
+        }
+        return result;
+    }
+};
+
+}
+
+template<typename T_Mgr>
+static void BM_BatchOperationsLoop(benchmark::State& state) {
+
+    BatchFixture<T_Mgr>& fixture = BatchFixture<T_Mgr>::instance();
+    std::vector<std::vector<AccountOperation>> batches = fixture.batches(static_cast<std::size_t>(state.range(0)));
+    std::size_t b = 0;
+    for (auto _ : state) {
+        for (const AccountOperation& op : batches[b]) {
+            if (op.amount >= 0) {
+                benchmark::DoNotOptimize(fixture.m_mgr.topUpAccount(op.id, op.amount));
+            } else {
+                benchmark::DoNotOptimize(fixture.m_mgr.withdrawFromAccount(op.id, -op.amount));
+            }
+        }
+        b = (b + 1) % batches.size();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_BatchOperationsLoop, AccountMgr)->RangeMultiplier(4)->Range(16, 4096);
+BENCHMARK_TEMPLATE(BM_BatchOperationsLoop, DataOrientedAccountMgr)->RangeMultiplier(4)->Range(16, 4096);
+
+template<typename T_Mgr>
+static void BM_BatchOperations(benchmark::State& state) {
+
+    BatchFixture<T_Mgr>& fixture = BatchFixture<T_Mgr>::instance();
+    std::vector<std::vector<AccountOperation>> batches = fixture.batches(static_cast<std::size_t>(state.range(0)));
+    std::size_t b = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.m_mgr.applyOperations(batches[b]));
+        b = (b + 1) % batches.size();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_BatchOperations, AccountMgr)->RangeMultiplier(4)->Range(16, 4096);
+BENCHMARK_TEMPLATE(BM_BatchOperations, DataOrientedAccountMgr)->RangeMultiplier(4)->Range(16, 4096);
+BENCHMARK_TEMPLATE(BM_BatchOperations, NodeAccountMgr)->RangeMultiplier(4)->Range(16, 4096);
+
+//Startup with 10M accounts: loading a snapshot against inserting them through the API.
+namespace {
+
+const char* const benchSnapshotPath = "tech_task_bench.snapshot";
+const int snapshotAccountCount = 10000000;
+
+}
+
+static void BM_StartupRebuild(benchmark::State& state) {
+
+    for (auto _ : state) {
+        AccountMgr mgr(64);
+        for (int i = 0; i < snapshotAccountCount; ++i) {
+            const accountIdType& id = mgr.insertNewPersonAccount("FirstName", "LastName");
+            mgr.topUpAccount(id, i);
+        }
+        benchmark::DoNotOptimize(mgr.size());
+        state.PauseTiming();
+        if (!mgr.saveSnapshot(benchSnapshotPath)) {
+            state.SkipWithError("Can't write the snapshot");
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * snapshotAccountCount);
+}
+BENCHMARK(BM_StartupRebuild)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_StartupLoadSnapshot(benchmark::State& state) {
+
+    for (auto _ : state) {
+        AccountMgr mgr(64);
+        if (!mgr.loadSnapshot(benchSnapshotPath)) {
+            state.SkipWithError("Run BM_StartupRebuild first to write the snapshot");
+            break;
+        }
+        benchmark::DoNotOptimize(mgr.size());
+    }
+    state.SetItemsProcessed(state.iterations() * snapshotAccountCount);
+    std::remove(benchSnapshotPath);
+}
+BENCHMARK(BM_StartupLoadSnapshot)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+
+//Bulk import of 1M accounts from CSV: a per row loader through the single insert API against importCsv().
+namespace {
+
+const char* const benchCsvPath = "tech_task_bench.csv";
+const int csvAccountCount = 1000000;
+
+void writeBenchCsv() {
+
+    std::ofstream out(benchCsvPath, std::ios::binary | std::ios::trunc);
+    out << "type,name,second name\n";
+    for (int i = 0; i < csvAccountCount; ++i) {
+        if (i % 4 == 0) {
+            out << "enterprise," << 1000000 + i << "-" << i % 10 << ",\"Company " << i << ", Oy\"\n";
+        } else {
+            out << "person,FirstName" << i << ",LastName" << i << "\n";
+        }
+    }
+}
+
+}
+
+static void BM_ImportRowLoop(benchmark::State& state) {
+
+    writeBenchCsv();
+    for (auto _ : state) {
+        AccountMgr mgr(64);
+        std::ifstream in(benchCsvPath);
+        std::string line;
+        std::getline(in, line);
+        while (std::getline(in, line)) {
+            //The loader of the migration: every field is copied into its own string.
+            std::vector<std::string> fields;
+            std::string field;
+            bool quoted = false;
+            for (char c : line) {
+                if (c == '"') {
+                    quoted = !quoted;
+                } else if ((c == ',') && !quoted) {
+                    fields.push_back(field);
+                    field.clear();
+                } else {
+                    field += c;
+                }
+            }
+            fields.push_back(field);
+            if (fields[0] == "person") {
+                mgr.insertNewPersonAccount(fields[1], fields[2]);
+            } else {
+                mgr.insertNewEnterpriseAccount(fields[1], fields[2]);
+            }
+        }
+        benchmark::DoNotOptimize(mgr.size());
+    }
+    state.SetItemsProcessed(state.iterations() * csvAccountCount);
+}
+BENCHMARK(BM_ImportRowLoop)->Iterations(3)->Unit(benchmark::kMillisecond);
+
+static void BM_ImportCsv(benchmark::State& state) {
+
+    for (auto _ : state) {
+        AccountMgr mgr(64);
+        CsvImportResult result = mgr.importCsv(benchCsvPath, static_cast<std::size_t>(state.range(0)));
+        if (result.ids.size() != static_cast<std::size_t>(csvAccountCount)) {
+            state.SkipWithError("Run BM_ImportRowLoop first to write the CSV file");
+            break;
+        }
+        benchmark::DoNotOptimize(mgr.size());
+    }
+    state.SetItemsProcessed(state.iterations() * csvAccountCount);
+}
+BENCHMARK(BM_ImportCsv)->Arg(1)->Arg(4)->Iterations(3)->Unit(benchmark::kMillisecond);
+
+
+//Rendering the details of 1M accounts: the former ostringstream rendering against
+//getAccountDetails() and the allocation free renderAccountDetails() into a buffer.
+namespace {
+
+struct DetailsFixture {
+    DetailsFixture() :
+        m_mgr(16)
+    {
+        for (int i = 0; i < 1000000; ++i) {
+            m_ids.push_back((i % 2 == 0) ? m_mgr.insertNewPersonAccount("FirstName", "LastName") : m_mgr.insertNewEnterpriseAccount(std::to_string(1000000 + i) + "-8", "CompanyName"));
+            m_mgr.topUpAccount(m_ids.back(), i);
+        }
+    }
+
+    static DetailsFixture& instance() {
+        static DetailsFixture fixture;
+
+        return fixture;
+    }
+
+    AccountMgr m_mgr;
+    std::vector<accountIdType> m_ids;
+};
+
+/** The rendering of AccountDetailsVisitor before AccountDetailsWriter. */
+class OstreamDetailsVisitor : public Visitor<AccountId_IdPartType> {
+public:
+    void VisitPersonAccount(const PersonAccount<AccountId_IdPartType>* account) override {
+        std::ostringstream s;
+        s << std::string("Account type: Person") << std::endl;
+        s << std::string("Account Id: id: ") << account->id().id() << ", creation date: \"" << account->id().creationDate() << "\"" << std::endl;
+        s << std::string("First Name: ") << account->firstName() << std::endl;
+        s << std::string("Last Name: ") << account->lastName() << std::endl;
+        s << std::string("Balance: ") << account->balance() << std::endl;
+        m_accountDetails = s.str();
+    }
+    void VisitEnterpriseAccount(const EnterpriseAccount<AccountId_IdPartType>* account) override {
+        std::ostringstream s;
+        s << std::string("Account type: Enterprise") << std::endl;
+        s << std::string("Account Id: id: ") << account->id().id() << ", creation date: \"" << account->id().creationDate() << "\"" << std::endl;
+        s << std::string("Y-Tunnus: ") << account->yTunnus() << std::endl;
+        s << std::string("Company Name: ") << account->companyName() << std::endl;
+        s << std::string("Balance: ") << account->balance() << std::endl;
+        m_accountDetails = s.str();
+    }
+
+    std::string m_accountDetails;
+};
+
+}
+
+static void BM_DetailsOstream(benchmark::State& state) {
+
+    //The store is used directly, the lookup is the same for all the renderings.
+    ObjectAccountStore store;
+    std::vector<ObjectAccountStore::Handle> handles;
+    for (int i = 0; i < 1000000; ++i) {
+        accountIdType id(i + 1, "20230115");
+        handles.push_back((i % 2 == 0) ? store.insertPersonAccount(id, "FirstName", "LastName") : store.insertEnterpriseAccount(id, "1234567-8", "CompanyName"));
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+        OstreamDetailsVisitor visitor;
+        store.accept(handles[i % handles.size()], &visitor);
+        std::string details = visitor.m_accountDetails;
+        benchmark::DoNotOptimize(details.data());
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DetailsOstream);
+
+static void BM_DetailsRenderToBuffer(benchmark::State& state) {
+
+    ObjectAccountStore store;
+    std::vector<ObjectAccountStore::Handle> handles;
+    for (int i = 0; i < 1000000; ++i) {
+        accountIdType id(i + 1, "20230115");
+        handles.push_back((i % 2 == 0) ? store.insertPersonAccount(id, "FirstName", "LastName") : store.insertEnterpriseAccount(id, "1234567-8", "CompanyName"));
+    }
+    const AccountDetailsFormat format = static_cast<AccountDetailsFormat>(state.range(0));
+    char buffer[256];
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store.renderAccountDetails(handles[i % handles.size()], buffer, format));
+        benchmark::ClobberMemory();
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DetailsRenderToBuffer)->Arg(static_cast<int>(AccountDetailsFormat::Text))->Arg(static_cast<int>(AccountDetailsFormat::Json));
+
+static void BM_GetAccountDetails(benchmark::State& state) {
+
+    DetailsFixture& fixture = DetailsFixture::instance();
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.m_mgr.getAccountDetails(fixture.m_ids[i % fixture.m_ids.size()]));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetAccountDetails);
+
+static void BM_RenderAccountDetails(benchmark::State& state) {
+
+    DetailsFixture& fixture = DetailsFixture::instance();
+    char buffer[256];
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.m_mgr.renderAccountDetails(fixture.m_ids[i % fixture.m_ids.size()], buffer, sizeof(buffer)));
+        benchmark::ClobberMemory();
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RenderAccountDetails);
+
+
+//Lookups from the id and the date typed by a user: a key holding a copy of the date, as
+//AccountId did before the date was packed, against building an AccountId and against an
+//AccountIdView. The allocations counter is the number of heap allocations per operation.
+namespace {
+
+struct TypedKeysFixture {
+    TypedKeysFixture() :
+        m_mgr(16)
+    {
+        for (int i = 0; i < benchAccountCount; ++i) {
+            const accountIdType& id = m_mgr.insertNewPersonAccount("FirstName", "LastName");
+            m_ids.push_back(id.id());
+            m_dates.push_back(id.creationDate());
+        }
+    }
+
+    static TypedKeysFixture& instance() {
+        static TypedKeysFixture fixture;
+
+        return fixture;
+    }
+
+    AccountMgr m_mgr;
+    std::vector<AccountId_IdPartType> m_ids;
+    std::vector<std::string> m_dates;
+};
+
+template<typename T_Lookup>
+void runTypedLookups(benchmark::State& state, T_Lookup lookup) {
+
+    TypedKeysFixture& fixture = TypedKeysFixture::instance();
+    std::size_t i = 0;
+    const std::uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        const std::size_t k = i % fixture.m_ids.size();
+        benchmark::DoNotOptimize(lookup(fixture.m_mgr, fixture.m_ids[k], fixture.m_dates[k]));
+        i += 7919;
+    }
+    state.counters["allocations"] = benchmark::Counter(static_cast<double>(g_allocations.load(std::memory_order_relaxed) - allocations), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+static void BM_TopUpCopiedDateKey(benchmark::State& state) {
+
+    runTypedLookups(state, [](AccountMgr& mgr, AccountId_IdPartType id, const std::string& date) {
+        const std::string copy(date.c_str());
+        return mgr.topUpAccount(accountIdType(id, copy), 1);
+    });
+}
+BENCHMARK(BM_TopUpCopiedDateKey);
+
+static void BM_TopUpAccountIdKey(benchmark::State& state) {
+
+    runTypedLookups(state, [](AccountMgr& mgr, AccountId_IdPartType id, const std::string& date) {
+        return mgr.topUpAccount(accountIdType(id, date), 1);
+    });
+}
+BENCHMARK(BM_TopUpAccountIdKey);
+
+static void BM_TopUpViewKey(benchmark::State& state) {
+
+    runTypedLookups(state, [](AccountMgr& mgr, AccountId_IdPartType id, const std::string& date) {
+        return mgr.topUpAccount(accountIdViewType{id, date}, 1);
+    });
+}
+BENCHMARK(BM_TopUpViewKey);
+
+static void BM_DetailsViewKey(benchmark::State& state) {
+
+    runTypedLookups(state, [](AccountMgr& mgr, AccountId_IdPartType id, const std::string& date) {
+        return mgr.getAccountDetails(accountIdViewType{id, date}).size();
+    });
+}
+BENCHMARK(BM_DetailsViewKey);
+
+
+//Hot paths of AccountMgr: insert, lookup hit and miss, top-up, withdrawal and details, on a
+//manager holding Arg accounts. The multi-threaded runs share the manager, which is built once
+//per run by the Setup hook, so the 10M account runs don't rebuild it for every thread count.
+namespace {
+
+const std::size_t hotPathShardCount = 64;
+
+std::unique_ptr<AccountMgr> g_hotMgr;
+std::vector<accountIdType> g_hotIds;
+
+void setUpHotPath(const benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    g_hotMgr.reset(new AccountMgr(hotPathShardCount));
+    std::vector<NewAccount> accounts(count, NewAccount{AccountKind::Person, "FirstName", "LastName"});
+    g_hotIds = g_hotMgr->insertNewAccounts(accounts);
+}
+
+void setUpFundedHotPath(const benchmark::State& state) {
+
+    setUpHotPath(state);
+    for (const accountIdType& id : g_hotIds) {
+        g_hotMgr->topUpAccount(id, 1 << 30);
+    }
+}
+
+void tearDownHotPath(const benchmark::State&) {
+
+    g_hotIds = std::vector<accountIdType>();
+    g_hotMgr.reset();
+}
+
+template<typename T_Operation>
+void runHotPath(benchmark::State& state, T_Operation operation) {
+
+    //Every thread walks the accounts with a large prime stride from its own start.
+    const std::size_t count = g_hotIds.size();
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * (count / static_cast<std::size_t>(state.threads()) + 1);
+    for (auto _ : state) {
+        operation(*g_hotMgr, g_hotIds[i % count]);
+        i += 1000003;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void hotPathArgs(benchmark::internal::Benchmark* b) {
+
+    b->Arg(1000)->Arg(1000000)->Arg(10000000)
+        ->Threads(1)->Threads(4)->Threads(16)
+        ->Setup(setUpHotPath)->Teardown(tearDownHotPath)
+        ->UseRealTime();
+}
+
+}
+
+static void BM_HotPathInsert(benchmark::State& state) {
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_hotMgr->insertNewPersonAccount("FirstName", "LastName"));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HotPathInsert)->Apply(hotPathArgs);
+
+static void BM_HotPathLookupHit(benchmark::State& state) {
+
+    runHotPath(state, [](AccountMgr& mgr, const accountIdType& id) {
+        benchmark::DoNotOptimize(mgr.hasAccount(id));
+    });
+}
+BENCHMARK(BM_HotPathLookupHit)->Apply(hotPathArgs);
+
+static void BM_HotPathLookupMiss(benchmark::State& state) {
+
+    //Same ids on another date: the hash differs, so the probes don't find the real account.
+    runHotPath(state, [](AccountMgr& mgr, const accountIdType& id) {
+        benchmark::DoNotOptimize(mgr.hasAccount(accountIdType(id.id(), id.packedCreationDate() + 1)));
+    });
+}
+BENCHMARK(BM_HotPathLookupMiss)->Apply(hotPathArgs);
+
+static void BM_HotPathTopUp(benchmark::State& state) {
+
+    runHotPath(state, [](AccountMgr& mgr, const accountIdType& id) {
+        benchmark::DoNotOptimize(mgr.topUpAccount(id, 1));
+    });
+}
+BENCHMARK(BM_HotPathTopUp)->Apply(hotPathArgs);
+
+static void BM_HotPathWithdraw(benchmark::State& state) {
+
+    runHotPath(state, [](AccountMgr& mgr, const accountIdType& id) {
+        benchmark::DoNotOptimize(mgr.withdrawFromAccount(id, 1));
+    });
+}
+BENCHMARK(BM_HotPathWithdraw)->Apply(hotPathArgs)->Setup(setUpFundedHotPath);
+
+static void BM_HotPathGetAccountDetails(benchmark::State& state) {
+
+    runHotPath(state, [](AccountMgr& mgr, const accountIdType& id) {
+        benchmark::DoNotOptimize(mgr.getAccountDetails(id));
+    });
+}
+BENCHMARK(BM_HotPathGetAccountDetails)->Apply(hotPathArgs);
+
+//What the metrics add to every operation: counting the call in the slab of the thread, and
+//for one call in Arg reading the clock twice and recording the latency. The whole overhead on
+//the hot paths is the difference between the BM_HotPath results of a build with and without
+//BUILD_METRICS.
+static void BM_MetricsRecord(benchmark::State& state) {
+
+    static AccountMetrics metrics;
+
+    if (state.thread_index() == 0) {
+        AccountMetrics::setSamplePeriod(static_cast<std::uint32_t>(state.range(0)));
+    }
+    for (auto _ : state) {
+        MetricsTimer timer;
+        timer.stop(metrics, MetricOperation::TopUp, MetricOutcome::Succeeded);
+    }
+    if (state.thread_index() == 0) {
+        AccountMetrics::setSamplePeriod(AccountMetrics::defaultSamplePeriod);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MetricsRecord)->Arg(1)->Arg(AccountMetrics::defaultSamplePeriod)->Threads(1)->Threads(4)->Threads(16)->UseRealTime();
+
+//Transfers while a read view is open. Arg 0 opens no view, 1 keeps a view open for the whole
+//run, 2 also scans it over and over from a thread of its own, like a long report. The versions
+//counter is the number of old balances kept at the end.
+namespace {
+
+std::optional<AccountMgr::ReadView> g_view;
+std::atomic<bool> g_scanning(false);
+std::thread g_scanner;
+
+}
+
+static void BM_TransferWithReadView(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(256);
+        for (const accountIdType& id : g_ids) {
+            g_mgr->topUpAccount(id, 1000000);
+        }
+        if (state.range(0) >= 1) {
+            g_view.emplace(g_mgr->openReadView());
+        }
+        if (state.range(0) >= 2) {
+            g_scanning = true;
+            g_scanner = std::thread([]() {
+                while (g_scanning.load()) {
+                    std::int64_t total = 0;
+                    g_view->forEachAccount([&total](const accountIdType&, AccountKind, const std::string&, const std::string&, int balance) {
+                        total += balance;
+                    });
+                    benchmark::DoNotOptimize(total);
+                }
+            });
+        }
+    }
+
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_mgr->transfer(g_ids[i % g_ids.size()], g_ids[(i + 52361) % g_ids.size()], 1));
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        if (g_scanner.joinable()) {
+            g_scanning = false;
+            g_scanner.join();
+        }
+        state.counters["versions"] = static_cast<double>(g_mgr->readViewVersions());
+        g_view.reset();
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_TransferWithReadView)
+    ->Arg(0)->Arg(1)->Arg(2)
+    ->Threads(1)->Threads(4)
+    ->UseRealTime();
+
+//A mix of account details read into a buffer and top-ups, Arg percent of them reads, e.g. 95
+//or 50. The reads take no lock, so they only compete with the top-ups for the cache lines of
+//the balances they share.
+static void BM_ReadWriteMix(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(hotPathShardCount);
+    }
+
+    const std::uint64_t readPercent = static_cast<std::uint64_t>(state.range(0));
+    std::uint32_t seed = static_cast<std::uint32_t>(state.thread_index()) + 1;
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    char buffer[256];
+    for (auto _ : state) {
+        seed = seed * 1664525u + 1013904223u;
+        const accountIdType& id = g_ids[i % g_ids.size()];
+        if ((seed >> 8) % 100 < readPercent) {
+            benchmark::DoNotOptimize(g_mgr->renderAccountDetails(id, buffer, sizeof(buffer)));
+        } else {
+            benchmark::DoNotOptimize(g_mgr->topUpAccount(id, 1));
+        }
+        i += 104729;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_ReadWriteMix)
+    ->Arg(95)->Arg(50)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)
+    ->UseRealTime();
+
+//Top-ups submitted to an AccountExecutor with Arg workers and completed by a callback. Every
+//thread waits for its own callbacks after the loop, so the time covers the whole round trip.
+namespace {
+
+std::unique_ptr<AccountExecutor> g_executor;
+
+}
+
+static void BM_ExecutorTopUp(benchmark::State& state) {
+
+    if (state.thread_index() == 0) {
+        setUpAccounts(hotPathShardCount);
+        g_executor.reset(new AccountExecutor(*g_mgr, static_cast<std::size_t>(state.range(0))));
+    }
+
+    std::atomic<std::int64_t> completed(0);
+    std::int64_t submitted = 0;
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 7919;
+    for (auto _ : state) {
+        g_executor->topUp(g_ids[i % g_ids.size()], 1, [&completed](OperationResult) {
+            completed.fetch_add(1, std::memory_order_release);
+        });
+        ++submitted;
+        i += 104729;
+    }
+    while (completed.load(std::memory_order_acquire) < submitted) {
+        std::this_thread::yield();
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        g_executor.reset();
+        tearDownAccounts();
+    }
+}
+BENCHMARK(BM_ExecutorTopUp)
+    ->Arg(1)->Arg(4)
+    ->Threads(1)->Threads(4)->Threads(16)
+    ->UseRealTime();
+
+
+//Lookups by the secondary indexes on a manager holding Arg persons and Arg enterprises. The
+//persons share 10000 last names. The bytes counters are the memory of each index per entry,
+//its strings included.
+namespace {
+
+const std::size_t indexLastNames = 10000;
+const std::size_t indexChunk = 100000;
+
+std::unique_ptr<AccountMgr> g_indexMgr;
+
+std::string indexYTunnus(std::size_t i) {
+
+    std::string yTunnus = std::to_string(1000000 + i % 9000000);
+    return yTunnus + "-" + std::to_string(i / 9000000);
+}
+
+std::string indexLastName(std::size_t i) {
+
+    return "Last" + std::to_string(10000 + i % indexLastNames);
+}
+
+void setUpIndexes(const benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    g_indexMgr.reset(new AccountMgr(hotPathShardCount));
+    //Inserted in chunks, so only the names of a chunk are held at once.
+    std::vector<std::string> names;
+    std::vector<NewAccount> accounts;
+    for (std::size_t begin = 0; begin < count; begin += indexChunk) {
+        const std::size_t end = std::min(count, begin + indexChunk);
+        names.clear();
+        accounts.clear();
+        for (std::size_t i = begin; i < end; ++i) {
+            names.push_back("First" + std::to_string(i));
+            names.push_back(indexLastName(i));
+            names.push_back(indexYTunnus(i));
+        }
+        for (std::size_t i = 0; i < end - begin; ++i) {
+            accounts.push_back(NewAccount{AccountKind::Person, names[3 * i], names[3 * i + 1]});
+            accounts.push_back(NewAccount{AccountKind::Enterprise, names[3 * i + 2], "Company Oy"});
+        }
+        g_indexMgr->insertNewAccounts(accounts);
+    }
+}
+
+void tearDownIndexes(const benchmark::State&) {
+
+    g_indexMgr.reset();
+}
+
+void indexArgs(benchmark::internal::Benchmark* b) {
+
+    b->Arg(1000000)->Arg(10000000)->Setup(setUpIndexes)->Teardown(tearDownIndexes);
+}
+
+void setIndexCounters(benchmark::State& state) {
+
+    const SecondaryIndexStats stats = g_indexMgr->indexStats();
+    state.counters["yTunnusBytesPerEntry"] = static_cast<double>(stats.yTunnusBytes) / static_cast<double>(stats.yTunnusEntries);
+    state.counters["personBytesPerEntry"] = static_cast<double>(stats.personBytes) / static_cast<double>(stats.personEntries);
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+static void BM_IndexFindByYTunnus(benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> keys;
+    for (std::size_t i = 0; i < 4096; ++i) {
+        keys.push_back(indexYTunnus(i * 1000003 % count));
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_indexMgr->findByYTunnus(keys[i++ % keys.size()]));
+    }
+    setIndexCounters(state);
+}
+BENCHMARK(BM_IndexFindByYTunnus)->Apply(indexArgs);
+
+static void BM_IndexFindPersonByName(benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::pair<std::string, std::string> > keys;
+    for (std::size_t i = 0; i < 4096; ++i) {
+        const std::size_t k = i * 1000003 % count;
+        keys.emplace_back(indexLastName(k), "First" + std::to_string(k));
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const std::pair<std::string, std::string>& key = keys[i++ % keys.size()];
+        benchmark::DoNotOptimize(g_indexMgr->findPersonsByName(key.first, key.second, 1));
+    }
+    setIndexCounters(state);
+}
+BENCHMARK(BM_IndexFindPersonByName)->Apply(indexArgs);
+
+static void BM_IndexLastNamePrefix(benchmark::State& state) {
+
+    //The first 10 persons whose last name starts with a prefix matching 10 last names.
+    std::vector<std::string> keys;
+    for (std::size_t i = 0; i < 4096; ++i) {
+        keys.push_back(indexLastName(i * 10007).substr(0, 8));
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_indexMgr->findPersonsByLastNamePrefix(keys[i++ % keys.size()], 10));
+    }
+    setIndexCounters(state);
+}
+BENCHMARK(BM_IndexLastNamePrefix)->Apply(indexArgs);
+
+
+//Aggregate queries over Arg accounts, 9 persons to 1 enterprise, a fifth of them with a
+//balance of 0. BM_AggregateTotalBalance is the scalar scan of totalBalance(), shard after shard.
+//The second argument is the number of threads scanning, 0 for one per core.
+namespace {
+
+const std::size_t aggregateAccounts = 10000000;
+
+template<typename T_Mgr>
+std::unique_ptr<T_Mgr> g_aggregateMgr;
+
+template<typename T_Mgr>
+void setUpAggregates(const benchmark::State& state) {
+
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    g_aggregateMgr<T_Mgr>.reset(new T_Mgr(hotPathShardCount));
+    std::vector<NewAccount> accounts;
+    std::vector<std::string> yTunnus;
+    yTunnus.reserve(count / 10 + 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i % 10 == 0) {
+            yTunnus.push_back(std::to_string(1000000 + i / 10) + "-8");
+            accounts.push_back(NewAccount{AccountKind::Enterprise, yTunnus.back(), "CompanyName"});
+        } else {
+            accounts.push_back(NewAccount{AccountKind::Person, "FirstName", "LastName"});
+        }
+    }
+    const std::vector<accountIdType> ids = g_aggregateMgr<T_Mgr>->insertNewAccounts(accounts);
+    std::size_t k = 1;
+    for (const accountIdType& id : ids) {
+        k = k * 6364136223846793005ULL + 1442695040888963407ULL;
+        if ((k >> 60) % 5 != 0) {
+            g_aggregateMgr<T_Mgr>->topUpAccount(id, static_cast<int>((k >> 33) % 1000000) + 1);
+        }
+    }
+}
+
+template<typename T_Mgr>
+void tearDownAggregates(const benchmark::State&) {
+
+    g_aggregateMgr<T_Mgr>.reset();
+}
+
+template<typename T_Mgr>
+void aggregateSetUp(benchmark::internal::Benchmark* b) {
+
+    b->Setup(setUpAggregates<T_Mgr>)->Teardown(tearDownAggregates<T_Mgr>)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+template<typename T_Mgr>
+void aggregateArgs(benchmark::internal::Benchmark* b) {
+
+    aggregateSetUp<T_Mgr>(b);
+    b->Args({static_cast<std::int64_t>(aggregateAccounts), 1})->Args({static_cast<std::int64_t>(aggregateAccounts), 0});
+}
+
+template<typename T_Query>
+void runAggregates(benchmark::State& state, T_Query query) {
+
+    for (auto _ : state) {
+        query(static_cast<std::size_t>(state.range(1)));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}
+
+template<typename T_Mgr>
+static void BM_AggregateTotalBalance(benchmark::State& state) {
+
+    runAggregates(state, [](std::size_t) {
+        benchmark::DoNotOptimize(g_aggregateMgr<T_Mgr>->totalBalance());
+    });
+}
+BENCHMARK_TEMPLATE(BM_AggregateTotalBalance, AccountMgr)->Apply(aggregateSetUp<AccountMgr>)->Args({static_cast<std::int64_t>(aggregateAccounts), 1});
+BENCHMARK_TEMPLATE(BM_AggregateTotalBalance, DataOrientedAccountMgr)->Apply(aggregateSetUp<DataOrientedAccountMgr>)->Args({static_cast<std::int64_t>(aggregateAccounts), 1});
+
+template<typename T_Mgr>
+static void BM_AggregateBalances(benchmark::State& state) {
+
+    runAggregates(state, [](std::size_t threads) {
+        benchmark::DoNotOptimize(g_aggregateMgr<T_Mgr>->aggregateBalances(AccountFilter::All, threads));
+    });
+}
+BENCHMARK_TEMPLATE(BM_AggregateBalances, AccountMgr)->Apply(aggregateArgs<AccountMgr>);
+BENCHMARK_TEMPLATE(BM_AggregateBalances, DataOrientedAccountMgr)->Apply(aggregateArgs<DataOrientedAccountMgr>);
+
+template<typename T_Mgr>
+static void BM_AggregateEnterpriseBalances(benchmark::State& state) {
+
+    runAggregates(state, [](std::size_t threads) {
+        benchmark::DoNotOptimize(g_aggregateMgr<T_Mgr>->aggregateBalances(AccountFilter::Enterprises, threads));
+    });
+}
+BENCHMARK_TEMPLATE(BM_AggregateEnterpriseBalances, AccountMgr)->Apply(aggregateArgs<AccountMgr>);
+BENCHMARK_TEMPLATE(BM_AggregateEnterpriseBalances, DataOrientedAccountMgr)->Apply(aggregateArgs<DataOrientedAccountMgr>);
+
+template<typename T_Mgr>
+static void BM_AggregateHistogram(benchmark::State& state) {
+
+    const std::vector<int> bounds = {1, 10, 100, 1000, 10000, 100000, 500000};
+    runAggregates(state, [&bounds](std::size_t threads) {
+        benchmark::DoNotOptimize(g_aggregateMgr<T_Mgr>->balanceHistogram(bounds, AccountFilter::All, threads));
+    });
+}
+BENCHMARK_TEMPLATE(BM_AggregateHistogram, AccountMgr)->Apply(aggregateArgs<AccountMgr>);
+BENCHMARK_TEMPLATE(BM_AggregateHistogram, DataOrientedAccountMgr)->Apply(aggregateArgs<DataOrientedAccountMgr>);
+
+template<typename T_Mgr>
+static void BM_AggregateTop100(benchmark::State& state) {
+
+    runAggregates(state, [](std::size_t threads) {
+        benchmark::DoNotOptimize(g_aggregateMgr<T_Mgr>->topBalances(100, AccountFilter::All, threads));
+    });
+}
+BENCHMARK_TEMPLATE(BM_AggregateTop100, AccountMgr)->Apply(aggregateArgs<AccountMgr>);
+BENCHMARK_TEMPLATE(BM_AggregateTop100, DataOrientedAccountMgr)->Apply(aggregateArgs<DataOrientedAccountMgr>);
@@ -0,0 +1,170 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <accountClient.h>
+
+#include <cerrno>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/** The size of every read from the socket. */
+constexpr std::size_t readChunk = 64 * 1024;
+
+}
+
+AccountClient::AccountClient() :
+    m_fd(-1),
+    m_tag(0),
+    m_out(),
+    m_in(),
+    m_inBegin(0)
+{}
+
+AccountClient::~AccountClient() {
+
+    close();
+}
+
+bool AccountClient::connect(const std::string& address, std::uint16_t port) {
+
+    close();
+    sockaddr_in addr = sockaddr_in();
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) return false;
+
+    m_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) return false;
+    if (::connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close();
+        return false;
+    }
+    int one = 1;
+    ::setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+void AccountClient::close() {
+
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_out.clear();
+    m_in.clear();
+    m_inBegin = 0;
+}
+
+std::uint32_t AccountClient::nextTag() {
+
+    return ++m_tag;
+}
+
+std::uint32_t AccountClient::createPersonAccount(std::string_view firstName, std::string_view lastName) {
+
+    const std::uint32_t tag = nextTag();
+    encodeCreateRequest(m_out, tag, RequestType::CreatePerson, firstName, lastName);
+    return tag;
+}
+
+std::uint32_t AccountClient::createEnterpriseAccount(std::string_view yTunnus, std::string_view companyName) {
+
+    const std::uint32_t tag = nextTag();
+    encodeCreateRequest(m_out, tag, RequestType::CreateEnterprise, yTunnus, companyName);
+    return tag;
+}
+
+std::uint32_t AccountClient::topUp(const accountIdType& id, int amount) {
+
+    const std::uint32_t tag = nextTag();
+    encodeBalanceRequest(m_out, tag, RequestType::TopUp, id, amount);
+    return tag;
+}
+
+std::uint32_t AccountClient::withdraw(const accountIdType& id, int amount) {
+
+    const std::uint32_t tag = nextTag();
+    encodeBalanceRequest(m_out, tag, RequestType::Withdraw, id, amount);
+    return tag;
+}
+
+std::uint32_t AccountClient::transfer(const accountIdType& from, const accountIdType& to, int amount) {
+
+    const std::uint32_t tag = nextTag();
+    encodeTransferRequest(m_out, tag, from, to, amount);
+    return tag;
+}
+
+std::uint32_t AccountClient::details(const accountIdType& id) {
+
+    const std::uint32_t tag = nextTag();
+    encodeDetailsRequest(m_out, tag, id);
+    return tag;
+}
+
+void AccountClient::queueRaw(std::string_view bytes) {
+
+    m_out += bytes;
+}
+
+bool AccountClient::flush() {
+
+    if (m_fd < 0) return false;
+    std::size_t offset = 0;
+    while (offset < m_out.size()) {
+        ssize_t sent = ::send(m_fd, m_out.data() + offset, m_out.size() - offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        offset += static_cast<std::size_t>(sent);
+    }
+    m_out.clear();
+    return true;
+}
+
+bool AccountClient::receive(Response& response) {
+
+    if (m_fd < 0) return false;
+    if (m_inBegin == m_in.size()) {
+        m_in.clear();
+        m_inBegin = 0;
+    }
+    while (true) {
+        std::size_t frameSize;
+        FrameResult result = decodeResponse(m_in.data() + m_inBegin, m_in.size() - m_inBegin, response, frameSize);
+        if (result == FrameResult::Complete) {
+            m_inBegin += frameSize;
+            return true;
+        }
+        if (result == FrameResult::Malformed) return false;
+
+        //The decoded details point into the buffer, so it's only compacted before reading more.
+        if (m_inBegin > 0) {
+            m_in.erase(0, m_inBegin);
+            m_inBegin = 0;
+        }
+        const std::size_t used = m_in.size();
+        m_in.resize(used + readChunk);
+        ssize_t received = ::recv(m_fd, &m_in[used], readChunk, 0);
+        if (received < 0 && errno == EINTR) {
+            m_in.resize(used);
+            continue;
+        }
+        if (received <= 0) {
+            m_in.resize(used);
+            return false;
+        }
+        m_in.resize(used + static_cast<std::size_t>(received));
+    }
+}
\ No newline at end of file
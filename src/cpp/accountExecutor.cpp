@@ -0,0 +1,375 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <accountExecutor.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+/** Counts down the requests of a blocking batch, and wakes up its caller after the last one. */
+class BatchLatch {
+public:
+    explicit BatchLatch(std::size_t count) :
+        m_remaining(count),
+        m_finished(count == 0)
+    {}
+
+    void countDown() {
+
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished = true;
+            m_done.notify_one();
+        }
+    }
+
+    void wait() {
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_finished; });
+    }
+
+private:
+    std::atomic<std::size_t> m_remaining;
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    bool m_finished;
+};
+
+}
+
+template<typename T_Store>
+BasicAccountExecutor<T_Store>::BasicAccountExecutor(BasicAccountMgr<T_Store>& mgr, std::size_t workerCount) :
+    m_mgr(mgr),
+    m_workerCount(std::min(std::max<std::size_t>(workerCount == 0 ? std::thread::hardware_concurrency() : workerCount, 1), mgr.shardCount())),
+    m_workers(new Worker[m_workerCount]),
+    m_stopping(false)
+{
+    for (std::size_t w = 0; w < m_workerCount; ++w) {
+        m_workers[w].m_thread = std::thread(&BasicAccountExecutor::run, this, w);
+    }
+    m_mgr.m_executor = this;
+}
+
+template<typename T_Store>
+BasicAccountExecutor<T_Store>::~BasicAccountExecutor() {
+
+    m_stopping.store(true, std::memory_order_seq_cst);
+    for (std::size_t w = 0; w < m_workerCount; ++w) {
+        {
+            std::lock_guard<std::mutex> lock(m_workers[w].m_mutex);
+            m_workers[w].m_wakeUp.notify_one();
+        }
+        m_workers[w].m_thread.join();
+    }
+    m_mgr.m_executor = nullptr;
+}
+
+template<typename T_Store>
+std::size_t BasicAccountExecutor<T_Store>::workerCount() const {
+
+    return m_workerCount;
+}
+
+template<typename T_Store>
+std::future<accountIdType> BasicAccountExecutor<T_Store>::createPersonAccount(const std::string& firstName, const std::string& lastName) {
+
+    return submitWithFuture<accountIdType>(RequestKind::CreatePerson, m_mgr.newAccountId(), 0, firstName, lastName);
+}
+
+template<typename T_Store>
+std::future<accountIdType> BasicAccountExecutor<T_Store>::createEnterpriseAccount(const std::string& yTunnus, const std::string& companyName) {
+
+    return submitWithFuture<accountIdType>(RequestKind::CreateEnterprise, m_mgr.newAccountId(), 0, yTunnus, companyName);
+}
+
+template<typename T_Store>
+std::future<OperationResult> BasicAccountExecutor<T_Store>::topUp(const accountIdType& id, int amount) {
+
+    return submitWithFuture<OperationResult>(RequestKind::TopUp, id, amount, std::string_view(), std::string_view());
+}
+
+template<typename T_Store>
+std::future<OperationResult> BasicAccountExecutor<T_Store>::withdraw(const accountIdType& id, int amount) {
+
+    return submitWithFuture<OperationResult>(RequestKind::Withdraw, id, amount, std::string_view(), std::string_view());
+}
+
+template<typename T_Store>
+std::future<std::string> BasicAccountExecutor<T_Store>::details(const accountIdType& id) {
+
+    return submitWithFuture<std::string>(RequestKind::Details, id, 0, std::string_view(), std::string_view());
+}
+
+template<typename T_Store>
+accountIdType BasicAccountExecutor<T_Store>::insertNewPersonAccount(const std::string& firstName, const std::string& lastName) {
+
+    return createPersonAccount(firstName, lastName).get();
+}
+
+template<typename T_Store>
+accountIdType BasicAccountExecutor<T_Store>::insertNewEnterpriseAccount(const std::string& yTunnus, const std::string& companyName) {
+
+    return createEnterpriseAccount(yTunnus, companyName).get();
+}
+
+template<typename T_Store>
+bool BasicAccountExecutor<T_Store>::topUpAccount(const accountIdType& id, int amount) {
+
+    return topUp(id, amount).get() == OperationResult::Applied;
+}
+
+template<typename T_Store>
+bool BasicAccountExecutor<T_Store>::withdrawFromAccount(const accountIdType& id, int amount) {
+
+    return withdraw(id, amount).get() == OperationResult::Applied;
+}
+
+template<typename T_Store>
+std::string BasicAccountExecutor<T_Store>::getAccountDetails(const accountIdType& id) {
+
+    return details(id).get();
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::applyOperations(const AccountOperation* operations, std::size_t count, OperationResult* results) {
+
+    BatchLatch latch(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        OperationResult* result = results + i;
+        auto callback = [result, &latch](OperationResult operationResult) {
+            *result = operationResult;
+            latch.countDown();
+        };
+        const int amount = operations[i].amount;
+        if (amount >= 0) {
+            topUp(operations[i].id, amount, callback);
+        } else if (amount != std::numeric_limits<int>::min()) {
+            withdraw(operations[i].id, -amount, callback);
+        } else {
+            callback(OperationResult::Rejected);
+        }
+    }
+    latch.wait();
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::insertNewAccounts(const NewAccount* accounts, std::size_t count, accountIdType* ids) {
+
+    BatchLatch latch(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        accountIdType* id = ids + i;
+        auto callback = [id, &latch](const accountIdType& insertedId) {
+            *id = insertedId;
+            latch.countDown();
+        };
+        const RequestKind kind = (accounts[i].kind == AccountKind::Person) ? RequestKind::CreatePerson : RequestKind::CreateEnterprise;
+        submit<accountIdType>(kind, m_mgr.newAccountId(), 0, accounts[i].name, accounts[i].secondName, std::move(callback));
+    }
+    latch.wait();
+}
+
+template<typename T_Store>
+std::size_t BasicAccountExecutor<T_Store>::workerOf(const accountIdType& id) const {
+
+    return m_mgr.shardOf(id) % m_workerCount;
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::enqueue(std::size_t worker, Request* request) {
+
+    Worker& target = m_workers[worker];
+    target.m_queue.push(request);
+    //The push and this load are sequentially consistent, like the flag and the check of the
+    //queue by the worker going to sleep: either it sees the request or this sees it asleep.
+    if (target.m_sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(target.m_mutex);
+        target.m_wakeUp.notify_one();
+    }
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::idle(Worker& worker) {
+
+    for (int spin = 0; spin < idleSpins; ++spin) {
+        if (!worker.m_queue.empty() || m_stopping.load(std::memory_order_relaxed)) return;
+        std::this_thread::yield();
+    }
+    worker.m_sleeping.store(true, std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(worker.m_mutex);
+        worker.m_wakeUp.wait(lock, [this, &worker]() {
+            return !worker.m_queue.empty() || m_stopping.load(std::memory_order_seq_cst);
+        });
+    }
+    worker.m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::run(std::size_t index) {
+
+    Worker& worker = m_workers[index];
+    std::vector<Request*> batch;
+    std::vector<AccountOperation> operations;
+    std::vector<OperationResult> results;
+    std::vector<Request*> operationRequests;
+    std::vector<NewAccount> accounts;
+    std::vector<accountIdType> ids;
+    std::vector<Request*> accountRequests;
+    batch.reserve(maxBatch);
+
+    auto applyOperations = [this, &operations, &results, &operationRequests]() {
+        if (operations.empty()) return;
+
+        results.resize(operations.size());
+        m_mgr.applyBatch(operations.data(), operations.size(), results.data(), true);
+        for (std::size_t i = 0; i < operationRequests.size(); ++i) {
+            operationRequests[i]->m_result = results[i];
+            operationRequests[i]->complete();
+        }
+        operations.clear();
+        operationRequests.clear();
+    };
+    auto insertAccounts = [this, &accounts, &ids, &accountRequests]() {
+        if (accounts.empty()) return;
+
+        m_mgr.insertAccounts(accounts.data(), accounts.size(), ids.data());
+        for (std::size_t i = 0; i < accountRequests.size(); ++i) {
+            accountRequests[i]->m_id = ids[i];
+            accountRequests[i]->complete();
+        }
+        accounts.clear();
+        ids.clear();
+        accountRequests.clear();
+    };
+
+    for (;;) {
+        batch.clear();
+        while (batch.size() < maxBatch) {
+            Request* request = worker.m_queue.pop();
+            if (request == nullptr) break;
+            batch.push_back(request);
+        }
+        if (batch.empty()) {
+            if (m_stopping.load(std::memory_order_seq_cst) && worker.m_queue.empty()) return;
+            idle(worker);
+            continue;
+        }
+
+        for (Request* request : batch) {
+            switch (request->m_kind) {
+            case RequestKind::CreatePerson:
+            case RequestKind::CreateEnterprise:
+                //Nobody knows the new ids yet, so the creations can't be reordered with anything.
+                accounts.push_back(NewAccount{(request->m_kind == RequestKind::CreatePerson) ? AccountKind::Person : AccountKind::Enterprise, request->m_name, request->m_secondName});
+                ids.push_back(request->m_id);
+                accountRequests.push_back(request);
+                break;
+            case RequestKind::TopUp:
+            case RequestKind::Withdraw:
+                //A negative amount would turn into the opposite operation in the batch, while the
+                //manager refuses it. A zero one is applied, as by the manager.
+                if (request->m_amount < 0) {
+                    request->m_result = OperationResult::Rejected;
+                    request->complete();
+                    break;
+                }
+                operations.push_back(AccountOperation{request->m_id, (request->m_kind == RequestKind::TopUp) ? request->m_amount : -request->m_amount});
+                operationRequests.push_back(request);
+                break;
+            case RequestKind::Details:
+                //The details see the operations submitted before them.
+                applyOperations();
+                request->m_details = m_mgr.getAccountDetails(request->m_id);
+                request->complete();
+                break;
+            case RequestKind::Park:
+                applyOperations();
+                insertAccounts();
+                request->complete();
+                break;
+            }
+        }
+        applyOperations();
+        insertAccounts();
+    }
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::ParkRequest::complete() {
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_parked = true;
+        m_changed.notify_all();
+        m_changed.wait(lock, [this]() { return m_resumed; });
+    }
+    delete this;
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::ParkRequest::waitParked() {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this]() { return m_parked; });
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::ParkRequest::resume() {
+
+    //Notified under the lock: the worker deletes the request once it gets the lock back.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_resumed = true;
+    m_changed.notify_all();
+}
+
+template<typename T_Store>
+BasicAccountExecutor<T_Store>::Pause::Pause(BasicAccountExecutor& executor, std::size_t firstShard, std::size_t secondShard) :
+    m_requests()
+{
+    m_requests.reserve(2);
+    const std::size_t first = firstShard % executor.m_workerCount;
+    const std::size_t second = secondShard % executor.m_workerCount;
+    park(executor, std::min(first, second));
+    if (first != second) {
+        park(executor, std::max(first, second));
+    }
+}
+
+template<typename T_Store>
+BasicAccountExecutor<T_Store>::Pause::Pause(BasicAccountExecutor& executor) :
+    m_requests()
+{
+    m_requests.reserve(executor.m_workerCount);
+    for (std::size_t w = 0; w < executor.m_workerCount; ++w) {
+        park(executor, w);
+    }
+}
+
+template<typename T_Store>
+BasicAccountExecutor<T_Store>::Pause::~Pause() {
+
+    for (auto it = m_requests.rbegin(); it != m_requests.rend(); ++it) {
+        (*it)->resume();
+    }
+}
+
+template<typename T_Store>
+void BasicAccountExecutor<T_Store>::Pause::park(BasicAccountExecutor& executor, std::size_t worker) {
+
+    ParkRequest* request = new ParkRequest();
+    executor.enqueue(worker, request);
+    request->waitParked();
+    m_requests.push_back(request);
+}
+
+template class BasicAccountExecutor<ObjectAccountStore>;
+template class BasicAccountExecutor<DataOrientedAccountStore>;
+template class BasicAccountExecutor<VariantAccountStore>;
+template class BasicAccountExecutor<NodeObjectAccountStore>;
\ No newline at end of file
@@ -0,0 +1,346 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <accountMetrics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+/** The percentiles printed by the dumps, and their names. */
+constexpr double dumpPercentiles[] = {50.0, 90.0, 99.0, 99.9};
+constexpr const char* dumpPercentileNames[] = {"p50", "p90", "p99", "p99.9"};
+
+/**
+ * @brief Appends printf-formatted text to a string.
+ */
+template<typename... T_Args>
+void appendFormat(std::string& text, const char* format, T_Args... args) {
+
+    char buffer[256];
+    const int length = std::snprintf(buffer, sizeof(buffer), format, args...);
+    if (length > 0) {
+        text.append(buffer, std::min(static_cast<std::size_t>(length), sizeof(buffer) - 1));
+    }
+}
+
+}
+
+const char* metricOperationName(MetricOperation operation) {
+
+    switch (operation) {
+    case MetricOperation::TopUp: return "top_up";
+    case MetricOperation::Withdraw: return "withdraw";
+    case MetricOperation::Transfer: return "transfer";
+    case MetricOperation::InsertAccount: return "insert_account";
+    case MetricOperation::AccountDetails: return "account_details";
+    }
+    return "unknown";
+}
+
+const char* metricOutcomeName(MetricOutcome outcome) {
+
+    switch (outcome) {
+    case MetricOutcome::Succeeded: return "succeeded";
+    case MetricOutcome::AccountNotFound: return "account_not_found";
+    case MetricOutcome::InvalidRequest: return "invalid_request";
+    case MetricOutcome::InsufficientFunds: return "insufficient_funds";
+    case MetricOutcome::BalanceLimit: return "balance_limit";
+    }
+    return "unknown";
+}
+
+std::uint64_t LatencyHistogram::bucketHighest(std::size_t bucket) {
+
+    if (bucket < subBucketCount) return bucket;
+    const unsigned shift = static_cast<unsigned>(bucket / subBucketCount) - 1;
+    const std::uint64_t lowest = static_cast<std::uint64_t>(subBucketCount + bucket % subBucketCount) << shift;
+    return lowest + (std::uint64_t(1) << shift) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() :
+    m_buckets(bucketCount, 0),
+    m_count(0)
+{}
+
+void LatencyHistogram::record(std::uint64_t nanos) {
+
+    add(bucketOf(nanos), 1);
+}
+
+void LatencyHistogram::add(std::size_t bucket, std::uint64_t count) {
+
+    m_buckets[std::min(bucket, bucketCount - 1)] += count;
+    m_count += count;
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other) {
+
+    for (std::size_t i = 0; i < bucketCount; ++i) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+    return *this;
+}
+
+std::uint64_t LatencyHistogram::count() const {
+
+    return m_count;
+}
+
+std::uint64_t LatencyHistogram::percentile(double percent) const {
+
+    if (m_count == 0) return 0;
+
+    //The rank of the latency, from 1 to m_count.
+    const double clamped = std::min(std::max(percent, 0.0), 100.0);
+    const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(m_count))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) return bucketHighest(i);
+    }
+    return bucketHighest(bucketCount - 1);
+}
+
+std::uint64_t OperationMetrics::calls() const {
+
+    std::uint64_t calls = 0;
+    for (std::uint64_t count : outcomes) {
+        calls += count;
+    }
+    return calls;
+}
+
+std::uint64_t OperationMetrics::failures() const {
+
+    return calls() - outcomes[static_cast<std::size_t>(MetricOutcome::Succeeded)];
+}
+
+double OperationMetrics::meanNanos() const {
+
+    const std::uint64_t n = latency.count();
+    return (n == 0) ? 0.0 : static_cast<double>(totalNanos) / static_cast<double>(n);
+}
+
+std::uint64_t OperationMetrics::percentileNanos(double percent) const {
+
+    return std::min(latency.percentile(percent), maxNanos);
+}
+
+OperationMetrics& OperationMetrics::operator+=(const OperationMetrics& other) {
+
+    for (std::size_t i = 0; i < metricOutcomeCount; ++i) {
+        outcomes[i] += other.outcomes[i];
+    }
+    totalNanos += other.totalNanos;
+    maxNanos = std::max(maxNanos, other.maxNanos);
+    latency += other.latency;
+    return *this;
+}
+
+const OperationMetrics& MetricsSnapshot::operation(MetricOperation operation) const {
+
+    return operations[static_cast<std::size_t>(operation)];
+}
+
+double MetricsSnapshot::loadFactor() const {
+
+    return (indexSlots == 0) ? 0.0 : static_cast<double>(accounts) / static_cast<double>(indexSlots);
+}
+
+std::string MetricsSnapshot::toText() const {
+
+    std::string text;
+    if (!enabled) {
+        text += "Operation metrics compiled out\n";
+    } else {
+        appendFormat(text, "%-16s %12s %10s %10s %10s", "operation", "calls", "failed", "timed", "mean_ns");
+        for (const char* name : dumpPercentileNames) {
+            appendFormat(text, " %10s", (std::string(name) + "_ns").c_str());
+        }
+        appendFormat(text, " %10s\n", "max_ns");
+        for (std::size_t i = 0; i < metricOperationCount; ++i) {
+            const OperationMetrics& op = operations[i];
+            appendFormat(text, "%-16s %12llu %10llu %10llu %10.0f", metricOperationName(static_cast<MetricOperation>(i)),
+                         static_cast<unsigned long long>(op.calls()), static_cast<unsigned long long>(op.failures()),
+                         static_cast<unsigned long long>(op.latency.count()), op.meanNanos());
+            for (double percent : dumpPercentiles) {
+                appendFormat(text, " %10llu", static_cast<unsigned long long>(op.percentileNanos(percent)));
+            }
+            appendFormat(text, " %10llu\n", static_cast<unsigned long long>(op.maxNanos));
+        }
+        for (std::size_t i = 0; i < metricOperationCount; ++i) {
+            if (operations[i].failures() == 0) continue;
+            appendFormat(text, "%s failures:", metricOperationName(static_cast<MetricOperation>(i)));
+            for (std::size_t o = 1; o < metricOutcomeCount; ++o) {
+                if (operations[i].outcomes[o] == 0) continue;
+                appendFormat(text, " %s %llu", metricOutcomeName(static_cast<MetricOutcome>(o)), static_cast<unsigned long long>(operations[i].outcomes[o]));
+            }
+            text += '\n';
+        }
+    }
+    appendFormat(text, "accounts %zu in %zu shards (largest %zu, smallest %zu), index load factor %.3f (highest shard %.3f)\n",
+                 accounts, shards, largestShard, smallestShard, loadFactor(), maxShardLoadFactor);
+    return text;
+}
+
+std::string MetricsSnapshot::toJson() const {
+
+    std::string json;
+    appendFormat(json, "{\"enabled\":%s,\"operations\":{", enabled ? "true" : "false");
+    for (std::size_t i = 0; i < metricOperationCount; ++i) {
+        const OperationMetrics& op = operations[i];
+        appendFormat(json, "%s\"%s\":{\"calls\":%llu,\"outcomes\":{", (i == 0) ? "" : ",", metricOperationName(static_cast<MetricOperation>(i)),
+                     static_cast<unsigned long long>(op.calls()));
+        for (std::size_t o = 0; o < metricOutcomeCount; ++o) {
+            appendFormat(json, "%s\"%s\":%llu", (o == 0) ? "" : ",", metricOutcomeName(static_cast<MetricOutcome>(o)), static_cast<unsigned long long>(op.outcomes[o]));
+        }
+        appendFormat(json, "},\"latency_ns\":{\"timed\":%llu,\"mean\":%.1f", static_cast<unsigned long long>(op.latency.count()), op.meanNanos());
+        for (std::size_t p = 0; p < sizeof(dumpPercentiles) / sizeof(dumpPercentiles[0]); ++p) {
+            appendFormat(json, ",\"%s\":%llu", dumpPercentileNames[p], static_cast<unsigned long long>(op.percentileNanos(dumpPercentiles[p])));
+        }
+        appendFormat(json, ",\"max\":%llu}}", static_cast<unsigned long long>(op.maxNanos));
+    }
+    appendFormat(json, "},\"gauges\":{\"shards\":%zu,\"accounts\":%zu,\"index_slots\":%zu,\"load_factor\":%.4f,\"largest_shard\":%zu,\"smallest_shard\":%zu,\"max_shard_load_factor\":%.4f}}",
+                 shards, accounts, indexSlots, loadFactor(), largestShard, smallestShard, maxShardLoadFactor);
+    return json;
+}
+
+#ifdef ACCOUNT_METRICS
+
+std::atomic<std::uint32_t> AccountMetrics::s_samplePeriod(AccountMetrics::defaultSamplePeriod);
+
+namespace {
+
+/** Ids of the AccountMetrics objects, so a thread never takes a new object for a destroyed one at the same address. */
+std::atomic<std::uint64_t> g_nextMetricsId(1);
+
+/**
+ * @brief Adds to a counter only its thread writes. A plain load and store, without the
+ * locked instruction of fetch_add, since no write can be lost.
+ */
+inline void addToCounter(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+}
+
+/**
+ * @brief The counters a thread records into. Only the thread writes them, the snapshots
+ * read them.
+ */
+struct AccountMetrics::ThreadSlab {
+    //The counters of every call fill the first cache line, the buckets are only written by the timed calls.
+    struct alignas(64) Operation {
+        std::atomic<std::uint64_t> m_outcomes[metricOutcomeCount];
+        std::atomic<std::uint64_t> m_totalNanos;
+        std::atomic<std::uint64_t> m_maxNanos;
+        std::atomic<std::uint64_t> m_buckets[LatencyHistogram::bucketCount];
+    };
+
+    ThreadSlab() {
+
+        for (Operation& op : m_operations) {
+            for (std::atomic<std::uint64_t>& count : op.m_outcomes) count.store(0, std::memory_order_relaxed);
+            op.m_totalNanos.store(0, std::memory_order_relaxed);
+            op.m_maxNanos.store(0, std::memory_order_relaxed);
+            for (std::atomic<std::uint64_t>& count : op.m_buckets) count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Operation m_operations[metricOperationCount];
+};
+
+AccountMetrics::AccountMetrics() :
+    m_id(g_nextMetricsId.fetch_add(1, std::memory_order_relaxed)),
+    m_mutex(),
+    m_slabs()
+{}
+
+AccountMetrics::~AccountMetrics() = default;
+
+void AccountMetrics::setSamplePeriod(std::uint32_t period) {
+
+    s_samplePeriod.store(std::max<std::uint32_t>(period, 1), std::memory_order_relaxed);
+}
+
+std::uint32_t AccountMetrics::samplePeriod() {
+
+    return s_samplePeriod.load(std::memory_order_relaxed);
+}
+
+AccountMetrics::ThreadSlab& AccountMetrics::threadSlab() {
+
+    //The slab of the object the thread recorded into last is cached, so switching objects
+    //costs a lookup under the lock.
+    thread_local std::uint64_t t_owner = 0;
+    thread_local ThreadSlab* t_slab = nullptr;
+    if (t_owner == m_id) {
+        return *t_slab;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::thread::id self = std::this_thread::get_id();
+    ThreadSlab* slab = nullptr;
+    for (const std::pair<std::thread::id, std::unique_ptr<ThreadSlab> >& entry : m_slabs) {
+        if (entry.first == self) {
+            slab = entry.second.get();
+            break;
+        }
+    }
+    if (slab == nullptr) {
+        m_slabs.emplace_back(self, std::unique_ptr<ThreadSlab>(new ThreadSlab()));
+        slab = m_slabs.back().second.get();
+    }
+    t_owner = m_id;
+    t_slab = slab;
+    return *slab;
+}
+
+void AccountMetrics::record(MetricOperation operation, MetricOutcome outcome) {
+
+    addToCounter(threadSlab().m_operations[static_cast<std::size_t>(operation)].m_outcomes[static_cast<std::size_t>(outcome)], 1);
+}
+
+void AccountMetrics::record(MetricOperation operation, MetricOutcome outcome, std::uint64_t nanos) {
+
+    ThreadSlab::Operation& op = threadSlab().m_operations[static_cast<std::size_t>(operation)];
+    addToCounter(op.m_outcomes[static_cast<std::size_t>(outcome)], 1);
+    addToCounter(op.m_buckets[LatencyHistogram::bucketOf(nanos)], 1);
+    addToCounter(op.m_totalNanos, nanos);
+    if (nanos > op.m_maxNanos.load(std::memory_order_relaxed)) {
+        op.m_maxNanos.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+void AccountMetrics::addTo(MetricsSnapshot& snapshot) const {
+
+    snapshot.enabled = true;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const std::pair<std::thread::id, std::unique_ptr<ThreadSlab> >& entry : m_slabs) {
+        for (std::size_t i = 0; i < metricOperationCount; ++i) {
+            const ThreadSlab::Operation& op = entry.second->m_operations[i];
+            OperationMetrics& metrics = snapshot.operations[i];
+            for (std::size_t o = 0; o < metricOutcomeCount; ++o) {
+                metrics.outcomes[o] += op.m_outcomes[o].load(std::memory_order_relaxed);
+            }
+            metrics.totalNanos += op.m_totalNanos.load(std::memory_order_relaxed);
+            metrics.maxNanos = std::max(metrics.maxNanos, op.m_maxNanos.load(std::memory_order_relaxed));
+            for (std::size_t b = 0; b < LatencyHistogram::bucketCount; ++b) {
+                const std::uint64_t count = op.m_buckets[b].load(std::memory_order_relaxed);
+                if (count != 0) metrics.latency.add(b, count);
+            }
+        }
+    }
+}
+
+#endif
\ No newline at end of file
@@ -6,89 +6,1105 @@ This source code is licensed under the BSD-style license found in the
 LICENSE file in the root directory of this source tree.
 **********************************************************************/
 #include <accountMgr.h>
+#include <accountExecutor.h>
 #include <accountId.h>
 #include <singletonUniqueIdGenerator.h>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <limits>
+#include <mutex>
+#include <thread>
 
-AccountMgr::AccountMgr() :
-    m_actMgrDB()
+namespace {
+
+/** Number of operations between the stages of the batched operations pipeline. */
+constexpr std::size_t batchPrefetchDistance = 4;
+
+/** Size of the buffer on the stack the account details are rendered into, enough for most accounts. */
+constexpr std::size_t detailsBufferSize = 256;
+
+/** Size of the blocks a CSV file is read in by importCsv(). */
+constexpr std::size_t csvImportBlockSize = 8 << 20;
+
+/** The id returned for an enterprise account refused because its Y-tunnus is taken. */
+const accountIdType noAccount;
+
+/**
+ * @brief Returns the current local date packed as YYYYMMDD.
+ * std::localtime() shares a static buffer, so the reentrant variants are used instead.
+ */
+std::uint32_t currentDate() {
+
+    std::time_t t = std::time(nullptr);
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    return static_cast<std::uint32_t>((tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday);
+}
+
+/** The id of the account of a request handed to the executor. */
+const accountIdType& executorId(const accountIdType& id) {
+
+    return id;
+}
+
+/** The id of the account of a request handed to the executor. A malformed date gives an id
+ * without a date, which no account has. */
+accountIdType executorId(const accountIdViewType& id) {
+
+    return accountIdType(id);
+}
+
+/** The outcome measured for the result of a request handed to the executor. */
+MetricOutcome executorOutcome(OperationResult result, MetricOutcome rejected) {
+
+    switch (result) {
+    case OperationResult::Applied:
+        return MetricOutcome::Succeeded;
+    case OperationResult::AccountNotFound:
+        return MetricOutcome::AccountNotFound;
+    default:
+        return rejected;
+    }
+}
+
+}
+
+template<typename T_Store>
+BasicAccountMgr<T_Store>::BasicAccountMgr() :
+    BasicAccountMgr(1)
+{}
+
+template<typename T_Store>
+BasicAccountMgr<T_Store>::BasicAccountMgr(std::size_t shardCount) :
+    m_shardCount(shardCount == 0 ? 1 : shardCount),
+    m_shards(new Shard[m_shardCount]),
+    m_journal(nullptr),
+    m_executor(nullptr),
+    m_indexMutex(),
+    m_yTunnusIndex(),
+    m_personNameIndex(),
+    m_metrics(),
+    m_viewMutex(),
+    m_lastViewEpoch(0),
+    m_openViewEpochs()
 {}
 
-bool AccountMgr::topUpAccount(const accountIdType& id, int amount) {
+template<typename T_Store>
+std::size_t BasicAccountMgr<T_Store>::shardCount() const {
+
+    return m_shardCount;
+}
+
+template<typename T_Store>
+std::size_t BasicAccountMgr<T_Store>::shardOf(const accountIdType& id) const {
+
+    return shardIndex(AccountIdHashFunctor<AccountId_IdPartType>()(id));
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::attachJournal(Journal* journal) {
+
+    m_journal = journal;
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::waitDurable(std::uint64_t sequence) const {
 
-    auto it = m_actMgrDB.find(id);
-    if (it != m_actMgrDB.end()) {
-        return (*it).second->addToBalance(amount);
+    if ((m_journal != nullptr) && (sequence != 0)) {
+        m_journal->waitDurable(sequence);
     }
-    return false;
 }
 
-bool AccountMgr::withdrawFromAccount(const accountIdType& id, int amount) {
+template<typename T_Store>
+std::unique_lock<std::mutex> BasicAccountMgr<T_Store>::lockJournal(Shard& shard) const {
 
-    auto it = m_actMgrDB.find(id);
-    if (it != m_actMgrDB.end()) {
-        return (*it).second->decreaseFromBalance(amount);
+    //Without a journal the balances are changed in any order, lock-free. With it, a withdrawal
+    //logged before the top-up it spent could be durable without it: the balance changes of a
+    //shard under its shared lock are logged one at a time, in the order they're applied.
+    //Transfers and creations hold the exclusive lock, which orders them already.
+    if (m_journal == nullptr) {
+        return std::unique_lock<std::mutex>();
     }
-    return false;
+    return std::unique_lock<std::mutex>(shard.m_journalMutex);
 }
 
-PersonAccount<AccountId_IdPartType>* AccountMgr::createNewPersonAccountPtr(const std::string& firstName, const std::string& lastName) {
+template<typename T_Store>
+std::size_t BasicAccountMgr<T_Store>::shardIndex(std::size_t hash) const {
 
-    PersonAccount<AccountId_IdPartType>* account = new PersonAccount<AccountId_IdPartType>;
-    account->setFirstName(firstName);
-    account->setLastName(lastName);
+    //The stores index the accounts with the low bits of the same hash, so the shard is
+    //chosen with the high ones to keep them independent.
+    return (hash >> (sizeof(std::size_t) * 4)) % m_shardCount;
+}
 
-    std::time_t t = std::time(nullptr);
-    std::tm tm = *std::localtime(&t);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y%m%d");
-    AccountId<AccountId_IdPartType> id(SingletonUniqueIdGenerator::instance().incrementAndReturn(), oss.str());
-    account->setId(id);
+template<typename T_Store>
+typename BasicAccountMgr<T_Store>::Shard& BasicAccountMgr<T_Store>::shardFor(const accountIdType& id) const {
 
-    return account;
+    return m_shards[shardIndex(AccountIdHashFunctor<AccountId_IdPartType>()(id))];
 }
 
-EnterpriseAccount<AccountId_IdPartType>* AccountMgr::createNewEnterpriseAccountPtr(const std::string& yTunnus, const std::string& companyName) {
+template<typename T_Store>
+template<typename T_Key>
+bool BasicAccountMgr<T_Store>::topUp(const T_Key& id, int amount) {
+
+    MetricsTimer timer;
+    if (m_executor != nullptr) {
+        const OperationResult result = m_executor->topUp(executorId(id), amount).get();
+        timer.stop(m_metrics, MetricOperation::TopUp, executorOutcome(result, (amount < 0) ? MetricOutcome::InvalidRequest : MetricOutcome::BalanceLimit));
+        return result == OperationResult::Applied;
+    }
+    std::uint64_t sequence = 0;
+    {
+        const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+        Shard& shard = m_shards[shardIndex(hash)];
+        std::shared_lock<std::shared_mutex> lock(shard.m_mutex);
+        Handle handle = shard.m_store.find(id, hash);
+        if (handle == T_Store::invalidHandle()) {
+            timer.stop(m_metrics, MetricOperation::TopUp, MetricOutcome::AccountNotFound);
+            return false;
+        }
+        shard.m_versions.preserve(shard.m_store, handle);
+        std::unique_lock<std::mutex> journalLock = lockJournal(shard);
+        if (!shard.m_store.addToBalance(handle, amount)) {
+            timer.stop(m_metrics, MetricOperation::TopUp, (amount < 0) ? MetricOutcome::InvalidRequest : MetricOutcome::BalanceLimit);
+            return false;
+        }
+        if (m_journal != nullptr) {
+            sequence = m_journal->logBalanceChange(shard.m_store.id(handle), amount);
+        }
+    }
+    waitDurable(sequence);
+    timer.stop(m_metrics, MetricOperation::TopUp, MetricOutcome::Succeeded);
+    return true;
+}
 
-    EnterpriseAccount<AccountId_IdPartType>* account = new EnterpriseAccount<AccountId_IdPartType>;
-    account->setYTunnus(yTunnus);
-    account->setCompanyName(companyName);
+template<typename T_Store>
+template<typename T_Key>
+bool BasicAccountMgr<T_Store>::withdraw(const T_Key& id, int amount) {
 
-    std::time_t t = std::time(nullptr);
-    std::tm tm = *std::localtime(&t);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y%m%d");
-    AccountId<AccountId_IdPartType> id(SingletonUniqueIdGenerator::instance().incrementAndReturn(), oss.str());
-    account->setId(id);
+    MetricsTimer timer;
+    if (m_executor != nullptr) {
+        const OperationResult result = m_executor->withdraw(executorId(id), amount).get();
+        timer.stop(m_metrics, MetricOperation::Withdraw, executorOutcome(result, (amount < 0) ? MetricOutcome::InvalidRequest : MetricOutcome::InsufficientFunds));
+        return result == OperationResult::Applied;
+    }
+    std::uint64_t sequence = 0;
+    {
+        const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+        Shard& shard = m_shards[shardIndex(hash)];
+        std::shared_lock<std::shared_mutex> lock(shard.m_mutex);
+        Handle handle = shard.m_store.find(id, hash);
+        if (handle == T_Store::invalidHandle()) {
+            timer.stop(m_metrics, MetricOperation::Withdraw, MetricOutcome::AccountNotFound);
+            return false;
+        }
+        shard.m_versions.preserve(shard.m_store, handle);
+        std::unique_lock<std::mutex> journalLock = lockJournal(shard);
+        if (!shard.m_store.decreaseFromBalance(handle, amount)) {
+            timer.stop(m_metrics, MetricOperation::Withdraw, (amount < 0) ? MetricOutcome::InvalidRequest : MetricOutcome::InsufficientFunds);
+            return false;
+        }
+        if (m_journal != nullptr) {
+            sequence = m_journal->logBalanceChange(shard.m_store.id(handle), -amount);
+        }
+    }
+    waitDurable(sequence);
+    timer.stop(m_metrics, MetricOperation::Withdraw, MetricOutcome::Succeeded);
+    return true;
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::topUpAccount(const accountIdType& id, int amount) {
+
+    return topUp(id, amount);
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::topUpAccount(const accountIdViewType& id, int amount) {
+
+    return topUp(id, amount);
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::withdrawFromAccount(const accountIdType& id, int amount) {
+
+    return withdraw(id, amount);
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::withdrawFromAccount(const accountIdViewType& id, int amount) {
+
+    return withdraw(id, amount);
+}
+
+template<typename T_Store>
+MetricOutcome BasicAccountMgr<T_Store>::moveBalance(Shard& fromShard, const accountIdType& from, std::size_t fromHash, Shard& toShard, const accountIdType& to, std::size_t toHash, int amount) {
+
+    T_Store& fromStore = fromShard.m_store;
+    T_Store& toStore = toShard.m_store;
+    Handle fromHandle = fromStore.find(from, fromHash);
+    Handle toHandle = toStore.find(to, toHash);
+    if ((fromHandle == T_Store::invalidHandle()) || (toHandle == T_Store::invalidHandle())) {
+        return MetricOutcome::AccountNotFound;
+    }
+    //Both shards are locked exclusively, so no other writer changes the balances: the limit of
+    //to is checked before any money leaves from, and then neither the debit nor the credit fail.
+    const int fromBalance = fromStore.balance(fromHandle);
+    if (amount > fromBalance) {
+        return MetricOutcome::InsufficientFunds;
+    }
+    if (amount > std::numeric_limits<int>::max() - toStore.balance(toHandle)) {
+        return MetricOutcome::BalanceLimit;
+    }
+    fromShard.m_versions.preserve(fromStore, fromHandle);
+    toShard.m_versions.preserve(toStore, toHandle);
+    fromStore.decreaseFromBalance(fromHandle, amount);
+    toStore.addToBalance(toHandle, amount);
+    return MetricOutcome::Succeeded;
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::transfer(const accountIdType& from, const accountIdType& to, int amount) {
+
+    MetricsTimer timer;
+    if ((amount < 0) || (from == to)) {
+        timer.stop(m_metrics, MetricOperation::Transfer, MetricOutcome::InvalidRequest);
+        return false;
+    }
+
+    const std::size_t fromHash = AccountIdHashFunctor<AccountId_IdPartType>()(from);
+    const std::size_t toHash = AccountIdHashFunctor<AccountId_IdPartType>()(to);
+    const std::size_t fromShard = shardIndex(fromHash);
+    const std::size_t toShard = shardIndex(toHash);
+
+    //The owners of the shards change their balances without locks, so they are parked first.
+    std::optional<typename BasicAccountExecutor<T_Store>::Pause> pause;
+    if (m_executor != nullptr) {
+        pause.emplace(*m_executor, fromShard, toShard);
+    }
+    std::uint64_t sequence = 0;
+    if (fromShard == toShard) {
+        Shard& shard = m_shards[fromShard];
+        std::unique_lock<std::shared_mutex> lock(shard.m_mutex);
+        const MetricOutcome outcome = moveBalance(shard, from, fromHash, shard, to, toHash, amount);
+        if (outcome != MetricOutcome::Succeeded) {
+            timer.stop(m_metrics, MetricOperation::Transfer, outcome);
+            return false;
+        }
+        if (m_journal != nullptr) {
+            sequence = m_journal->logTransfer(from, to, amount);
+        }
+    } else {
+        //Canonical lock order: the shard with the lowest index first, so transfers in opposite
+        //directions, or loadSnapshot() and openReadView(), can't wait for each other in a cycle.
+        std::unique_lock<std::shared_mutex> firstLock(m_shards[std::min(fromShard, toShard)].m_mutex);
+        std::unique_lock<std::shared_mutex> secondLock(m_shards[std::max(fromShard, toShard)].m_mutex);
+        const MetricOutcome outcome = moveBalance(m_shards[fromShard], from, fromHash, m_shards[toShard], to, toHash, amount);
+        if (outcome != MetricOutcome::Succeeded) {
+            timer.stop(m_metrics, MetricOperation::Transfer, outcome);
+            return false;
+        }
+        if (m_journal != nullptr) {
+            sequence = m_journal->logTransfer(from, to, amount);
+        }
+    }
+    waitDurable(sequence);
+    timer.stop(m_metrics, MetricOperation::Transfer, MetricOutcome::Succeeded);
+    return true;
+}
+
+template<typename T_Store>
+OperationResult BasicAccountMgr<T_Store>::applyOperation(Shard& shard, Handle handle, int amount) {
+
+    if (handle == T_Store::invalidHandle()) {
+        return OperationResult::AccountNotFound;
+    }
+    T_Store& store = shard.m_store;
+    shard.m_versions.preserve(store, handle);
+    bool applied;
+    if (amount >= 0) {
+        applied = store.addToBalance(handle, amount);
+    } else {
+        applied = (amount != std::numeric_limits<int>::min()) && store.decreaseFromBalance(handle, -amount);
+    }
+    return applied ? OperationResult::Applied : OperationResult::Rejected;
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::applyToStore(Shard& shard, const AccountOperation* operations, const std::size_t* hashes, const std::uint32_t* order, std::size_t count, OperationResult* results, Journal* journal, std::uint64_t& sequence) {
+
+    //A software pipeline with a stage every batchPrefetchDistance operations: the control
+    //group of the index is prefetched, then the candidate slots, then the account is looked
+    //up and its balance prefetched, and finally the operation is applied.
+    T_Store& store = shard.m_store;
+    const std::size_t distance = batchPrefetchDistance;
+    Handle handles[4 * batchPrefetchDistance];
+    for (std::size_t i = 0; i < count + 3 * distance; ++i) {
+        if (i < count) {
+            store.prefetch(hashes[order[i]]);
+        }
+        if ((i >= distance) && (i - distance < count)) {
+            store.prefetchCandidates(hashes[order[i - distance]]);
+        }
+        if ((i >= 2 * distance) && (i - 2 * distance < count)) {
+            const std::size_t j = order[i - 2 * distance];
+            Handle handle = store.find(operations[j].id, hashes[j]);
+            if (handle != T_Store::invalidHandle()) {
+                store.prefetchBalance(handle);
+            }
+            handles[(i - 2 * distance) % (4 * distance)] = handle;
+        }
+        if (i >= 3 * distance) {
+            const std::size_t j = order[i - 3 * distance];
+            results[j] = applyOperation(shard, handles[(i - 3 * distance) % (4 * distance)], operations[j].amount);
+            if ((journal != nullptr) && (results[j] == OperationResult::Applied)) {
+                sequence = journal->logBalanceChange(operations[j].id, operations[j].amount);
+            }
+        }
+    }
+}
+
+template<typename T_Store>
+std::vector<OperationResult> BasicAccountMgr<T_Store>::applyOperations(const AccountOperation* operations, std::size_t count) {
+
+    std::vector<OperationResult> results(count);
+    if (m_executor != nullptr) {
+        m_executor->applyOperations(operations, count, results.data());
+    } else {
+        applyBatch(operations, count, results.data(), false);
+    }
+    return results;
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::applyBatch(const AccountOperation* operations, std::size_t count, OperationResult* results, bool byOwner) {
+
+    std::vector<std::size_t> hashes(count);
+    std::vector<std::uint32_t> order(count);
+    std::vector<std::size_t> shardBegin(m_shardCount + 1, 0);
+
+    //Counting sort of the operations by shard. It's stable, so the operations on the same
+    //account keep the order of the batch.
+    for (std::size_t i = 0; i < count; ++i) {
+        hashes[i] = AccountIdHashFunctor<AccountId_IdPartType>()(operations[i].id);
+        ++shardBegin[shardIndex(hashes[i]) + 1];
+    }
+    for (std::size_t s = 0; s < m_shardCount; ++s) {
+        shardBegin[s + 1] += shardBegin[s];
+    }
+    std::vector<std::size_t> next(shardBegin.begin(), shardBegin.end() - 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        order[next[shardIndex(hashes[i])]++] = static_cast<std::uint32_t>(i);
+    }
+
+    std::uint64_t sequence = 0;
+    for (std::size_t s = 0; s < m_shardCount; ++s) {
+        if (shardBegin[s] == shardBegin[s + 1]) continue;
+
+        //The owner of the shard is the only thread changing its balances: it needs no lock, and
+        //its journal records are in the order it applies the changes.
+        std::shared_lock<std::shared_mutex> lock(m_shards[s].m_mutex, std::defer_lock);
+        std::unique_lock<std::mutex> journalLock;
+        if (!byOwner) {
+            lock.lock();
+            journalLock = lockJournal(m_shards[s]);
+        }
+        applyToStore(m_shards[s], operations, hashes.data(), order.data() + shardBegin[s], shardBegin[s + 1] - shardBegin[s], results, m_journal, sequence);
+    }
+    waitDurable(sequence);
+}
+
+template<typename T_Store>
+std::vector<OperationResult> BasicAccountMgr<T_Store>::applyOperations(const std::vector<AccountOperation>& operations) {
+
+    return applyOperations(operations.data(), operations.size());
+}
+
+template<typename T_Store>
+const accountIdType& BasicAccountMgr<T_Store>::insertAccount(const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName) {
+
+    //An enterprise account claims its Y-tunnus first and keeps the index locked until it's in
+    //its shard: of the accounts created concurrently with a Y-tunnus exactly one is inserted,
+    //and the index never returns an account that isn't there yet.
+    std::unique_lock<std::shared_mutex> indexLock(m_indexMutex, std::defer_lock);
+    if (kind == AccountKind::Enterprise) {
+        indexLock.lock();
+        if (!m_yTunnusIndex.insert(name, id)) {
+            return noAccount;
+        }
+    }
+
+    std::uint64_t sequence = 0;
+    const accountIdType* insertedId;
+    {
+        Shard& shard = shardFor(id);
+        std::unique_lock<std::shared_mutex> lock(shard.m_mutex);
+        Handle handle;
+        {
+            SeqLock::WriteGuard write(shard.m_seqLock);
+            if (kind == AccountKind::Person) {
+                handle = shard.m_store.insertPersonAccount(id, name, secondName);
+            } else {
+                handle = shard.m_store.insertEnterpriseAccount(id, name, secondName);
+            }
+        }
+        shard.m_versions.inserted(handle);
+        insertedId = &shard.m_store.id(handle);
+
+        //Logged under the lock, so the creation precedes any change of the account in the journal.
+        if (m_journal != nullptr) {
+            if (kind == AccountKind::Person) {
+                sequence = m_journal->logPersonAccount(id, name, secondName);
+            } else {
+                sequence = m_journal->logEnterpriseAccount(id, name, secondName);
+            }
+        }
+    }
+    if (kind == AccountKind::Person) {
+        std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+        m_personNameIndex.insert(secondName, name, id);
+    } else {
+        indexLock.unlock();
+    }
+    waitDurable(sequence);
+    return *insertedId;
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::indexAccount(const accountIdType& id, AccountKind kind, std::string_view name, std::string_view secondName) {
+
+    if (kind == AccountKind::Person) {
+        m_personNameIndex.insert(secondName, name, id);
+    } else if (kind == AccountKind::Enterprise) {
+        return m_yTunnusIndex.insert(name, id);
+    }
+    return true;
+}
+
+template<typename T_Store>
+const accountIdType& BasicAccountMgr<T_Store>::insertNewPersonAccount(const std::string& firstName, const std::string& lastName) {
+
+    MetricsTimer timer;
+    if (m_executor != nullptr) {
+        const accountIdType& insertedId = storedId(m_executor->insertNewPersonAccount(firstName, lastName));
+        timer.stop(m_metrics, MetricOperation::InsertAccount, MetricOutcome::Succeeded);
+        return insertedId;
+    }
+    const accountIdType& insertedId = insertAccount(newAccountId(), AccountKind::Person, firstName, lastName);
+    timer.stop(m_metrics, MetricOperation::InsertAccount, MetricOutcome::Succeeded);
+    return insertedId;
+}
+
+template<typename T_Store>
+const accountIdType& BasicAccountMgr<T_Store>::insertNewEnterpriseAccount(const std::string& yTunnus, const std::string& companyName) {
+
+    MetricsTimer timer;
+    const accountIdType& insertedId = (m_executor != nullptr) ? storedId(m_executor->insertNewEnterpriseAccount(yTunnus, companyName)) : insertAccount(newAccountId(), AccountKind::Enterprise, yTunnus, companyName);
+    timer.stop(m_metrics, MetricOperation::InsertAccount, (&insertedId == &noAccount) ? MetricOutcome::InvalidRequest : MetricOutcome::Succeeded);
+    return insertedId;
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::insertNewAccounts(const NewAccount* accounts, std::size_t count, accountIdType* ids) {
+
+    if (m_executor != nullptr) {
+        m_executor->insertNewAccounts(accounts, count, ids);
+        return;
+    }
+    const std::uint32_t date = currentDate();
+    for (std::size_t i = 0; i < count; ++i) {
+        ids[i] = accountIdType(SingletonUniqueIdGenerator::instance().incrementAndReturn(), date);
+    }
+    insertAccounts(accounts, count, ids);
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::insertAccounts(const NewAccount* accounts, std::size_t count, accountIdType* ids) {
+
+    std::vector<std::size_t> hashes(count);
+    std::vector<std::uint32_t> order(count);
+    std::vector<std::size_t> shardBegin(m_shardCount + 1, 0);
+
+    //The index stays locked for the whole batch, see insertAccount(). The enterprise accounts
+    //claim their Y-tunnus in the order of the batch, the ones finding it taken aren't inserted.
+    //The shards are locked exclusively even by their owners: the scans and the readers that
+    //race an insertion read the stores under the shared locks.
+    std::unique_lock<std::shared_mutex> indexLock(m_indexMutex);
+    std::vector<bool> refused(count, false);
+    for (std::size_t i = 0; i < count; ++i) {
+        if ((accounts[i].kind == AccountKind::Enterprise) && !m_yTunnusIndex.insert(accounts[i].name, ids[i])) {
+            ids[i] = noAccount;
+            refused[i] = true;
+            continue;
+        }
+        hashes[i] = AccountIdHashFunctor<AccountId_IdPartType>()(ids[i]);
+        ++shardBegin[shardIndex(hashes[i]) + 1];
+    }
+    for (std::size_t s = 0; s < m_shardCount; ++s) {
+        shardBegin[s + 1] += shardBegin[s];
+    }
+    std::vector<std::size_t> next(shardBegin.begin(), shardBegin.end() - 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (refused[i]) continue;
+        order[next[shardIndex(hashes[i])]++] = static_cast<std::uint32_t>(i);
+    }
+
+    std::uint64_t sequence = 0;
+    std::string name;
+    std::string secondName;
+    for (std::size_t s = 0; s < m_shardCount; ++s) {
+        if (shardBegin[s] == shardBegin[s + 1]) continue;
 
-    return account;
+        std::unique_lock<std::shared_mutex> lock(m_shards[s].m_mutex);
+        SeqLock::WriteGuard write(m_shards[s].m_seqLock);
+        T_Store& store = m_shards[s].m_store;
+        store.reserve(store.size() + (shardBegin[s + 1] - shardBegin[s]));
+        for (std::size_t k = shardBegin[s]; k < shardBegin[s + 1]; ++k) {
+            const std::size_t i = order[k];
+            name.assign(accounts[i].name);
+            secondName.assign(accounts[i].secondName);
+            if (accounts[i].kind == AccountKind::Person) {
+                m_shards[s].m_versions.inserted(store.insertPersonAccount(ids[i], name, secondName));
+                if (m_journal != nullptr) {
+                    sequence = m_journal->logPersonAccount(ids[i], name, secondName);
+                }
+            } else {
+                m_shards[s].m_versions.inserted(store.insertEnterpriseAccount(ids[i], name, secondName));
+                if (m_journal != nullptr) {
+                    sequence = m_journal->logEnterpriseAccount(ids[i], name, secondName);
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        if (accounts[i].kind == AccountKind::Person) {
+            m_personNameIndex.insert(accounts[i].secondName, accounts[i].name, ids[i]);
+        }
+    }
+    indexLock.unlock();
+    waitDurable(sequence);
+}
+
+template<typename T_Store>
+accountIdType BasicAccountMgr<T_Store>::newAccountId() {
+
+    return accountIdType(SingletonUniqueIdGenerator::instance().incrementAndReturn(), currentDate());
+}
+
+template<typename T_Store>
+const accountIdType& BasicAccountMgr<T_Store>::storedId(const accountIdType& id) const {
+
+    //The executor returns a copy of the id, the callers of the insertions a reference to the
+    //one stored with the account.
+    if (id == noAccount) {
+        return noAccount;
+    }
+    const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+    const Shard& shard = m_shards[shardIndex(hash)];
+    return shard.m_store.id(findForRead(shard, id, hash));
+}
+
+template<typename T_Store>
+std::vector<accountIdType> BasicAccountMgr<T_Store>::insertNewAccounts(const std::vector<NewAccount>& accounts) {
+
+    std::vector<accountIdType> ids(accounts.size());
+    insertNewAccounts(accounts.data(), accounts.size(), ids.data());
+    return ids;
 }
 
-const accountIdType& AccountMgr::insertNewPersonAccount(const std::string& firstName, const std::string& lastName) {
+template<typename T_Store>
+CsvImportResult BasicAccountMgr<T_Store>::importCsv(const std::string& path, std::size_t threadCount) {
+
+    CsvImportResult result;
+    CsvBlockReader reader(path, csvImportBlockSize);
+    if (!reader.isOpen()) {
+        return result;
+    }
+    result.fileRead = true;
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<CsvChunkParser> parsers(threadCount);
+    std::vector<NewAccount> accounts;
+    std::vector<accountIdType> ids;
+    std::size_t firstLine = 1;
+
+    char* begin;
+    char* end;
+    while (reader.next(begin, end)) {
+        //The chunks are parsed in parallel, numbering their lines from 1: the line count of
+        //the previous chunks is only known once they're parsed.
+        const std::vector<char*> limits = splitCsvBlock(begin, end, threadCount);
+        const bool firstBlock = (firstLine == 1);
+        auto parse = [&parsers, &limits, firstBlock](std::size_t chunk) {
+            parsers[chunk].parse(limits[chunk], limits[chunk + 1], 1, firstBlock && (chunk == 0));
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t t = 1; t < threadCount; ++t) {
+            threads.emplace_back(parse, t);
+        }
+        parse(0);
+        for (std::thread& t : threads) {
+            t.join();
+        }
 
-    PersonAccount<AccountId_IdPartType>* account = createNewPersonAccountPtr(firstName, lastName);
-    m_actMgrDB[account->id()] = std::unique_ptr<AbstractAccount<AccountId_IdPartType>>(account);
+        accounts.clear();
+        for (const CsvChunkParser& parser : parsers) {
+            for (std::size_t r = 0; r < parser.rows().size(); ++r) {
+                if (parser.rowValid()[r]) {
+                    accounts.push_back(parser.rows()[r]);
+                }
+            }
+        }
+        ids.resize(accounts.size());
+        insertNewAccounts(accounts.data(), accounts.size(), ids.data());
 
-    return account->id();
+        std::size_t next = 0;
+        for (const CsvChunkParser& parser : parsers) {
+            for (std::size_t r = 0; r < parser.rows().size(); ++r) {
+                result.ids.push_back(parser.rowValid()[r] ? ids[next++] : accountIdType());
+            }
+            for (const CsvImportError& error : parser.errors()) {
+                result.errors.push_back(error);
+                result.errors.back().line += firstLine - 1;
+            }
+            firstLine += parser.lineCount();
+        }
+    }
+    return result;
 }
 
-const accountIdType& AccountMgr::insertNewEnterpriseAccount(const std::string& yTunnus, const std::string& companyName) {
+template<typename T_Store>
+JournalReplayStats BasicAccountMgr<T_Store>::replayJournal(const std::string& path) {
+
+    //The balance changes are added up by account and applied at the end: the records of
+    //concurrent operations may be logged in a different order than they were applied, but
+    //their sum doesn't depend on it.
+    FlatHashMap<accountIdType, std::int64_t, AccountIdHashFunctor<AccountId_IdPartType> > balances;
+    std::int64_t lastUsedId = 0;
+    JournalReplayStats stats;
+
+    JournalReader reader(path);
+    JournalRecord record;
+    while (reader.next(record)) {
+        switch (record.type) {
+        case JournalRecordType::PersonAccount:
+            insertAccount(record.id, AccountKind::Person, record.name, record.secondName);
+            lastUsedId = std::max(lastUsedId, static_cast<std::int64_t>(record.id.id()));
+            break;
+        case JournalRecordType::EnterpriseAccount:
+            insertAccount(record.id, AccountKind::Enterprise, record.name, record.secondName);
+            lastUsedId = std::max(lastUsedId, static_cast<std::int64_t>(record.id.id()));
+            break;
+        case JournalRecordType::BalanceChange:
+            balances[record.id] += record.amount;
+            break;
+        case JournalRecordType::Transfer:
+            balances[record.id] -= record.amount;
+            balances[record.toId] += record.amount;
+            break;
+        }
+        ++stats.records;
+    }
+
+    for (const auto& entry : balances) {
+        if (entry.second > 0) {
+            topUpAccount(entry.first, static_cast<int>(std::min<std::int64_t>(entry.second, std::numeric_limits<int>::max())));
+        } else if (entry.second < 0) {
+            //The records of an account are logged in the order of its changes, so any prefix of
+            //them adds up to a balance >= 0: these were not all written by this manager.
+            stats.negativeBalances.push_back(entry.first);
+        }
+    }
+    SingletonUniqueIdGenerator::instance().seed(lastUsedId);
+
+    return stats;
+}
 
-    EnterpriseAccount<AccountId_IdPartType>* account = createNewEnterpriseAccountPtr(yTunnus, companyName);
-    m_actMgrDB[account->id()] = std::unique_ptr<AbstractAccount<AccountId_IdPartType>>(account);
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::saveSnapshot(const std::string& path) const {
 
-    return account->id();
+    SnapshotWriter writer(path);
+    std::int64_t lastUsedId = 0;
+    auto add = [&writer, &lastUsedId](const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance) {
+        writer.addAccount(id, kind, name, secondName, balance);
+        lastUsedId = std::max(lastUsedId, static_cast<std::int64_t>(id.id()));
+    };
+    ReadView view = openReadView();
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        forEachAccountOfShard(view.m_epoch, i, add);
+        if (!writer.flushBlock()) {
+            return false;
+        }
+    }
+    return writer.finish(lastUsedId);
 }
 
-std::string AccountMgr::getAccountDetails(const accountIdType& id) const {
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::loadSnapshot(const std::string& path, std::size_t threadCount) {
+
+    SnapshotReader reader(path);
+    if (!reader.valid()) {
+        return false;
+    }
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min(threadCount, m_shardCount);
 
-    AccountDetailsVisitor<AccountId_IdPartType> visitor;
-    auto it = m_actMgrDB.find(id);
-    if (it != m_actMgrDB.end()) {
-        (*it).second->accept(&visitor);
-        return visitor.accountDetails();
+    //The indexes are filled first, in the order of the file. A snapshot of this manager has no
+    //two enterprise accounts with the same Y-tunnus, an older one may: the later ones are
+    //refused, as they would be when created, and not loaded.
+    std::vector<std::size_t> blockBegin(reader.blockCount() + 1, 0);
+    std::vector<bool> refused;
+    refused.reserve(static_cast<std::size_t>(reader.header().accountCount));
+    {
+        std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+        for (std::size_t b = 0; b < reader.blockCount(); ++b) {
+            const SnapshotRecord* records = reader.records(b);
+            for (std::size_t r = 0; r < reader.recordCount(b); ++r) {
+                const SnapshotRecord& record = records[r];
+                refused.push_back(!indexAccount(accountIdType(static_cast<AccountId_IdPartType>(record.id), record.creationDate), record.kind, reader.name(b, record), reader.secondName(b, record)));
+            }
+            blockBegin[b + 1] = refused.size();
+        }
     }
-    return "<ACCOUNT NOT FOUND>";
-}
\ No newline at end of file
+
+    //Every thread owns the shards whose index modulo threadCount is its own index, so the
+    //threads never insert into the same store.
+    auto load = [this, &reader, &blockBegin, &refused, threadCount](std::size_t thread) {
+        std::vector<std::unique_lock<std::shared_mutex> > locks;
+        std::vector<std::unique_ptr<SeqLock::WriteGuard> > writes;
+        for (std::size_t s = thread; s < m_shardCount; s += threadCount) {
+            locks.emplace_back(m_shards[s].m_mutex);
+            writes.emplace_back(new SeqLock::WriteGuard(m_shards[s].m_seqLock));
+            m_shards[s].m_store.reserve(m_shards[s].m_store.size() + reader.header().accountCount / m_shardCount * 9 / 8);
+        }
+
+        for (std::size_t b = 0; b < reader.blockCount(); ++b) {
+            const SnapshotRecord* records = reader.records(b);
+            for (std::size_t r = 0; r < reader.recordCount(b); ++r) {
+                const SnapshotRecord& record = records[r];
+                accountIdType id(static_cast<AccountId_IdPartType>(record.id), record.creationDate);
+                const std::size_t s = shardIndex(AccountIdHashFunctor<AccountId_IdPartType>()(id));
+                if ((s % threadCount != thread) || refused[blockBegin[b] + r]) continue;
+
+                T_Store& store = m_shards[s].m_store;
+                Handle handle;
+                if (record.kind == AccountKind::Person) {
+                    handle = store.insertPersonAccount(id, reader.name(b, record), reader.secondName(b, record));
+                } else if (record.kind == AccountKind::Enterprise) {
+                    handle = store.insertEnterpriseAccount(id, reader.name(b, record), reader.secondName(b, record));
+                } else {
+                    continue;
+                }
+                m_shards[s].m_versions.inserted(handle);
+                if (record.balance > 0) {
+                    store.addToBalance(handle, record.balance);
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(load, t);
+    }
+    load(0);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    SingletonUniqueIdGenerator::instance().seed(reader.header().lastUsedId);
+    return true;
+}
+
+template<typename T_Store>
+std::optional<accountIdType> BasicAccountMgr<T_Store>::findByYTunnus(std::string_view yTunnus) const {
+
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    return m_yTunnusIndex.find(yTunnus);
+}
+
+template<typename T_Store>
+std::vector<accountIdType> BasicAccountMgr<T_Store>::findPersonsByLastNamePrefix(std::string_view lastNamePrefix, std::size_t limit) const {
+
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    return m_personNameIndex.findByLastNamePrefix(lastNamePrefix, limit);
+}
+
+template<typename T_Store>
+std::vector<accountIdType> BasicAccountMgr<T_Store>::findPersonsByName(std::string_view lastName, std::string_view firstNamePrefix, std::size_t limit) const {
+
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    return m_personNameIndex.findByName(lastName, firstNamePrefix, limit);
+}
+
+template<typename T_Store>
+SecondaryIndexStats BasicAccountMgr<T_Store>::indexStats() const {
+
+    SecondaryIndexStats stats;
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    m_yTunnusIndex.addStats(stats);
+    m_personNameIndex.addStats(stats);
+    return stats;
+}
+
+template<typename T_Store>
+std::size_t BasicAccountMgr<T_Store>::size() const {
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        std::shared_lock<std::shared_mutex> lock(m_shards[i].m_mutex);
+        count += m_shards[i].m_store.size();
+    }
+    return count;
+}
+
+template<typename T_Store>
+std::int64_t BasicAccountMgr<T_Store>::totalBalance() const {
+
+    std::int64_t total = 0;
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        std::shared_lock<std::shared_mutex> lock(m_shards[i].m_mutex);
+        total += m_shards[i].m_store.totalBalance();
+    }
+    return total;
+}
+
+template<typename T_Store>
+template<typename T_Result, typename T_Block>
+T_Result BasicAccountMgr<T_Store>::scanBalances(AccountFilter filter, std::size_t threadCount, const T_Result& empty, T_Block block) const {
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min(threadCount, m_shardCount);
+
+    //The threads take the next shard to scan from a shared counter and add its balances to a
+    //partial result of their own, so they only meet when the partials are added up.
+    std::vector<T_Result> partials(threadCount, empty);
+    std::atomic<std::size_t> nextShard(0);
+    auto scan = [this, filter, &block, &partials, &nextShard](std::size_t thread) {
+        T_Result& partial = partials[thread];
+        for (std::size_t s = nextShard++; s < m_shardCount; s = nextShard++) {
+            std::shared_lock<std::shared_mutex> lock(m_shards[s].m_mutex);
+            const T_Store& store = m_shards[s].m_store;
+            store.forEachBalanceBlock(filter, [&block, &partial, &store](const int* balances, const Handle* handles, std::size_t count) {
+                block(partial, store, balances, handles, count);
+            });
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(scan, t);
+    }
+    scan(0);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    for (std::size_t t = 1; t < threadCount; ++t) {
+        partials[0] += partials[t];
+    }
+    return partials[0];
+}
+
+template<typename T_Store>
+BalanceAggregates BasicAccountMgr<T_Store>::aggregateBalances(AccountFilter filter, std::size_t threadCount) const {
+
+    return scanBalances(filter, threadCount, BalanceAggregates(), [](BalanceAggregates& aggregates, const T_Store&, const int* balances, const Handle*, std::size_t count) {
+        aggregates.add(balances, count);
+    });
+}
+
+template<typename T_Store>
+BalanceHistogram BasicAccountMgr<T_Store>::balanceHistogram(const std::vector<int>& bounds, AccountFilter filter, std::size_t threadCount) const {
+
+    return scanBalances(filter, threadCount, BalanceHistogram(bounds), [](BalanceHistogram& histogram, const T_Store&, const int* balances, const Handle*, std::size_t count) {
+        histogram.add(balances, count);
+    });
+}
+
+template<typename T_Store>
+std::vector<AccountBalance> BasicAccountMgr<T_Store>::topBalances(std::size_t n, AccountFilter filter, std::size_t threadCount) const {
+
+    //Only the balances that may enter the top get their id read from the store.
+    return scanBalances(filter, threadCount, TopBalances(n), [](TopBalances& top, const T_Store& store, const int* balances, const Handle* handles, std::size_t count) {
+        if (!top.wantsAny(balances, count)) return;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (top.wants(balances[i])) {
+                top.add(store.id(handles[i]), balances[i]);
+            }
+        }
+    }).sorted();
+}
+
+template<typename T_Store>
+typename BasicAccountMgr<T_Store>::ReadView BasicAccountMgr<T_Store>::openReadView() const {
+
+    std::optional<typename BasicAccountExecutor<T_Store>::Pause> pause;
+    if (m_executor != nullptr) {
+        pause.emplace(*m_executor);
+    }
+    std::lock_guard<std::mutex> viewLock(m_viewMutex);
+    const std::uint64_t epoch = ++m_lastViewEpoch;
+    m_openViewEpochs.push_back(epoch);
+
+    //All the shards are locked at once, so no balance is changing when the epoch begins,
+    //not even half of a transfer between two shards.
+    std::vector<std::unique_lock<std::shared_mutex> > locks;
+    locks.reserve(m_shardCount);
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        locks.emplace_back(m_shards[i].m_mutex);
+    }
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        m_shards[i].m_versions.beginEpoch(epoch);
+    }
+    return ReadView(this, epoch);
+}
+
+template<typename T_Store>
+void BasicAccountMgr<T_Store>::closeReadView(std::uint64_t epoch) const {
+
+    std::lock_guard<std::mutex> viewLock(m_viewMutex);
+    m_openViewEpochs.erase(std::find(m_openViewEpochs.begin(), m_openViewEpochs.end(), epoch));
+
+    //The views are opened in the order of their epochs, so the first one is the oldest. Closing
+    //a later view frees nothing: the older views may need its versions.
+    const std::uint64_t oldest = m_openViewEpochs.empty() ? 0 : m_openViewEpochs.front();
+    if ((oldest != 0) && (oldest < epoch)) return;
+
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        m_shards[i].m_versions.collect(oldest);
+    }
+}
+
+template<typename T_Store>
+std::size_t BasicAccountMgr<T_Store>::readViewVersions() const {
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        count += m_shards[i].m_versions.size();
+    }
+    return count;
+}
+
+template<typename T_Store>
+AccountAllocationStats BasicAccountMgr<T_Store>::allocationStats() const {
+
+    AccountAllocationStats stats;
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        std::shared_lock<std::shared_mutex> lock(m_shards[i].m_mutex);
+        stats += m_shards[i].m_store.allocationStats();
+    }
+    return stats;
+}
+
+template<typename T_Store>
+MetricsSnapshot BasicAccountMgr<T_Store>::metricsSnapshot() const {
+
+    MetricsSnapshot snapshot;
+    m_metrics.addTo(snapshot);
+    snapshot.shards = m_shardCount;
+    snapshot.smallestShard = std::numeric_limits<std::size_t>::max();
+    for (std::size_t i = 0; i < m_shardCount; ++i) {
+        std::shared_lock<std::shared_mutex> lock(m_shards[i].m_mutex);
+        const std::size_t accounts = m_shards[i].m_store.size();
+        const std::size_t slots = m_shards[i].m_store.indexCapacity();
+        snapshot.accounts += accounts;
+        snapshot.indexSlots += slots;
+        snapshot.largestShard = std::max(snapshot.largestShard, accounts);
+        snapshot.smallestShard = std::min(snapshot.smallestShard, accounts);
+        if (slots != 0) {
+            snapshot.maxShardLoadFactor = std::max(snapshot.maxShardLoadFactor, static_cast<double>(accounts) / static_cast<double>(slots));
+        }
+    }
+    return snapshot;
+}
+
+template<typename T_Store>
+std::size_t BasicAccountMgr<T_Store>::renderAccountDetails(const accountIdType& id, char* buffer, std::size_t size, AccountDetailsFormat format) const {
+
+    std::optional<BoundedCharOutput> out = renderAccountDetails(id, BoundedCharOutput(buffer, size), format);
+    return out ? out->length() : 0;
+}
+
+template<typename T_Store>
+template<typename T_Key>
+std::string BasicAccountMgr<T_Store>::accountDetails(const T_Key& id) const {
+
+    //Rendered on the stack, so the string is allocated once with its final size. Longer
+    //details are rendered again straight into the string, until the balance stops growing.
+    MetricsTimer timer;
+    char buffer[detailsBufferSize];
+    std::optional<BoundedCharOutput> out = renderDetails(id, BoundedCharOutput(buffer, sizeof(buffer)), AccountDetailsFormat::Text);
+    std::size_t length = out ? out->length() : 0;
+    if (length == 0) {
+        timer.stop(m_metrics, MetricOperation::AccountDetails, MetricOutcome::AccountNotFound);
+        return "<ACCOUNT NOT FOUND>";
+    }
+    if (length <= sizeof(buffer)) {
+        std::string details(buffer, length);
+        timer.stop(m_metrics, MetricOperation::AccountDetails, MetricOutcome::Succeeded);
+        return details;
+    }
+    std::string details;
+    do {
+        details.resize(length);
+        out = renderDetails(id, BoundedCharOutput(&details[0], details.size()), AccountDetailsFormat::Text);
+        length = out ? out->length() : 0;
+    } while (length > details.size());
+    details.resize(length);
+    timer.stop(m_metrics, MetricOperation::AccountDetails, MetricOutcome::Succeeded);
+    return details;
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::hasAccount(const accountIdType& id) const {
+
+    const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+    return findForRead(m_shards[shardIndex(hash)], id, hash) != T_Store::invalidHandle();
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::makeHotAccount(const accountIdType& id) {
+
+    const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+    Shard& shard = m_shards[shardIndex(hash)];
+    std::shared_lock<std::shared_mutex> lock(shard.m_mutex);
+    Handle handle = shard.m_store.find(id, hash);
+    return (handle != T_Store::invalidHandle()) && shard.m_store.makeBalanceHot(handle);
+}
+
+template<typename T_Store>
+bool BasicAccountMgr<T_Store>::isHotAccount(const accountIdType& id) const {
+
+    const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+    const Shard& shard = m_shards[shardIndex(hash)];
+    Handle handle = findForRead(shard, id, hash);
+    return (handle != T_Store::invalidHandle()) && shard.m_store.balanceHot(handle);
+}
+
+template<typename T_Store>
+std::string BasicAccountMgr<T_Store>::getAccountDetails(const accountIdType& id) const {
+
+    return accountDetails(id);
+}
+
+template<typename T_Store>
+std::string BasicAccountMgr<T_Store>::getAccountDetails(const accountIdViewType& id) const {
+
+    return accountDetails(id);
+}
+
+template class BasicAccountMgr<ObjectAccountStore>;
+template class BasicAccountMgr<DataOrientedAccountStore>;
+template class BasicAccountMgr<VariantAccountStore>;
+template class BasicAccountMgr<NodeObjectAccountStore>;
\ No newline at end of file
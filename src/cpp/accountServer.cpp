@@ -0,0 +1,356 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <accountServer.h>
+
+#include <cerrno>
+#include <iterator>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/** The room kept free in the input buffer of a connection before every read. */
+constexpr std::size_t readChunk = 64 * 1024;
+
+/** The number of events taken from epoll at once. */
+constexpr int maxEvents = 128;
+
+/**
+ * @brief A connection of a worker, with the bytes received but not run yet and the
+ * responses not sent yet.
+ */
+struct Connection {
+    int m_fd;
+    std::string m_in;
+    std::size_t m_inBegin = 0;
+    std::string m_out;
+    std::size_t m_outBegin = 0;
+    std::uint32_t m_events = 0;
+};
+
+[[noreturn]] void throwErrno(const char* what) {
+
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/**
+ * @brief Sends the pending responses of a connection until done or the socket is full.
+ */
+bool sendPending(Connection& c) {
+
+    while (c.m_outBegin < c.m_out.size()) {
+        ssize_t sent = ::send(c.m_fd, c.m_out.data() + c.m_outBegin, c.m_out.size() - c.m_outBegin, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        }
+        c.m_outBegin += static_cast<std::size_t>(sent);
+    }
+    c.m_out.clear();
+    c.m_outBegin = 0;
+    return true;
+}
+
+}
+
+AccountServer::AccountServer(AccountMgr& mgr, const ServerOptions& options) :
+    m_mgr(mgr),
+    m_options(options),
+    m_listenFd(-1),
+    m_stopFd(-1),
+    m_port(0),
+    m_requestCount(0),
+    m_workers()
+{
+    if (m_options.threadCount == 0) {
+        m_options.threadCount = 1;
+    }
+}
+
+AccountServer::~AccountServer() {
+
+    stop();
+}
+
+void AccountServer::start(const std::string& address, std::uint16_t port) {
+
+    sockaddr_in addr = sockaddr_in();
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid address " + address);
+    }
+
+    m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) throwErrno("socket");
+    int one = 1;
+    ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        const int error = errno;
+        stop();
+        throw std::system_error(error, std::generic_category(), "bind");
+    }
+    if (::listen(m_listenFd, m_options.backlog) != 0) {
+        const int error = errno;
+        stop();
+        throw std::system_error(error, std::generic_category(), "listen");
+    }
+    socklen_t length = sizeof(addr);
+    ::getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&addr), &length);
+    m_port = ntohs(addr.sin_port);
+
+    //Writing to the event counter wakes every worker, which then leaves its loop.
+    m_stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_stopFd < 0) throwErrno("eventfd");
+
+    for (std::size_t i = 0; i < m_options.threadCount; ++i) {
+        m_workers.emplace_back(&AccountServer::workerLoop, this);
+    }
+}
+
+std::uint16_t AccountServer::port() const {
+
+    return m_port;
+}
+
+void AccountServer::stop() {
+
+    if (m_stopFd >= 0) {
+        std::uint64_t one = 1;
+        ssize_t written = ::write(m_stopFd, &one, sizeof(one));
+        static_cast<void>(written);
+    }
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    if (m_stopFd >= 0) {
+        ::close(m_stopFd);
+        m_stopFd = -1;
+    }
+    if (m_listenFd >= 0) {
+        ::close(m_listenFd);
+        m_listenFd = -1;
+    }
+}
+
+std::uint64_t AccountServer::requestCount() const {
+
+    return m_requestCount.load(std::memory_order_relaxed);
+}
+
+void AccountServer::execute(AccountMgr& mgr, const Request& request, std::string& out) {
+
+    if (!request.valid) {
+        encodeResponse(out, request.tag, ResponseStatus::Malformed);
+        return;
+    }
+    switch (request.type) {
+    case RequestType::CreatePerson:
+        encodeIdResponse(out, request.tag, mgr.insertNewPersonAccount(std::string(request.name), std::string(request.secondName)));
+        break;
+    case RequestType::CreateEnterprise: {
+        const accountIdType& id = mgr.insertNewEnterpriseAccount(std::string(request.name), std::string(request.secondName));
+        if (id == accountIdType()) {
+            encodeResponse(out, request.tag, ResponseStatus::Rejected);
+        } else {
+            encodeIdResponse(out, request.tag, id);
+        }
+        break;
+    }
+    case RequestType::TopUp:
+    case RequestType::Withdraw: {
+        const bool done = (request.type == RequestType::TopUp) ? mgr.topUpAccount(request.id, request.amount) : mgr.withdrawFromAccount(request.id, request.amount);
+        ResponseStatus status = ResponseStatus::Ok;
+        if (!done) {
+            status = mgr.hasAccount(request.id) ? ResponseStatus::Rejected : ResponseStatus::NotFound;
+        }
+        encodeResponse(out, request.tag, status);
+        break;
+    }
+    case RequestType::Transfer: {
+        ResponseStatus status = ResponseStatus::Ok;
+        if (!mgr.transfer(request.id, request.toId, request.amount)) {
+            status = (mgr.hasAccount(request.id) && mgr.hasAccount(request.toId)) ? ResponseStatus::Rejected : ResponseStatus::NotFound;
+        }
+        encodeResponse(out, request.tag, status);
+        break;
+    }
+    case RequestType::Details: {
+        //The details are rendered straight into the response, which is dropped if not found.
+        const std::size_t start = beginFrame(out, request.tag, static_cast<std::uint8_t>(ResponseStatus::Ok));
+        if (mgr.renderAccountDetails(request.id, std::back_inserter(out), AccountDetailsFormat::Json)) {
+            endFrame(out, start);
+        } else {
+            out.resize(start);
+            encodeResponse(out, request.tag, ResponseStatus::NotFound);
+        }
+        break;
+    }
+    }
+}
+
+void AccountServer::workerLoop() {
+
+    const int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) return;
+
+    epoll_event event = epoll_event();
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.fd = m_listenFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+    event.events = EPOLLIN;
+    event.data.fd = m_stopFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, m_stopFd, &event);
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    auto closeConnection = [&](Connection& c) {
+        ::epoll_ctl(epollFd, EPOLL_CTL_DEL, c.m_fd, nullptr);
+        ::close(c.m_fd);
+        connections.erase(c.m_fd);
+    };
+    //Reading stops while too many responses wait, so a client that doesn't read can't grow them.
+    auto updateEvents = [&](Connection& c) {
+        const std::size_t pending = c.m_out.size() - c.m_outBegin;
+        std::uint32_t events = (pending < m_options.maxPendingOutput) ? static_cast<std::uint32_t>(EPOLLIN) : 0;
+        if (pending > 0) events |= EPOLLOUT;
+        if (events != c.m_events) {
+            epoll_event e = epoll_event();
+            e.events = events;
+            e.data.fd = c.m_fd;
+            ::epoll_ctl(epollFd, EPOLL_CTL_MOD, c.m_fd, &e);
+            c.m_events = events;
+        }
+    };
+
+    epoll_event events[maxEvents];
+    bool running = true;
+    while (running) {
+        const int count = ::epoll_wait(epollFd, events, maxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == m_stopFd) {
+                running = false;
+                break;
+            }
+            if (fd == m_listenFd) {
+                int client;
+                while ((client = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    int one = 1;
+                    ::setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    std::unique_ptr<Connection> c(new Connection());
+                    c->m_fd = client;
+                    c->m_events = EPOLLIN;
+                    epoll_event e = epoll_event();
+                    e.events = EPOLLIN;
+                    e.data.fd = client;
+                    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &e);
+                    connections.emplace(client, std::move(c));
+                }
+                continue;
+            }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            Connection& c = *it->second;
+
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN)) {
+                closeConnection(c);
+                continue;
+            }
+            bool open = true;
+            bool peerClosed = false;
+            if (events[i].events & EPOLLIN) {
+                //Read all the socket holds, run every complete request, and answer them at once.
+                while (true) {
+                    const std::size_t used = c.m_in.size();
+                    c.m_in.resize(used + readChunk);
+                    ssize_t received = ::recv(fd, &c.m_in[used], readChunk, 0);
+                    if (received <= 0) {
+                        c.m_in.resize(used);
+                        if ((received < 0) && (errno == EINTR)) continue;
+                        if (received == 0) {
+                            peerClosed = true;
+                        } else {
+                            open = (errno == EAGAIN) || (errno == EWOULDBLOCK);
+                        }
+                        break;
+                    }
+                    c.m_in.resize(used + static_cast<std::size_t>(received));
+                    if (static_cast<std::size_t>(received) < readChunk) break;
+                }
+            }
+
+            //Requests left in the buffer by the output limit are run once their responses are
+            //sent, so the frames are decoded on every event, not only when reading.
+            Request request;
+            std::size_t frameSize;
+            std::uint64_t requests = 0;
+            bool limited = true;
+            while (open && limited) {
+                limited = false;
+                while (true) {
+                    if (c.m_out.size() - c.m_outBegin >= m_options.maxPendingOutput) {
+                        limited = true;
+                        break;
+                    }
+                    FrameResult result = decodeRequest(c.m_in.data() + c.m_inBegin, c.m_in.size() - c.m_inBegin, request, frameSize);
+                    if (result == FrameResult::Incomplete) break;
+                    if (result == FrameResult::Malformed) {
+                        open = false;
+                        break;
+                    }
+                    execute(m_mgr, request, c.m_out);
+                    c.m_inBegin += frameSize;
+                    ++requests;
+                }
+                //Counted before the responses leave, so a client that got them sees the count.
+                m_requestCount.fetch_add(requests, std::memory_order_relaxed);
+                requests = 0;
+                if (open) {
+                    open = sendPending(c);
+                }
+                limited = limited && (c.m_out.size() == c.m_outBegin);
+            }
+            if (c.m_inBegin == c.m_in.size()) {
+                c.m_in.clear();
+                c.m_inBegin = 0;
+            } else if (c.m_inBegin >= readChunk) {
+                c.m_in.erase(0, c.m_inBegin);
+                c.m_inBegin = 0;
+            }
+
+            if (open && !peerClosed) {
+                updateEvents(c);
+            } else {
+                //The requests received before the client closed its side are still answered, as far
+                //as the socket takes the responses.
+                sendPending(c);
+                closeConnection(c);
+            }
+        }
+    }
+
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    ::close(epollFd);
+}
\ No newline at end of file
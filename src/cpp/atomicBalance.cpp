@@ -0,0 +1,122 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <atomicBalance.h>
+#include <stripedBalance.h>
+
+std::atomic<bool> AtomicBalance::s_autoPromotion(false);
+
+namespace {
+
+/**
+ * The last balance the thread failed a compare-and-swap on, and how many times in a row. Only
+ * the contended paths reset the count on success: a failure always leads to one of them.
+ */
+thread_local const AtomicBalance* t_contendedBalance = nullptr;
+thread_local unsigned t_contentions = 0;
+
+}
+
+AtomicBalance::~AtomicBalance() {
+
+    const int current = m_value.load(std::memory_order_relaxed);
+    if (isHot(current)) {
+        StripedBalancePool::instance().release(hotIndex(current));
+    }
+}
+
+bool AtomicBalance::addContended(int amount) {
+
+    int current = m_value.load(std::memory_order_relaxed);
+    while (true) {
+        if (isHot(current)) return addHot(current, amount);
+        if (amount > INT_MAX - current) return false;
+        if (m_value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+            t_contentions = 0;
+            return true;
+        }
+        noteContention();
+        current = m_value.load(std::memory_order_relaxed);
+    }
+}
+
+bool AtomicBalance::decreaseContended(int amount) {
+
+    int current = m_value.load(std::memory_order_relaxed);
+    while (true) {
+        if (isHot(current)) return decreaseHot(current, amount);
+        if (amount > current) return false;
+        if (m_value.compare_exchange_weak(current, current - amount, std::memory_order_relaxed)) {
+            t_contentions = 0;
+            return true;
+        }
+        noteContention();
+        current = m_value.load(std::memory_order_relaxed);
+    }
+}
+
+bool AtomicBalance::addHot(int value, int amount) {
+
+    //Pairs with the release of makeHot(), so the striped balance is seen initialized.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return StripedBalancePool::instance().at(hotIndex(value)).add(amount);
+}
+
+bool AtomicBalance::decreaseHot(int value, int amount) {
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return StripedBalancePool::instance().at(hotIndex(value)).decrease(amount);
+}
+
+int AtomicBalance::valueHot(int value) const {
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return StripedBalancePool::instance().at(hotIndex(value)).value();
+}
+
+void AtomicBalance::noteContention() {
+
+    if (!s_autoPromotion.load(std::memory_order_relaxed)) return;
+
+    if (t_contendedBalance != this) {
+        t_contendedBalance = this;
+        t_contentions = 0;
+    }
+    if (++t_contentions >= promotionContentions) {
+        t_contentions = 0;
+        makeHot();
+    }
+}
+
+bool AtomicBalance::makeHot() {
+
+    int current = m_value.load(std::memory_order_relaxed);
+    if (isHot(current)) return true;
+
+    std::uint32_t index;
+    StripedBalancePool& pool = StripedBalancePool::instance();
+    if (!pool.acquire(current, index)) return false;
+    //The striped balance starts with the balance it replaces, which may change meanwhile.
+    while (!m_value.compare_exchange_weak(current, hotValue(index), std::memory_order_release, std::memory_order_relaxed)) {
+        if (isHot(current)) {
+            pool.release(index);
+            return true;
+        }
+        pool.at(index).reset(current);
+    }
+    return true;
+}
+
+void AtomicBalance::setAutoPromotion(bool enabled) {
+
+    s_autoPromotion.store(enabled, std::memory_order_relaxed);
+}
+
+bool AtomicBalance::autoPromotion() {
+
+    return s_autoPromotion.load(std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,192 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <balanceAggregates.h>
+
+#include <algorithm>
+#include <utility>
+
+//The kernels are also compiled for AVX2 and the loader picks the version the CPU runs, since
+//the build targets the baseline instruction set. SSE2 has neither 32 bit min/max nor cheap
+//sign extension, and the AVX2 version is about 3 times faster.
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__)
+#define BALANCE_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define BALANCE_KERNEL
+#endif
+
+namespace {
+
+/** Up to this many bounds, a histogram counts the balances at or above every bound with a vectorized loop. */
+constexpr std::size_t maxVectorizedBounds = 32;
+
+/**
+ * @brief Counts the balances at or above a bound, branch-free.
+ */
+BALANCE_KERNEL std::uint32_t countAtLeast(const int* balances, std::size_t count, int bound) {
+
+    std::uint32_t atLeast = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        atLeast += static_cast<std::uint32_t>(balances[i] >= bound);
+    }
+    return atLeast;
+}
+
+/**
+ * @brief Returns the largest balance of a block, branch-free.
+ */
+BALANCE_KERNEL int maxOf(const int* balances, std::size_t count) {
+
+    int high = balances[0];
+    for (std::size_t i = 0; i < count; ++i) {
+        high = std::max(high, balances[i]);
+    }
+    return high;
+}
+
+/**
+ * @brief Aggregates a block of balances, branch-free.
+ */
+BALANCE_KERNEL BalanceAggregates aggregateBlock(const int* balances, std::size_t count) {
+
+    std::int64_t sum = 0;
+    std::uint32_t zeros = 0;
+    int low = balances[0];
+    int high = balances[0];
+    for (std::size_t i = 0; i < count; ++i) {
+        const int balance = balances[i];
+        sum += balance;
+        zeros += static_cast<std::uint32_t>(balance == 0);
+        low = std::min(low, balance);
+        high = std::max(high, balance);
+    }
+
+    BalanceAggregates block;
+    block.accounts = count;
+    block.zeroBalanceAccounts = zeros;
+    block.total = sum;
+    block.minBalance = low;
+    block.maxBalance = high;
+    return block;
+}
+
+}
+
+void BalanceAggregates::add(const int* balances, std::size_t count) {
+
+    if (count == 0) return;
+
+    *this += aggregateBlock(balances, count);
+}
+
+BalanceAggregates& BalanceAggregates::operator+=(const BalanceAggregates& other) {
+
+    if (other.accounts == 0) return *this;
+    if (accounts == 0) {
+        minBalance = other.minBalance;
+        maxBalance = other.maxBalance;
+    } else {
+        minBalance = std::min(minBalance, other.minBalance);
+        maxBalance = std::max(maxBalance, other.maxBalance);
+    }
+    accounts += other.accounts;
+    zeroBalanceAccounts += other.zeroBalanceAccounts;
+    total += other.total;
+    return *this;
+}
+
+BalanceHistogram::BalanceHistogram(std::vector<int> bounds) :
+    m_bounds(std::move(bounds)),
+    m_counts()
+{
+    std::sort(m_bounds.begin(), m_bounds.end());
+    m_bounds.erase(std::unique(m_bounds.begin(), m_bounds.end()), m_bounds.end());
+    m_counts.assign(m_bounds.size() + 1, 0);
+}
+
+void BalanceHistogram::add(const int* balances, std::size_t count) {
+
+    if (m_bounds.size() > maxVectorizedBounds) {
+        for (std::size_t i = 0; i < count; ++i) {
+            ++m_counts[static_cast<std::size_t>(std::upper_bound(m_bounds.begin(), m_bounds.end(), balances[i]) - m_bounds.begin())];
+        }
+        return;
+    }
+
+    //The bucket of every bound gets the balances at or above it, less the ones at or above the next.
+    std::uint64_t above = count;
+    for (std::size_t b = 0; b < m_bounds.size(); ++b) {
+        const std::uint64_t atLeast = countAtLeast(balances, count, m_bounds[b]);
+        m_counts[b] += above - atLeast;
+        above = atLeast;
+    }
+    m_counts.back() += above;
+}
+
+BalanceHistogram& BalanceHistogram::operator+=(const BalanceHistogram& other) {
+
+    for (std::size_t i = 0; i < m_counts.size() && i < other.m_counts.size(); ++i) {
+        m_counts[i] += other.m_counts[i];
+    }
+    return *this;
+}
+
+const std::vector<int>& BalanceHistogram::bounds() const {
+
+    return m_bounds;
+}
+
+const std::vector<std::uint64_t>& BalanceHistogram::counts() const {
+
+    return m_counts;
+}
+
+TopBalances::TopBalances(std::size_t n) :
+    m_n(n),
+    m_heap()
+{}
+
+bool TopBalances::ranksBefore(const AccountBalance& lhs, const AccountBalance& rhs) {
+
+    if (lhs.balance != rhs.balance) return lhs.balance > rhs.balance;
+    if (lhs.id.id() != rhs.id.id()) return lhs.id.id() < rhs.id.id();
+    return lhs.id.packedCreationDate() < rhs.id.packedCreationDate();
+}
+
+bool TopBalances::wantsAny(const int* balances, std::size_t count) const {
+
+    return (count > 0) && wants(maxOf(balances, count));
+}
+
+void TopBalances::add(const accountIdType& id, int balance) {
+
+    //The heap keeps the account ranked last at its front, the first one to drop.
+    const AccountBalance entry{id, balance};
+    if (m_heap.size() < m_n) {
+        m_heap.push_back(entry);
+        std::push_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+    } else if ((m_n > 0) && ranksBefore(entry, m_heap.front())) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+        m_heap.back() = entry;
+        std::push_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+    }
+}
+
+TopBalances& TopBalances::operator+=(const TopBalances& other) {
+
+    for (const AccountBalance& entry : other.m_heap) {
+        add(entry.id, entry.balance);
+    }
+    return *this;
+}
+
+std::vector<AccountBalance> TopBalances::sorted() const {
+
+    std::vector<AccountBalance> accounts(m_heap);
+    std::sort(accounts.begin(), accounts.end(), ranksBefore);
+    return accounts;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <batchRunner.h>
+
+#include <charconv>
+#include <cstring>
+#include <iterator>
+
+#include <csvImport.h>
+
+namespace {
+
+/**
+ * @brief Returns the next field of a line, removing it from the line.
+ */
+std::string_view nextField(std::string_view& line) {
+
+    std::size_t begin = 0;
+    while ((begin < line.size()) && ((line[begin] == ' ') || (line[begin] == '\t'))) ++begin;
+    std::size_t end = begin;
+    while ((end < line.size()) && (line[end] != ' ') && (line[end] != '\t')) ++end;
+    std::string_view field = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    return field;
+}
+
+template<typename T_Number>
+bool parseNumber(std::string_view field, T_Number& value) {
+
+    std::from_chars_result r = std::from_chars(field.data(), field.data() + field.size(), value);
+    return (r.ec == std::errc()) && (r.ptr == field.data() + field.size());
+}
+
+/**
+ * @brief Parses the id and the date of an account into an AccountId, which allocates nothing.
+ */
+bool parseId(std::string_view& line, accountIdType& id) {
+
+    AccountId_IdPartType idPart;
+    if (!parseNumber(nextField(line), idPart)) return false;
+    std::string_view date = nextField(line);
+    id = accountIdType(idPart, date);
+    return id.packedCreationDate() != 0;
+}
+
+bool parseAmount(std::string_view& line, int& amount) {
+
+    return parseNumber(nextField(line), amount) && (amount >= 0);
+}
+
+bool fail(std::string& out, const char* reason) {
+
+    out += "ERR ";
+    out += reason;
+    out += '\n';
+    return false;
+}
+
+}
+
+BatchRunner::BatchRunner(AccountMgr& mgr) :
+    m_mgr(mgr),
+    m_name(),
+    m_secondName()
+{}
+
+BatchStats BatchRunner::run(std::FILE* in, std::FILE* out) {
+
+    BatchStats stats;
+    CsvBlockReader reader(in, bufferSize);
+    std::string output;
+    output.reserve(bufferSize + 4096);
+
+    char* begin;
+    char* end;
+    while (reader.next(begin, end)) {
+        for (char* line = begin; line < end; ) {
+            char* eol = static_cast<char*>(std::memchr(line, '\n', static_cast<std::size_t>(end - line)));
+            if (eol == nullptr) eol = end;
+            const char* contentEnd = ((eol > line) && (eol[-1] == '\r')) ? eol - 1 : eol;
+
+            const std::size_t before = output.size();
+            if (!execute(std::string_view(line, static_cast<std::size_t>(contentEnd - line)), output)) {
+                ++stats.failed;
+            }
+            if (output.size() != before) {
+                ++stats.commands;
+            }
+            if (output.size() >= bufferSize) {
+                std::fwrite(output.data(), 1, output.size(), out);
+                output.clear();
+            }
+            line = eol + 1;
+        }
+    }
+    if (!output.empty()) {
+        std::fwrite(output.data(), 1, output.size(), out);
+    }
+    std::fflush(out);
+    return stats;
+}
+
+bool BatchRunner::execute(std::string_view line, std::string& out) {
+
+    std::string_view command = nextField(line);
+    if (command.empty() || (command[0] == '#')) return true;
+    if (command.size() != 1) return fail(out, "unknown command");
+
+    accountIdType id;
+    int amount;
+    switch (command[0]) {
+    case 'P':
+    case 'E': {
+        std::string_view name = nextField(line);
+        std::string_view secondName = nextField(line);
+        if (name.empty() || secondName.empty()) return fail(out, "missing name");
+        m_name.assign(name);
+        m_secondName.assign(secondName);
+        const accountIdType& newId = (command[0] == 'P') ? m_mgr.insertNewPersonAccount(m_name, m_secondName) : m_mgr.insertNewEnterpriseAccount(m_name, m_secondName);
+        if (newId == accountIdType()) return fail(out, "Y-tunnus taken");
+        putId(newId, out);
+        return true;
+    }
+    case 'T':
+    case 'W': {
+        if (!parseId(line, id)) return fail(out, "bad account id");
+        if (!parseAmount(line, amount)) return fail(out, "bad amount");
+        const bool done = (command[0] == 'T') ? m_mgr.topUpAccount(id, amount) : m_mgr.withdrawFromAccount(id, amount);
+        if (!done) return fail(out, "rejected");
+        out += "OK\n";
+        return true;
+    }
+    case 'X': {
+        accountIdType to;
+        if (!parseId(line, id) || !parseId(line, to)) return fail(out, "bad account id");
+        if (!parseAmount(line, amount)) return fail(out, "bad amount");
+        if (!m_mgr.transfer(id, to, amount)) return fail(out, "rejected");
+        out += "OK\n";
+        return true;
+    }
+    case 'D': {
+        if (!parseId(line, id)) return fail(out, "bad account id");
+        if (!m_mgr.renderAccountDetails(id, std::back_inserter(out), AccountDetailsFormat::Json)) return fail(out, "account not found");
+        out += '\n';
+        return true;
+    }
+    case 'M':
+        out += m_mgr.metricsSnapshot().toJson();
+        out += '\n';
+        return true;
+    default:
+        return fail(out, "unknown command");
+    }
+}
+
+void BatchRunner::putId(const accountIdType& id, std::string& out) {
+
+    char buffer[32];
+    char* p = std::to_chars(buffer, buffer + sizeof(buffer), id.id()).ptr;
+    *p++ = ' ';
+    p = accountIdType::formatCreationDate(id.packedCreationDate(), p);
+    *p++ = '\n';
+    out.append(buffer, static_cast<std::size_t>(p - buffer));
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <csvImport.h>
+
+#include <cstring>
+
+namespace {
+
+/**
+ * @brief Returns the end of the line starting at begin, i.e. its line feed or end.
+ */
+char* lineEnd(char* begin, char* end) {
+
+    char* lf = static_cast<char*>(std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+    return (lf != nullptr) ? lf : end;
+}
+
+}
+
+CsvChunkParser::CsvChunkParser() :
+    m_rows(),
+    m_rowValid(),
+    m_errors(),
+    m_lineCount(0)
+{}
+
+void CsvChunkParser::parse(char* begin, char* end, std::size_t firstLine, bool skipHeader) {
+
+    m_rows.clear();
+    m_rowValid.clear();
+    m_errors.clear();
+    m_lineCount = 0;
+
+    for (char* line = begin; line < end; ) {
+        char* eol = lineEnd(line, end);
+        char* next = (eol < end) ? eol + 1 : end;
+        char* contentEnd = ((eol > line) && (eol[-1] == '\r')) ? eol - 1 : eol;
+        ++m_lineCount;
+
+        const bool header = skipHeader && (m_lineCount == 1) && (contentEnd - line >= 5) && (std::memcmp(line, "type,", 5) == 0);
+        if ((contentEnd > line) && !header) {
+            //Unescaping rewrites the quoted lines, so their text is kept beforehand in case of error.
+            const bool quoted = std::memchr(line, '"', static_cast<std::size_t>(contentEnd - line)) != nullptr;
+            const std::string original = quoted ? std::string(line, contentEnd) : std::string();
+            NewAccount account{AccountKind::Person, std::string_view(), std::string_view()};
+            const char* error = nullptr;
+            if (parseLine(line, contentEnd, account, error)) {
+                m_rowValid.push_back(1);
+            } else {
+                m_rowValid.push_back(0);
+                m_errors.push_back(CsvImportError{firstLine + m_lineCount - 1, error, quoted ? original : std::string(line, contentEnd)});
+            }
+            m_rows.push_back(account);
+        }
+        line = next;
+    }
+}
+
+bool CsvChunkParser::parseLine(char* begin, char* end, NewAccount& row, const char*& error) {
+
+    std::string_view fields[3];
+    char* p = begin;
+    std::size_t count = 0;
+    while (true) {
+        if (count == 3) {
+            error = "Too many fields, expected 3";
+            return false;
+        }
+        p = parseField(p, end, fields[count], error);
+        if (p == nullptr) return false;
+        ++count;
+        if (p == end) break;
+        ++p;
+    }
+    if (count != 3) {
+        error = "Too few fields, expected 3";
+        return false;
+    }
+
+    if (fields[0] == "person") {
+        row.kind = AccountKind::Person;
+    } else if (fields[0] == "enterprise") {
+        row.kind = AccountKind::Enterprise;
+    } else {
+        error = "Unknown account type, expected person or enterprise";
+        return false;
+    }
+    if (fields[1].empty() || fields[2].empty()) {
+        error = "Empty name";
+        return false;
+    }
+    row.name = fields[1];
+    row.secondName = fields[2];
+    return true;
+}
+
+char* CsvChunkParser::parseField(char* begin, char* end, std::string_view& field, const char*& error) {
+
+    if ((begin == end) || (*begin != '"')) {
+        char* comma = static_cast<char*>(std::memchr(begin, ',', static_cast<std::size_t>(end - begin)));
+        char* fieldEnd = (comma != nullptr) ? comma : end;
+        if (std::memchr(begin, '"', static_cast<std::size_t>(fieldEnd - begin)) != nullptr) {
+            error = "Quote inside an unquoted field";
+            return nullptr;
+        }
+        field = std::string_view(begin, static_cast<std::size_t>(fieldEnd - begin));
+        return fieldEnd;
+    }
+
+    //Quoted field: the escaped quotes are unescaped in place, moving the text left.
+    char* out = begin;
+    for (char* p = begin + 1; p < end; ++p) {
+        if (*p == '"') {
+            if ((p + 1 < end) && (p[1] == '"')) {
+                *out++ = '"';
+                ++p;
+            } else {
+                if ((p + 1 != end) && (p[1] != ',')) {
+                    error = "Text after the closing quote";
+                    return nullptr;
+                }
+                field = std::string_view(begin, static_cast<std::size_t>(out - begin));
+                return p + 1;
+            }
+        } else {
+            *out++ = *p;
+        }
+    }
+    error = "Unterminated quoted field";
+    return nullptr;
+}
+
+const std::vector<NewAccount>& CsvChunkParser::rows() const {
+
+    return m_rows;
+}
+
+const std::vector<char>& CsvChunkParser::rowValid() const {
+
+    return m_rowValid;
+}
+
+const std::vector<CsvImportError>& CsvChunkParser::errors() const {
+
+    return m_errors;
+}
+
+std::size_t CsvChunkParser::lineCount() const {
+
+    return m_lineCount;
+}
+
+CsvBlockReader::CsvBlockReader(const std::string& path, std::size_t blockSize) :
+    m_file(std::fopen(path.c_str(), "rb")),
+    m_ownsFile(true),
+    m_buffer(),
+    m_blockSize(blockSize == 0 ? 1 : blockSize),
+    m_carryBegin(0),
+    m_carryEnd(0),
+    m_eof(false)
+{}
+
+CsvBlockReader::CsvBlockReader(std::FILE* file, std::size_t blockSize) :
+    m_file(file),
+    m_ownsFile(false),
+    m_buffer(),
+    m_blockSize(blockSize == 0 ? 1 : blockSize),
+    m_carryBegin(0),
+    m_carryEnd(0),
+    m_eof(false)
+{}
+
+CsvBlockReader::~CsvBlockReader() {
+
+    if ((m_file != nullptr) && m_ownsFile) {
+        std::fclose(m_file);
+    }
+}
+
+bool CsvBlockReader::isOpen() const {
+
+    return m_file != nullptr;
+}
+
+bool CsvBlockReader::next(char*& begin, char*& end) {
+
+    if (m_file == nullptr) return false;
+
+    //The partial line left at the end of the previous block starts the new one.
+    std::size_t size = m_carryEnd - m_carryBegin;
+    if (size > 0) {
+        std::memmove(m_buffer.data(), m_buffer.data() + m_carryBegin, size);
+    }
+    m_carryBegin = m_carryEnd = 0;
+
+    while (true) {
+        if (m_buffer.size() < size + m_blockSize) {
+            m_buffer.resize(size + m_blockSize);
+        }
+        std::size_t read = m_eof ? 0 : std::fread(m_buffer.data() + size, 1, m_buffer.size() - size, m_file);
+        if (read == 0) {
+            m_eof = true;
+        }
+        const std::size_t previous = size;
+        size += read;
+
+        if (m_eof) {
+            if (size == 0) return false;
+            begin = m_buffer.data();
+            end = begin + size;
+            return true;
+        }
+
+        //Cut the block after its last line feed; without one, the line continues in the next read.
+        for (std::size_t i = size; i > previous; --i) {
+            if (m_buffer[i - 1] == '\n') {
+                begin = m_buffer.data();
+                end = begin + i;
+                m_carryBegin = i;
+                m_carryEnd = size;
+                return true;
+            }
+        }
+    }
+}
+
+std::vector<char*> splitCsvBlock(char* begin, char* end, std::size_t count) {
+
+    std::vector<char*> limits;
+    limits.push_back(begin);
+    const std::size_t size = static_cast<std::size_t>(end - begin);
+    for (std::size_t i = 1; i < count; ++i) {
+        char* cut = begin + size * i / count;
+        if (cut < limits.back()) {
+            cut = limits.back();
+        }
+        cut = lineEnd(cut, end);
+        limits.push_back((cut < end) ? cut + 1 : end);
+    }
+    limits.push_back(end);
+    return limits;
+}
\ No newline at end of file
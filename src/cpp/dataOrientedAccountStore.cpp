@@ -0,0 +1,212 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <dataOrientedAccountStore.h>
+#include <rcuDomain.h>
+#include <accountDetails.h>
+#include <personAccount.h>
+#include <enterpriseAccount.h>
+
+DataOrientedAccountStore::ColdRecord::ColdRecord(const accountIdType& id, std::string_view name, std::string_view secondName) :
+    m_id(id),
+    m_name(name),
+    m_secondName(secondName)
+{}
+
+DataOrientedAccountStore::DataOrientedAccountStore() :
+    m_index(),
+    m_balances(),
+    m_kinds(),
+    m_cold(),
+    m_personCount(0)
+{
+    m_index.setGracePeriod(&RcuDomain::synchronize);
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::find(const accountIdType& id) const {
+
+    auto it = m_index.find(id);
+    if (it != m_index.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::find(const accountIdType& id, std::size_t hash) const {
+
+    auto it = m_index.find(id, hash);
+    if (it != m_index.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::find(const accountIdViewType& id, std::size_t hash) const {
+
+    auto it = m_index.find(id, hash);
+    if (it != m_index.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::findConcurrent(const accountIdType& id, std::size_t hash) const {
+
+    Handle handle;
+    return m_index.findConcurrent(id, hash, handle) ? handle : invalidHandle();
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::findConcurrent(const accountIdViewType& id, std::size_t hash) const {
+
+    Handle handle;
+    return m_index.findConcurrent(id, hash, handle) ? handle : invalidHandle();
+}
+
+void DataOrientedAccountStore::prefetch(std::size_t hash) const {
+
+    m_index.prefetch(hash);
+}
+
+void DataOrientedAccountStore::prefetchCandidates(std::size_t hash) const {
+
+    m_index.prefetchCandidates(hash);
+}
+
+void DataOrientedAccountStore::prefetchBalance(Handle handle) const {
+
+    prefetchForWrite(&m_balances[handle]);
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::insertAccount(const accountIdType& id, AccountKind kind, std::string_view name, std::string_view secondName) {
+
+    Handle handle = static_cast<Handle>(m_balances.emplace_back(0));
+    m_kinds.emplace_back(kind);
+    m_cold.emplace_back(id, name, secondName);
+    m_index[id] = handle;
+
+    return handle;
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::insertPersonAccount(const accountIdType& id, std::string_view firstName, std::string_view lastName) {
+
+    ++m_personCount;
+    return insertAccount(id, AccountKind::Person, firstName, lastName);
+}
+
+DataOrientedAccountStore::Handle DataOrientedAccountStore::insertEnterpriseAccount(const accountIdType& id, std::string_view yTunnus, std::string_view companyName) {
+
+    return insertAccount(id, AccountKind::Enterprise, yTunnus, companyName);
+}
+
+const accountIdType& DataOrientedAccountStore::id(Handle handle) const {
+
+    return m_cold[handle].m_id;
+}
+
+AccountKind DataOrientedAccountStore::kind(Handle handle) const {
+
+    return m_kinds[handle];
+}
+
+bool DataOrientedAccountStore::addToBalance(Handle handle, int amount) {
+
+    return m_balances[handle].add(amount);
+}
+
+bool DataOrientedAccountStore::decreaseFromBalance(Handle handle, int amount) {
+
+    return m_balances[handle].decrease(amount);
+}
+
+int DataOrientedAccountStore::balance(Handle handle) const {
+
+    return m_balances[handle].value();
+}
+
+bool DataOrientedAccountStore::makeBalanceHot(Handle handle) {
+
+    return m_balances[handle].makeHot();
+}
+
+bool DataOrientedAccountStore::balanceHot(Handle handle) const {
+
+    return m_balances[handle].hot();
+}
+
+void DataOrientedAccountStore::accept(Handle handle, Visitor<AccountId_IdPartType>* visitor) const {
+
+    const ColdRecord& cold = m_cold[handle];
+    if (m_kinds[handle] == AccountKind::Person) {
+        PersonAccount<AccountId_IdPartType> account;
+        account.setId(cold.m_id);
+        account.setFirstName(cold.m_name);
+        account.setLastName(cold.m_secondName);
+        account.addToBalance(balance(handle));
+        account.accept(visitor);
+    } else {
+        EnterpriseAccount<AccountId_IdPartType> account;
+        account.setId(cold.m_id);
+        account.setYTunnus(cold.m_name);
+        account.setCompanyName(cold.m_secondName);
+        account.addToBalance(balance(handle));
+        account.accept(visitor);
+    }
+}
+
+std::string DataOrientedAccountStore::accountDetails(Handle handle) const {
+
+    AccountDetailsVisitor<AccountId_IdPartType> visitor;
+    accept(handle, &visitor);
+    return visitor.accountDetails();
+}
+
+std::size_t DataOrientedAccountStore::size() const {
+
+    return m_balances.size();
+}
+
+std::size_t DataOrientedAccountStore::indexCapacity() const {
+
+    return m_index.capacity();
+}
+
+std::int64_t DataOrientedAccountStore::totalBalance() const {
+
+    std::int64_t total = 0;
+    for (std::size_t c = 0; c < m_balances.chunkCount(); ++c) {
+        const AtomicBalance* balances = m_balances.chunk(c);
+        const std::size_t length = m_balances.chunkLength(c);
+        for (std::size_t i = 0; i < length; ++i) {
+            total += balances[i].value();
+        }
+    }
+    return total;
+}
+
+void DataOrientedAccountStore::reserve(std::size_t count) {
+
+    m_index.reserve(count);
+}
+
+AccountAllocationStats DataOrientedAccountStore::allocationStats() const {
+
+    AccountAllocationStats stats;
+    stats.personAccounts.liveObjects = m_personCount;
+    stats.personAccounts.createdObjects = m_personCount;
+    stats.enterpriseAccounts.liveObjects = size() - m_personCount;
+    stats.enterpriseAccounts.createdObjects = size() - m_personCount;
+
+    const std::size_t bytesPerAccount = sizeof(AtomicBalance) + sizeof(AccountKind) + sizeof(ColdRecord);
+    stats.columns.liveObjects = size();
+    stats.columns.createdObjects = size();
+    stats.columns.systemAllocations = m_balances.chunkCount() + m_kinds.chunkCount() + m_cold.chunkCount();
+    stats.columns.bytesAllocated = m_balances.chunkCount() * ChunkedArray<AtomicBalance>::chunkSize * sizeof(AtomicBalance)
+                                 + m_kinds.chunkCount() * ChunkedArray<AccountKind>::chunkSize * sizeof(AccountKind)
+                                 + m_cold.chunkCount() * ChunkedArray<ColdRecord>::chunkSize * sizeof(ColdRecord);
+    stats.columns.bytesInUse = size() * bytesPerAccount;
+    return stats;
+}
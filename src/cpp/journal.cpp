@@ -0,0 +1,369 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <journal.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/** Size of the frame of a record: the payload length and its checksum. */
+constexpr std::size_t frameSize = 2 * sizeof(std::uint32_t);
+
+/** Records larger than this are treated as corrupt. */
+constexpr std::uint32_t maxPayloadSize = 1 << 24;
+
+/**
+ * @brief FNV-1a hash of the payload of a record, used as its checksum.
+ */
+std::uint32_t checksum(const char* data, std::size_t size) {
+
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Reads the payload of a record field by field.
+ */
+class PayloadParser {
+public:
+    PayloadParser(const char* data, std::size_t size) :
+        m_data(data),
+        m_end(data + size),
+        m_ok(true)
+    {}
+
+    template<typename T>
+    T get() {
+
+        T value = T();
+        if (static_cast<std::size_t>(m_end - m_data) < sizeof(T)) {
+            m_ok = false;
+            return value;
+        }
+        std::memcpy(&value, m_data, sizeof(T));
+        m_data += sizeof(T);
+        return value;
+    }
+
+    accountIdType getId() {
+
+        AccountId_IdPartType id = get<AccountId_IdPartType>();
+        std::uint32_t creationDate = get<std::uint32_t>();
+        return accountIdType(id, creationDate);
+    }
+
+    std::string getString() {
+
+        std::uint32_t size = get<std::uint32_t>();
+        if (!m_ok || (static_cast<std::size_t>(m_end - m_data) < size)) {
+            m_ok = false;
+            return std::string();
+        }
+        std::string s(m_data, size);
+        m_data += size;
+        return s;
+    }
+
+    bool ok() const { return m_ok && (m_data == m_end); }
+
+private:
+    const char* m_data;
+    const char* m_end;
+    bool m_ok;
+};
+
+#ifdef _WIN32
+int openJournalFile(const std::string& path) { return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE); }
+int truncateFile(int fd, std::uint64_t length) { return _chsize_s(fd, static_cast<__int64>(length)) == 0 ? 0 : -1; }
+std::int64_t seekToEnd(int fd) { return _lseeki64(fd, 0, SEEK_END); }
+long writeFile(int fd, const char* data, std::size_t size) { return _write(fd, data, static_cast<unsigned int>(size)); }
+int syncFile(int fd) { return _commit(fd); }
+int closeFile(int fd) { return _close(fd); }
+#else
+int openJournalFile(const std::string& path) { return ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644); }
+int truncateFile(int fd, std::uint64_t length) { return ::ftruncate(fd, static_cast<off_t>(length)); }
+std::int64_t seekToEnd(int fd) { return static_cast<std::int64_t>(::lseek(fd, 0, SEEK_END)); }
+long writeFile(int fd, const char* data, std::size_t size) { return static_cast<long>(::write(fd, data, size)); }
+#ifdef __APPLE__
+int syncFile(int fd) { return ::fsync(fd); }
+#else
+int syncFile(int fd) { return ::fdatasync(fd); }
+#endif
+int closeFile(int fd) { return ::close(fd); }
+#endif
+
+}
+
+JournalReader::JournalReader(const std::string& path) :
+    m_file(std::fopen(path.c_str(), "rb")),
+    m_payload(),
+    m_validLength(0)
+{}
+
+JournalReader::~JournalReader() {
+
+    if (m_file != nullptr) {
+        std::fclose(m_file);
+    }
+}
+
+bool JournalReader::next(JournalRecord& record) {
+
+    if (m_file == nullptr) return false;
+
+    std::uint32_t frame[2];
+    if (std::fread(frame, 1, frameSize, m_file) != frameSize) return false;
+    if (frame[0] > maxPayloadSize) return false;
+
+    m_payload.resize(frame[0]);
+    if (std::fread(m_payload.data(), 1, m_payload.size(), m_file) != m_payload.size()) return false;
+    if (checksum(m_payload.data(), m_payload.size()) != frame[1]) return false;
+
+    PayloadParser parser(m_payload.data(), m_payload.size());
+    record.type = static_cast<JournalRecordType>(parser.get<std::uint8_t>());
+    switch (record.type) {
+    case JournalRecordType::PersonAccount:
+    case JournalRecordType::EnterpriseAccount:
+        record.id = parser.getId();
+        record.name = parser.getString();
+        record.secondName = parser.getString();
+        break;
+    case JournalRecordType::BalanceChange:
+        record.id = parser.getId();
+        record.amount = parser.get<std::int32_t>();
+        break;
+    case JournalRecordType::Transfer:
+        record.id = parser.getId();
+        record.toId = parser.getId();
+        record.amount = parser.get<std::int32_t>();
+        break;
+    default:
+        return false;
+    }
+    if (!parser.ok()) return false;
+
+    m_validLength += frameSize + m_payload.size();
+    return true;
+}
+
+std::uint64_t JournalReader::validLength() const {
+
+    return m_validLength;
+}
+
+Journal::Journal(const std::string& path, const JournalOptions& options) :
+    m_options(options),
+    m_fd(-1),
+    m_mutex(),
+    m_hasWork(),
+    m_durable(),
+    m_buffer(),
+    m_recordStart(0),
+    m_lastSequence(0),
+    m_durableSequence(0),
+    m_stop(false),
+    m_failed(false),
+    m_stats(),
+    m_writer()
+{
+    std::uint64_t validLength = 0;
+    {
+        JournalReader reader(path);
+        JournalRecord record;
+        while (reader.next(record)) {
+        }
+        validLength = reader.validLength();
+    }
+
+    m_fd = openJournalFile(path);
+    if (m_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Can't open the journal " + path);
+    }
+    if ((truncateFile(m_fd, validLength) != 0) || (seekToEnd(m_fd) < 0)) {
+        int error = errno;
+        closeFile(m_fd);
+        throw std::system_error(error, std::generic_category(), "Can't open the journal " + path);
+    }
+
+    m_writer = std::thread(&Journal::writerLoop, this);
+}
+
+Journal::~Journal() {
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_hasWork.notify_one();
+    m_writer.join();
+    closeFile(m_fd);
+}
+
+void Journal::beginRecord(JournalRecordType type) {
+
+    m_recordStart = m_buffer.size();
+    m_buffer.resize(m_recordStart + frameSize);
+    put(&type, sizeof(type));
+}
+
+std::uint64_t Journal::endRecord() {
+
+    std::uint32_t frame[2];
+    const std::size_t payloadStart = m_recordStart + frameSize;
+    frame[0] = static_cast<std::uint32_t>(m_buffer.size() - payloadStart);
+    frame[1] = checksum(m_buffer.data() + payloadStart, frame[0]);
+    std::memcpy(m_buffer.data() + m_recordStart, frame, frameSize);
+
+    ++m_stats.records;
+    //The writer only needs a wake up for the first record of a batch or when the batch is full.
+    if ((m_recordStart == 0) || (m_buffer.size() >= m_options.maxBatchBytes)) {
+        m_hasWork.notify_one();
+    }
+    return ++m_lastSequence;
+}
+
+void Journal::put(const void* data, std::size_t size) {
+
+    const char* bytes = static_cast<const char*>(data);
+    m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+}
+
+void Journal::putId(const accountIdType& id) {
+
+    AccountId_IdPartType idPart = id.id();
+    std::uint32_t creationDate = id.packedCreationDate();
+    put(&idPart, sizeof(idPart));
+    put(&creationDate, sizeof(creationDate));
+}
+
+void Journal::putString(const std::string& s) {
+
+    std::uint32_t size = static_cast<std::uint32_t>(s.size());
+    put(&size, sizeof(size));
+    put(s.data(), s.size());
+}
+
+std::uint64_t Journal::logPersonAccount(const accountIdType& id, const std::string& firstName, const std::string& lastName) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    beginRecord(JournalRecordType::PersonAccount);
+    putId(id);
+    putString(firstName);
+    putString(lastName);
+    return endRecord();
+}
+
+std::uint64_t Journal::logEnterpriseAccount(const accountIdType& id, const std::string& yTunnus, const std::string& companyName) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    beginRecord(JournalRecordType::EnterpriseAccount);
+    putId(id);
+    putString(yTunnus);
+    putString(companyName);
+    return endRecord();
+}
+
+std::uint64_t Journal::logBalanceChange(const accountIdType& id, int amount) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::int32_t amount32 = amount;
+    beginRecord(JournalRecordType::BalanceChange);
+    putId(id);
+    put(&amount32, sizeof(amount32));
+    return endRecord();
+}
+
+std::uint64_t Journal::logTransfer(const accountIdType& from, const accountIdType& to, int amount) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::int32_t amount32 = amount;
+    beginRecord(JournalRecordType::Transfer);
+    putId(from);
+    putId(to);
+    put(&amount32, sizeof(amount32));
+    return endRecord();
+}
+
+bool Journal::waitDurable(std::uint64_t sequence) {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_durable.wait(lock, [this, sequence]() { return m_failed || (m_durableSequence >= sequence); });
+    return m_durableSequence >= sequence;
+}
+
+bool Journal::failed() const {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+JournalStats Journal::stats() const {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Journal::writerLoop() {
+
+    std::vector<char> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_hasWork.wait(lock, [this]() { return m_stop || !m_buffer.empty(); });
+        if (m_buffer.empty()) break;
+
+        if (m_options.maxDelay.count() > 0) {
+            m_hasWork.wait_for(lock, m_options.maxDelay, [this]() { return m_stop || (m_buffer.size() >= m_options.maxBatchBytes); });
+        }
+
+        batch.clear();
+        batch.swap(m_buffer);
+        const std::uint64_t sequence = m_lastSequence;
+
+        lock.unlock();
+        bool written = !m_failed && writeBatch(batch);
+        lock.lock();
+
+        if (written) {
+            m_durableSequence = sequence;
+            ++m_stats.batches;
+            m_stats.bytes += batch.size();
+        } else {
+            m_failed = true;
+        }
+        m_durable.notify_all();
+    }
+}
+
+bool Journal::writeBatch(const std::vector<char>& batch) {
+
+    std::size_t written = 0;
+    while (written < batch.size()) {
+        long n = writeFile(m_fd, batch.data() + written, batch.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    return !m_options.syncToDisk || (syncFile(m_fd) == 0);
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <accountClient.h>
+
+namespace {
+
+/** The accounts every connection creates and then operates on. */
+constexpr std::size_t accountsPerConnection = 100;
+
+struct ConnectionResult {
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    std::vector<double> batchMicros;
+    bool ok = true;
+};
+
+/**
+ * @brief Runs the load of one connection: creates its accounts, then sends batches of
+ * pipelined top-ups, withdrawals, transfers and details, waiting for each whole batch.
+ */
+void runConnection(const std::string& address, std::uint16_t port, std::size_t requests, std::size_t depth, std::size_t seed, ConnectionResult& result) {
+
+    AccountClient client;
+    if (!client.connect(address, port)) {
+        result.ok = false;
+        return;
+    }
+
+    Response response;
+    std::vector<accountIdType> ids;
+    for (std::size_t i = 0; i < accountsPerConnection; ++i) {
+        client.createPersonAccount("Load", "Generator");
+    }
+    if (!client.flush()) {
+        result.ok = false;
+        return;
+    }
+    for (std::size_t i = 0; i < accountsPerConnection; ++i) {
+        if (!client.receive(response)) {
+            result.ok = false;
+            return;
+        }
+        ids.push_back(response.id);
+    }
+
+    std::size_t k = seed;
+    std::size_t sent = 0;
+    while (sent < requests) {
+        const std::size_t batch = std::min(depth, requests - sent);
+        for (std::size_t i = 0; i < batch; ++i) {
+            k = k * 6364136223846793005ULL + 1442695040888963407ULL;
+            const accountIdType& id = ids[(k >> 33) % ids.size()];
+            switch ((k >> 20) % 10) {
+            case 0:
+                client.details(id);
+                break;
+            case 1:
+                client.transfer(id, ids[(k >> 40) % ids.size()], 1);
+                break;
+            case 2:
+            case 3:
+            case 4:
+                client.withdraw(id, 1);
+                break;
+            default:
+                client.topUp(id, 2);
+                break;
+            }
+        }
+        const auto start = std::chrono::steady_clock::now();
+        if (!client.flush()) {
+            result.ok = false;
+            return;
+        }
+        for (std::size_t i = 0; i < batch; ++i) {
+            if (!client.receive(response)) {
+                result.ok = false;
+                return;
+            }
+            if (response.status != ResponseStatus::Ok) {
+                ++result.errors;
+            }
+        }
+        result.batchMicros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        result.requests += batch;
+        sent += batch;
+    }
+}
+
+}
+
+/**
+ * tech_task_load <address> <port> [connections] [requests per connection] [pipeline depth]
+ *
+ * Loads an AccountMgr server with a mix of 50% top-ups, 30% withdrawals, 10% transfers and
+ * 10% details, and prints the throughput and the latency of the pipelined batches.
+ */
+int main(int argc, char* argv[]) {
+
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s <address> <port> [connections] [requests per connection] [pipeline depth]\n", argv[0]);
+        return 1;
+    }
+    const std::string address = argv[1];
+    const std::uint16_t port = static_cast<std::uint16_t>(std::atoi(argv[2]));
+    const std::size_t connections = (argc > 3) ? static_cast<std::size_t>(std::atoi(argv[3])) : 4;
+    const std::size_t requests = (argc > 4) ? static_cast<std::size_t>(std::atoll(argv[4])) : 100000;
+    const std::size_t depth = std::max<std::size_t>((argc > 5) ? static_cast<std::size_t>(std::atoi(argv[5])) : 64, 1);
+
+    std::vector<ConnectionResult> results(connections);
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < connections; ++i) {
+        threads.emplace_back(runConnection, address, port, requests, depth, i + 1, std::ref(results[i]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::uint64_t total = 0;
+    std::uint64_t errors = 0;
+    std::vector<double> batches;
+    for (const ConnectionResult& result : results) {
+        if (!result.ok) {
+            std::fprintf(stderr, "A connection failed\n");
+            return 1;
+        }
+        total += result.requests;
+        errors += result.errors;
+        batches.insert(batches.end(), result.batchMicros.begin(), result.batchMicros.end());
+    }
+    std::sort(batches.begin(), batches.end());
+    const double p50 = batches.empty() ? 0 : batches[batches.size() / 2];
+    const double p99 = batches.empty() ? 0 : batches[batches.size() * 99 / 100];
+
+    std::printf("%llu requests in %.3f s: %.0f requests/s\n", static_cast<unsigned long long>(total), seconds, static_cast<double>(total) / seconds);
+    std::printf("Not Ok: %llu (withdrawals and transfers from empty accounts)\n", static_cast<unsigned long long>(errors));
+    std::printf("Batch of %zu latency: p50 %.1f us, p99 %.1f us\n", depth, p50, p99);
+    return 0;
+}
\ No newline at end of file
@@ -6,11 +6,17 @@ This source code is licensed under the BSD-style license found in the
 LICENSE file in the root directory of this source tree.
 **********************************************************************/
 #include <iostream>
+#include <memory>
 #include <string>
 #include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
 
 #include <accountMgr.h>
 #include <accountId.h>
+#include <batchRunner.h>
+#include <journal.h>
 
 void createNewPersonAccount(AccountMgr& db) {
 
@@ -36,6 +42,10 @@ void createNewEnterpriseAccount(AccountMgr& db) {
     std::cin >> companyName;
 
     accountIdType id = db.insertNewEnterpriseAccount(yTunnus, companyName);
+    if (id == accountIdType()) {
+        std::cout << "Error! The Y-tunnus has an account already." << std::endl;
+        return;
+    }
     std::cout   << "Account created: {" << id.id() << ", "
                 << id.creationDate() << "}" <<  std::endl;
 }
@@ -52,7 +62,7 @@ void addBalance(AccountMgr& db) {
     std::cout << "Amount (> 0)? ";
     std::cin >> sAmount;
 
-    int id;
+    AccountId_IdPartType id;
     std::from_chars_result r = std::from_chars(sId.data(), sId.data() + sId.size(), id);
     if (r.ec == std::errc::invalid_argument) {
         std::cout << "Wrong argument Id!" << std::endl;
@@ -66,8 +76,7 @@ void addBalance(AccountMgr& db) {
         return;
     }
 
-    accountIdType aId(id, creationDate);
-    if (db.topUpAccount(aId, amount))  {
+    if (db.topUpAccount(accountIdViewType{id, creationDate}, amount))  {
         std::cout << "Success!" << std::endl;
     } else {
         std::cout << "Error!" << std::endl;
@@ -86,7 +95,7 @@ void decreaseBalance(AccountMgr& db) {
     std::cout << "Amount (> 0)? ";
     std::cin >> sAmount;
 
-    int id;
+    AccountId_IdPartType id;
     std::from_chars_result r = std::from_chars(sId.data(), sId.data() + sId.size(), id);
     if (r.ec == std::errc::invalid_argument) {
         std::cout << "Wrong argument Id!" << std::endl;
@@ -100,8 +109,55 @@ void decreaseBalance(AccountMgr& db) {
         return;
     }
 
-    accountIdType aId(id, creationDate);
-    if (db.withdrawFromAccount(aId, amount))  {
+    if (db.withdrawFromAccount(accountIdViewType{id, creationDate}, amount))  {
+        std::cout << "Success!" << std::endl;
+    } else {
+        std::cout << "Error!" << std::endl;
+    }
+}
+
+void transferBalance(AccountMgr& db) {
+
+    std::string sFromId;
+    std::string fromCreationDate;
+    std::string sToId;
+    std::string toCreationDate;
+    std::string sAmount;
+    std::cout << "From Id? ";
+    std::cin >> sFromId;
+    std::cout << "From Creation Date? ";
+    std::cin >> fromCreationDate;
+    std::cout << "To Id? ";
+    std::cin >> sToId;
+    std::cout << "To Creation Date? ";
+    std::cin >> toCreationDate;
+    std::cout << "Amount (> 0)? ";
+    std::cin >> sAmount;
+
+    AccountId_IdPartType fromId;
+    std::from_chars_result r = std::from_chars(sFromId.data(), sFromId.data() + sFromId.size(), fromId);
+    if (r.ec == std::errc::invalid_argument) {
+        std::cout << "Wrong argument From Id!" << std::endl;
+        return;
+    }
+
+    AccountId_IdPartType toId;
+    r = std::from_chars(sToId.data(), sToId.data() + sToId.size(), toId);
+    if (r.ec == std::errc::invalid_argument) {
+        std::cout << "Wrong argument To Id!" << std::endl;
+        return;
+    }
+
+    int amount;
+    r = std::from_chars(sAmount.data(), sAmount.data() + sAmount.size(), amount);
+    if ((r.ec == std::errc::invalid_argument) || (amount < 0)) {
+        std::cout << "Wrong argument Amount!" << std::endl;
+        return;
+    }
+
+    accountIdType aFromId(fromId, fromCreationDate);
+    accountIdType aToId(toId, toCreationDate);
+    if (db.transfer(aFromId, aToId, amount))  {
         std::cout << "Success!" << std::endl;
     } else {
         std::cout << "Error!" << std::endl;
@@ -117,16 +173,15 @@ void accountDetails(AccountMgr& db) {
     std::cout << "Creation Date? ";
     std::cin >> creationDate;
 
-    int id;
+    AccountId_IdPartType id;
     std::from_chars_result r = std::from_chars(sId.data(), sId.data() + sId.size(), id);
     if (r.ec == std::errc::invalid_argument) {
         std::cout << "Wrong argument Id!" << std::endl;
         return;
     }
 
-    accountIdType aId(id, creationDate);
     std::cout << "****" << std::endl;
-    std::cout << db.getAccountDetails(aId) << std::endl;
+    std::cout << db.getAccountDetails(accountIdViewType{id, creationDate}) << std::endl;
     std::cout << "****" << std::endl;
 }
 
@@ -142,15 +197,76 @@ void processOption(const std::string& op, AccountMgr& db) {
         decreaseBalance(db);
     } else if (op == "5") {
         accountDetails(db);
+    } else if (op == "7") {
+        transferBalance(db);
     } else {
         std::cout << "INVALID OPTION!" << std::endl;
     }
 }
 
+/**
+ * @brief Runs the commands of a file, or of stdin for "-", printing only their results.
+ * Without a journal path nothing is journaled, as every journaled change waits for the disk.
+ */
+int runBatch(const char* commandsPath, const char* journalPath) {
+
+    AccountMgr db;
+    std::unique_ptr<Journal> journal;
+    if (journalPath != nullptr) {
+        JournalReplayStats replay = db.replayJournal(journalPath);
+        for (const accountIdType& id : replay.negativeBalances) {
+            std::fprintf(stderr, "The journal leaves account %lld %s with a negative balance\n", static_cast<long long>(id.id()), id.creationDate().c_str());
+        }
+        try {
+            journal.reset(new Journal(journalPath));
+        } catch (const std::system_error& e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+        db.attachJournal(journal.get());
+    }
+
+    const bool useStdin = std::strcmp(commandsPath, "-") == 0;
+    std::FILE* in = useStdin ? stdin : std::fopen(commandsPath, "rb");
+    if (in == nullptr) {
+        std::fprintf(stderr, "Can't open %s\n", commandsPath);
+        return 1;
+    }
+    BatchStats stats = BatchRunner(db).run(in, stdout);
+    if (!useStdin) {
+        std::fclose(in);
+    }
+    return (stats.failed == 0) ? 0 : 2;
+}
+
 int main(int argc, char* argv[]) {
 
+    if ((argc > 2) && (std::strcmp(argv[1], "--batch") == 0)) {
+        return runBatch(argv[2], (argc > 3) ? argv[3] : nullptr);
+    }
+
     AccountMgr db;
 
+    //Only given a journal, the accounts are recovered from the previous runs and logged to it.
+    std::unique_ptr<Journal> journal;
+    if (argc > 1) {
+        const std::string journalPath = argv[1];
+        JournalReplayStats replay = db.replayJournal(journalPath);
+        if (replay.records > 0) {
+            std::cout << "Recovered " << replay.records << " records from " << journalPath << std::endl;
+        }
+        for (const accountIdType& id : replay.negativeBalances) {
+            std::cout << "The journal leaves account " << id.id() << " " << id.creationDate() << " with a negative balance" << std::endl;
+        }
+        try {
+            journal.reset(new Journal(journalPath));
+        } catch (const std::system_error& e) {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+        db.attachJournal(journal.get());
+    }
+
     std::string option;
     while (option != "6") {
         std::cout << "Options" << std::endl;
@@ -161,6 +277,7 @@ int main(int argc, char* argv[]) {
         std::cout << "4.- Decrease balance from account" << std::endl;
         std::cout << "5.- Get account details" << std::endl;
         std::cout << "6.- Salir" << std::endl;
+        std::cout << "7.- Transferir saldo entre cuentas" << std::endl;
         std::cout << "? ";
         std::cin >> option;
 
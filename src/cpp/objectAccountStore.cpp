@@ -0,0 +1,225 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <objectAccountStore.h>
+#include <rcuDomain.h>
+#include <accountDetails.h>
+
+template<typename T_Index>
+BasicObjectAccountStore<T_Index>::BasicObjectAccountStore() :
+    m_actMgrDB(),
+    m_personAccounts(),
+    m_enterpriseAccounts()
+{
+    if constexpr (concurrentLookups) {
+        m_actMgrDB.setGracePeriod(&RcuDomain::synchronize);
+    }
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::find(const accountIdType& id) const {
+
+    auto it = m_actMgrDB.find(id);
+    if (it != m_actMgrDB.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::find(const accountIdType& id, std::size_t hash) const {
+
+    auto it = m_actMgrDB.find(id, hash);
+    if (it != m_actMgrDB.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::find(const accountIdViewType& id, std::size_t hash) const {
+
+    auto it = m_actMgrDB.find(id, hash);
+    if (it != m_actMgrDB.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::findConcurrent(const accountIdType& id, std::size_t hash) const {
+
+    if constexpr (concurrentLookups) {
+        Handle handle;
+        return m_actMgrDB.findConcurrent(id, hash, handle) ? handle : invalidHandle();
+    } else {
+        return find(id, hash);
+    }
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::findConcurrent(const accountIdViewType& id, std::size_t hash) const {
+
+    if constexpr (concurrentLookups) {
+        Handle handle;
+        return m_actMgrDB.findConcurrent(id, hash, handle) ? handle : invalidHandle();
+    } else {
+        return find(id, hash);
+    }
+}
+
+template<typename T_Index>
+void BasicObjectAccountStore<T_Index>::prefetch(std::size_t hash) const {
+
+    if constexpr (concurrentLookups) {
+        m_actMgrDB.prefetch(hash);
+    }
+}
+
+template<typename T_Index>
+void BasicObjectAccountStore<T_Index>::prefetchCandidates(std::size_t hash) const {
+
+    if constexpr (concurrentLookups) {
+        m_actMgrDB.prefetchCandidates(hash);
+    }
+}
+
+template<typename T_Index>
+void BasicObjectAccountStore<T_Index>::prefetchBalance(Handle handle) const {
+
+    prefetchForWrite(handle);
+}
+
+template<typename T_Index>
+PersonAccount<AccountId_IdPartType>* BasicObjectAccountStore<T_Index>::createNewPersonAccountPtr(const accountIdType& id, std::string_view firstName, std::string_view lastName) {
+
+    PersonAccount<AccountId_IdPartType>* account = m_personAccounts.create();
+    account->setFirstName(firstName);
+    account->setLastName(lastName);
+    account->setId(id);
+
+    return account;
+}
+
+template<typename T_Index>
+EnterpriseAccount<AccountId_IdPartType>* BasicObjectAccountStore<T_Index>::createNewEnterpriseAccountPtr(const accountIdType& id, std::string_view yTunnus, std::string_view companyName) {
+
+    EnterpriseAccount<AccountId_IdPartType>* account = m_enterpriseAccounts.create();
+    account->setYTunnus(yTunnus);
+    account->setCompanyName(companyName);
+    account->setId(id);
+
+    return account;
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::insertPersonAccount(const accountIdType& id, std::string_view firstName, std::string_view lastName) {
+
+    PersonAccount<AccountId_IdPartType>* account = createNewPersonAccountPtr(id, firstName, lastName);
+    m_actMgrDB[account->id()] = account;
+
+    return account;
+}
+
+template<typename T_Index>
+typename BasicObjectAccountStore<T_Index>::Handle BasicObjectAccountStore<T_Index>::insertEnterpriseAccount(const accountIdType& id, std::string_view yTunnus, std::string_view companyName) {
+
+    EnterpriseAccount<AccountId_IdPartType>* account = createNewEnterpriseAccountPtr(id, yTunnus, companyName);
+    m_actMgrDB[account->id()] = account;
+
+    return account;
+}
+
+template<typename T_Index>
+const accountIdType& BasicObjectAccountStore<T_Index>::id(Handle handle) const {
+
+    return handle->id();
+}
+
+template<typename T_Index>
+bool BasicObjectAccountStore<T_Index>::addToBalance(Handle handle, int amount) {
+
+    return handle->addToBalance(amount);
+}
+
+template<typename T_Index>
+bool BasicObjectAccountStore<T_Index>::decreaseFromBalance(Handle handle, int amount) {
+
+    return handle->decreaseFromBalance(amount);
+}
+
+template<typename T_Index>
+int BasicObjectAccountStore<T_Index>::balance(Handle handle) const {
+
+    return handle->balance();
+}
+
+template<typename T_Index>
+bool BasicObjectAccountStore<T_Index>::makeBalanceHot(Handle handle) {
+
+    return handle->makeBalanceHot();
+}
+
+template<typename T_Index>
+bool BasicObjectAccountStore<T_Index>::balanceHot(Handle handle) const {
+
+    return handle->balanceHot();
+}
+
+template<typename T_Index>
+void BasicObjectAccountStore<T_Index>::accept(Handle handle, Visitor<AccountId_IdPartType>* visitor) const {
+
+    handle->accept(visitor);
+}
+
+template<typename T_Index>
+std::string BasicObjectAccountStore<T_Index>::accountDetails(Handle handle) const {
+
+    AccountDetailsVisitor<AccountId_IdPartType> visitor;
+    handle->accept(&visitor);
+    return visitor.accountDetails();
+}
+
+template<typename T_Index>
+std::size_t BasicObjectAccountStore<T_Index>::size() const {
+
+    return m_actMgrDB.size();
+}
+
+template<typename T_Index>
+std::size_t BasicObjectAccountStore<T_Index>::indexCapacity() const {
+
+    return m_actMgrDB.capacity();
+}
+
+template<typename T_Index>
+std::int64_t BasicObjectAccountStore<T_Index>::totalBalance() const {
+
+    std::int64_t total = 0;
+    for (const auto& entry : m_actMgrDB) {
+        total += entry.second->balance();
+    }
+    return total;
+}
+
+template<typename T_Index>
+void BasicObjectAccountStore<T_Index>::reserve(std::size_t count) {
+
+    m_actMgrDB.reserve(count);
+}
+
+template<typename T_Index>
+AccountAllocationStats BasicObjectAccountStore<T_Index>::allocationStats() const {
+
+    AccountAllocationStats stats;
+    stats.personAccounts = m_personAccounts.stats();
+    stats.enterpriseAccounts = m_enterpriseAccounts.stats();
+    return stats;
+}
+
+template class BasicObjectAccountStore<AccountMgrMap>;
+template class BasicObjectAccountStore<AccountMgrNodeMap>;
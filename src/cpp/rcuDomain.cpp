@@ -0,0 +1,96 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <rcuDomain.h>
+
+#include <thread>
+
+/** Gives the slot of a thread back when the thread ends. */
+struct RcuDomain::ThreadExit {
+    ~ThreadExit() {
+
+        RcuDomain::unregisterThread();
+    }
+};
+
+std::atomic<std::uint64_t> RcuDomain::s_epoch(1);
+
+RcuDomain::RcuDomain() :
+    m_mutex(),
+    m_readers()
+{}
+
+RcuDomain& RcuDomain::instance() {
+
+    //Never destroyed: threads may end, and give their slot back, after it would be.
+    static RcuDomain* domain = new RcuDomain();
+    return *domain;
+}
+
+RcuDomain::Reader* RcuDomain::registerThread() {
+
+    thread_local ThreadExit threadExit;
+    (void)threadExit;
+
+    RcuDomain& domain = instance();
+    std::lock_guard<std::mutex> lock(domain.m_mutex);
+    Reader* reader = nullptr;
+    for (const std::unique_ptr<Reader>& candidate : domain.m_readers) {
+        if (!candidate->m_inUse) {
+            reader = candidate.get();
+            break;
+        }
+    }
+    if (reader == nullptr) {
+        domain.m_readers.push_back(std::make_unique<Reader>());
+        reader = domain.m_readers.back().get();
+    }
+    reader->m_inUse = true;
+    t_reader = reader;
+    return reader;
+}
+
+void RcuDomain::unregisterThread() {
+
+    if (t_reader == nullptr) return;
+
+    RcuDomain& domain = instance();
+    std::lock_guard<std::mutex> lock(domain.m_mutex);
+    t_reader->m_epoch.store(0, std::memory_order_release);
+    t_reader->m_depth = 0;
+    t_reader->m_inUse = false;
+    t_reader = nullptr;
+}
+
+void RcuDomain::synchronize() {
+
+    //A reader either announced its section before this increment, and is waited for, or
+    //its fence comes after the fence below, so it already sees what the writer unlinked.
+    const std::uint64_t target = s_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    RcuDomain& domain = instance();
+    std::lock_guard<std::mutex> lock(domain.m_mutex);
+    for (const std::unique_ptr<Reader>& reader : domain.m_readers) {
+        for (;;) {
+            const std::uint64_t epoch = reader->m_epoch.load(std::memory_order_acquire);
+            if ((epoch == 0) || (epoch >= target)) break;
+            std::this_thread::yield();
+        }
+    }
+}
+
+std::size_t RcuDomain::readerCount() {
+
+    RcuDomain& domain = instance();
+    std::lock_guard<std::mutex> lock(domain.m_mutex);
+    std::size_t count = 0;
+    for (const std::unique_ptr<Reader>& reader : domain.m_readers) {
+        if (reader->m_inUse) ++count;
+    }
+    return count;
+}
\ No newline at end of file
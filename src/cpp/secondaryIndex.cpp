@@ -0,0 +1,180 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <secondaryIndex.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/** The recent insertions of a PersonNameIndex are merged once they reach this size at least. */
+constexpr std::size_t minRecentEntries = 1024;
+
+/**
+ * @brief The approximate size of a node of std::set, i.e. the element and the tree links.
+ */
+template<typename T>
+constexpr std::size_t setNodeBytes() {
+
+    return sizeof(T) + 4 * sizeof(void*);
+}
+
+}
+
+StringArena::StringArena() :
+    m_blocks(),
+    m_allocated(0),
+    m_next(nullptr),
+    m_left(0)
+{}
+
+std::string_view StringArena::store(std::string_view text, std::string_view more) {
+
+    const std::size_t length = text.size() + more.size();
+    if (length == 0) {
+        return std::string_view();
+    }
+    if (length > m_left) {
+        const std::size_t size = std::max(blockSize, length);
+        m_blocks.emplace_back(new char[size]);
+        m_allocated += size;
+        m_next = m_blocks.back().get();
+        m_left = size;
+    }
+    char* copy = m_next;
+    if (!text.empty()) std::memcpy(copy, text.data(), text.size());
+    if (!more.empty()) std::memcpy(copy + text.size(), more.data(), more.size());
+    m_next += length;
+    m_left -= length;
+    return std::string_view(copy, length);
+}
+
+std::size_t StringArena::bytes() const {
+
+    return m_allocated + m_blocks.capacity() * sizeof(m_blocks[0]);
+}
+
+YTunnusIndex::YTunnusIndex() :
+    m_strings(),
+    m_map(),
+    m_duplicates(0)
+{}
+
+bool YTunnusIndex::insert(std::string_view yTunnus, const accountIdType& id) {
+
+    if (m_map.find(yTunnus) != m_map.end()) {
+        ++m_duplicates;
+        return false;
+    }
+    m_map.try_emplace(m_strings.store(yTunnus), id);
+    return true;
+}
+
+std::optional<accountIdType> YTunnusIndex::find(std::string_view yTunnus) const {
+
+    Map::const_iterator it = m_map.find(yTunnus);
+    if (it == m_map.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void YTunnusIndex::addStats(SecondaryIndexStats& stats) const {
+
+    stats.yTunnusEntries += m_map.size();
+    stats.duplicateYTunnus += m_duplicates;
+    //A slot holds the key and the value, plus a control byte.
+    stats.yTunnusBytes += m_map.capacity() * (sizeof(Map::value_type) + 1) + m_strings.bytes();
+}
+
+bool PersonNameIndex::Less::operator()(const Entry& lhs, const Entry& rhs) const {
+
+    int c = lhs.lastName().compare(rhs.lastName());
+    if (c == 0) c = lhs.firstName().compare(rhs.firstName());
+    if (c != 0) return c < 0;
+    if (lhs.m_id.id() != rhs.m_id.id()) return lhs.m_id.id() < rhs.m_id.id();
+    return lhs.m_id.packedCreationDate() < rhs.m_id.packedCreationDate();
+}
+
+bool PersonNameIndex::Less::operator()(const Entry& lhs, const Key& rhs) const {
+
+    int c = lhs.lastName().compare(rhs.first);
+    return (c < 0) || ((c == 0) && (lhs.firstName().compare(rhs.second) < 0));
+}
+
+bool PersonNameIndex::Less::operator()(const Key& lhs, const Entry& rhs) const {
+
+    int c = lhs.first.compare(rhs.lastName());
+    return (c < 0) || ((c == 0) && (lhs.second.compare(rhs.firstName()) < 0));
+}
+
+PersonNameIndex::PersonNameIndex() :
+    m_strings(),
+    m_sorted(),
+    m_recent()
+{}
+
+void PersonNameIndex::insert(std::string_view lastName, std::string_view firstName, const accountIdType& id) {
+
+    //Both names are stored together, the last name first.
+    std::string_view names = m_strings.store(lastName, firstName);
+    m_recent.insert(Entry{names.data(), static_cast<std::uint32_t>(lastName.size()), static_cast<std::uint32_t>(firstName.size()), id});
+    if (m_recent.size() >= std::max(minRecentEntries, m_sorted.size() / 8)) {
+        mergeRecent();
+    }
+}
+
+void PersonNameIndex::mergeRecent() {
+
+    const std::size_t middle = m_sorted.size();
+    m_sorted.insert(m_sorted.end(), m_recent.begin(), m_recent.end());
+    std::inplace_merge(m_sorted.begin(), m_sorted.begin() + static_cast<std::ptrdiff_t>(middle), m_sorted.end(), Less());
+    m_recent.clear();
+}
+
+template<typename T_Match>
+std::vector<accountIdType> PersonNameIndex::collect(const Less::Key& from, T_Match match, std::size_t limit) const {
+
+    //Both sorted ranges are walked from the key at once, so the results come out in name order.
+    std::vector<accountIdType> ids;
+    std::vector<Entry>::const_iterator sorted = std::lower_bound(m_sorted.begin(), m_sorted.end(), from, Less());
+    std::set<Entry, Less>::const_iterator recent = m_recent.lower_bound(from);
+    while (ids.size() < limit) {
+        const bool sortedOk = (sorted != m_sorted.end()) && match(*sorted);
+        const bool recentOk = (recent != m_recent.end()) && match(*recent);
+        if (!sortedOk && !recentOk) break;
+        if (sortedOk && (!recentOk || Less()(*sorted, *recent))) {
+            ids.push_back(sorted->m_id);
+            ++sorted;
+        } else {
+            ids.push_back(recent->m_id);
+            ++recent;
+        }
+    }
+    return ids;
+}
+
+std::vector<accountIdType> PersonNameIndex::findByLastNamePrefix(std::string_view lastNamePrefix, std::size_t limit) const {
+
+    return collect(Less::Key(lastNamePrefix, std::string_view()), [lastNamePrefix](const Entry& e) {
+        return e.lastName().substr(0, lastNamePrefix.size()) == lastNamePrefix;
+    }, limit);
+}
+
+std::vector<accountIdType> PersonNameIndex::findByName(std::string_view lastName, std::string_view firstNamePrefix, std::size_t limit) const {
+
+    return collect(Less::Key(lastName, firstNamePrefix), [lastName, firstNamePrefix](const Entry& e) {
+        return (e.lastName() == lastName) && (e.firstName().substr(0, firstNamePrefix.size()) == firstNamePrefix);
+    }, limit);
+}
+
+void PersonNameIndex::addStats(SecondaryIndexStats& stats) const {
+
+    stats.personEntries += m_sorted.size() + m_recent.size();
+    stats.personBytes += m_sorted.capacity() * sizeof(Entry) + m_recent.size() * setNodeBytes<Entry>() + m_strings.bytes();
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include <pthread.h>
+
+#include <accountMgr.h>
+#include <accountServer.h>
+#include <journal.h>
+
+/**
+ * tech_task_server [port] [worker threads] [journal file]
+ *
+ * Serves an AccountMgr over TCP until SIGINT or SIGTERM. Without a journal file nothing is
+ * journaled; with one, the accounts are recovered from it on start.
+ */
+int main(int argc, char* argv[]) {
+
+    const std::uint16_t port = static_cast<std::uint16_t>((argc > 1) ? std::atoi(argv[1]) : 7070);
+    ServerOptions options;
+    if (argc > 2) {
+        options.threadCount = static_cast<std::size_t>(std::atoi(argv[2]));
+    }
+
+    //The signals are blocked before the workers start, so only sigwait below receives them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    AccountMgr db;
+    std::unique_ptr<Journal> journal;
+    if (argc > 3) {
+        JournalReplayStats replay = db.replayJournal(argv[3]);
+        std::printf("Recovered %zu records from %s\n", replay.records, argv[3]);
+        for (const accountIdType& id : replay.negativeBalances) {
+            std::fprintf(stderr, "The journal leaves account %lld %s with a negative balance\n", static_cast<long long>(id.id()), id.creationDate().c_str());
+        }
+        try {
+            journal.reset(new Journal(argv[3]));
+        } catch (const std::system_error& e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+        db.attachJournal(journal.get());
+    }
+
+    AccountServer server(db, options);
+    try {
+        server.start("0.0.0.0", port);
+    } catch (const std::system_error& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    std::printf("Listening on port %u with %zu workers\n", static_cast<unsigned>(server.port()), options.threadCount);
+    std::fflush(stdout);
+
+    int signal;
+    sigwait(&signals, &signal);
+    server.stop();
+    std::printf("Served %llu requests\n", static_cast<unsigned long long>(server.requestCount()));
+    std::printf("%s", db.metricsSnapshot().toText().c_str());
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <serverProtocol.h>
+
+namespace {
+
+/**
+ * @brief Reads the little endian integers of a body, failing once past its end.
+ */
+class BodyReader {
+public:
+    BodyReader(const char* data, std::size_t size) :
+        m_data(reinterpret_cast<const unsigned char*>(data)),
+        m_size(size),
+        m_offset(0),
+        m_ok(true)
+    {}
+
+    std::uint64_t get(std::size_t bytes) {
+
+        if (m_size - m_offset < bytes) {
+            m_ok = false;
+            m_offset = m_size;
+            return 0;
+        }
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < bytes; ++i) {
+            value |= static_cast<std::uint64_t>(m_data[m_offset + i]) << (8 * i);
+        }
+        m_offset += bytes;
+        return value;
+    }
+
+    std::string_view getBytes(std::size_t bytes) {
+
+        if (m_size - m_offset < bytes) {
+            m_ok = false;
+            m_offset = m_size;
+            return std::string_view();
+        }
+        std::string_view view(reinterpret_cast<const char*>(m_data + m_offset), bytes);
+        m_offset += bytes;
+        return view;
+    }
+
+    accountIdType getId() {
+
+        const std::int64_t id = static_cast<std::int64_t>(get(8));
+        const std::uint32_t date = static_cast<std::uint32_t>(get(4));
+        return accountIdType(static_cast<AccountId_IdPartType>(id), date);
+    }
+
+    std::string_view rest() {
+
+        return getBytes(m_size - m_offset);
+    }
+
+    /** Whether every field was read and nothing is left. */
+    bool done() const {
+
+        return m_ok && (m_offset == m_size);
+    }
+
+private:
+    const unsigned char* m_data;
+    std::size_t m_size;
+    std::size_t m_offset;
+    bool m_ok;
+};
+
+void put(std::string& out, std::uint64_t value, std::size_t bytes) {
+
+    for (std::size_t i = 0; i < bytes; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+void putId(std::string& out, const accountIdType& id) {
+
+    put(out, static_cast<std::uint64_t>(static_cast<std::int64_t>(id.id())), 8);
+    put(out, id.packedCreationDate(), 4);
+}
+
+/**
+ * @brief Decodes the length, the tag and the code of a frame.
+ */
+FrameResult decodeHeader(const char* data, std::size_t size, std::uint32_t& tag, std::uint8_t& code, std::size_t& frameSize) {
+
+    if (size < 4) return FrameResult::Incomplete;
+    BodyReader header(data, size);
+    const std::uint32_t length = static_cast<std::uint32_t>(header.get(4));
+    if ((length < frameHeaderSize - 4) || (length > maxFrameLength)) return FrameResult::Malformed;
+    if (size - 4 < length) return FrameResult::Incomplete;
+    tag = static_cast<std::uint32_t>(header.get(4));
+    code = static_cast<std::uint8_t>(header.get(1));
+    frameSize = 4 + static_cast<std::size_t>(length);
+    return FrameResult::Complete;
+}
+
+}
+
+FrameResult decodeRequest(const char* data, std::size_t size, Request& request, std::size_t& frameSize) {
+
+    std::uint8_t code;
+    FrameResult result = decodeHeader(data, size, request.tag, code, frameSize);
+    if (result != FrameResult::Complete) return result;
+
+    request.type = static_cast<RequestType>(code);
+    request.id = accountIdType();
+    request.toId = accountIdType();
+    request.amount = 0;
+    request.name = std::string_view();
+    request.secondName = std::string_view();
+
+    BodyReader body(data + frameHeaderSize, frameSize - frameHeaderSize);
+    bool knownType = true;
+    switch (request.type) {
+    case RequestType::CreatePerson:
+    case RequestType::CreateEnterprise:
+        request.name = body.getBytes(static_cast<std::size_t>(body.get(2)));
+        request.secondName = body.getBytes(static_cast<std::size_t>(body.get(2)));
+        break;
+    case RequestType::TopUp:
+    case RequestType::Withdraw:
+        request.id = body.getId();
+        request.amount = static_cast<std::int32_t>(body.get(4));
+        break;
+    case RequestType::Transfer:
+        request.id = body.getId();
+        request.toId = body.getId();
+        request.amount = static_cast<std::int32_t>(body.get(4));
+        break;
+    case RequestType::Details:
+        request.id = body.getId();
+        break;
+    default:
+        knownType = false;
+        break;
+    }
+    request.valid = knownType && body.done();
+    return FrameResult::Complete;
+}
+
+FrameResult decodeResponse(const char* data, std::size_t size, Response& response, std::size_t& frameSize) {
+
+    std::uint8_t code;
+    FrameResult result = decodeHeader(data, size, response.tag, code, frameSize);
+    if (result != FrameResult::Complete) return result;
+
+    response.status = static_cast<ResponseStatus>(code);
+    response.id = accountIdType();
+    response.details = std::string_view();
+
+    //A created account and the details are told apart by the body: ids are exactly 12 bytes.
+    BodyReader body(data + frameHeaderSize, frameSize - frameHeaderSize);
+    if (frameSize - frameHeaderSize == 12) {
+        response.id = body.getId();
+    } else {
+        response.details = body.rest();
+    }
+    return FrameResult::Complete;
+}
+
+std::size_t beginFrame(std::string& out, std::uint32_t tag, std::uint8_t code) {
+
+    const std::size_t start = out.size();
+    put(out, 0, 4);
+    put(out, tag, 4);
+    put(out, code, 1);
+    return start;
+}
+
+void endFrame(std::string& out, std::size_t start) {
+
+    const std::uint64_t length = out.size() - start - 4;
+    for (std::size_t i = 0; i < 4; ++i) {
+        out[start + i] = static_cast<char>((length >> (8 * i)) & 0xff);
+    }
+}
+
+void encodeCreateRequest(std::string& out, std::uint32_t tag, RequestType type, std::string_view name, std::string_view secondName) {
+
+    const std::size_t start = beginFrame(out, tag, static_cast<std::uint8_t>(type));
+    put(out, name.size(), 2);
+    out += name;
+    put(out, secondName.size(), 2);
+    out += secondName;
+    endFrame(out, start);
+}
+
+void encodeBalanceRequest(std::string& out, std::uint32_t tag, RequestType type, const accountIdType& id, int amount) {
+
+    const std::size_t start = beginFrame(out, tag, static_cast<std::uint8_t>(type));
+    putId(out, id);
+    put(out, static_cast<std::uint32_t>(amount), 4);
+    endFrame(out, start);
+}
+
+void encodeTransferRequest(std::string& out, std::uint32_t tag, const accountIdType& from, const accountIdType& to, int amount) {
+
+    const std::size_t start = beginFrame(out, tag, static_cast<std::uint8_t>(RequestType::Transfer));
+    putId(out, from);
+    putId(out, to);
+    put(out, static_cast<std::uint32_t>(amount), 4);
+    endFrame(out, start);
+}
+
+void encodeDetailsRequest(std::string& out, std::uint32_t tag, const accountIdType& id) {
+
+    const std::size_t start = beginFrame(out, tag, static_cast<std::uint8_t>(RequestType::Details));
+    putId(out, id);
+    endFrame(out, start);
+}
+
+void encodeResponse(std::string& out, std::uint32_t tag, ResponseStatus status) {
+
+    endFrame(out, beginFrame(out, tag, static_cast<std::uint8_t>(status)));
+}
+
+void encodeIdResponse(std::string& out, std::uint32_t tag, const accountIdType& id) {
+
+    const std::size_t start = beginFrame(out, tag, static_cast<std::uint8_t>(ResponseStatus::Ok));
+    putId(out, id);
+    endFrame(out, start);
+}
\ No newline at end of file
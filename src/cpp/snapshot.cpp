@@ -0,0 +1,258 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <snapshot.h>
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/** Blocks, the block table and the records are aligned to 8 bytes inside the file. */
+constexpr std::uint64_t fileAlignment = 8;
+
+std::uint64_t alignUp(std::uint64_t value) {
+
+    return (value + fileAlignment - 1) & ~(fileAlignment - 1);
+}
+
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path) :
+    m_path(path),
+    m_tmpPath(path + ".tmp"),
+    m_file(std::fopen(m_tmpPath.c_str(), "wb")),
+    m_ok(m_file != nullptr),
+    m_offset(sizeof(SnapshotHeader)),
+    m_accountCount(0),
+    m_records(),
+    m_strings(),
+    m_blocks()
+{
+    if (m_ok) {
+        //The header is written last, once the counts are known.
+        SnapshotHeader header = SnapshotHeader();
+        m_ok = std::fwrite(&header, sizeof(header), 1, m_file) == 1;
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+
+    if (m_file != nullptr) {
+        std::fclose(m_file);
+        std::remove(m_tmpPath.c_str());
+    }
+}
+
+void SnapshotWriter::addAccount(const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance) {
+
+    SnapshotRecord record = SnapshotRecord();
+    record.id = static_cast<std::int64_t>(id.id());
+    record.stringOffset = m_strings.size();
+    record.creationDate = id.packedCreationDate();
+    record.balance = balance;
+    record.nameLength = static_cast<std::uint32_t>(name.size());
+    record.secondNameLength = static_cast<std::uint32_t>(secondName.size());
+    record.kind = kind;
+    m_records.push_back(record);
+
+    m_strings += name;
+    m_strings += secondName;
+}
+
+bool SnapshotWriter::flushBlock() {
+
+    if (!m_ok) return false;
+
+    SnapshotBlock block;
+    block.offset = m_offset;
+    block.accountCount = m_records.size();
+    block.stringBytes = m_strings.size();
+    m_strings.resize(alignUp(m_strings.size()), '\0');
+
+    m_ok = (m_records.empty() || (std::fwrite(m_records.data(), sizeof(SnapshotRecord), m_records.size(), m_file) == m_records.size()))
+        && (m_strings.empty() || (std::fwrite(m_strings.data(), 1, m_strings.size(), m_file) == m_strings.size()));
+
+    m_offset += m_records.size() * sizeof(SnapshotRecord) + m_strings.size();
+    m_accountCount += m_records.size();
+    m_blocks.push_back(block);
+    m_records.clear();
+    m_strings.clear();
+    return m_ok;
+}
+
+bool SnapshotWriter::finish(std::int64_t lastUsedId) {
+
+    if (!m_records.empty()) {
+        flushBlock();
+    }
+    if (!m_ok) return false;
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.recordSize = sizeof(SnapshotRecord);
+    header.accountCount = m_accountCount;
+    header.lastUsedId = lastUsedId;
+    header.blockCount = m_blocks.size();
+    header.blockTableOffset = m_offset;
+
+    m_ok = (m_blocks.empty() || (std::fwrite(m_blocks.data(), sizeof(SnapshotBlock), m_blocks.size(), m_file) == m_blocks.size()))
+        && (std::fseek(m_file, 0, SEEK_SET) == 0)
+        && (std::fwrite(&header, sizeof(header), 1, m_file) == 1)
+        && (std::fflush(m_file) == 0);
+#ifndef _WIN32
+    m_ok = m_ok && (::fsync(fileno(m_file)) == 0);
+#endif
+    m_ok = (std::fclose(m_file) == 0) && m_ok;
+    m_file = nullptr;
+
+#ifdef _WIN32
+    m_ok = m_ok && MoveFileExA(m_tmpPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    m_ok = m_ok && (std::rename(m_tmpPath.c_str(), m_path.c_str()) == 0);
+#endif
+    if (!m_ok) {
+        std::remove(m_tmpPath.c_str());
+    }
+    return m_ok;
+}
+
+SnapshotReader::SnapshotReader(const std::string& path) :
+    m_data(nullptr),
+    m_size(0),
+    m_blocks(nullptr),
+    m_valid(false)
+#ifdef _WIN32
+    , m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(nullptr)
+#endif
+{
+#ifdef _WIN32
+    m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size) || (size.QuadPart == 0)) return;
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr) return;
+    m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) return;
+    m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if ((::fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        ::close(fd);
+        return;
+    }
+    void* data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return;
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<std::size_t>(st.st_size);
+    ::madvise(data, m_size, MADV_WILLNEED);
+#endif
+    m_valid = validate();
+}
+
+SnapshotReader::~SnapshotReader() {
+
+    unmap();
+}
+
+void SnapshotReader::unmap() {
+
+#ifdef _WIN32
+    if (m_data != nullptr) UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr) CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE) CloseHandle(m_fileHandle);
+#else
+    if (m_data != nullptr) ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+}
+
+bool SnapshotReader::validate() {
+
+    if (m_size < sizeof(SnapshotHeader)) return false;
+
+    const SnapshotHeader& h = header();
+    if ((std::memcmp(h.magic, snapshotMagic, sizeof(h.magic)) != 0) || (h.version != snapshotVersion) || (h.recordSize != sizeof(SnapshotRecord))) {
+        return false;
+    }
+    if ((h.blockTableOffset % fileAlignment != 0) || (h.blockTableOffset > m_size) || (h.blockCount > (m_size - h.blockTableOffset) / sizeof(SnapshotBlock))) {
+        return false;
+    }
+    m_blocks = reinterpret_cast<const SnapshotBlock*>(m_data + h.blockTableOffset);
+
+    std::uint64_t accountCount = 0;
+    for (std::size_t i = 0; i < h.blockCount; ++i) {
+        const SnapshotBlock& block = m_blocks[i];
+        if ((block.offset % fileAlignment != 0) || (block.offset > h.blockTableOffset)) return false;
+        const std::uint64_t room = h.blockTableOffset - block.offset;
+        if ((block.accountCount > room / sizeof(SnapshotRecord)) || (block.stringBytes > room - block.accountCount * sizeof(SnapshotRecord))) {
+            return false;
+        }
+        accountCount += block.accountCount;
+    }
+    return accountCount == h.accountCount;
+}
+
+bool SnapshotReader::valid() const {
+
+    return m_valid;
+}
+
+const SnapshotHeader& SnapshotReader::header() const {
+
+    return *reinterpret_cast<const SnapshotHeader*>(m_data);
+}
+
+std::size_t SnapshotReader::blockCount() const {
+
+    return m_valid ? static_cast<std::size_t>(header().blockCount) : 0;
+}
+
+const SnapshotRecord* SnapshotReader::records(std::size_t block) const {
+
+    return reinterpret_cast<const SnapshotRecord*>(m_data + m_blocks[block].offset);
+}
+
+std::size_t SnapshotReader::recordCount(std::size_t block) const {
+
+    return static_cast<std::size_t>(m_blocks[block].accountCount);
+}
+
+std::string_view SnapshotReader::name(std::size_t block, const SnapshotRecord& record) const {
+
+    const SnapshotBlock& b = m_blocks[block];
+    if ((record.stringOffset > b.stringBytes) || (record.nameLength > b.stringBytes - record.stringOffset)) {
+        return std::string_view();
+    }
+    const char* strings = m_data + b.offset + b.accountCount * sizeof(SnapshotRecord);
+    return std::string_view(strings + record.stringOffset, record.nameLength);
+}
+
+std::string_view SnapshotReader::secondName(std::size_t block, const SnapshotRecord& record) const {
+
+    const SnapshotBlock& b = m_blocks[block];
+    const std::uint64_t offset = record.stringOffset + record.nameLength;
+    if ((record.stringOffset > b.stringBytes) || (offset > b.stringBytes) || (record.secondNameLength > b.stringBytes - offset)) {
+        return std::string_view();
+    }
+    const char* strings = m_data + b.offset + b.accountCount * sizeof(SnapshotRecord);
+    return std::string_view(strings + offset, record.secondNameLength);
+}
\ No newline at end of file
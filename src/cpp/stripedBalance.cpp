@@ -0,0 +1,178 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <stripedBalance.h>
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+/** The stripe of the next thread that credits a striped balance. */
+std::atomic<std::size_t> g_nextStripe(0);
+
+std::uint64_t pack(std::uint64_t money, std::uint64_t headroom) { return money | (headroom << 32); }
+std::uint64_t moneyOf(std::uint64_t state) { return state & 0xFFFFFFFFu; }
+std::uint64_t headroomOf(std::uint64_t state) { return state >> 32; }
+
+/** Moves the amount from the headroom of a stripe to its money, if the headroom is enough. */
+bool credit(std::atomic<std::uint64_t>& stripe, std::uint64_t amount) {
+
+    std::uint64_t current = stripe.load(std::memory_order_relaxed);
+    while (headroomOf(current) >= amount) {
+        if (stripe.compare_exchange_weak(current, pack(moneyOf(current) + amount, headroomOf(current) - amount), std::memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+/** Moves the amount from the money of a stripe to its headroom, if the money is enough. */
+bool debit(std::atomic<std::uint64_t>& stripe, std::uint64_t amount) {
+
+    std::uint64_t current = stripe.load(std::memory_order_relaxed);
+    while (moneyOf(current) >= amount) {
+        if (stripe.compare_exchange_weak(current, pack(moneyOf(current) - amount, headroomOf(current) + amount), std::memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+}
+
+StripedBalance::StripedBalance() :
+    m_stripes(),
+    m_borrowMutex()
+{}
+
+std::size_t StripedBalance::threadStripe() {
+
+    thread_local const std::size_t stripe = g_nextStripe.fetch_add(1, std::memory_order_relaxed) % stripeCount;
+    return stripe;
+}
+
+void StripedBalance::reset(int value) {
+
+    for (Stripe& stripe : m_stripes) {
+        stripe.m_state.store(0, std::memory_order_relaxed);
+    }
+    m_stripes[0].m_state.store(pack(value, INT_MAX - value), std::memory_order_relaxed);
+}
+
+bool StripedBalance::add(int amount) {
+
+    const std::size_t own = threadStripe();
+    std::atomic<std::uint64_t>& ownState = m_stripes[own].m_state;
+    if (credit(ownState, amount)) return true;
+
+    //The first pass takes half the headroom of every other stripe, so the threads crediting
+    //them don't run out at once, and the second one whatever is left. Other threads may spend
+    //what was gathered meanwhile, in which case the credit is refused as if they came first.
+    std::lock_guard<std::mutex> lock(m_borrowMutex);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::size_t i = 1; i < stripeCount; ++i) {
+            std::atomic<std::uint64_t>& stripe = m_stripes[(own + i) % stripeCount].m_state;
+            std::uint64_t current = stripe.load(std::memory_order_relaxed);
+            while (headroomOf(current) > 0) {
+                const std::uint64_t take = (pass == 0) ? (headroomOf(current) + 1) / 2 : headroomOf(current);
+                if (stripe.compare_exchange_weak(current, pack(moneyOf(current), headroomOf(current) - take), std::memory_order_relaxed)) {
+                    ownState.fetch_add(pack(0, take), std::memory_order_relaxed);
+                    break;
+                }
+            }
+        }
+        if (credit(ownState, amount)) return true;
+    }
+    return false;
+}
+
+bool StripedBalance::decrease(int amount) {
+
+    const std::uint64_t wanted = amount;
+    const std::size_t own = threadStripe();
+    std::atomic<std::uint64_t>& ownState = m_stripes[own].m_state;
+    if (debit(ownState, wanted)) return true;
+
+    //Borrowers go one at a time, so two of them can't both hold part of the money and fail.
+    //Each stripe only gives what it holds, so none becomes negative. The headroom the borrowed
+    //money leaves isn't given to the stripes until the withdrawal succeeds, so no credit can
+    //spend it and the money always fits back.
+    std::lock_guard<std::mutex> lock(m_borrowMutex);
+    std::uint64_t taken[stripeCount] = {};
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; (i < stripeCount) && (total < wanted); ++i) {
+        std::atomic<std::uint64_t>& stripe = m_stripes[(own + i) % stripeCount].m_state;
+        std::uint64_t current = stripe.load(std::memory_order_relaxed);
+        while (moneyOf(current) > 0) {
+            const std::uint64_t take = std::min(moneyOf(current), wanted - total);
+            if (stripe.compare_exchange_weak(current, pack(moneyOf(current) - take, headroomOf(current)), std::memory_order_relaxed)) {
+                taken[i] = take;
+                total += take;
+                break;
+            }
+        }
+    }
+    if (total == wanted) {
+        ownState.fetch_add(pack(0, total), std::memory_order_relaxed);
+        return true;
+    }
+
+    for (std::size_t i = 0; i < stripeCount; ++i) {
+        m_stripes[(own + i) % stripeCount].m_state.fetch_add(pack(taken[i], 0), std::memory_order_relaxed);
+    }
+    return false;
+}
+
+int StripedBalance::value() const {
+
+    std::uint64_t total = 0;
+    for (const Stripe& stripe : m_stripes) {
+        total += moneyOf(stripe.m_state.load(std::memory_order_relaxed));
+    }
+    //The stripes are read one after another, so the sum may mix moments whose total differs.
+    return static_cast<int>(std::min<std::uint64_t>(total, INT_MAX));
+}
+
+StripedBalancePool& StripedBalancePool::instance() {
+
+    //Never destroyed: accounts in static storage may give their balance back after it would be.
+    static StripedBalancePool* pool = new StripedBalancePool();
+    return *pool;
+}
+
+StripedBalancePool::StripedBalancePool() :
+    m_chunks(),
+    m_size(0),
+    m_free(),
+    m_mutex()
+{}
+
+bool StripedBalancePool::acquire(int value, std::uint32_t& index) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        if (m_size == chunkSize * maxChunks) return false;
+        if (m_size % chunkSize == 0) {
+            m_chunks[m_size / chunkSize].store(new StripedBalance[chunkSize], std::memory_order_relaxed);
+        }
+        index = static_cast<std::uint32_t>(m_size++);
+    }
+    at(index).reset(value);
+    return true;
+}
+
+void StripedBalancePool::release(std::uint32_t index) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(index);
+}
+
+std::size_t StripedBalancePool::inUse() const {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size - m_free.size();
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#include <variantAccountStore.h>
+#include <rcuDomain.h>
+
+VariantAccountStore::VariantAccountStore() :
+    m_index(),
+    m_accounts(),
+    m_personCount(0)
+{
+    m_index.setGracePeriod(&RcuDomain::synchronize);
+}
+
+VariantAccountStore::Handle VariantAccountStore::find(const accountIdType& id) const {
+
+    auto it = m_index.find(id);
+    if (it != m_index.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+VariantAccountStore::Handle VariantAccountStore::find(const accountIdType& id, std::size_t hash) const {
+
+    auto it = m_index.find(id, hash);
+    if (it != m_index.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+VariantAccountStore::Handle VariantAccountStore::find(const accountIdViewType& id, std::size_t hash) const {
+
+    auto it = m_index.find(id, hash);
+    if (it != m_index.end()) {
+        return (*it).second;
+    }
+    return invalidHandle();
+}
+
+VariantAccountStore::Handle VariantAccountStore::findConcurrent(const accountIdType& id, std::size_t hash) const {
+
+    Handle handle;
+    return m_index.findConcurrent(id, hash, handle) ? handle : invalidHandle();
+}
+
+VariantAccountStore::Handle VariantAccountStore::findConcurrent(const accountIdViewType& id, std::size_t hash) const {
+
+    Handle handle;
+    return m_index.findConcurrent(id, hash, handle) ? handle : invalidHandle();
+}
+
+void VariantAccountStore::prefetch(std::size_t hash) const {
+
+    m_index.prefetch(hash);
+}
+
+void VariantAccountStore::prefetchCandidates(std::size_t hash) const {
+
+    m_index.prefetchCandidates(hash);
+}
+
+void VariantAccountStore::prefetchBalance(Handle handle) const {
+
+    prefetchForWrite(&m_accounts[handle]);
+}
+
+VariantAccountStore::Handle VariantAccountStore::insertPersonAccount(const accountIdType& id, std::string_view firstName, std::string_view lastName) {
+
+    Handle handle = static_cast<Handle>(m_accounts.emplace_back(std::in_place_type<PersonAccountValue<AccountId_IdPartType> >, id, firstName, lastName));
+    m_index[id] = handle;
+    ++m_personCount;
+
+    return handle;
+}
+
+VariantAccountStore::Handle VariantAccountStore::insertEnterpriseAccount(const accountIdType& id, std::string_view yTunnus, std::string_view companyName) {
+
+    Handle handle = static_cast<Handle>(m_accounts.emplace_back(std::in_place_type<EnterpriseAccountValue<AccountId_IdPartType> >, id, yTunnus, companyName));
+    m_index[id] = handle;
+
+    return handle;
+}
+
+const accountIdType& VariantAccountStore::id(Handle handle) const {
+
+    return accountValue(m_accounts[handle]).id();
+}
+
+AccountKind VariantAccountStore::kind(Handle handle) const {
+
+    return std::holds_alternative<PersonAccountValue<AccountId_IdPartType> >(m_accounts[handle]) ? AccountKind::Person : AccountKind::Enterprise;
+}
+
+bool VariantAccountStore::addToBalance(Handle handle, int amount) {
+
+    return accountValue(m_accounts[handle]).addToBalance(amount);
+}
+
+bool VariantAccountStore::decreaseFromBalance(Handle handle, int amount) {
+
+    return accountValue(m_accounts[handle]).decreaseFromBalance(amount);
+}
+
+int VariantAccountStore::balance(Handle handle) const {
+
+    return accountValue(m_accounts[handle]).balance();
+}
+
+bool VariantAccountStore::makeBalanceHot(Handle handle) {
+
+    return accountValue(m_accounts[handle]).makeBalanceHot();
+}
+
+bool VariantAccountStore::balanceHot(Handle handle) const {
+
+    return accountValue(m_accounts[handle]).balanceHot();
+}
+
+std::string VariantAccountStore::accountDetails(Handle handle) const {
+
+    return std::visit(AccountDetailsRenderer<AccountId_IdPartType>(), m_accounts[handle]);
+}
+
+std::size_t VariantAccountStore::size() const {
+
+    return m_accounts.size();
+}
+
+std::size_t VariantAccountStore::indexCapacity() const {
+
+    return m_index.capacity();
+}
+
+std::int64_t VariantAccountStore::totalBalance() const {
+
+    std::int64_t total = 0;
+    for (std::size_t c = 0; c < m_accounts.chunkCount(); ++c) {
+        const Account* accounts = m_accounts.chunk(c);
+        const std::size_t length = m_accounts.chunkLength(c);
+        for (std::size_t i = 0; i < length; ++i) {
+            total += accountValue(accounts[i]).balance();
+        }
+    }
+    return total;
+}
+
+void VariantAccountStore::reserve(std::size_t count) {
+
+    m_index.reserve(count);
+}
+
+AccountAllocationStats VariantAccountStore::allocationStats() const {
+
+    AccountAllocationStats stats;
+    stats.personAccounts.liveObjects = m_personCount;
+    stats.personAccounts.createdObjects = m_personCount;
+    stats.enterpriseAccounts.liveObjects = size() - m_personCount;
+    stats.enterpriseAccounts.createdObjects = size() - m_personCount;
+
+    stats.columns.liveObjects = size();
+    stats.columns.createdObjects = size();
+    stats.columns.systemAllocations = m_accounts.chunkCount();
+    stats.columns.bytesAllocated = m_accounts.chunkCount() * ChunkedArray<Account>::chunkSize * sizeof(Account);
+    stats.columns.bytesInUse = size() * sizeof(Account);
+    return stats;
+}
\ No newline at end of file
@@ -26,6 +26,12 @@ LICENSE file in the root directory of this source tree.
 template<typename T_Id>
 class AbstractAccount {
 public:
+    /**
+     * @brief Destroy the Abstract Account object
+     * 
+     */
+    virtual ~AbstractAccount() = default;
+
     /**
      * @brief Method used to add balance to the account.
      * 
@@ -52,6 +58,23 @@ public:
      */
     virtual int balance() const = 0;
 
+    /**
+     * @brief Makes the balance of the account hot, so concurrent top-ups don't contend on it.
+     * See AtomicBalance::makeHot().
+     * 
+     * @return true The balance is hot.
+     * @return false The balance couldn't be made hot.
+     */
+    virtual bool makeBalanceHot() = 0;
+
+    /**
+     * @brief Returns whether the balance of the account is hot.
+     * 
+     * @return true The balance is hot.
+     * @return false The balance is a single integer.
+     */
+    virtual bool balanceHot() const = 0;
+
     /**
      * @brief Returns the id of the account.
      * 
@@ -11,10 +11,14 @@ LICENSE file in the root directory of this source tree.
 #include <string>
 
 #include <abstractAccount.h>
+#include <atomicBalance.h>
 
 /**
  * @brief An intermediate class that implements common functionality to all concrete account types.
  * 
+ * The balance is lock-free (see AtomicBalance), so several threads can operate on the same
+ * account without a mutex and the balance never becomes negative.
+ * 
  * @tparam T_Id The type of the Id part of the class
  * AccountId used to identify each individual account.
  */
@@ -33,7 +37,7 @@ public:
      * 
      * @param amount The amount of money to add. It must be > 0.
      * @return true The amount was added to the account's balance.
-     * @return false The amount is a negative number.
+     * @return false The amount is a negative number, or the balance would exceed INT_MAX.
      */
     bool addToBalance(int amount) override;
 
@@ -54,6 +58,22 @@ public:
      */
     int balance() const;
 
+    /**
+     * @brief Makes the balance hot. See AtomicBalance::makeHot().
+     * 
+     * @return true The balance is hot.
+     * @return false The pool of striped balances is full.
+     */
+    bool makeBalanceHot() override;
+
+    /**
+     * @brief Returns whether the balance is hot.
+     * 
+     * @return true The balance is hot.
+     * @return false The balance is a single integer.
+     */
+    bool balanceHot() const override;
+
     /**
      * @brief Returns the Id of the account.
      * 
@@ -70,7 +90,7 @@ public:
 
 private:
     AccountId<T_Id> m_id;
-    int m_balance;
+    AtomicBalance m_balance;
 };
 
 //IMPLEMENTATION
@@ -82,29 +102,31 @@ Account<T_Id>::Account() :
 template<typename T_Id>
 bool Account<T_Id>::addToBalance(int amount) {
 
-    if (amount < 0) return false;
-
-    m_balance += amount;
-    return true;
+    return m_balance.add(amount);
 }
 
 template<typename T_Id>
 bool Account<T_Id>::decreaseFromBalance(int amount) {
 
-    if (amount < 0) return false;
-
-    if (amount > m_balance) {
-        return false        ;
-    } else {
-        m_balance -= amount;
-        return true;
-    }
+    return m_balance.decrease(amount);
 }
 
 template<typename T_Id>
 int Account<T_Id>::balance() const {
 
-    return m_balance;
+    return m_balance.value();
+}
+
+template<typename T_Id>
+bool Account<T_Id>::makeBalanceHot() {
+
+    return m_balance.makeHot();
+}
+
+template<typename T_Id>
+bool Account<T_Id>::balanceHot() const {
+
+    return m_balance.hot();
 }
 
 template<typename T_Id>
@@ -0,0 +1,134 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ACCOUNT_CLIENT
+#define H_ACCOUNT_CLIENT
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <accountTypes.h>
+#include <serverProtocol.h>
+
+/**
+ * @brief Blocking client of an AccountServer that pipelines its requests. Linux only.
+ *
+ * The request methods only queue the request and return its tag; flush() sends all the queued
+ * requests with a single write, and receive() returns their responses in the same order.
+ */
+class AccountClient {
+public:
+    /**
+     * @brief Construct a client without connection.
+     *
+     */
+    AccountClient();
+
+    AccountClient(const AccountClient&) = delete;
+    AccountClient& operator=(const AccountClient&) = delete;
+
+    /**
+     * @brief Closes the connection.
+     *
+     */
+    ~AccountClient();
+
+    /**
+     * @brief Connects to a server.
+     *
+     * @param address The IPv4 address of the server.
+     * @param port The port of the server.
+     * @return true The client is connected.
+     * @return false The connection failed.
+     */
+    bool connect(const std::string& address, std::uint16_t port);
+
+    /**
+     * @brief Closes the connection.
+     *
+     */
+    void close();
+
+    /**
+     * @brief Queues the creation of a person account.
+     *
+     * @return std::uint32_t The tag of the request.
+     */
+    std::uint32_t createPersonAccount(std::string_view firstName, std::string_view lastName);
+
+    /**
+     * @brief Queues the creation of an enterprise account.
+     *
+     * @return std::uint32_t The tag of the request.
+     */
+    std::uint32_t createEnterpriseAccount(std::string_view yTunnus, std::string_view companyName);
+
+    /**
+     * @brief Queues a top-up.
+     *
+     * @return std::uint32_t The tag of the request.
+     */
+    std::uint32_t topUp(const accountIdType& id, int amount);
+
+    /**
+     * @brief Queues a withdrawal.
+     *
+     * @return std::uint32_t The tag of the request.
+     */
+    std::uint32_t withdraw(const accountIdType& id, int amount);
+
+    /**
+     * @brief Queues a transfer.
+     *
+     * @return std::uint32_t The tag of the request.
+     */
+    std::uint32_t transfer(const accountIdType& from, const accountIdType& to, int amount);
+
+    /**
+     * @brief Queues a request of the details of an account.
+     *
+     * @return std::uint32_t The tag of the request.
+     */
+    std::uint32_t details(const accountIdType& id);
+
+    /**
+     * @brief Queues raw bytes, e.g. to send a malformed request.
+     *
+     * @param bytes The bytes.
+     */
+    void queueRaw(std::string_view bytes);
+
+    /**
+     * @brief Sends all the queued requests.
+     *
+     * @return true The requests were sent.
+     * @return false The connection failed.
+     */
+    bool flush();
+
+    /**
+     * @brief Waits for the next response.
+     *
+     * @param response The response. Its details are valid until the next call.
+     * @return true A response was received.
+     * @return false The connection was closed or failed.
+     */
+    bool receive(Response& response);
+
+private:
+    std::uint32_t nextTag();
+
+    int m_fd;
+    std::uint32_t m_tag;
+    std::string m_out;
+    std::string m_in;
+    std::size_t m_inBegin;
+};
+
+#endif //H_ACCOUNT_CLIENT
\ No newline at end of file
@@ -0,0 +1,262 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ACCOUNT_DETAILS
+#define H_ACCOUNT_DETAILS
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <accountTypes.h>
+#include <personAccount.h>
+#include <enterpriseAccount.h>
+#include <visitor.h>
+
+/**
+ * @brief The formats of the account details.
+ */
+enum class AccountDetailsFormat : std::uint8_t {
+    /** The text shown to the user, one "Field: value" line per field. */
+    Text,
+    /** A JSON object on a single line, e.g.
+     * {"type":"person","id":1,"creationDate":"20230115","firstName":"A","lastName":"B","balance":0}
+     * or {"type":"enterprise",...,"yTunnus":"A","companyName":"B",...}. */
+    Json
+};
+
+/**
+ * @brief Formats the details of an account into an output iterator of char.
+ * 
+ * The numbers are formatted with std::to_chars and the text is copied straight to the
+ * output, so nothing is allocated: with a char buffer or a BoundedCharOutput as the output
+ * the rendering doesn't touch the heap.
+ */
+class AccountDetailsWriter {
+public:
+    /**
+     * @brief Writes the details of an account.
+     * 
+     * @param out The output iterator.
+     * @param format The format.
+     * @param kind The kind of the account.
+     * @param id The id of the account.
+     * @param name The first name or the Y-tunnus.
+     * @param secondName The last name or the company name.
+     * @param balance The balance.
+     * @return T_OutputIt The output iterator past the written chars.
+     */
+    template<typename T_OutputIt, typename T_Id>
+    static T_OutputIt write(T_OutputIt out, AccountDetailsFormat format, AccountKind kind, const AccountId<T_Id>& id, std::string_view name, std::string_view secondName, int balance);
+
+private:
+    template<typename T_OutputIt>
+    static T_OutputIt put(T_OutputIt out, std::string_view text);
+    template<typename T_OutputIt, typename T_Integer>
+    static T_OutputIt putInteger(T_OutputIt out, T_Integer value);
+    template<typename T_OutputIt>
+    static T_OutputIt putJsonString(T_OutputIt out, std::string_view text);
+};
+
+/**
+ * @brief An output iterator of char into a fixed size buffer. The chars that don't fit are
+ * dropped but counted, so length() tells the size the whole output needs, like std::snprintf.
+ */
+class BoundedCharOutput {
+public:
+    typedef std::output_iterator_tag iterator_category;
+    typedef void value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef void pointer;
+    typedef void reference;
+
+    /**
+     * @brief Construct an output into a buffer.
+     * 
+     * @param buffer The buffer.
+     * @param size The size of the buffer.
+     */
+    BoundedCharOutput(char* buffer, std::size_t size) :
+        m_buffer(buffer),
+        m_size(size),
+        m_length(0)
+    {}
+
+    BoundedCharOutput& operator*() { return *this; }
+    BoundedCharOutput& operator++() { return *this; }
+    BoundedCharOutput& operator++(int) { return *this; }
+
+    BoundedCharOutput& operator=(char c) {
+        if (m_length < m_size) {
+            m_buffer[m_length] = c;
+        }
+        ++m_length;
+        return *this;
+    }
+
+    /**
+     * @brief Returns the number of chars output so far, written or dropped.
+     * 
+     * @return std::size_t The number of chars.
+     */
+    std::size_t length() const { return m_length; }
+
+private:
+    char* m_buffer;
+    std::size_t m_size;
+    std::size_t m_length;
+};
+
+/**
+ * @brief Returns the details of a person account as shown to the user.
+ * 
+ * @tparam T_Account Any type with the accessors of PersonAccount: id(), firstName(), lastName() and balance().
+ * @param account The account.
+ * @return std::string The details.
+ */
+template<typename T_Account>
+std::string personAccountDetails(const T_Account& account);
+
+/**
+ * @brief Returns the details of an enterprise account as shown to the user.
+ * 
+ * @tparam T_Account Any type with the accessors of EnterpriseAccount: id(), yTunnus(), companyName() and balance().
+ * @param account The account.
+ * @return std::string The details.
+ */
+template<typename T_Account>
+std::string enterpriseAccountDetails(const T_Account& account);
+
+template<typename T_Id>
+class AccountDetailsVisitor : public Visitor<T_Id> {
+public:
+    AccountDetailsVisitor();
+    void VisitPersonAccount(const PersonAccount<T_Id> *account) override;
+    void VisitEnterpriseAccount(const EnterpriseAccount<T_Id> *account) override;
+    const std::string& accountDetails() const;
+
+private:
+    std::string m_accountDetails;
+};
+
+//IMPLEMENTATION
+template<typename T_OutputIt, typename T_Id>
+T_OutputIt AccountDetailsWriter::write(T_OutputIt out, AccountDetailsFormat format, AccountKind kind, const AccountId<T_Id>& id, std::string_view name, std::string_view secondName, int balance) {
+
+    const bool person = (kind == AccountKind::Person);
+    char date[8];
+    const std::string_view creationDate(date, static_cast<std::size_t>(AccountId<T_Id>::formatCreationDate(id.packedCreationDate(), date) - date));
+
+    if (format == AccountDetailsFormat::Json) {
+        out = put(out, person ? "{\"type\":\"person\",\"id\":" : "{\"type\":\"enterprise\",\"id\":");
+        out = putInteger(out, id.id());
+        out = put(out, ",\"creationDate\":\"");
+        out = put(out, creationDate);
+        out = put(out, person ? "\",\"firstName\":" : "\",\"yTunnus\":");
+        out = putJsonString(out, name);
+        out = put(out, person ? ",\"lastName\":" : ",\"companyName\":");
+        out = putJsonString(out, secondName);
+        out = put(out, ",\"balance\":");
+        out = putInteger(out, balance);
+        return put(out, "}");
+    }
+
+    out = put(out, person ? "Account type: Person\n" : "Account type: Enterprise\n");
+    out = put(out, "Account Id: id: ");
+    out = putInteger(out, id.id());
+    out = put(out, ", creation date: \"");
+    out = put(out, creationDate);
+    out = put(out, person ? "\"\nFirst Name: " : "\"\nY-Tunnus: ");
+    out = put(out, name);
+    out = put(out, person ? "\nLast Name: " : "\nCompany Name: ");
+    out = put(out, secondName);
+    out = put(out, "\nBalance: ");
+    out = putInteger(out, balance);
+    return put(out, "\n");
+}
+
+template<typename T_OutputIt>
+T_OutputIt AccountDetailsWriter::put(T_OutputIt out, std::string_view text) {
+
+    return std::copy(text.begin(), text.end(), out);
+}
+
+template<typename T_OutputIt, typename T_Integer>
+T_OutputIt AccountDetailsWriter::putInteger(T_OutputIt out, T_Integer value) {
+
+    char buffer[24];
+    std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::copy(buffer, r.ptr, out);
+}
+
+template<typename T_OutputIt>
+T_OutputIt AccountDetailsWriter::putJsonString(T_OutputIt out, std::string_view text) {
+
+    static const char hexDigits[] = "0123456789abcdef";
+
+    *out++ = '"';
+    for (char c : text) {
+        if ((c == '"') || (c == '\\')) {
+            *out++ = '\\';
+            *out++ = c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            const char escape[6] = { '\\', 'u', '0', '0', hexDigits[(c >> 4) & 0xf], hexDigits[c & 0xf] };
+            out = std::copy(escape, escape + 6, out);
+        } else {
+            *out++ = c;
+        }
+    }
+    *out++ = '"';
+    return out;
+}
+
+template<typename T_Account>
+std::string personAccountDetails(const T_Account& account) {
+
+    std::string details;
+    details.reserve(128);
+    AccountDetailsWriter::write(std::back_inserter(details), AccountDetailsFormat::Text, AccountKind::Person, account.id(), account.firstName(), account.lastName(), account.balance());
+    return details;
+}
+
+template<typename T_Account>
+std::string enterpriseAccountDetails(const T_Account& account) {
+
+    std::string details;
+    details.reserve(128);
+    AccountDetailsWriter::write(std::back_inserter(details), AccountDetailsFormat::Text, AccountKind::Enterprise, account.id(), account.yTunnus(), account.companyName(), account.balance());
+    return details;
+}
+
+template<typename T_Id>
+AccountDetailsVisitor<T_Id>::AccountDetailsVisitor() :
+    m_accountDetails()
+{}
+
+template<typename T_Id>
+const std::string& AccountDetailsVisitor<T_Id>::accountDetails() const {
+
+    return m_accountDetails;
+}
+
+template<typename T_Id>
+void AccountDetailsVisitor<T_Id>::VisitPersonAccount(const PersonAccount<T_Id> *account) {
+
+    m_accountDetails = personAccountDetails(*account);
+}
+
+template<typename T_Id>
+void AccountDetailsVisitor<T_Id>::VisitEnterpriseAccount(const EnterpriseAccount<T_Id> *account) {
+
+    m_accountDetails = enterpriseAccountDetails(*account);
+}
+
+#endif //H_ACCOUNT_DETAILS
\ No newline at end of file
@@ -0,0 +1,471 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ACCOUNT_EXECUTOR
+#define H_ACCOUNT_EXECUTOR
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <accountMgr.h>
+#include <mpscQueue.h>
+
+/**
+ * @brief Runs the operations of an account manager asynchronously: every shard of the manager
+ * is owned by one worker thread, the only one changing its balances and inserting into it, and
+ * the callers hand their requests to the owner instead of taking the locks of the shard.
+ *
+ * Every worker drains a lock-free queue with many producers (MpscQueue), so submitting a
+ * request never blocks: it's a heap allocation and an atomic exchange. The worker applies what
+ * it drained in batches: the top-ups and withdrawals without any lock, the owner being their
+ * only writer, and with the journal records of the batch sharing their writes; the new accounts
+ * under the exclusive lock of their shard, which the scans and the readers racing an insertion
+ * still take. A new account gets its id when it's submitted, so it goes to the owner of the
+ * shard of its id. The requests of a caller on an account are applied in the order they were
+ * submitted. A request completes by calling its callback on the worker, or by setting its
+ * future; the blocking methods named like the ones of BasicAccountMgr wait for that future.
+ *
+ * The executor attaches itself to the manager, whose balance operations and insertions then
+ * go through the executor too, see BasicAccountMgr. The other writers of the shards park their
+ * owners first, see Pause.
+ *
+ * Callbacks run on the worker, which applies nothing else meanwhile: they should be short,
+ * must not throw, and must call neither the blocking methods of the executor nor those of the
+ * manager that go through it.
+ *
+ * @tparam T_Store The account store of the manager.
+ */
+template<typename T_Store>
+class BasicAccountExecutor {
+public:
+    /** The most requests a worker drains from its queue before applying them. */
+    static constexpr std::size_t maxBatch = 256;
+    /** The times an idle worker yields, looking for requests, before it sleeps. */
+    static constexpr int idleSpins = 64;
+
+    class Pause;
+
+    /**
+     * @brief Starts the workers and attaches the object to the manager. The manager must not
+     * be used by other threads meanwhile, and must have replayed its journal or loaded its
+     * snapshot, if any, before.
+     *
+     * @param mgr The manager. It must outlive the object.
+     * @param workerCount The number of workers, each owning the shards whose index modulo
+     * workerCount is its own. 0 uses one per core. It's at most the number of shards.
+     */
+    BasicAccountExecutor(BasicAccountMgr<T_Store>& mgr, std::size_t workerCount);
+
+    BasicAccountExecutor(const BasicAccountExecutor&) = delete;
+    BasicAccountExecutor& operator=(const BasicAccountExecutor&) = delete;
+
+    /**
+     * @brief Stops the workers once they completed all the requests submitted, and detaches
+     * the object from the manager. The manager must not be used by other threads meanwhile.
+     */
+    ~BasicAccountExecutor();
+
+    /**
+     * @brief Returns the number of workers.
+     *
+     * @return std::size_t The number of workers.
+     */
+    std::size_t workerCount() const;
+
+    /**
+     * @brief Creates a person account.
+     *
+     * @param firstName The first name of the owner.
+     * @param lastName The last name of the owner.
+     * @param callback Called with the const accountIdType& of the new account.
+     */
+    template<typename T_Callback>
+    void createPersonAccount(const std::string& firstName, const std::string& lastName, T_Callback callback);
+
+    /**
+     * @brief Creates an enterprise account, refused if its Y-tunnus is taken, see
+     * BasicAccountMgr::insertNewEnterpriseAccount().
+     *
+     * @param yTunnus The Y-tunnus of the enterprise.
+     * @param companyName The name of the enterprise.
+     * @param callback Called with the const accountIdType& of the new account, default
+     * constructed if it was refused.
+     */
+    template<typename T_Callback>
+    void createEnterpriseAccount(const std::string& yTunnus, const std::string& companyName, T_Callback callback);
+
+    /**
+     * @brief Adds money to an account.
+     *
+     * @param id The id of the account.
+     * @param amount The amount of money to add. It must not be negative, or the top-up is
+     * rejected like by BasicAccountMgr::topUpAccount().
+     * @param callback Called with the OperationResult.
+     */
+    template<typename T_Callback>
+    void topUp(const accountIdType& id, int amount, T_Callback callback);
+
+    /**
+     * @brief Withdraws money from an account.
+     *
+     * @param id The id of the account.
+     * @param amount The amount of money to withdraw. It must not be negative nor above the
+     * balance, or the withdrawal is rejected like by BasicAccountMgr::withdrawFromAccount().
+     * @param callback Called with the OperationResult.
+     */
+    template<typename T_Callback>
+    void withdraw(const accountIdType& id, int amount, T_Callback callback);
+
+    /**
+     * @brief Reads the details of an account, after the operations on it submitted before.
+     *
+     * @param id The id of the account.
+     * @param callback Called with the std::string&& of BasicAccountMgr::getAccountDetails().
+     */
+    template<typename T_Callback>
+    void details(const accountIdType& id, T_Callback callback);
+
+    /**
+     * @brief Creates a person account. See the overload with a callback.
+     *
+     * @param firstName The first name of the owner.
+     * @param lastName The last name of the owner.
+     * @return std::future<accountIdType> The id of the new account.
+     */
+    std::future<accountIdType> createPersonAccount(const std::string& firstName, const std::string& lastName);
+
+    /**
+     * @brief Creates an enterprise account. See the overload with a callback.
+     *
+     * @param yTunnus The Y-tunnus of the enterprise.
+     * @param companyName The name of the enterprise.
+     * @return std::future<accountIdType> The id of the new account, default constructed if it was refused.
+     */
+    std::future<accountIdType> createEnterpriseAccount(const std::string& yTunnus, const std::string& companyName);
+
+    /**
+     * @brief Adds money to an account. See the overload with a callback.
+     *
+     * @param id The id of the account.
+     * @param amount The amount of money to add.
+     * @return std::future<OperationResult> The result.
+     */
+    std::future<OperationResult> topUp(const accountIdType& id, int amount);
+
+    /**
+     * @brief Withdraws money from an account. See the overload with a callback.
+     *
+     * @param id The id of the account.
+     * @param amount The amount of money to withdraw.
+     * @return std::future<OperationResult> The result.
+     */
+    std::future<OperationResult> withdraw(const accountIdType& id, int amount);
+
+    /**
+     * @brief Reads the details of an account. See the overload with a callback.
+     *
+     * @param id The id of the account.
+     * @return std::future<std::string> The details.
+     */
+    std::future<std::string> details(const accountIdType& id);
+
+    /**
+     * @brief Creates a person account and waits for it, like BasicAccountMgr::insertNewPersonAccount().
+     *
+     * @param firstName The first name of the owner.
+     * @param lastName The last name of the owner.
+     * @return accountIdType The id of the new account.
+     */
+    accountIdType insertNewPersonAccount(const std::string& firstName, const std::string& lastName);
+
+    /**
+     * @brief Creates an enterprise account and waits for it, like BasicAccountMgr::insertNewEnterpriseAccount().
+     *
+     * @param yTunnus The Y-tunnus of the enterprise.
+     * @param companyName The name of the enterprise.
+     * @return accountIdType The id of the new account, default constructed if it was refused.
+     */
+    accountIdType insertNewEnterpriseAccount(const std::string& yTunnus, const std::string& companyName);
+
+    /**
+     * @brief Adds money to an account and waits for it, like BasicAccountMgr::topUpAccount().
+     *
+     * @param id The id of the account.
+     * @param amount The amount of money to add. It must not be negative.
+     * @return true The amount was added.
+     * @return false The amount is negative, the account doesn't exist or its balance would
+     * exceed INT_MAX.
+     */
+    bool topUpAccount(const accountIdType& id, int amount);
+
+    /**
+     * @brief Withdraws money from an account and waits for it, like BasicAccountMgr::withdrawFromAccount().
+     *
+     * @param id The id of the account.
+     * @param amount The amount of money to withdraw. It must not be negative nor above the balance.
+     * @return true The amount was withdrawn.
+     * @return false The amount is negative or above the balance, or the account doesn't exist.
+     */
+    bool withdrawFromAccount(const accountIdType& id, int amount);
+
+    /**
+     * @brief Reads the details of an account and waits for them, like BasicAccountMgr::getAccountDetails().
+     *
+     * @param id The id of the account.
+     * @return std::string The details of the account.
+     */
+    std::string getAccountDetails(const accountIdType& id);
+
+    /**
+     * @brief Applies a batch of top-ups and withdrawals and waits for it, like
+     * BasicAccountMgr::applyOperations(). Every operation is a request of its own.
+     *
+     * @param operations The operations. A positive amount is a top-up, a negative one a withdrawal.
+     * @param count The number of operations.
+     * @param results The result of every operation, in the order of the batch. It must have
+     * room for count results.
+     */
+    void applyOperations(const AccountOperation* operations, std::size_t count, OperationResult* results);
+
+    /**
+     * @brief Creates a batch of accounts and waits for it, like BasicAccountMgr::insertNewAccounts().
+     * Every account is a request of its own.
+     *
+     * @param accounts The accounts to create.
+     * @param count The number of accounts.
+     * @param ids The ids of the new accounts, in the order of the batch, a default constructed
+     * one for every refused account. It must have room for count ids.
+     */
+    void insertNewAccounts(const NewAccount* accounts, std::size_t count, accountIdType* ids);
+
+private:
+    enum class RequestKind : std::uint8_t {
+        CreatePerson,
+        CreateEnterprise,
+        TopUp,
+        Withdraw,
+        Details,
+        Park
+    };
+
+    /** A request in the queue of a worker. The worker fills its result and completes it. */
+    struct Request : MpscNode {
+        Request(RequestKind kind, const accountIdType& id, int amount) :
+            m_kind(kind),
+            m_id(id),
+            m_amount(amount),
+            m_name(),
+            m_secondName(),
+            m_result(OperationResult::Rejected),
+            m_details()
+        {}
+
+        virtual ~Request() = default;
+
+        /** Calls the callback with the result and deletes the request. */
+        virtual void complete() = 0;
+
+        const accountIdType& result(const accountIdType*) const { return m_id; }
+        OperationResult result(const OperationResult*) const { return m_result; }
+        std::string&& result(const std::string*) { return std::move(m_details); }
+
+        RequestKind m_kind;
+        /** The account, or the one created. */
+        accountIdType m_id;
+        int m_amount;
+        std::string m_name;
+        std::string m_secondName;
+        OperationResult m_result;
+        std::string m_details;
+    };
+
+    /** Parks its worker, once it applied the requests before, until resume() is called. */
+    struct ParkRequest final : Request {
+        ParkRequest() :
+            Request(RequestKind::Park, accountIdType(), 0),
+            m_parked(false),
+            m_resumed(false)
+        {}
+
+        /** Called by the worker: reports it's parked, waits for resume() and deletes the request. */
+        void complete() override;
+        /** Waits for the worker to be parked. */
+        void waitParked();
+        /** Lets the worker go on. The request must not be used afterwards. */
+        void resume();
+
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        bool m_parked;
+        bool m_resumed;
+    };
+
+    template<typename T_Result, typename T_Callback>
+    struct CallbackRequest final : Request {
+        CallbackRequest(RequestKind kind, const accountIdType& id, int amount, T_Callback&& callback) :
+            Request(kind, id, amount),
+            m_callback(std::move(callback))
+        {}
+
+        void complete() override {
+
+            m_callback(this->result(static_cast<const T_Result*>(nullptr)));
+            delete this;
+        }
+
+        T_Callback m_callback;
+    };
+
+    /** Aligned to a cache line, so the queues of neighbour workers don't share one. */
+    struct alignas(64) Worker {
+        MpscQueue<Request> m_queue;
+        /** Set while the worker sleeps on m_wakeUp. */
+        std::atomic<bool> m_sleeping{false};
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        std::thread m_thread;
+    };
+
+    template<typename T_Result, typename T_Callback>
+    void submit(RequestKind kind, const accountIdType& id, int amount, std::string_view name, std::string_view secondName, T_Callback&& callback);
+    template<typename T_Result>
+    std::future<T_Result> submitWithFuture(RequestKind kind, const accountIdType& id, int amount, std::string_view name, std::string_view secondName);
+    std::size_t workerOf(const accountIdType& id) const;
+    void enqueue(std::size_t worker, Request* request);
+    void run(std::size_t worker);
+    void idle(Worker& worker);
+
+    BasicAccountMgr<T_Store>& m_mgr;
+    std::size_t m_workerCount;
+    std::unique_ptr<Worker[]> m_workers;
+    std::atomic<bool> m_stopping;
+};
+
+/**
+ * @brief Parks workers of an executor for the lifetime of the object, once they applied the
+ * requests submitted before, so the caller can change the shards they own under the locks of
+ * the manager, e.g. for a transfer. The workers are parked in the order of their indexes, so
+ * pauses never wait for each other in a cycle. A worker must not be paused from its callbacks.
+ *
+ * @tparam T_Store The account store of the manager.
+ */
+template<typename T_Store>
+class BasicAccountExecutor<T_Store>::Pause {
+public:
+    /**
+     * @brief Parks the owners of two shards, a single one if they share it.
+     *
+     * @param executor The executor.
+     * @param firstShard A shard.
+     * @param secondShard Another shard, or the same.
+     */
+    Pause(BasicAccountExecutor& executor, std::size_t firstShard, std::size_t secondShard);
+
+    /**
+     * @brief Parks all the workers.
+     *
+     * @param executor The executor.
+     */
+    explicit Pause(BasicAccountExecutor& executor);
+
+    Pause(const Pause&) = delete;
+    Pause& operator=(const Pause&) = delete;
+
+    /**
+     * @brief Lets the workers go on.
+     */
+    ~Pause();
+
+private:
+    void park(BasicAccountExecutor& executor, std::size_t worker);
+
+    std::vector<ParkRequest*> m_requests;
+};
+
+/** This typedef defines the executor of the account manager used by the application. */
+typedef BasicAccountExecutor<AccountMgr::Store> AccountExecutor;
+
+/** Executor of a manager with the data oriented layout. */
+typedef BasicAccountExecutor<DataOrientedAccountStore> DataOrientedAccountExecutor;
+
+/** Executor of a manager with the accounts stored by value. */
+typedef BasicAccountExecutor<VariantAccountStore> VariantAccountExecutor;
+
+extern template class BasicAccountExecutor<ObjectAccountStore>;
+extern template class BasicAccountExecutor<DataOrientedAccountStore>;
+extern template class BasicAccountExecutor<VariantAccountStore>;
+extern template class BasicAccountExecutor<NodeObjectAccountStore>;
+
+//IMPLEMENTATION
+template<typename T_Store>
+template<typename T_Callback>
+void BasicAccountExecutor<T_Store>::createPersonAccount(const std::string& firstName, const std::string& lastName, T_Callback callback) {
+
+    submit<accountIdType>(RequestKind::CreatePerson, m_mgr.newAccountId(), 0, firstName, lastName, std::move(callback));
+}
+
+template<typename T_Store>
+template<typename T_Callback>
+void BasicAccountExecutor<T_Store>::createEnterpriseAccount(const std::string& yTunnus, const std::string& companyName, T_Callback callback) {
+
+    submit<accountIdType>(RequestKind::CreateEnterprise, m_mgr.newAccountId(), 0, yTunnus, companyName, std::move(callback));
+}
+
+template<typename T_Store>
+template<typename T_Callback>
+void BasicAccountExecutor<T_Store>::topUp(const accountIdType& id, int amount, T_Callback callback) {
+
+    submit<OperationResult>(RequestKind::TopUp, id, amount, std::string_view(), std::string_view(), std::move(callback));
+}
+
+template<typename T_Store>
+template<typename T_Callback>
+void BasicAccountExecutor<T_Store>::withdraw(const accountIdType& id, int amount, T_Callback callback) {
+
+    submit<OperationResult>(RequestKind::Withdraw, id, amount, std::string_view(), std::string_view(), std::move(callback));
+}
+
+template<typename T_Store>
+template<typename T_Callback>
+void BasicAccountExecutor<T_Store>::details(const accountIdType& id, T_Callback callback) {
+
+    submit<std::string>(RequestKind::Details, id, 0, std::string_view(), std::string_view(), std::move(callback));
+}
+
+template<typename T_Store>
+template<typename T_Result, typename T_Callback>
+void BasicAccountExecutor<T_Store>::submit(RequestKind kind, const accountIdType& id, int amount, std::string_view name, std::string_view secondName, T_Callback&& callback) {
+
+    Request* request = new CallbackRequest<T_Result, T_Callback>(kind, id, amount, std::move(callback));
+    request->m_name.assign(name);
+    request->m_secondName.assign(secondName);
+    enqueue(workerOf(id), request);
+}
+
+template<typename T_Store>
+template<typename T_Result>
+std::future<T_Result> BasicAccountExecutor<T_Store>::submitWithFuture(RequestKind kind, const accountIdType& id, int amount, std::string_view name, std::string_view secondName) {
+
+    std::promise<T_Result> promise;
+    std::future<T_Result> future = promise.get_future();
+    submit<T_Result>(kind, id, amount, name, secondName, [promise = std::move(promise)](auto&& result) mutable {
+        promise.set_value(std::forward<decltype(result)>(result));
+    });
+    return future;
+}
+
+#endif //H_ACCOUNT_EXECUTOR
\ No newline at end of file
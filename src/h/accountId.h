@@ -9,11 +9,21 @@ LICENSE file in the root directory of this source tree.
 #define H_ACCOUNT_ID
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <functional>
+
+template<typename T_Id> struct AccountIdView;
 
 /**
  * @brief A class that represents the identification of an Account.
  * 
+ * The creation date is packed into an integer holding the decimal number YYYYMMDD, 0 meaning
+ * no date, so the whole object is trivially copyable and as small as the id part allows.
+ * Dates are only parsed from or formatted to strings at the edges of the application.
+ * 
  * @tparam T_Id Defines the type to be used as the Id part of the AccountId class.
  */
 template<typename T_Id> class AccountId {
@@ -29,15 +39,32 @@ public:
      * 
      * @param other The AccountId object to be copied.
      */
-    AccountId(const AccountId<T_Id>& other);
+    AccountId(const AccountId<T_Id>& other) = default;
+
+    /**
+     * @brief Custom constructor to build a filled AccountId from a packed date.
+     * 
+     * @param _id The id part of the account. This number must be unique.
+     * @param _creationDate The date when the account was created, packed as YYYYMMDD.
+     */
+    AccountId(const T_Id& _id, std::uint32_t _creationDate);
 
     /**
      * @brief Custom constructor to build a filled AccountId.
      * 
      * @param _id The id part of the account. This number must be unique.
-     * @param _creationDate A string representing the date when the account was created.
+     * @param _creationDate A string representing the date when the account was created, formatted
+     * as YYYYMMDD. Malformed dates are stored as no date.
      */
-    AccountId(const T_Id& _id, const std::string& _creationDate);
+    AccountId(const T_Id& _id, std::string_view _creationDate);
+
+    /**
+     * @brief Builds the AccountId viewed. A malformed date is stored as no date, so the result
+     * is only equal to the view if it has a date, see AccountIdEqualFunctor.
+     * 
+     * @param view The view of the AccountId.
+     */
+    explicit AccountId(const AccountIdView<T_Id>& view);
 
     /**
      * @brief The assignment operator
@@ -45,7 +72,7 @@ public:
      * @param rhs Right hand side of the assignation operation..
      * @return AccountId<T_Id>& Returns the just assigned object, allowing to chain the assignation.
      */
-    AccountId<T_Id>& operator=(const AccountId<T_Id>& rhs);
+    AccountId<T_Id>& operator=(const AccountId<T_Id>& rhs) = default;
 
     /**
      * @brief Returns the id part of the AccountId
@@ -55,11 +82,18 @@ public:
     const T_Id& id() const;
 
     /**
-     * @brief Returns the creation date.
+     * @brief Returns the creation date formatted as YYYYMMDD.
+     * 
+     * @return std::string The creation date. Empty if the object has no date.
+     */
+    std::string creationDate() const;
+
+    /**
+     * @brief Returns the creation date packed as the integer YYYYMMDD.
      * 
-     * @return const std::string& The creation date.
+     * @return std::uint32_t The packed creation date. 0 if the object has no date.
      */
-    const std::string& creationDate() const;
+    std::uint32_t packedCreationDate() const;
 
     /**
      * @brief The equality comparator. It's a requirement to insert objects of this class
@@ -71,20 +105,60 @@ public:
      */
     bool operator==(const AccountId<T_Id>& rhs) const;
 
+    /**
+     * @brief Parses a date formatted as YYYYMMDD.
+     * 
+     * @param date The date string.
+     * @return std::uint32_t The packed date, or 0 if the string is not a valid date.
+     */
+    static std::uint32_t parseCreationDate(std::string_view date);
+
+    /**
+     * @brief Formats a packed date as YYYYMMDD into a buffer of at least 8 chars.
+     * 
+     * @param date The packed date.
+     * @param buffer The output buffer.
+     * @return char* The end of the written chars. Nothing is written for 0.
+     */
+    static char* formatCreationDate(std::uint32_t date, char* buffer);
+
 private:
     T_Id m_Id;
-    std::string m_creationDate;
+    std::uint32_t m_creationDate;
+};
+
+/**
+ * @brief A lightweight key to look up an account without building an AccountId: the id part
+ * and the creation date as it was typed, formatted as YYYYMMDD. The date is only viewed, never
+ * copied. AccountIdHashFunctor and AccountIdEqualFunctor accept it in place of an AccountId,
+ * and a view matches the AccountId with the same id and date.
+ * 
+ * @tparam T_Id Defines the type to be used as the Id part of the AccountId class.
+ */
+template<typename T_Id>
+struct AccountIdView {
+    /** The id part. */
+    T_Id id;
+    /** The creation date formatted as YYYYMMDD. A malformed date matches no account. */
+    std::string_view creationDate;
 };
 
 /**
  * @brief Implementation of a hash functions taking into account all the attributes of the class. This
  * is a requirement to insert objects of this class into unordered_map.
  * 
+ * The id hash and the packed date are combined and passed through the 64 bits finalizer of
+ * SplitMix64, so every input bit affects every output bit: the low bits pick the buckets of
+ * the stores and the high bits pick the shard, see BasicAccountMgr::shardIndex().
+ * 
  * @tparam T_Id Defines the type to be used as the Id part of the AccountId class.
  */
 template<typename T_Id>
 class AccountIdHashFunctor {
 public:
+    /** Lookups may pass an AccountIdView instead of an AccountId. */
+    typedef void is_transparent;
+
     /**
      * @brief Defines () operator and allows objects of this class to be called as functions (functor).
      * 
@@ -92,7 +166,53 @@ public:
      * @return size_t The hash value of the object.
      */
     size_t operator()(const AccountId<T_Id>& aid) const {
-        return (std::hash<T_Id>()(aid.id())) ^ (std::hash<std::string>()(aid.creationDate()));
+        return hash(aid.id(), aid.packedCreationDate());
+    }
+
+    /**
+     * @brief Returns the hash of the AccountId viewed, without building it.
+     * 
+     * @param view The view of the AccountId.
+     * @return size_t The hash value, the same as the one of the AccountId.
+     */
+    size_t operator()(const AccountIdView<T_Id>& view) const {
+        return hash(view.id, AccountId<T_Id>::parseCreationDate(view.creationDate));
+    }
+
+private:
+    static size_t hash(const T_Id& id, std::uint32_t packedCreationDate) {
+        std::uint64_t h = static_cast<std::uint64_t>(std::hash<T_Id>()(id));
+        h ^= static_cast<std::uint64_t>(packedCreationDate) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return static_cast<size_t>(h);
+    }
+};
+
+/**
+ * @brief The equality of AccountId objects, which also compares them with an AccountIdView.
+ * 
+ * @tparam T_Id Defines the type to be used as the Id part of the AccountId class.
+ */
+template<typename T_Id>
+class AccountIdEqualFunctor {
+public:
+    /** Lookups may pass an AccountIdView instead of an AccountId. */
+    typedef void is_transparent;
+
+    bool operator()(const AccountId<T_Id>& lhs, const AccountId<T_Id>& rhs) const {
+        return lhs == rhs;
+    }
+
+    bool operator()(const AccountId<T_Id>& lhs, const AccountIdView<T_Id>& rhs) const {
+        return (lhs.id() == rhs.id) && (lhs.packedCreationDate() != 0) && (lhs.packedCreationDate() == AccountId<T_Id>::parseCreationDate(rhs.creationDate));
+    }
+
+    bool operator()(const AccountIdView<T_Id>& lhs, const AccountId<T_Id>& rhs) const {
+        return (*this)(rhs, lhs);
     }
 };
 
@@ -100,28 +220,26 @@ public:
 template<typename T_Id>
 AccountId<T_Id>::AccountId() :
     m_Id(),
-    m_creationDate()
+    m_creationDate(0)
 {}
 
 template<typename T_Id>
-AccountId<T_Id>::AccountId(const T_Id& _id, const std::string& _creationDate) :
+AccountId<T_Id>::AccountId(const T_Id& _id, std::uint32_t _creationDate) :
     m_Id(_id),
     m_creationDate(_creationDate)
 {}
 
 template<typename T_Id>
-AccountId<T_Id>::AccountId(const AccountId<T_Id>& other) :
-    m_Id(other.m_Id),
-    m_creationDate(other.m_creationDate)
+AccountId<T_Id>::AccountId(const T_Id& _id, std::string_view _creationDate) :
+    m_Id(_id),
+    m_creationDate(parseCreationDate(_creationDate))
 {}
 
 template<typename T_Id>
-AccountId<T_Id>& AccountId<T_Id>::operator=(const AccountId<T_Id>& rhs) {
-    m_Id = rhs.m_Id;
-    m_creationDate = rhs.m_creationDate;
-
-    return *this;
-}
+AccountId<T_Id>::AccountId(const AccountIdView<T_Id>& view) :
+    m_Id(view.id),
+    m_creationDate(parseCreationDate(view.creationDate))
+{}
 
 template<typename T_Id>
 const T_Id& AccountId<T_Id>::id() const {
@@ -130,7 +248,14 @@ const T_Id& AccountId<T_Id>::id() const {
 }
 
 template<typename T_Id>
-const std::string& AccountId<T_Id>::creationDate() const {
+std::string AccountId<T_Id>::creationDate() const {
+
+    char buffer[8];
+    return std::string(buffer, formatCreationDate(m_creationDate, buffer));
+}
+
+template<typename T_Id>
+std::uint32_t AccountId<T_Id>::packedCreationDate() const {
 
     return m_creationDate;
 }
@@ -141,4 +266,32 @@ bool AccountId<T_Id>::operator==(const AccountId<T_Id>& rhs) const {
     return (m_Id == rhs.m_Id) && (m_creationDate == rhs.m_creationDate);
 }
 
+template<typename T_Id>
+std::uint32_t AccountId<T_Id>::parseCreationDate(std::string_view date) {
+
+    if (date.size() != 8) return 0;
+
+    std::uint32_t packed = 0;
+    std::from_chars_result r = std::from_chars(date.data(), date.data() + date.size(), packed);
+    if ((r.ec != std::errc()) || (r.ptr != date.data() + date.size())) return 0;
+
+    std::uint32_t month = (packed / 100) % 100;
+    std::uint32_t day = packed % 100;
+    if ((month < 1) || (month > 12) || (day < 1) || (day > 31)) return 0;
+
+    return packed;
+}
+
+template<typename T_Id>
+char* AccountId<T_Id>::formatCreationDate(std::uint32_t date, char* buffer) {
+
+    if (date == 0) return buffer;
+
+    for (int i = 7; i >= 0; --i) {
+        buffer[i] = static_cast<char>('0' + date % 10);
+        date /= 10;
+    }
+    return buffer + 8;
+}
+
 #endif //H_ACCOUNT_ID
\ No newline at end of file
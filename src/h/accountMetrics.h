@@ -0,0 +1,418 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ACCOUNT_METRICS
+#define H_ACCOUNT_METRICS
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The operations of the account manager that are measured.
+ */
+enum class MetricOperation : std::uint8_t {
+    TopUp,
+    Withdraw,
+    Transfer,
+    InsertAccount,
+    AccountDetails
+};
+
+/** The number of MetricOperation values. */
+constexpr std::size_t metricOperationCount = 5;
+
+/**
+ * @brief How a measured operation ended.
+ */
+enum class MetricOutcome : std::uint8_t {
+    /** The operation was applied. */
+    Succeeded,
+    /** An account of the operation doesn't exist. */
+    AccountNotFound,
+    /** The amount is negative, the accounts of a transfer are the same, or the Y-tunnus of a new enterprise account is taken. */
+    InvalidRequest,
+    /** The balance is lower than the amount withdrawn. */
+    InsufficientFunds,
+    /** The balance credited would pass INT_MAX. */
+    BalanceLimit
+};
+
+/** The number of MetricOutcome values. */
+constexpr std::size_t metricOutcomeCount = 5;
+
+/**
+ * @brief Returns the name of an operation in the metrics dumps, e.g. "top_up".
+ *
+ * @param operation The operation.
+ * @return const char* The name.
+ */
+const char* metricOperationName(MetricOperation operation);
+
+/**
+ * @brief Returns the name of an outcome in the metrics dumps, e.g. "insufficient_funds".
+ *
+ * @param outcome The outcome.
+ * @return const char* The name.
+ */
+const char* metricOutcomeName(MetricOutcome outcome);
+
+/**
+ * @brief Histogram of latencies in nanoseconds with log-linear buckets, like HdrHistogram:
+ * every power of two is split into 16 buckets, so a value is known within 1/16 of it, from
+ * 1 ns up to 2^40 ns (about 18 minutes). Longer latencies are counted in the last bucket.
+ */
+class LatencyHistogram {
+public:
+    /** A power of two is split into 2^subBucketBits buckets. */
+    static constexpr unsigned subBucketBits = 4;
+    /** The number of buckets of a power of two. */
+    static constexpr std::size_t subBucketCount = std::size_t(1) << subBucketBits;
+    /** Latencies from 2^maxBits ns up share the last bucket. */
+    static constexpr unsigned maxBits = 40;
+    /** The number of buckets. */
+    static constexpr std::size_t bucketCount = (maxBits - subBucketBits + 1) * subBucketCount;
+
+    /**
+     * @brief Returns the bucket of a latency.
+     *
+     * @param nanos The latency.
+     * @return std::size_t The index of the bucket.
+     */
+    static std::size_t bucketOf(std::uint64_t nanos) {
+
+        if (nanos < subBucketCount) return static_cast<std::size_t>(nanos);
+        if (nanos >> maxBits) return bucketCount - 1;
+        const unsigned exponent = highestBit(nanos);
+        return (exponent - subBucketBits + 1) * subBucketCount + static_cast<std::size_t>((nanos >> (exponent - subBucketBits)) & (subBucketCount - 1));
+    }
+
+    /**
+     * @brief Returns the largest latency counted in a bucket.
+     *
+     * @param bucket The index of the bucket.
+     * @return std::uint64_t The latency.
+     */
+    static std::uint64_t bucketHighest(std::size_t bucket);
+
+    LatencyHistogram();
+
+    /**
+     * @brief Counts a latency.
+     *
+     * @param nanos The latency.
+     */
+    void record(std::uint64_t nanos);
+
+    /**
+     * @brief Counts latencies in a bucket, e.g. copied from another histogram.
+     *
+     * @param bucket The index of the bucket.
+     * @param count The number of latencies.
+     */
+    void add(std::size_t bucket, std::uint64_t count);
+
+    /**
+     * @brief Adds the counts of another histogram.
+     *
+     * @param other The histogram.
+     * @return LatencyHistogram& This object.
+     */
+    LatencyHistogram& operator+=(const LatencyHistogram& other);
+
+    /**
+     * @brief Returns the number of latencies counted.
+     *
+     * @return std::uint64_t The number of latencies.
+     */
+    std::uint64_t count() const;
+
+    /**
+     * @brief Returns the latency below which a percentage of the latencies are, rounded up to
+     * the largest latency of its bucket.
+     *
+     * @param percent The percentage, from 0 to 100.
+     * @return std::uint64_t The latency in nanoseconds, 0 if nothing was counted.
+     */
+    std::uint64_t percentile(double percent) const;
+
+private:
+    static unsigned highestBit(std::uint64_t value) {
+
+#if defined(__GNUC__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned bit = 0;
+        while (value >>= 1) ++bit;
+        return bit;
+#endif
+    }
+
+    std::vector<std::uint64_t> m_buckets;
+    std::uint64_t m_count;
+};
+
+/**
+ * @brief The calls, outcomes and latencies of an operation.
+ */
+struct OperationMetrics {
+    /** The calls by outcome, indexed by MetricOutcome. */
+    std::uint64_t outcomes[metricOutcomeCount] = {};
+    /** The sum of the latencies of the timed calls. */
+    std::uint64_t totalNanos = 0;
+    /** The largest latency of the timed calls. */
+    std::uint64_t maxNanos = 0;
+    /** The latencies of the timed calls, see AccountMetrics::samplePeriod(). */
+    LatencyHistogram latency;
+
+    /**
+     * @brief Returns the number of calls.
+     *
+     * @return std::uint64_t The number of calls.
+     */
+    std::uint64_t calls() const;
+
+    /**
+     * @brief Returns the number of calls that didn't succeed.
+     *
+     * @return std::uint64_t The number of failed calls.
+     */
+    std::uint64_t failures() const;
+
+    /**
+     * @brief Returns the mean latency of the timed calls.
+     *
+     * @return double The mean latency in nanoseconds, 0 without timed calls.
+     */
+    double meanNanos() const;
+
+    /**
+     * @brief Returns a percentile of the latencies, see LatencyHistogram::percentile(). It's
+     * never above maxNanos.
+     *
+     * @param percent The percentage, from 0 to 100.
+     * @return std::uint64_t The latency in nanoseconds.
+     */
+    std::uint64_t percentileNanos(double percent) const;
+
+    /**
+     * @brief Adds the metrics of the same operation measured elsewhere.
+     *
+     * @param other The metrics.
+     * @return OperationMetrics& This object.
+     */
+    OperationMetrics& operator+=(const OperationMetrics& other);
+};
+
+/**
+ * @brief The metrics of an account manager at some point: the measured operations and the
+ * size of its account indexes.
+ */
+struct MetricsSnapshot {
+    /** Whether the operations were measured. False if the metrics are compiled out. */
+    bool enabled = false;
+    /** The operations, indexed by MetricOperation. */
+    OperationMetrics operations[metricOperationCount];
+    /** The number of shards. */
+    std::size_t shards = 0;
+    /** The number of accounts. */
+    std::size_t accounts = 0;
+    /** The slots of the hash indexes of all the shards. */
+    std::size_t indexSlots = 0;
+    /** The accounts of the shard with the most. */
+    std::size_t largestShard = 0;
+    /** The accounts of the shard with the fewest. */
+    std::size_t smallestShard = 0;
+    /** The highest load factor of the index of a shard. */
+    double maxShardLoadFactor = 0.0;
+
+    /**
+     * @brief Returns the metrics of an operation.
+     *
+     * @param operation The operation.
+     * @return const OperationMetrics& The metrics.
+     */
+    const OperationMetrics& operation(MetricOperation operation) const;
+
+    /**
+     * @brief Returns the load factor of the indexes of all the shards together.
+     *
+     * @return double The accounts per slot.
+     */
+    double loadFactor() const;
+
+    /**
+     * @brief Formats the metrics as a table for people.
+     *
+     * @return std::string The text.
+     */
+    std::string toText() const;
+
+    /**
+     * @brief Formats the metrics as a JSON object.
+     *
+     * @return std::string The JSON text.
+     */
+    std::string toJson() const;
+};
+
+/**
+ * @brief Records the outcome and the latency of the operations of an account manager.
+ *
+ * Every thread records into a slab of its own, so recording takes no lock and writes no cache
+ * line another thread writes; a snapshot adds up the slabs. The slabs of the threads that
+ * ended are kept, and reused by new threads, so their calls stay counted.
+ *
+ * Every call is counted, but only one call in samplePeriod() of every thread is timed: reading
+ * the clock twice costs more than a top-up of a cached account. The histograms are of the
+ * timed calls.
+ *
+ * Without ACCOUNT_METRICS defined (the CMake option BUILD_METRICS) the class is empty,
+ * recording does nothing and MetricsTimer reads no clock.
+ */
+class AccountMetrics {
+public:
+    /** The default of samplePeriod(). */
+    static constexpr std::uint32_t defaultSamplePeriod = 16;
+
+#ifdef ACCOUNT_METRICS
+    /** Whether the operations are measured. */
+    static constexpr bool enabled = true;
+
+    AccountMetrics();
+    ~AccountMetrics();
+
+    /**
+     * @brief Sets how often the calls are timed, for all the account managers.
+     *
+     * @param period One call in period is timed, 1 times them all. 0 is treated as 1.
+     */
+    static void setSamplePeriod(std::uint32_t period);
+
+    /**
+     * @brief Returns how often the calls are timed.
+     *
+     * @return std::uint32_t One call in this many is timed.
+     */
+    static std::uint32_t samplePeriod();
+
+    /**
+     * @brief Returns whether the calling thread times its next call.
+     *
+     * @return true The call is timed.
+     * @return false The call is only counted.
+     */
+    static bool sampleNext() {
+
+        if (++t_sinceSample < s_samplePeriod.load(std::memory_order_relaxed)) return false;
+        t_sinceSample = 0;
+        return true;
+    }
+
+    /**
+     * @brief Counts a call of an operation that wasn't timed.
+     *
+     * @param operation The operation.
+     * @param outcome How it ended.
+     */
+    void record(MetricOperation operation, MetricOutcome outcome);
+
+    /**
+     * @brief Counts a timed call of an operation.
+     *
+     * @param operation The operation.
+     * @param outcome How it ended.
+     * @param nanos How long it took.
+     */
+    void record(MetricOperation operation, MetricOutcome outcome, std::uint64_t nanos);
+
+    /**
+     * @brief Adds the calls recorded by all the threads to a snapshot. Calls being recorded
+     * meanwhile may be partly counted.
+     *
+     * @param snapshot The snapshot.
+     */
+    void addTo(MetricsSnapshot& snapshot) const;
+#else
+    static constexpr bool enabled = false;
+
+    AccountMetrics() = default;
+
+    static void setSamplePeriod(std::uint32_t) {}
+
+    static std::uint32_t samplePeriod() {
+
+        return defaultSamplePeriod;
+    }
+
+    void addTo(MetricsSnapshot&) const {}
+#endif
+
+    AccountMetrics(const AccountMetrics&) = delete;
+    AccountMetrics& operator=(const AccountMetrics&) = delete;
+
+#ifdef ACCOUNT_METRICS
+private:
+    struct ThreadSlab;
+
+    ThreadSlab& threadSlab();
+
+    static std::atomic<std::uint32_t> s_samplePeriod;
+    /** The calls of the thread since it timed one. Inline, so it's read without a TLS wrapper call. */
+    static inline thread_local std::uint32_t t_sinceSample = 0;
+
+    const std::uint64_t m_id;
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<ThreadSlab> > > m_slabs;
+#endif
+};
+
+/**
+ * @brief Measures an operation from its construction to stop(), if the thread samples it,
+ * see AccountMetrics::sampleNext().
+ */
+class MetricsTimer {
+public:
+#ifdef ACCOUNT_METRICS
+    MetricsTimer() :
+        m_timed(AccountMetrics::sampleNext()),
+        m_start(m_timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+    {}
+
+    /**
+     * @brief Records the operation.
+     *
+     * @param metrics The metrics of the account manager.
+     * @param operation The operation.
+     * @param outcome How it ended.
+     */
+    void stop(AccountMetrics& metrics, MetricOperation operation, MetricOutcome outcome) const {
+
+        if (!m_timed) {
+            metrics.record(operation, outcome);
+            return;
+        }
+        const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_start;
+        metrics.record(operation, outcome, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+private:
+    bool m_timed;
+    std::chrono::steady_clock::time_point m_start;
+#else
+    void stop(AccountMetrics&, MetricOperation, MetricOutcome) const {}
+#endif
+};
+
+#endif //H_ACCOUNT_METRICS
\ No newline at end of file
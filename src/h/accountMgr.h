@@ -8,35 +8,155 @@ LICENSE file in the root directory of this source tree.
 #ifndef H_ACCOUNT_MGR
 #define H_ACCOUNT_MGR
 
-#include <unordered_map>
+#include <atomic>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <shared_mutex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
-#include <accountId.h>
-#include <account.h>
+#include <accountDetails.h>
+#include <accountMetrics.h>
+#include <accountTypes.h>
+#include <balanceAggregates.h>
+#include <balanceVersions.h>
+#include <csvImport.h>
+#include <objectAccountStore.h>
+#include <dataOrientedAccountStore.h>
+#include <variantAccountStore.h>
 #include <personAccount.h>
 #include <enterpriseAccount.h>
+#include <journal.h>
+#include <rcuDomain.h>
+#include <secondaryIndex.h>
+#include <seqLock.h>
+#include <snapshot.h>
 #include <visitor.h>
 
-/* ************************
- * Modify the following typedef to change the type of the id part of AccountId
- * The type used must have a std::hash instantiation or a hash functor defined.
- * ************************/
-/** This type defines the type of the id part of the AccountId class. */
-typedef int AccountId_IdPartType;
-/*************************/
+template<typename T_Store>
+class BasicAccountExecutor;
 
-/** This typedef defines the type of the id AccountId classes used in the application. */
-typedef AccountId<AccountId_IdPartType> accountIdType;
-
-class AccountMgr {
+/**
+ * @brief The bank's account manager. It owns all the accounts and performs the operations on them.
+ *
+ * The accounts are partitioned into shards by the hash of their AccountId. Every shard has
+ * its own lock, so operations on accounts living in different shards proceed in parallel.
+ * The lock only protects the shard's store: balance operations take it in shared mode and
+ * rely on the lock-free balances of the store, only the insertions and the transfers, which
+ * must change two balances at once, take it exclusively.
+ * The account details and the lookups of hasAccount() and isHotAccount() take no lock at all:
+ * they look the account up optimistically, and the insertions of the shard bump a sequence
+ * counter the readers check afterwards, so a reader retries, or takes the lock, only if it
+ * raced an insertion into its shard. The accounts themselves are never freed nor moved, and
+ * only their balance, a single atomic word, ever changes.
+ * The secondary indexes by Y-tunnus and by person name are shared by all the shards and have
+ * a lock of their own, taken exclusively by the insertions: after their shard for the person
+ * accounts, and before it for the enterprise accounts, which must claim their Y-tunnus.
+ * The top-ups, withdrawals, transfers, insertions of single accounts and account details are
+ * counted by outcome and timed, see metricsSnapshot().
+ * The balances of all the accounts at a single instant can be read while they keep changing,
+ * see openReadView().
+ * With a BasicAccountExecutor attached, every shard is owned by one of its workers, the only
+ * thread changing the balances of the shard or inserting into it: topUpAccount(),
+ * withdrawFromAccount(), applyOperations() and the insertions hand their requests to the
+ * owners and wait for them, and the owners apply them without the shared locks of the balance
+ * operations. transfer() and openReadView() park the owners of the shards they lock first.
+ * The account details and the lookups still run on the calling thread, without locks.
+ * All public methods are thread-safe.
+ *
+ * @tparam T_Store The account store used by every shard. It decides the memory layout of the
+ * accounts: ObjectAccountStore keeps an object per account, DataOrientedAccountStore keeps the
+ * balances in a dense array apart from the cold profile data.
+ */
+template<typename T_Store>
+class BasicAccountMgr {
 public:
+    /** The account store of each shard. */
+    typedef T_Store Store;
+
+    /**
+     * @brief Construct a new Account Mgr object with a single shard.
+     * 
+     */
+    BasicAccountMgr();
+
+    /**
+     * @brief Construct a new Account Mgr object in concurrent mode.
+     * 
+     * @param shardCount The number of shards the accounts are partitioned into. Each shard
+     * has its own lock. Use a few times the number of cores to keep the lock contention low.
+     * A value of 0 is treated as 1.
+     */
+    explicit BasicAccountMgr(std::size_t shardCount);
+
+    /**
+     * @brief Makes the object log all its mutations to a journal. Every mutation returns once
+     * its record is written, so the concurrent mutations share the writes of the journal
+     * (group commit). The mutations are applied in memory before they are written: if the
+     * journal fails, they go on in memory and aren't durable, see Journal::failed().
+     * It must be called before the object is used by several threads.
+     * 
+     * @param journal The journal, or nullptr to stop logging. It must outlive the object.
+     */
+    void attachJournal(Journal* journal);
+
+    /**
+     * @brief Replays a journal written by a previous run into this object, which should be empty.
+     * The accounts are created with their original ids, the unique id generator is seeded past
+     * them, and the balances are restored. It must be called at startup, before attachJournal().
+     * 
+     * @param path The path of the journal file. A file that doesn't exist is an empty journal.
+     * @return JournalReplayStats The number of records replayed and the accounts whose
+     * changes add up to a negative balance, which is not restored.
+     */
+    JournalReplayStats replayJournal(const std::string& path);
+
+    /**
+     * @brief Writes all the accounts to a snapshot file, see snapshot.h for the format.
+     * The accounts are read through a read view, so the snapshot is a consistent point in
+     * time across shards. The shards are copied one at a time under their shared lock and
+     * written to the file after releasing it: the balance operations are never blocked and
+     * the insertions are only blocked while their shard is copied.
+     * 
+     * @param path The path of the snapshot file. It's replaced once the new one is complete.
+     * @return true The snapshot was written.
+     * @return false The file couldn't be written.
+     */
+    bool saveSnapshot(const std::string& path) const;
+
+    /**
+     * @brief Loads the accounts of a snapshot file into this object, which should be empty.
+     * The file is mapped in memory and the accounts are inserted straight from the mapping,
+     * by several threads each filling its own shards. The unique id generator is seeded past
+     * the ids of the snapshot. It must be called at startup, before the object is used.
+     * 
+     * @param path The path of the snapshot file.
+     * @param threadCount The number of threads loading the accounts. 0 uses one per core.
+     * @return true The snapshot was loaded.
+     * @return false The file doesn't exist or isn't a valid snapshot. Nothing was loaded.
+     */
+    bool loadSnapshot(const std::string& path, std::size_t threadCount = 0);
+
+    /**
+     * @brief Returns the number of shards of the object.
+     * 
+     * @return std::size_t The number of shards.
+     */
+    std::size_t shardCount() const;
+
     /**
-     * @brief Construct a new Account Mgr object
+     * @brief Returns the shard of an account, whether it exists or not, e.g. to partition the
+     * operations between threads by shard.
      * 
+     * @param id The id of the account.
+     * @return std::size_t The index of the shard, below shardCount().
      */
-    AccountMgr();
+    std::size_t shardOf(const accountIdType& id) const;
 
     /**
      * @brief Adds money to the account identified by id.
@@ -45,10 +165,22 @@ public:
      * @param amount The amount of money to add. It must be > 0.
      * @return true The amount was successfuly added to the account.
      * @return false The amount couldn't be added becuause it's a negative number.
-     * Or the account doesn't exist.
+     * Or the account doesn't exist, or its balance would exceed INT_MAX.
      */
     bool topUpAccount(const accountIdType& id, int amount);
 
+    /**
+     * @brief Adds money to the account identified by a view of its id. See the other overload.
+     * The lookup allocates nothing and builds no AccountId.
+     * 
+     * @param id The view of the id of the account, e.g. the id and the date typed by a user.
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was successfuly added to the account.
+     * @return false The amount couldn't be added becuause it's a negative number.
+     * Or the account doesn't exist, or its balance would exceed INT_MAX.
+     */
+    bool topUpAccount(const accountIdViewType& id, int amount);
+
     /**
      * @brief Withdraws money from the account identified by id.
      * 
@@ -60,13 +192,133 @@ public:
     bool withdrawFromAccount(const accountIdType& id, int amount);
 
     /**
-     * @brief Returns a string with the details of the account
+     * @brief Withdraws money from the account identified by a view of its id. See the other
+     * overload. The lookup allocates nothing and builds no AccountId.
+     * 
+     * @param id The view of the id of the account, e.g. the id and the date typed by a user.
+     * @param amount The amount of money to withdraw. It must be > 0 and less than the current balance of the account.
+     * @return true The amount was successfuly withdrawn from the account.
+     * @return false The amount couldn't be added because it's a negative number or is greater than the current balance of the acount. Or the account doesn't exist.
+     */
+    bool withdrawFromAccount(const accountIdViewType& id, int amount);
+
+    /**
+     * @brief Moves money from an account to another one.
+     * 
+     * The transfer is atomic: the locks of the shards of both accounts are taken exclusively,
+     * so no other operation on the two shards runs between the debit and the credit, and the
+     * money is never lost or created. The locks are taken in the order of the shard indexes, so
+     * concurrent transfers in opposite directions can't deadlock; a transfer between accounts of
+     * the same shard takes a single lock. Only the account details, read without any lock, may
+     * see the amount in flight, withdrawn but not yet credited.
+     * 
+     * @param from The AccountId object of the account to withdraw the money from.
+     * @param to The AccountId object of the account to credit the money to.
+     * @param amount The amount of money to move. It must be > 0 and less than the current balance of from.
+     * @return true The money was moved.
+     * @return false The money couldn't be moved because the amount is a negative number or is greater than the
+     * balance of from, from and to are the same account, or one of them doesn't exist.
+     */
+    bool transfer(const accountIdType& from, const accountIdType& to, int amount);
+
+    /**
+     * @brief Applies a batch of top-ups and withdrawals.
+     * 
+     * The ids of the whole batch are hashed first and the operations are grouped by shard, so
+     * every shard is locked once. Within a shard the lookups are pipelined: the index entries
+     * and the balances of the next operations are prefetched while the current one is applied,
+     * which hides most of the memory latency of a lookup. The operations on the same account are
+     * applied in the order of the batch; each operation is atomic, the batch as a whole isn't.
+     * With an executor attached, the operations are handed to the owners of their shards instead.
+     * 
+     * @param operations The operations. A positive amount is a top-up, a negative one a withdrawal.
+     * @param count The number of operations.
+     * @return std::vector<OperationResult> The result of every operation, in the order of the batch.
+     */
+    std::vector<OperationResult> applyOperations(const AccountOperation* operations, std::size_t count);
+
+    /**
+     * @brief Applies a batch of top-ups and withdrawals. See the other overload.
+     * 
+     * @param operations The operations.
+     * @return std::vector<OperationResult> The result of every operation, in the order of the batch.
+     */
+    std::vector<OperationResult> applyOperations(const std::vector<AccountOperation>& operations);
+
+    /**
+     * @brief Returns whether an account exists.
+     * 
+     * @param id The id of the account.
+     * @return true The account exists.
+     * @return false There is no account with that id.
+     */
+    bool hasAccount(const accountIdType& id) const;
+
+    /**
+     * @brief Makes an account hot: its balance is split into stripes that concurrent top-ups
+     * credit without sharing a cache line, see StripedBalance. Withdrawals still never
+     * overdraw it. Meant for the few accounts that receive a large share of the top-ups;
+     * contended accounts can also be made hot automatically, see AtomicBalance::setAutoPromotion().
+     * 
+     * @param id The id of the account.
+     * @return true The account is hot.
+     * @return false There is no account with that id, or too many accounts are hot already.
+     */
+    bool makeHotAccount(const accountIdType& id);
+
+    /**
+     * @brief Returns whether an account is hot.
+     * 
+     * @param id The id of the account.
+     * @return true The account exists and is hot.
+     * @return false The account doesn't exist or isn't hot.
+     */
+    bool isHotAccount(const accountIdType& id) const;
+
+    /**
+     * @brief Returns a string with the details of the account. It takes no lock, see the
+     * class description.
      * 
      * @param id The id of the object.
      * @return std::string The details of the account.
      */
     std::string getAccountDetails(const accountIdType& id) const;
 
+    /**
+     * @brief Returns a string with the details of the account identified by a view of its id.
+     * The lookup allocates nothing and builds no AccountId.
+     * 
+     * @param id The view of the id of the account, e.g. the id and the date typed by a user.
+     * @return std::string The details of the account.
+     */
+    std::string getAccountDetails(const accountIdViewType& id) const;
+
+    /**
+     * @brief Formats the details of the account identified by id into an output iterator of
+     * char, without allocating memory. See AccountDetailsWriter.
+     * 
+     * @param id The id of the account.
+     * @param out The output iterator, e.g. a char* into a large enough buffer or a std::back_insert_iterator.
+     * @param format The format. AccountDetailsFormat::Text is the text of getAccountDetails().
+     * @return std::optional<T_OutputIt> The output iterator past the written chars, or nothing
+     * if the account doesn't exist.
+     */
+    template<typename T_OutputIt>
+    std::optional<T_OutputIt> renderAccountDetails(const accountIdType& id, T_OutputIt out, AccountDetailsFormat format = AccountDetailsFormat::Text) const;
+
+    /**
+     * @brief Formats the details of the account identified by id into a buffer, without
+     * allocating memory. Like std::snprintf, the output is cut at the size of the buffer and
+     * the length of the whole output is returned; no terminating null char is written.
+     * 
+     * @param id The id of the account.
+     * @param buffer The buffer.
+     * @param size The size of the buffer.
+     * @param format The format. AccountDetailsFormat::Text is the text of getAccountDetails().
+     * @return std::size_t The length of the details, which may exceed size. 0 if the account doesn't exist.
+     */
+    std::size_t renderAccountDetails(const accountIdType& id, char* buffer, std::size_t size, AccountDetailsFormat format = AccountDetailsFormat::Text) const;
+
     /**
      * @brief Inserts a new person account into the internal database of the object.
      * 
@@ -78,68 +330,437 @@ public:
 
     /**
      * @brief Inserts a new enterprise account into the internal database of the object.
+     * A Y-tunnus identifies one enterprise, so the account is refused if another one has its
+     * Y-tunnus. Of several accounts created concurrently with a Y-tunnus exactly one is inserted.
+     * 
+     * A refused account is reported with a default constructed accountIdType, with id 0 and no
+     * creation date, which no account ever has: callers must compare the returned id with
+     * accountIdType() before using it.
      * 
      * @param yTunnus The Y-tunnus identifier of the enterprise.
      * @param companyName The enterprise name.
-     * @return const accountIdType& The AccountId object of the just created account.
+     * @return const accountIdType& The AccountId object of the just created account, or a default
+     * constructed one if the Y-tunnus is taken.
      */
     const accountIdType& insertNewEnterpriseAccount(const std::string& yTunnus, const std::string& companyName);
 
-private:
-    PersonAccount<AccountId_IdPartType>* createNewPersonAccountPtr(const std::string& firstName, const std::string& lastName);
-    EnterpriseAccount<AccountId_IdPartType>* createNewEnterpriseAccountPtr(const std::string& yTunnus, const std::string& companyName);
-    typedef std::unordered_map<accountIdType, std::unique_ptr<AbstractAccount<AccountId_IdPartType>>, AccountIdHashFunctor<AccountId_IdPartType> > AccountMgrUnorderedMap;
-    AccountMgrUnorderedMap m_actMgrDB;
-};
+    /**
+     * @brief Inserts a batch of new accounts.
+     * 
+     * The ids are generated in the order of the batch, then the accounts are grouped by shard,
+     * so every shard is locked once and its capacity reserved for all of its new accounts
+     * before inserting them. The enterprise accounts whose Y-tunnus is taken, by an account
+     * inserted before or earlier in the batch, are refused as by insertNewEnterpriseAccount().
+     * With an executor attached, the accounts are handed to the owners of their shards instead,
+     * and of the accounts of the batch sharing a Y-tunnus the first one inserted by its owner,
+     * not necessarily the first one of the batch, is kept.
+     * 
+     * @param accounts The accounts to insert.
+     * @param count The number of accounts.
+     * @param ids The AccountId objects of the new accounts, in the order of the batch, a default
+     * constructed one for every refused account. It must have room for count ids.
+     */
+    void insertNewAccounts(const NewAccount* accounts, std::size_t count, accountIdType* ids);
 
-template<typename T_Id>
-class AccountDetailsVisitor : public Visitor<T_Id> {
-public:
-    AccountDetailsVisitor();
-    void VisitPersonAccount(const PersonAccount<T_Id> *account) override;
-    void VisitEnterpriseAccount(const EnterpriseAccount<T_Id> *account) override;
-    const std::string& accountDetails() const;
+    /**
+     * @brief Inserts a batch of new accounts. See the other overload.
+     * 
+     * @param accounts The accounts to insert.
+     * @return std::vector<accountIdType> The AccountId objects of the new accounts, in the order of
+     * the batch, a default constructed one for every refused account.
+     */
+    std::vector<accountIdType> insertNewAccounts(const std::vector<NewAccount>& accounts);
+
+    /**
+     * @brief Imports the accounts of a CSV file, see csvImport.h for the format.
+     * 
+     * The file is read in large blocks. Every block is split at line ends into chunks parsed
+     * by several threads without allocating memory per field, and its well formed lines are
+     * inserted with insertNewAccounts(). The malformed lines are reported and skipped, the
+     * enterprise lines whose Y-tunnus is taken are refused.
+     * 
+     * @param path The path of the CSV file.
+     * @param threadCount The number of threads parsing the file. 0 uses one per core.
+     * @return CsvImportResult The ids of the accounts in the order of the file and the malformed lines.
+     */
+    CsvImportResult importCsv(const std::string& path, std::size_t threadCount = 0);
+
+    /**
+     * @brief Returns the enterprise account with a Y-tunnus. There is one at most, see
+     * insertNewEnterpriseAccount().
+     * 
+     * @param yTunnus The Y-tunnus.
+     * @return std::optional<accountIdType> The id of the account, if any.
+     */
+    std::optional<accountIdType> findByYTunnus(std::string_view yTunnus) const;
+
+    /**
+     * @brief Returns the person accounts whose last name starts with a prefix, sorted by last
+     * name and first name.
+     * 
+     * @param lastNamePrefix The prefix of the last name.
+     * @param limit The greatest number of accounts returned.
+     * @return std::vector<accountIdType> The ids of the accounts.
+     */
+    std::vector<accountIdType> findPersonsByLastNamePrefix(std::string_view lastNamePrefix, std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    /**
+     * @brief Returns the person accounts with a last name whose first name starts with a prefix,
+     * sorted by first name.
+     * 
+     * @param lastName The last name.
+     * @param firstNamePrefix The prefix of the first name, empty for all the first names.
+     * @param limit The greatest number of accounts returned.
+     * @return std::vector<accountIdType> The ids of the accounts.
+     */
+    std::vector<accountIdType> findPersonsByName(std::string_view lastName, std::string_view firstNamePrefix = std::string_view(), std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    /**
+     * @brief Returns the entries and the memory of the secondary indexes.
+     * 
+     * @return SecondaryIndexStats The statistics.
+     */
+    SecondaryIndexStats indexStats() const;
+
+    /**
+     * @brief Returns the number of accounts.
+     * 
+     * @return std::size_t The number of accounts.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Returns the sum of the balances of all the accounts. Each shard is summed under
+     * its lock, but the shards are not locked all at once: concurrent operations may or may
+     * not be reflected.
+     * 
+     * @return std::int64_t The sum of the balances.
+     */
+    std::int64_t totalBalance() const;
+
+    /**
+     * @brief Returns the count, sum, minimum and maximum of the balances and the number of
+     * accounts with a balance of 0. The shards are scanned in parallel, each one under its
+     * lock, so like totalBalance() concurrent operations may or may not be reflected.
+     * 
+     * @param filter The accounts scanned.
+     * @param threadCount The number of threads scanning the shards, 0 for one per core.
+     * @return BalanceAggregates The aggregates.
+     */
+    BalanceAggregates aggregateBalances(AccountFilter filter = AccountFilter::All, std::size_t threadCount = 0) const;
+
+    /**
+     * @brief Returns the number of accounts in every bucket of balances. Scanned like
+     * aggregateBalances().
+     * 
+     * @param bounds The bounds of the buckets, see BalanceHistogram.
+     * @param filter The accounts scanned.
+     * @param threadCount The number of threads scanning the shards, 0 for one per core.
+     * @return BalanceHistogram The histogram.
+     */
+    BalanceHistogram balanceHistogram(const std::vector<int>& bounds, AccountFilter filter = AccountFilter::All, std::size_t threadCount = 0) const;
+
+    /**
+     * @brief Returns the n accounts with the largest balances, the largest first, equal
+     * balances by id. Scanned like aggregateBalances().
+     * 
+     * @param n The number of accounts.
+     * @param filter The accounts scanned.
+     * @param threadCount The number of threads scanning the shards, 0 for one per core.
+     * @return std::vector<AccountBalance> The accounts and their balances.
+     */
+    std::vector<AccountBalance> topBalances(std::size_t n, AccountFilter filter = AccountFilter::All, std::size_t threadCount = 0) const;
+
+    /**
+     * @brief The accounts and their balances at the instant the view was opened, see
+     * openReadView(). The view is closed when it's destroyed. It must not outlive its
+     * account manager.
+     */
+    class ReadView {
+    public:
+        ReadView(ReadView&& other) noexcept :
+            m_mgr(other.m_mgr),
+            m_epoch(other.m_epoch)
+        {
+            other.m_mgr = nullptr;
+        }
+
+        ReadView& operator=(ReadView&& rhs) noexcept {
+
+            if (this != &rhs) {
+                close();
+                m_mgr = rhs.m_mgr;
+                m_epoch = rhs.m_epoch;
+                rhs.m_mgr = nullptr;
+            }
+            return *this;
+        }
+
+        ReadView(const ReadView&) = delete;
+        ReadView& operator=(const ReadView&) = delete;
+
+        ~ReadView() {
+
+            close();
+        }
+
+        /**
+         * @brief Calls function for every account that existed when the view was opened, with
+         * the balance it had then, shard by shard, with the arguments
+         * (const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance).
+         * A shard is read under its shared lock, so function must not insert accounts or open
+         * views. The view must be open.
+         * 
+         * @param function The function.
+         */
+        template<typename T_Function>
+        void forEachAccount(T_Function function) const {
+
+            for (std::size_t s = 0; s < m_mgr->m_shardCount; ++s) {
+                m_mgr->forEachAccountOfShard(m_epoch, s, function);
+            }
+        }
+
+        /**
+         * @brief Closes the view, so the old balances it kept may be dropped. Nothing is done if
+         * the view is closed already.
+         * 
+         */
+        void close() {
+
+            if (m_mgr != nullptr) {
+                m_mgr->closeReadView(m_epoch);
+                m_mgr = nullptr;
+            }
+        }
+
+        /**
+         * @brief Returns whether the view is open.
+         * 
+         * @return true The view is open.
+         * @return false The view was closed or moved.
+         */
+        bool isOpen() const {
+
+            return m_mgr != nullptr;
+        }
+
+    private:
+        friend class BasicAccountMgr;
+
+        ReadView(const BasicAccountMgr* mgr, std::uint64_t epoch) :
+            m_mgr(mgr),
+            m_epoch(epoch)
+        {}
+
+        const BasicAccountMgr* m_mgr;
+        std::uint64_t m_epoch;
+    };
+
+    /**
+     * @brief Opens a view of the balances of all the accounts at this instant, e.g. for a
+     * report that adds them up while the operations go on (MVCC).
+     * 
+     * Opening the view takes the locks of all the shards at once, only long enough to start a
+     * new epoch. While views are open, the first change of an account after the newest one
+     * was opened keeps its old balance, see BalanceVersions; the following changes run as
+     * without views. The old balances are dropped once no open view needs them.
+     * 
+     * @return ReadView The view.
+     */
+    ReadView openReadView() const;
+
+    /**
+     * @brief Returns the number of old balances kept for the open views.
+     * 
+     * @return std::size_t The number of old balances, 0 without open views.
+     */
+    std::size_t readViewVersions() const;
+
+    /**
+     * @brief Returns the allocation statistics of the accounts, added up over all the shards.
+     * 
+     * @return AccountAllocationStats The statistics.
+     */
+    AccountAllocationStats allocationStats() const;
+
+    /**
+     * @brief Returns the calls, outcomes and latency histograms of the measured operations,
+     * added up over all the threads, and the size and load factor of the account indexes.
+     * Without the metrics compiled in (the CMake option BUILD_METRICS) only the indexes are
+     * reported.
+     * 
+     * @return MetricsSnapshot The metrics.
+     */
+    MetricsSnapshot metricsSnapshot() const;
 
 private:
-    std::string m_accountDetails;
+    friend class BasicAccountExecutor<T_Store>;
+
+    typedef typename T_Store::Handle Handle;
+
+    /** The lock-free lookups tried before a reader that races insertions takes the lock. */
+    static constexpr int optimisticReads = 2;
+
+    /** Shards are aligned to a cache line so the locks of neighbour shards don't share it. */
+    struct alignas(64) Shard {
+        mutable std::shared_mutex m_mutex;
+        /** Held under the shared lock from a balance change to its journal record, so the
+         * records of an account are in the order of its changes. */
+        std::mutex m_journalMutex;
+        /** Bumped by the insertions. On a line apart from the lock, which balance operations write. */
+        alignas(64) SeqLock m_seqLock;
+        T_Store m_store;
+        BalanceVersions<T_Store> m_versions;
+    };
+
+    std::size_t shardIndex(std::size_t hash) const;
+    Shard& shardFor(const accountIdType& id) const;
+    void waitDurable(std::uint64_t sequence) const;
+    std::unique_lock<std::mutex> lockJournal(Shard& shard) const;
+    template<typename T_Key>
+    bool topUp(const T_Key& id, int amount);
+    template<typename T_Key>
+    bool withdraw(const T_Key& id, int amount);
+    template<typename T_Key>
+    std::string accountDetails(const T_Key& id) const;
+    template<typename T_Key, typename T_OutputIt>
+    std::optional<T_OutputIt> renderDetails(const T_Key& id, T_OutputIt out, AccountDetailsFormat format) const;
+    template<typename T_Key>
+    static Handle findForRead(const Shard& shard, const T_Key& id, std::size_t hash);
+    const accountIdType& insertAccount(const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName);
+    void insertAccounts(const NewAccount* accounts, std::size_t count, accountIdType* ids);
+    static accountIdType newAccountId();
+    const accountIdType& storedId(const accountIdType& id) const;
+    bool indexAccount(const accountIdType& id, AccountKind kind, std::string_view name, std::string_view secondName);
+    template<typename T_Result, typename T_Block>
+    T_Result scanBalances(AccountFilter filter, std::size_t threadCount, const T_Result& empty, T_Block block) const;
+    static MetricOutcome moveBalance(Shard& fromShard, const accountIdType& from, std::size_t fromHash, Shard& toShard, const accountIdType& to, std::size_t toHash, int amount);
+    static OperationResult applyOperation(Shard& shard, Handle handle, int amount);
+    void applyBatch(const AccountOperation* operations, std::size_t count, OperationResult* results, bool byOwner);
+    static void applyToStore(Shard& shard, const AccountOperation* operations, const std::size_t* hashes, const std::uint32_t* order, std::size_t count, OperationResult* results, Journal* journal, std::uint64_t& sequence);
+    void closeReadView(std::uint64_t epoch) const;
+    template<typename T_Function>
+    void forEachAccountOfShard(std::uint64_t epoch, std::size_t shard, T_Function& function) const;
+
+    std::size_t m_shardCount;
+    std::unique_ptr<Shard[]> m_shards;
+    Journal* m_journal;
+    /** Set by the executor attached, which owns the shards while it lives. */
+    BasicAccountExecutor<T_Store>* m_executor;
+    mutable std::shared_mutex m_indexMutex;
+    YTunnusIndex m_yTunnusIndex;
+    PersonNameIndex m_personNameIndex;
+    mutable AccountMetrics m_metrics;
+    /** Serializes opening and closing the views. */
+    mutable std::mutex m_viewMutex;
+    mutable std::uint64_t m_lastViewEpoch;
+    mutable std::vector<std::uint64_t> m_openViewEpochs;
 };
 
+/* ************************
+ * Modify the following typedef to change the account store used by the application.
+ * ObjectAccountStore keeps an object per account, DataOrientedAccountStore keeps the balances
+ * in a dense array apart from the profile data, VariantAccountStore keeps the accounts by
+ * value and dispatches them without virtual calls, NodeObjectAccountStore indexes the objects
+ * in a std::unordered_map and reads them under the shard locks:
+ * typedef BasicAccountMgr<DataOrientedAccountStore> AccountMgr;
+ * typedef BasicAccountMgr<VariantAccountStore> AccountMgr;
+ * typedef BasicAccountMgr<NodeObjectAccountStore> AccountMgr;
+ * ************************/
+/** This typedef defines the account manager used by the application. */
+typedef BasicAccountMgr<ObjectAccountStore> AccountMgr;
+/*************************/
+
+/** Account manager with the data oriented layout. */
+typedef BasicAccountMgr<DataOrientedAccountStore> DataOrientedAccountMgr;
+
+/** Account manager with the accounts stored by value and dispatched statically. */
+typedef BasicAccountMgr<VariantAccountStore> VariantAccountMgr;
+
+/** Account manager with the account objects indexed in a node based hash map. */
+typedef BasicAccountMgr<NodeObjectAccountStore> NodeAccountMgr;
+
+extern template class BasicAccountMgr<ObjectAccountStore>;
+extern template class BasicAccountMgr<DataOrientedAccountStore>;
+extern template class BasicAccountMgr<VariantAccountStore>;
+extern template class BasicAccountMgr<NodeObjectAccountStore>;
+
 //IMPLEMENTATION
-template<typename T_Id>
-AccountDetailsVisitor<T_Id>::AccountDetailsVisitor() :
-    m_accountDetails()
-{}
+template<typename T_Store>
+template<typename T_OutputIt>
+std::optional<T_OutputIt> BasicAccountMgr<T_Store>::renderAccountDetails(const accountIdType& id, T_OutputIt out, AccountDetailsFormat format) const {
+
+    MetricsTimer timer;
+    std::optional<T_OutputIt> end = renderDetails(id, out, format);
+    timer.stop(m_metrics, MetricOperation::AccountDetails, end ? MetricOutcome::Succeeded : MetricOutcome::AccountNotFound);
+    return end;
+}
 
-template<typename T_Id>
-const std::string& AccountDetailsVisitor<T_Id>::accountDetails() const {
+template<typename T_Store>
+template<typename T_Key, typename T_OutputIt>
+std::optional<T_OutputIt> BasicAccountMgr<T_Store>::renderDetails(const T_Key& id, T_OutputIt out, AccountDetailsFormat format) const {
 
-    return m_accountDetails;
+    const std::size_t hash = AccountIdHashFunctor<AccountId_IdPartType>()(id);
+    const Shard& shard = m_shards[shardIndex(hash)];
+    Handle handle = findForRead(shard, id, hash);
+    if (handle == T_Store::invalidHandle()) {
+        return std::nullopt;
+    }
+    //No lock needed: what's rendered never changes once inserted, but the atomic balance.
+    return shard.m_store.renderAccountDetails(handle, out, format);
 }
 
-template<typename T_Id>
-void AccountDetailsVisitor<T_Id>::VisitPersonAccount(const PersonAccount<T_Id> *account) {
+template<typename T_Store>
+template<typename T_Key>
+typename BasicAccountMgr<T_Store>::Handle BasicAccountMgr<T_Store>::findForRead(const Shard& shard, const T_Key& id, std::size_t hash) {
 
-    std::ostringstream s;
+    //An index without concurrent lookups is only read under the lock.
+    for (int attempt = 0; T_Store::concurrentLookups && attempt < optimisticReads; ++attempt) {
+        std::uint64_t sequence;
+        if (!shard.m_seqLock.readBegin(sequence)) break;
 
-    s << std::string("Account type: Person") << std::endl;
-    s << std::string("Account Id: id: ") << account->id().id() << ", creation date: \"" << account->id().creationDate() << "\"" << std::endl;
-    s << std::string("First Name: ") << account->firstName() << std::endl;
-    s << std::string("Last Name: ") << account->lastName() << std::endl;
-    s << std::string("Balance: ") << account->balance() << std::endl;
-    m_accountDetails = s.str();
+        Handle handle;
+        {
+            //Covers the index arrays, which an insertion growing the index may replace.
+            RcuDomain::ReadSection section;
+            handle = shard.m_store.findConcurrent(id, hash);
+        }
+        if (shard.m_seqLock.readValid(sequence)) return handle;
+    }
+    //An insertion is running or keeps racing the reader: wait for it like a writer would.
+    std::shared_lock<std::shared_mutex> lock(shard.m_mutex);
+    return shard.m_store.find(id, hash);
 }
 
-template<typename T_Id>
-void AccountDetailsVisitor<T_Id>::VisitEnterpriseAccount(const EnterpriseAccount<T_Id> *account) {
+template<typename T_Store>
+template<typename T_Function>
+void BasicAccountMgr<T_Store>::forEachAccountOfShard(std::uint64_t epoch, std::size_t shard, T_Function& function) const {
+
+    std::vector<int> balances;
+    std::vector<Handle> handles;
+    std::shared_lock<std::shared_mutex> lock(m_shards[shard].m_mutex);
+    const T_Store& store = m_shards[shard].m_store;
+    balances.reserve(store.size());
+    handles.reserve(store.size());
+    store.forEachBalanceBlock(AccountFilter::All, [&balances, &handles](const int* blockBalances, const Handle* blockHandles, std::size_t count) {
+        balances.insert(balances.end(), blockBalances, blockBalances + count);
+        handles.insert(handles.end(), blockHandles, blockHandles + count);
+    });
+
+    //The balances are read before their versions: a writer keeps the old balance before
+    //changing it, so a changed balance read here has its version visible below.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    m_shards[shard].m_versions.resolve(epoch, handles.data(), balances.data(), balances.size());
 
-    std::ostringstream s;
+    for (std::size_t i = 0; i < balances.size(); ++i) {
+        if (balances[i] == BalanceVersions<T_Store>::absent) continue;
 
-    s << std::string("Account type: Enterprise") << std::endl;
-    s << std::string("Account Id: id: ") << account->id().id() << ", creation date: \"" << account->id().creationDate() << "\"" << std::endl;
-    s << std::string("Y-Tunnus: ") << account->yTunnus() << std::endl;
-    s << std::string("Company Name: ") << account->companyName() << std::endl;
-    s << std::string("Balance: ") << account->balance() << std::endl;
-    m_accountDetails = s.str();
+        const int balance = balances[i];
+        store.exportAccount(handles[i], [&function, balance](const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int) {
+            function(id, kind, name, secondName, balance);
+        });
+    }
 }
 
 #endif //H_ACCOUNT_MGR
\ No newline at end of file
@@ -0,0 +1,114 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ACCOUNT_SERVER
+#define H_ACCOUNT_SERVER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <accountMgr.h>
+#include <serverProtocol.h>
+
+/**
+ * @brief Configuration of an AccountServer.
+ */
+struct ServerOptions {
+    /** The number of worker threads, each with its own event loop. */
+    std::size_t threadCount = 2;
+    /** The length of the queue of pending connections. */
+    int backlog = 1024;
+    /** A connection stops reading requests while this many response bytes wait to be sent. */
+    std::size_t maxPendingOutput = 4 << 20;
+};
+
+/**
+ * @brief TCP front-end of an AccountMgr speaking the protocol of serverProtocol.h. Linux only.
+ *
+ * Every worker thread runs an epoll event loop over the listening socket, shared with the
+ * other workers through EPOLLEXCLUSIVE, and over the connections it accepted. A readable
+ * connection is read until the socket is empty, all the complete requests received are run
+ * in order, and their responses are sent with a single write. A client may therefore pipeline
+ * many requests and get their responses back in few segments.
+ *
+ * The requests run on the worker threads; with a journal attached, a worker blocks while the
+ * changes it ran wait for the disk.
+ */
+class AccountServer {
+public:
+    /**
+     * @brief Construct a server for a manager. Nothing listens until start() is called.
+     *
+     * @param mgr The manager the requests are run against.
+     * @param options The configuration.
+     */
+    explicit AccountServer(AccountMgr& mgr, const ServerOptions& options = ServerOptions());
+
+    AccountServer(const AccountServer&) = delete;
+    AccountServer& operator=(const AccountServer&) = delete;
+
+    /**
+     * @brief Stops the server.
+     *
+     */
+    ~AccountServer();
+
+    /**
+     * @brief Listens on an address and starts the workers.
+     *
+     * @param address The IPv4 address to listen on, e.g. "127.0.0.1" or "0.0.0.0".
+     * @param port The port, 0 to get any free port.
+     * @throw std::system_error The socket can't be created, bound or listened on.
+     */
+    void start(const std::string& address, std::uint16_t port);
+
+    /**
+     * @brief Returns the port the server listens on, useful after starting on port 0.
+     *
+     * @return std::uint16_t The port.
+     */
+    std::uint16_t port() const;
+
+    /**
+     * @brief Stops the workers and closes the listening socket and all the connections.
+     *
+     */
+    void stop();
+
+    /**
+     * @brief Returns the number of requests run so far.
+     *
+     * @return std::uint64_t The number of requests.
+     */
+    std::uint64_t requestCount() const;
+
+    /**
+     * @brief Runs a request against a manager and appends its response.
+     *
+     * @param mgr The manager.
+     * @param request The request.
+     * @param out The buffer the response is appended to.
+     */
+    static void execute(AccountMgr& mgr, const Request& request, std::string& out);
+
+private:
+    void workerLoop();
+
+    AccountMgr& m_mgr;
+    ServerOptions m_options;
+    int m_listenFd;
+    int m_stopFd;
+    std::uint16_t m_port;
+    std::atomic<std::uint64_t> m_requestCount;
+    std::vector<std::thread> m_workers;
+};
+
+#endif //H_ACCOUNT_SERVER
\ No newline at end of file
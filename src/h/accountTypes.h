@@ -0,0 +1,76 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ACCOUNT_TYPES
+#define H_ACCOUNT_TYPES
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include <accountId.h>
+
+/* ************************
+ * Modify the following typedef to change the type of the id part of AccountId
+ * The type used must have a std::hash instantiation or a hash functor defined.
+ * ************************/
+/** This type defines the type of the id part of the AccountId class. */
+typedef std::int64_t AccountId_IdPartType;
+/*************************/
+
+/** This typedef defines the type of the id AccountId classes used in the application. */
+typedef AccountId<AccountId_IdPartType> accountIdType;
+
+/** This typedef defines the type of the lightweight keys to look up accounts without building an accountIdType. */
+typedef AccountIdView<AccountId_IdPartType> accountIdViewType;
+
+static_assert(std::is_trivially_copyable<accountIdType>::value, "accountIdType must be trivially copyable");
+static_assert(sizeof(accountIdType) <= 16, "accountIdType must fit in 16 bytes");
+
+/**
+ * @brief The kinds of accounts managed by the application.
+ */
+enum class AccountKind : std::uint8_t {
+    Person,
+    Enterprise
+};
+
+/**
+ * @brief An account to create, in a batch inserted by AccountMgr::insertNewAccounts().
+ */
+struct NewAccount {
+    /** The kind of the account. */
+    AccountKind kind;
+    /** The first name of the owner or the Y-tunnus of the enterprise. */
+    std::string_view name;
+    /** The last name of the owner or the enterprise name. */
+    std::string_view secondName;
+};
+
+/**
+ * @brief An operation of a batch applied by AccountMgr::applyOperations().
+ */
+struct AccountOperation {
+    /** The account. */
+    accountIdType id;
+    /** The amount of money. A positive amount is a top-up, a negative one a withdrawal. */
+    int amount;
+};
+
+/**
+ * @brief The result of an AccountOperation.
+ */
+enum class OperationResult : std::uint8_t {
+    /** The operation was applied. */
+    Applied,
+    /** The account exists but the operation was refused, e.g. the balance is not enough. */
+    Rejected,
+    /** The account doesn't exist. */
+    AccountNotFound
+};
+
+#endif //H_ACCOUNT_TYPES
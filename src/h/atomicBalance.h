@@ -0,0 +1,173 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_ATOMIC_BALANCE
+#define H_ATOMIC_BALANCE
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+/**
+ * @brief A lock-free account balance.
+ * 
+ * The balance is an atomic integer and the withdrawals are done with a compare-and-swap loop,
+ * so several threads can operate on the same balance without a mutex and it never becomes
+ * negative.
+ * 
+ * A balance that many threads update at once can be made hot: it moves to a StripedBalance,
+ * whose stripes the threads credit without sharing a cache line. Since a balance is never
+ * negative, a hot balance keeps the index of its StripedBalance as a negative value, and the
+ * class stays the size of an int. Balances are made hot with makeHot(), or automatically when
+ * setAutoPromotion() is enabled and a thread sees its compare-and-swaps fail
+ * promotionContentions times in a row on the same balance. A hot balance stays hot.
+ */
+class AtomicBalance {
+public:
+    /** The consecutive failed compare-and-swaps of a thread on a balance that make it hot. */
+    static constexpr unsigned promotionContentions = 32;
+
+    /**
+     * @brief Construct a new Atomic Balance object with a balance of 0.
+     * 
+     */
+    AtomicBalance();
+
+    /**
+     * @brief Construct a new Atomic Balance object with the given balance.
+     * 
+     * @param value The initial balance.
+     */
+    explicit AtomicBalance(int value);
+
+    AtomicBalance(const AtomicBalance&) = delete;
+    AtomicBalance& operator=(const AtomicBalance&) = delete;
+
+    /**
+     * @brief Gives back the StripedBalance of a hot balance.
+     * 
+     */
+    ~AtomicBalance();
+
+    /**
+     * @brief Adds to the balance.
+     * 
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was added.
+     * @return false The amount is a negative number, or the balance would exceed INT_MAX.
+     */
+    bool add(int amount);
+
+    /**
+     * @brief Decreases the balance.
+     * 
+     * @param amount The amount of money to decrease. It must be > 0 and less than the balance.
+     * @return true The amount was decreased.
+     * @return false The amount is a negative number or is larger than the balance.
+     */
+    bool decrease(int amount);
+
+    /**
+     * @brief Returns the balance.
+     * 
+     * @return int The balance.
+     */
+    int value() const;
+
+    /**
+     * @brief Makes the balance hot, see StripedBalance.
+     * 
+     * @return true The balance is hot.
+     * @return false The pool of striped balances is full.
+     */
+    bool makeHot();
+
+    /**
+     * @brief Returns whether the balance is hot.
+     * 
+     * @return true The balance is striped.
+     * @return false The balance is a single integer.
+     */
+    bool hot() const;
+
+    /**
+     * @brief Enables or disables the automatic promotion of contended balances to hot, for
+     * the whole process. It's disabled by default.
+     * 
+     * @param enabled Whether contended balances are made hot.
+     */
+    static void setAutoPromotion(bool enabled);
+
+    /**
+     * @brief Returns whether contended balances are made hot automatically.
+     * 
+     * @return true The automatic promotion is enabled.
+     * @return false The automatic promotion is disabled.
+     */
+    static bool autoPromotion();
+
+private:
+    static bool isHot(int value) { return value < 0; }
+    static int hotValue(std::uint32_t index) { return -static_cast<int>(index) - 1; }
+    static std::uint32_t hotIndex(int value) { return static_cast<std::uint32_t>(-(value + 1)); }
+
+    bool addContended(int amount);
+    bool decreaseContended(int amount);
+    bool addHot(int value, int amount);
+    bool decreaseHot(int value, int amount);
+    int valueHot(int value) const;
+    void noteContention();
+
+    std::atomic<int> m_value;
+    static std::atomic<bool> s_autoPromotion;
+};
+
+//IMPLEMENTATION
+inline AtomicBalance::AtomicBalance() :
+    m_value(0)
+{}
+
+inline AtomicBalance::AtomicBalance(int value) :
+    m_value(value)
+{}
+
+inline bool AtomicBalance::add(int amount) {
+
+    if (amount < 0) return false;
+
+    //A compare-and-swap rather than a fetch_add: an overflow would turn the balance hot, and
+    //its failures are how the contention is detected.
+    int current = m_value.load(std::memory_order_relaxed);
+    if (isHot(current)) return addHot(current, amount);
+    if (amount > INT_MAX - current) return false;
+    if (m_value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) return true;
+    return addContended(amount);
+}
+
+inline bool AtomicBalance::decrease(int amount) {
+
+    if (amount < 0) return false;
+
+    int current = m_value.load(std::memory_order_relaxed);
+    if (isHot(current)) return decreaseHot(current, amount);
+    if (amount > current) return false;
+    if (m_value.compare_exchange_weak(current, current - amount, std::memory_order_relaxed)) return true;
+    return decreaseContended(amount);
+}
+
+inline int AtomicBalance::value() const {
+
+    const int current = m_value.load(std::memory_order_relaxed);
+    return isHot(current) ? valueHot(current) : current;
+}
+
+inline bool AtomicBalance::hot() const {
+
+    return isHot(m_value.load(std::memory_order_relaxed));
+}
+
+#endif //H_ATOMIC_BALANCE
\ No newline at end of file
@@ -0,0 +1,298 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_BALANCE_AGGREGATES
+#define H_BALANCE_AGGREGATES
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <accountTypes.h>
+#include <atomicBalance.h>
+
+/**
+ * @brief The accounts scanned by an aggregate query.
+ */
+enum class AccountFilter : std::uint8_t {
+    All,
+    Persons,
+    Enterprises
+};
+
+/**
+ * @brief Returns whether an account of a kind passes a filter.
+ *
+ * @param filter The filter.
+ * @param kind The kind of the account.
+ * @return true The account is scanned.
+ * @return false The account is skipped.
+ */
+inline bool matchesFilter(AccountFilter filter, AccountKind kind) {
+
+    return (filter == AccountFilter::All) || ((filter == AccountFilter::Persons) == (kind == AccountKind::Person));
+}
+
+/** The number of balances the account stores hand at once to the aggregates. */
+constexpr std::size_t balanceBlockSize = 1024;
+
+/**
+ * @brief Collects the balances scanned by an account store into blocks of balanceBlockSize,
+ * with the handles of their accounts, and calls a function with every full block. The
+ * aggregates then run over plain arrays of int, which the compiler vectorizes.
+ *
+ * @tparam T_Handle The handle of the accounts of the store.
+ * @tparam T_Function The function, called with (const int* balances, const T_Handle* handles, std::size_t count).
+ */
+template<typename T_Handle, typename T_Function>
+class BalanceBlockBuffer {
+public:
+    explicit BalanceBlockBuffer(T_Function& function) :
+        m_function(function),
+        m_count(0)
+    {}
+
+    BalanceBlockBuffer(const BalanceBlockBuffer&) = delete;
+    BalanceBlockBuffer& operator=(const BalanceBlockBuffer&) = delete;
+
+    /**
+     * @brief Adds the balance of an account, passing the block to the function when it's full.
+     *
+     * @param balance The balance.
+     * @param handle The handle of the account.
+     */
+    void push(int balance, T_Handle handle) {
+
+        m_balances[m_count] = balance;
+        m_handles[m_count] = handle;
+        if (++m_count == balanceBlockSize) {
+            flush();
+        }
+    }
+
+    /**
+     * @brief Adds the balance of an account if it passes a filter. The balance is written
+     * either way and only counted when it passes, so there's no branch to mispredict.
+     *
+     * @param passes Whether the account passes the filter.
+     * @param balance The balance.
+     * @param handle The handle of the account.
+     */
+    void pushIf(bool passes, int balance, T_Handle handle) {
+
+        m_balances[m_count] = balance;
+        m_handles[m_count] = handle;
+        m_count += static_cast<std::size_t>(passes);
+        if (m_count == balanceBlockSize) {
+            flush();
+        }
+    }
+
+    /**
+     * @brief Adds the balances of accounts with consecutive handles, passing every full block
+     * to the function. The copy has no branch per account, unlike push().
+     *
+     * @param balances The balances.
+     * @param first The handle of the first account.
+     * @param count The number of accounts.
+     */
+    void pushConsecutive(const AtomicBalance* balances, T_Handle first, std::size_t count) {
+
+        std::size_t done = 0;
+        while (done < count) {
+            const std::size_t n = std::min(balanceBlockSize - m_count, count - done);
+            for (std::size_t i = 0; i < n; ++i) {
+                m_balances[m_count + i] = balances[done + i].value();
+                m_handles[m_count + i] = first + static_cast<T_Handle>(done + i);
+            }
+            m_count += n;
+            done += n;
+            if (m_count == balanceBlockSize) {
+                flush();
+            }
+        }
+    }
+
+    /**
+     * @brief Passes the balances left to the function.
+     *
+     */
+    void flush() {
+
+        if (m_count > 0) {
+            m_function(static_cast<const int*>(m_balances), static_cast<const T_Handle*>(m_handles), m_count);
+            m_count = 0;
+        }
+    }
+
+private:
+    T_Function& m_function;
+    std::size_t m_count;
+    int m_balances[balanceBlockSize];
+    T_Handle m_handles[balanceBlockSize];
+};
+
+/**
+ * @brief The balance of an account, as returned by the top-N queries.
+ */
+struct AccountBalance {
+    /** The account. */
+    accountIdType id;
+    /** Its balance. */
+    int balance;
+};
+
+/**
+ * @brief The count, sum, minimum and maximum of a set of balances. The sum is accumulated in
+ * 64 bits, so it can't overflow for fewer than 2^32 accounts.
+ */
+struct BalanceAggregates {
+    /** The number of accounts. */
+    std::size_t accounts = 0;
+    /** The number of accounts with a balance of 0, the ones a withdrawal would fail on. */
+    std::size_t zeroBalanceAccounts = 0;
+    /** The sum of the balances. */
+    std::int64_t total = 0;
+    /** The smallest balance. Meaningless without accounts. */
+    int minBalance = 0;
+    /** The largest balance. Meaningless without accounts. */
+    int maxBalance = 0;
+
+    /**
+     * @brief Adds a block of balances. The loop is branch-free so it's vectorized.
+     *
+     * @param balances The balances.
+     * @param count The number of balances.
+     */
+    void add(const int* balances, std::size_t count);
+
+    /**
+     * @brief Adds the aggregates of other balances.
+     *
+     * @param other The aggregates.
+     * @return BalanceAggregates& This object.
+     */
+    BalanceAggregates& operator+=(const BalanceAggregates& other);
+};
+
+/**
+ * @brief The number of balances in every bucket between some bounds. With the bounds
+ * b0 < b1 < ... < bn-1 there are n + 1 buckets: below b0, [b0, b1), ..., and from bn-1 up.
+ */
+class BalanceHistogram {
+public:
+    /**
+     * @brief Construct an empty histogram.
+     *
+     * @param bounds The bounds of the buckets. They're sorted and duplicates removed.
+     */
+    explicit BalanceHistogram(std::vector<int> bounds);
+
+    /**
+     * @brief Adds a block of balances.
+     *
+     * @param balances The balances.
+     * @param count The number of balances.
+     */
+    void add(const int* balances, std::size_t count);
+
+    /**
+     * @brief Adds the counts of a histogram with the same bounds.
+     *
+     * @param other The histogram.
+     * @return BalanceHistogram& This object.
+     */
+    BalanceHistogram& operator+=(const BalanceHistogram& other);
+
+    /**
+     * @brief Returns the bounds of the buckets.
+     *
+     * @return const std::vector<int>& The sorted bounds.
+     */
+    const std::vector<int>& bounds() const;
+
+    /**
+     * @brief Returns the number of balances of every bucket.
+     *
+     * @return const std::vector<std::uint64_t>& The counts, one more than the bounds.
+     */
+    const std::vector<std::uint64_t>& counts() const;
+
+private:
+    std::vector<int> m_bounds;
+    std::vector<std::uint64_t> m_counts;
+};
+
+/**
+ * @brief The N accounts with the largest balances, kept in a min-heap of N entries. Equal
+ * balances are ranked by id, so the result doesn't depend on the scan order.
+ */
+class TopBalances {
+public:
+    /**
+     * @brief Construct an empty top.
+     *
+     * @param n The number of accounts kept.
+     */
+    explicit TopBalances(std::size_t n);
+
+    /**
+     * @brief Returns whether a balance may enter the top. Checked before getting the id of the
+     * account, which only a few accounts need.
+     *
+     * @param balance The balance.
+     * @return true The balance may enter the top.
+     * @return false The balance is below all the accounts of the full top.
+     */
+    bool wants(int balance) const {
+
+        return (m_heap.size() < m_n) || ((m_n > 0) && (balance >= m_heap.front().balance));
+    }
+
+    /**
+     * @brief Returns whether any balance of a block may enter the top, so most blocks are
+     * skipped with a vectorized scan once the top is full.
+     *
+     * @param balances The balances.
+     * @param count The number of balances.
+     * @return true A balance may enter the top.
+     * @return false No balance enters the top.
+     */
+    bool wantsAny(const int* balances, std::size_t count) const;
+
+    /**
+     * @brief Adds an account, dropping the last one of the top if it's full.
+     *
+     * @param id The account.
+     * @param balance Its balance.
+     */
+    void add(const accountIdType& id, int balance);
+
+    /**
+     * @brief Adds the accounts of another top.
+     *
+     * @param other The top.
+     * @return TopBalances& This object.
+     */
+    TopBalances& operator+=(const TopBalances& other);
+
+    /**
+     * @brief Returns the accounts of the top, the largest balance first.
+     *
+     * @return std::vector<AccountBalance> The accounts.
+     */
+    std::vector<AccountBalance> sorted() const;
+
+private:
+    static bool ranksBefore(const AccountBalance& lhs, const AccountBalance& rhs);
+
+    std::size_t m_n;
+    std::vector<AccountBalance> m_heap;
+};
+
+#endif //H_BALANCE_AGGREGATES
\ No newline at end of file
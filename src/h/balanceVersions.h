@@ -0,0 +1,247 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_BALANCE_VERSIONS
+#define H_BALANCE_VERSIONS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <flatHashMap.h>
+
+/**
+ * @brief The old balances of the accounts of a shard, kept for the open read views, see
+ * BasicAccountMgr::openReadView().
+ *
+ * Every view has an epoch, a later view a higher one. While views are open, the first change
+ * of an account after the newest one opened copies its balance into a version tagged with the
+ * epoch of that view, and an account inserted meanwhile gets a version saying it didn't exist.
+ * The balance an account had when a view opened is the one of its oldest version tagged with
+ * the epoch of the view or a later one, or else its current balance, which hasn't changed since.
+ *
+ * The versions are behind a mutex, but a writer only takes it for the first change of an
+ * account in an epoch: the accounts already preserved are remembered in a direct-mapped table
+ * of atomic handles, checked without a lock. Without open views a writer only reads a flag.
+ *
+ * @tparam T_Store The account store of the shard.
+ */
+template<typename T_Store>
+class BalanceVersions {
+public:
+    typedef typename T_Store::Handle Handle;
+
+    /** The balance of a version of an account that didn't exist yet. */
+    static constexpr int absent = std::numeric_limits<int>::min();
+    /** The table of the accounts preserved in the current epoch has 2^recentBits slots. */
+    static constexpr unsigned recentBits = 10;
+
+    BalanceVersions() :
+        m_tracking(false),
+        m_epoch(0),
+        m_recent(),
+        m_mutex(),
+        m_versions(),
+        m_latest()
+    {}
+
+    BalanceVersions(const BalanceVersions&) = delete;
+    BalanceVersions& operator=(const BalanceVersions&) = delete;
+
+    /**
+     * @brief Starts keeping the balances for a new view. Called while no writer is in the shard.
+     *
+     * @param epoch The epoch of the view, higher than the ones of the previous views.
+     */
+    void beginEpoch(std::uint64_t epoch) {
+
+        if (!m_recent) {
+            m_recent.reset(new std::atomic<Handle>[std::size_t(1) << recentBits]);
+        }
+        for (std::size_t i = 0; i < (std::size_t(1) << recentBits); ++i) {
+            m_recent[i].store(T_Store::invalidHandle(), std::memory_order_relaxed);
+        }
+        m_epoch = epoch;
+        m_tracking.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Keeps the balance of an account for the open views, if it wasn't kept yet in this
+     * epoch. Called under the shared lock of the shard, right before changing the balance.
+     *
+     * @param store The store of the shard.
+     * @param handle The handle of the account.
+     */
+    void preserve(const T_Store& store, Handle handle) {
+
+        if (!m_tracking.load(std::memory_order_relaxed)) return;
+
+        if (m_recent[slotOf(handle)].load(std::memory_order_acquire) != handle) {
+            preserveSlow(store, handle);
+        }
+        //A reader that sees the change this fence precedes sees the version too, see resolve().
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /**
+     * @brief Records that an account didn't exist for the open views. Called under the exclusive
+     * lock of the shard, after inserting the account.
+     *
+     * @param handle The handle of the account.
+     */
+    void inserted(Handle handle) {
+
+        if (!m_tracking.load(std::memory_order_relaxed)) return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_tracking.load(std::memory_order_relaxed)) return;
+        addVersion(handle, absent);
+        m_recent[slotOf(handle)].store(handle, std::memory_order_release);
+    }
+
+    /**
+     * @brief Replaces balances read from the store by the ones the accounts had when a view
+     * opened, absent for the accounts inserted later. The balances must have been read under
+     * the shared lock of the shard, followed by an acquire fence.
+     *
+     * @param epoch The epoch of the view.
+     * @param handles The handles of the accounts.
+     * @param balances Their balances, replaced.
+     * @param count The number of accounts.
+     */
+    void resolve(std::uint64_t epoch, const Handle* handles, int* balances, std::size_t count) const {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_latest.empty()) return;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            auto it = m_latest.find(handles[i]);
+            if (it == m_latest.end()) continue;
+
+            //The versions of an account are chained from the newest, so the oldest one that's
+            //recent enough is the last one seen before an older epoch.
+            for (std::uint32_t v = it->second; (v != noVersion) && (m_versions[v].m_epoch >= epoch); v = m_versions[v].m_previous) {
+                balances[i] = m_versions[v].m_balance;
+            }
+        }
+    }
+
+    /**
+     * @brief Drops the versions no open view needs: all of them without open views, or else
+     * the ones older than the oldest view.
+     *
+     * @param oldestEpoch The epoch of the oldest open view, 0 if no view is open.
+     */
+    void collect(std::uint64_t oldestEpoch) {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (oldestEpoch == 0) {
+            m_tracking.store(false, std::memory_order_relaxed);
+            m_versions = std::vector<Version>();
+            m_latest = Index();
+            return;
+        }
+
+        std::vector<Version> versions;
+        Index latest;
+        std::vector<std::uint32_t> chain;
+        for (const auto& entry : m_latest) {
+            chain.clear();
+            for (std::uint32_t v = entry.second; (v != noVersion) && (m_versions[v].m_epoch >= oldestEpoch); v = m_versions[v].m_previous) {
+                chain.push_back(v);
+            }
+            if (chain.empty()) continue;
+
+            std::uint32_t previous = noVersion;
+            for (std::size_t i = chain.size(); i-- > 0;) {
+                versions.push_back(Version{m_versions[chain[i]].m_epoch, m_versions[chain[i]].m_balance, previous});
+                previous = static_cast<std::uint32_t>(versions.size() - 1);
+            }
+            latest[entry.first] = previous;
+        }
+        m_versions.swap(versions);
+        m_latest = std::move(latest);
+    }
+
+    /**
+     * @brief Returns the number of versions kept.
+     *
+     * @return std::size_t The number of versions.
+     */
+    std::size_t size() const {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_versions.size();
+    }
+
+private:
+    /** A balance of an account before it changed, chained to its previous version. */
+    struct Version {
+        std::uint64_t m_epoch;
+        int m_balance;
+        std::uint32_t m_previous;
+    };
+
+    /** Mixes all the bits of a handle, since the ones of a pointer are aligned. */
+    struct HandleHash {
+        std::size_t operator()(Handle handle) const {
+
+            std::uint64_t bits = handleBits(handle);
+            bits ^= bits >> 33;
+            bits *= 0xff51afd7ed558ccdULL;
+            bits ^= bits >> 33;
+            return static_cast<std::size_t>(bits);
+        }
+    };
+
+    typedef FlatHashMap<Handle, std::uint32_t, HandleHash> Index;
+
+    static constexpr std::uint32_t noVersion = std::numeric_limits<std::uint32_t>::max();
+
+    static std::uint64_t handleBits(const void* handle) { return reinterpret_cast<std::uintptr_t>(handle); }
+    static std::uint64_t handleBits(std::uint32_t handle) { return handle; }
+
+    static std::size_t slotOf(Handle handle) {
+
+        return static_cast<std::size_t>((handleBits(handle) * 0x9e3779b97f4a7c15ULL) >> (64 - recentBits));
+    }
+
+    void preserveSlow(const T_Store& store, Handle handle) {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        //The last view may have closed since the flag was read, see collect().
+        if (!m_tracking.load(std::memory_order_relaxed)) return;
+
+        auto it = m_latest.find(handle);
+        if ((it == m_latest.end()) || (m_versions[it->second].m_epoch != m_epoch)) {
+            //Read under the mutex: the writers of the account wait here until it's kept.
+            addVersion(handle, store.balance(handle));
+        }
+        m_recent[slotOf(handle)].store(handle, std::memory_order_release);
+    }
+
+    void addVersion(Handle handle, int balance) {
+
+        std::uint32_t& latest = m_latest.try_emplace(handle, noVersion).first->second;
+        m_versions.push_back(Version{m_epoch, balance, latest});
+        latest = static_cast<std::uint32_t>(m_versions.size() - 1);
+    }
+
+    std::atomic<bool> m_tracking;
+    /** The epoch of the newest view. Only changed while no writer is in the shard. */
+    std::uint64_t m_epoch;
+    std::unique_ptr<std::atomic<Handle>[]> m_recent;
+    mutable std::mutex m_mutex;
+    std::vector<Version> m_versions;
+    Index m_latest;
+};
+
+#endif //H_BALANCE_VERSIONS
\ No newline at end of file
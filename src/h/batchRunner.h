@@ -0,0 +1,91 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_BATCH_RUNNER
+#define H_BATCH_RUNNER
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include <accountMgr.h>
+
+/*
+ * Batch command format. Every line is a command, its fields separated by spaces or tabs:
+ *
+ * P <first name> <last name>                              Create a person account
+ * E <Y-tunnus> <company name>                             Create an enterprise account
+ * T <id> <date> <amount>                                  Top up an account
+ * W <id> <date> <amount>                                  Withdraw from an account
+ * X <from id> <from date> <to id> <to date> <amount>      Transfer between accounts
+ * D <id> <date>                                           Account details, as JSON
+ * M                                                       Metrics of the manager, as JSON
+ *
+ * Dates are formatted as YYYYMMDD. Empty lines and lines starting with '#' are skipped.
+ * Every command prints one line: "<id> <date>" for the created accounts, "OK" for the
+ * balance changes that succeeded, the JSON details, or "ERR" followed by the reason.
+ */
+
+/**
+ * @brief Statistics of a batch run.
+ */
+struct BatchStats {
+    /** Commands run, malformed ones included. */
+    std::uint64_t commands = 0;
+    /** Commands that printed ERR. */
+    std::uint64_t failed = 0;
+};
+
+/**
+ * @brief Runs a stream of batch commands against an AccountMgr.
+ *
+ * The input is read in large blocks and the results are gathered in a large buffer written
+ * with a single fwrite, so a command costs the parsing and the operation itself. Nothing is
+ * printed but the results.
+ */
+class BatchRunner {
+public:
+    /** The size of the input blocks and the output buffer. */
+    static constexpr std::size_t bufferSize = 1 << 20;
+
+    /**
+     * @brief Construct a runner for a manager.
+     *
+     * @param mgr The manager the commands are run against.
+     */
+    explicit BatchRunner(AccountMgr& mgr);
+
+    /**
+     * @brief Runs all the commands of a file and writes their results.
+     *
+     * @param in The file with the commands.
+     * @param out The file the results are written to.
+     * @return BatchStats The statistics of the run.
+     */
+    BatchStats run(std::FILE* in, std::FILE* out);
+
+    /**
+     * @brief Runs a single command line and appends its result line to out.
+     *
+     * @param line The command, without its line feed.
+     * @param out The string the result is appended to. Skipped lines append nothing.
+     * @return true The command succeeded or the line was skipped.
+     * @return false The command printed ERR.
+     */
+    bool execute(std::string_view line, std::string& out);
+
+private:
+    void putId(const accountIdType& id, std::string& out);
+
+    AccountMgr& m_mgr;
+    std::string m_name;
+    std::string m_secondName;
+};
+
+#endif //H_BATCH_RUNNER
\ No newline at end of file
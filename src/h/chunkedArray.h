@@ -0,0 +1,180 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_CHUNKED_ARRAY
+#define H_CHUNKED_ARRAY
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief An append only array stored in contiguous chunks of a fixed size.
+ * 
+ * Unlike std::vector, growing never moves the elements: their addresses are stable, so the
+ * elements don't need to be movable (e.g. atomics) and references to them survive appends.
+ * Scans should go chunk by chunk, each chunk being a plain contiguous array.
+ * 
+ * The directory of the chunks doubles when it's full and the old directories are kept until
+ * the array is destroyed, so a reader may index elements published to it while a writer
+ * appends. The directories kept take less room than the current one.
+ * 
+ * @tparam T The type of the elements.
+ * @tparam T_ChunkBits log2 of the number of elements of a chunk.
+ */
+template<typename T, std::size_t T_ChunkBits = 12>
+class ChunkedArray {
+public:
+    /** The number of elements of a chunk. */
+    static constexpr std::size_t chunkSize = std::size_t(1) << T_ChunkBits;
+
+    /**
+     * @brief Construct an empty array. It doesn't allocate memory.
+     * 
+     */
+    ChunkedArray();
+
+    ChunkedArray(const ChunkedArray&) = delete;
+    ChunkedArray& operator=(const ChunkedArray&) = delete;
+
+    ~ChunkedArray();
+
+    /**
+     * @brief Appends an element constructed from args.
+     * 
+     * @param args The arguments passed to the constructor of T.
+     * @return std::size_t The index of the new element.
+     */
+    template<typename... T_Args>
+    std::size_t emplace_back(T_Args&&... args);
+
+    T& operator[](std::size_t index);
+    const T& operator[](std::size_t index) const;
+
+    /**
+     * @brief Returns the number of elements.
+     * 
+     * @return std::size_t The number of elements.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Returns the number of allocated chunks.
+     * 
+     * @return std::size_t The number of chunks.
+     */
+    std::size_t chunkCount() const;
+
+    /**
+     * @brief Returns the elements of a chunk, which are contiguous.
+     * 
+     * @param chunk The chunk index.
+     * @return const T* The first element of the chunk.
+     */
+    const T* chunk(std::size_t chunk) const;
+
+    /**
+     * @brief Returns the number of elements in a chunk. It's chunkSize for all but the last one.
+     * 
+     * @param chunk The chunk index.
+     * @return std::size_t The number of elements.
+     */
+    std::size_t chunkLength(std::size_t chunk) const;
+
+private:
+    /** The directory of the chunks, the last of m_directories. */
+    std::atomic<T**> m_directory;
+    std::vector<std::unique_ptr<T*[]> > m_directories;
+    std::size_t m_directoryCapacity;
+    std::size_t m_chunkCount;
+    std::size_t m_size;
+};
+
+//IMPLEMENTATION
+template<typename T, std::size_t T_ChunkBits>
+ChunkedArray<T, T_ChunkBits>::ChunkedArray() :
+    m_directory(nullptr),
+    m_directories(),
+    m_directoryCapacity(0),
+    m_chunkCount(0),
+    m_size(0)
+{}
+
+template<typename T, std::size_t T_ChunkBits>
+ChunkedArray<T, T_ChunkBits>::~ChunkedArray() {
+
+    for (std::size_t i = 0; i < m_size; ++i) {
+        (*this)[i].~T();
+    }
+    T** directory = m_directory.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < m_chunkCount; ++i) {
+        std::allocator<T>().deallocate(directory[i], chunkSize);
+    }
+}
+
+template<typename T, std::size_t T_ChunkBits>
+template<typename... T_Args>
+std::size_t ChunkedArray<T, T_ChunkBits>::emplace_back(T_Args&&... args) {
+
+    T** directory = m_directory.load(std::memory_order_relaxed);
+    if (m_size == m_chunkCount * chunkSize) {
+        if (m_chunkCount == m_directoryCapacity) {
+            m_directoryCapacity = (m_directoryCapacity == 0) ? 8 : m_directoryCapacity * 2;
+            m_directories.emplace_back(new T*[m_directoryCapacity]);
+            for (std::size_t i = 0; i < m_chunkCount; ++i) {
+                m_directories.back()[i] = directory[i];
+            }
+            directory = m_directories.back().get();
+            m_directory.store(directory, std::memory_order_release);
+        }
+        directory[m_chunkCount++] = std::allocator<T>().allocate(chunkSize);
+    }
+    new (directory[m_size >> T_ChunkBits] + (m_size & (chunkSize - 1))) T(std::forward<T_Args>(args)...);
+    return m_size++;
+}
+
+template<typename T, std::size_t T_ChunkBits>
+T& ChunkedArray<T, T_ChunkBits>::operator[](std::size_t index) {
+
+    return m_directory.load(std::memory_order_acquire)[index >> T_ChunkBits][index & (chunkSize - 1)];
+}
+
+template<typename T, std::size_t T_ChunkBits>
+const T& ChunkedArray<T, T_ChunkBits>::operator[](std::size_t index) const {
+
+    return m_directory.load(std::memory_order_acquire)[index >> T_ChunkBits][index & (chunkSize - 1)];
+}
+
+template<typename T, std::size_t T_ChunkBits>
+std::size_t ChunkedArray<T, T_ChunkBits>::size() const {
+
+    return m_size;
+}
+
+template<typename T, std::size_t T_ChunkBits>
+std::size_t ChunkedArray<T, T_ChunkBits>::chunkCount() const {
+
+    return m_chunkCount;
+}
+
+template<typename T, std::size_t T_ChunkBits>
+const T* ChunkedArray<T, T_ChunkBits>::chunk(std::size_t chunk) const {
+
+    return m_directory.load(std::memory_order_acquire)[chunk];
+}
+
+template<typename T, std::size_t T_ChunkBits>
+std::size_t ChunkedArray<T, T_ChunkBits>::chunkLength(std::size_t chunk) const {
+
+    std::size_t begin = chunk * chunkSize;
+    return (m_size - begin < chunkSize) ? (m_size - begin) : chunkSize;
+}
+
+#endif //H_CHUNKED_ARRAY
\ No newline at end of file
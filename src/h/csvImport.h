@@ -0,0 +1,184 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_CSV_IMPORT
+#define H_CSV_IMPORT
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <accountTypes.h>
+
+/*
+ * CSV import format. Every line is an account:
+ *
+ * person,<first name>,<last name>
+ * enterprise,<Y-tunnus>,<company name>
+ *
+ * An optional first line starting with "type," is a header and is skipped, as are the empty
+ * lines. Fields may be quoted with '"', a quote inside a quoted field being written twice.
+ * Lines may end with "\r\n".
+ */
+
+/**
+ * @brief A malformed line found by the CSV import.
+ */
+struct CsvImportError {
+    /** The line number, starting at 1. */
+    std::size_t line;
+    /** What is wrong with the line. */
+    std::string message;
+    /** The text of the line. */
+    std::string row;
+};
+
+/**
+ * @brief The outcome of a CSV import.
+ */
+struct CsvImportResult {
+    /** The id assigned to every account line, in the order of the file. Malformed lines get a
+     * default constructed id and an entry in errors, the enterprise lines whose Y-tunnus is
+     * taken a default constructed id only. */
+    std::vector<accountIdType> ids;
+    /** The malformed lines, in the order of the file. */
+    std::vector<CsvImportError> errors;
+    /** Whether the file could be read. */
+    bool fileRead = false;
+};
+
+/**
+ * @brief Parses the lines of a chunk of a CSV file into NewAccount rows.
+ *
+ * The fields are string views into the chunk, so parsing allocates no memory per field. The
+ * quoted fields with escaped quotes are unescaped in place, so the chunk must be writable and
+ * outlive the rows. A parser keeps its buffers between chunks.
+ */
+class CsvChunkParser {
+public:
+    /**
+     * @brief Construct a parser without rows.
+     *
+     */
+    CsvChunkParser();
+
+    /**
+     * @brief Parses the lines of a chunk, replacing the rows and errors of the previous one.
+     *
+     * @param begin The first character of the chunk, at the start of a line.
+     * @param end The end of the chunk. The last line may lack its line feed.
+     * @param firstLine The line number of the first line of the chunk in the file, starting at 1.
+     * @param skipHeader Whether the first line is skipped if it's a header.
+     */
+    void parse(char* begin, char* end, std::size_t firstLine, bool skipHeader);
+
+    /**
+     * @brief Returns the rows of the account lines, malformed ones included.
+     *
+     * @return const std::vector<NewAccount>& The rows.
+     */
+    const std::vector<NewAccount>& rows() const;
+
+    /**
+     * @brief Returns whether every row is well formed.
+     *
+     * @return const std::vector<char>& 1 for the well formed rows, 0 for the malformed ones.
+     */
+    const std::vector<char>& rowValid() const;
+
+    /**
+     * @brief Returns the malformed lines of the chunk.
+     *
+     * @return const std::vector<CsvImportError>& The errors.
+     */
+    const std::vector<CsvImportError>& errors() const;
+
+    /**
+     * @brief Returns the number of lines of the chunk, empty ones included.
+     *
+     * @return std::size_t The number of lines.
+     */
+    std::size_t lineCount() const;
+
+private:
+    bool parseLine(char* begin, char* end, NewAccount& row, const char*& error);
+    static char* parseField(char* begin, char* end, std::string_view& field, const char*& error);
+
+    std::vector<NewAccount> m_rows;
+    std::vector<char> m_rowValid;
+    std::vector<CsvImportError> m_errors;
+    std::size_t m_lineCount;
+};
+
+/**
+ * @brief Reads a CSV file, or any other line oriented file, in large blocks of complete lines.
+ */
+class CsvBlockReader {
+public:
+    /**
+     * @brief Opens a CSV file.
+     *
+     * @param path The path of the file.
+     * @param blockSize The approximate size of the blocks. Blocks grow to hold longer lines.
+     */
+    CsvBlockReader(const std::string& path, std::size_t blockSize);
+
+    /**
+     * @brief Reads an already open file, e.g. stdin. The file is not closed by the reader.
+     *
+     * @param file The file.
+     * @param blockSize The approximate size of the blocks. Blocks grow to hold longer lines.
+     */
+    CsvBlockReader(std::FILE* file, std::size_t blockSize);
+
+    CsvBlockReader(const CsvBlockReader&) = delete;
+    CsvBlockReader& operator=(const CsvBlockReader&) = delete;
+
+    ~CsvBlockReader();
+
+    /**
+     * @brief Returns whether the file was opened.
+     *
+     * @return true The file is open.
+     * @return false The file couldn't be opened.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Reads the next block. It ends at a line end, or at the end of the file.
+     * The previous block is overwritten.
+     *
+     * @param begin The first character of the block.
+     * @param end The end of the block.
+     * @return true A block was read.
+     * @return false The end of the file was reached.
+     */
+    bool next(char*& begin, char*& end);
+
+private:
+    std::FILE* m_file;
+    bool m_ownsFile;
+    std::vector<char> m_buffer;
+    std::size_t m_blockSize;
+    std::size_t m_carryBegin;
+    std::size_t m_carryEnd;
+    bool m_eof;
+};
+
+/**
+ * @brief Splits a block of lines into count chunks of about the same size, cut at line ends.
+ *
+ * @param begin The first character of the block.
+ * @param end The end of the block.
+ * @param count The number of chunks.
+ * @return std::vector<char*> The count + 1 limits of the chunks.
+ */
+std::vector<char*> splitCsvBlock(char* begin, char* end, std::size_t count);
+
+#endif //H_CSV_IMPORT
\ No newline at end of file
@@ -0,0 +1,364 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_DATA_ORIENTED_ACCOUNT_STORE
+#define H_DATA_ORIENTED_ACCOUNT_STORE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <accountDetails.h>
+#include <accountTypes.h>
+#include <balanceAggregates.h>
+#include <atomicBalance.h>
+#include <chunkedArray.h>
+#include <flatHashMap.h>
+#include <objectAccountStore.h>
+#include <prefetch.h>
+#include <visitor.h>
+
+/**
+ * @brief Account store with a data oriented (structure of arrays) layout.
+ * 
+ * Every account gets a slot number, its handle. The balances are kept in a dense array of
+ * AtomicBalance indexed by slot, the hot data, apart from the account kinds and the cold
+ * table with the ids and the names or Y-tunnus. The index maps an AccountId to its slot.
+ * Balance updates and aggregate scans only touch the balance array; the cold table is only
+ * read to render the account details.
+ * 
+ * The arrays are chunked, so growing them never moves an account. Like every account store,
+ * it holds the accounts of one shard of a BasicAccountMgr, which provides the locking.
+ */
+class DataOrientedAccountStore {
+public:
+    /** The slot of an account inside the store. */
+    typedef std::uint32_t Handle;
+
+    /**
+     * @brief Returns the handle meaning "no account".
+     * 
+     * @return Handle The invalid handle.
+     */
+    static Handle invalidHandle() { return UINT32_MAX; }
+
+    /** Whether findConcurrent() may run while another thread inserts, as the FlatHashMap index allows. */
+    static constexpr bool concurrentLookups = true;
+
+    /**
+     * @brief Construct an empty store.
+     * 
+     */
+    DataOrientedAccountStore();
+
+    /**
+     * @brief Finds an account.
+     * 
+     * @param id The id of the account.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdType& id) const;
+
+    /**
+     * @brief Finds an account whose hash was already computed.
+     * 
+     * @param id The id of the account.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdType& id, std::size_t hash) const;
+
+    /**
+     * @brief Finds an account by a view of its id, whose hash was already computed. Nothing
+     * is allocated and no AccountId is built.
+     * 
+     * @param id The view of the id of the account.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdViewType& id, std::size_t hash) const;
+
+    /**
+     * @brief Finds an account without the lock of the store, while another thread may be
+     * inserting into it, see FlatHashMap::findConcurrent(). The handle is only meaningful if
+     * no insertion ran meanwhile, which the caller must check. The index waits for
+     * RcuDomain::synchronize() before freeing the arrays it replaces, so the lookup must run
+     * in a RcuDomain::ReadSection.
+     * 
+     * @param id The id of the account, or a view of it.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it wasn't found.
+     */
+    Handle findConcurrent(const accountIdType& id, std::size_t hash) const;
+    Handle findConcurrent(const accountIdViewType& id, std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the index entries probed by a lookup of hash. See FlatHashMap::prefetch().
+     * 
+     * @param hash The hash of the id computed with AccountIdHashFunctor.
+     */
+    void prefetch(std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the index slots that may hold hash. See FlatHashMap::prefetchCandidates().
+     * 
+     * @param hash The hash of the id computed with AccountIdHashFunctor.
+     */
+    void prefetchCandidates(std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the balance of an account before it's updated.
+     * 
+     * @param handle The handle of the account.
+     */
+    void prefetchBalance(Handle handle) const;
+
+    /**
+     * @brief Inserts a new person account. The names are copied once, straight from the views.
+     * 
+     * @param id The id of the account. It must not be in the store.
+     * @param firstName The first name of the account's owner.
+     * @param lastName The last name of the account's owner.
+     * @return Handle The handle of the new account.
+     */
+    Handle insertPersonAccount(const accountIdType& id, std::string_view firstName, std::string_view lastName);
+
+    /**
+     * @brief Inserts a new enterprise account. The names are copied once, straight from the views.
+     * 
+     * @param id The id of the account. It must not be in the store.
+     * @param yTunnus The Y-tunnus identifier of the enterprise.
+     * @param companyName The enterprise name.
+     * @return Handle The handle of the new account.
+     */
+    Handle insertEnterpriseAccount(const accountIdType& id, std::string_view yTunnus, std::string_view companyName);
+
+    /**
+     * @brief Returns the id of an account. The reference is valid as long as the store lives.
+     * 
+     * @param handle The handle of the account.
+     * @return const accountIdType& The id.
+     */
+    const accountIdType& id(Handle handle) const;
+
+    /**
+     * @brief Returns the kind of an account.
+     * 
+     * @param handle The handle of the account.
+     * @return AccountKind The kind.
+     */
+    AccountKind kind(Handle handle) const;
+
+    /**
+     * @brief Adds money to an account.
+     * 
+     * @param handle The handle of the account.
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was added.
+     * @return false The amount is a negative number, or the balance would exceed INT_MAX.
+     */
+    bool addToBalance(Handle handle, int amount);
+
+    /**
+     * @brief Decreases money from an account.
+     * 
+     * @param handle The handle of the account.
+     * @param amount The amount of money to decrease. It must be > 0 and less than the balance.
+     * @return true The amount was decreased.
+     * @return false The amount is a negative number or is larger than the balance.
+     */
+    bool decreaseFromBalance(Handle handle, int amount);
+
+    /**
+     * @brief Returns the balance of an account.
+     * 
+     * @param handle The handle of the account.
+     * @return int The balance.
+     */
+    int balance(Handle handle) const;
+
+    /**
+     * @brief Makes the balance of an account hot. See AtomicBalance::makeHot().
+     * 
+     * @param handle The handle of the account.
+     * @return true The balance is hot.
+     * @return false The pool of striped balances is full.
+     */
+    bool makeBalanceHot(Handle handle);
+
+    /**
+     * @brief Returns whether the balance of an account is hot.
+     * 
+     * @param handle The handle of the account.
+     * @return true The balance is hot.
+     * @return false The balance is a single integer.
+     */
+    bool balanceHot(Handle handle) const;
+
+    /**
+     * @brief Makes the visitor visit an account. The visitor gets a temporary PersonAccount or
+     * EnterpriseAccount built from the columns of the account.
+     * 
+     * @param handle The handle of the account.
+     * @param visitor The visitor.
+     */
+    void accept(Handle handle, Visitor<AccountId_IdPartType>* visitor) const;
+
+    /**
+     * @brief Returns the details of an account as shown to the user. They're rendered with an
+     * AccountDetailsVisitor, see accept().
+     * 
+     * @param handle The handle of the account.
+     * @return std::string The details.
+     */
+    std::string accountDetails(Handle handle) const;
+
+    /**
+     * @brief Formats the details of an account into an output iterator of char, without
+     * allocating memory. See AccountDetailsWriter.
+     * 
+     * @param handle The handle of the account.
+     * @param out The output iterator.
+     * @param format The format.
+     * @return T_OutputIt The output iterator past the written chars.
+     */
+    template<typename T_OutputIt>
+    T_OutputIt renderAccountDetails(Handle handle, T_OutputIt out, AccountDetailsFormat format) const;
+
+    /**
+     * @brief Returns the number of accounts in the store.
+     * 
+     * @return std::size_t The number of accounts.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Returns the number of slots of the hash index of the store, whose load factor
+     * is size() / indexCapacity().
+     * 
+     * @return std::size_t The number of slots.
+     */
+    std::size_t indexCapacity() const;
+
+    /**
+     * @brief Returns the sum of the balances of all the accounts. It only scans the balance array.
+     * 
+     * @return std::int64_t The sum of the balances.
+     */
+    std::int64_t totalBalance() const;
+
+    /**
+     * @brief Reserves room for count accounts in the index, so inserting them doesn't rehash it.
+     * 
+     * @param count The number of accounts.
+     */
+    void reserve(std::size_t count);
+
+    /**
+     * @brief Calls function for every account, in no particular order, with the arguments
+     * (const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance),
+     * name and secondName being the first and last name or the Y-tunnus and the company name.
+     * 
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void forEachAccount(T_Function function) const;
+
+    /**
+     * @brief Calls function for an account with the arguments of forEachAccount().
+     * 
+     * @param handle The handle of the account.
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void exportAccount(Handle handle, T_Function function) const;
+
+    /**
+     * @brief Calls function with blocks of up to balanceBlockSize balances of the accounts
+     * passing filter, in no particular order, with the arguments
+     * (const int* balances, const Handle* handles, std::size_t count). Only the balance and kind
+     * arrays are read.
+     * 
+     * @param filter The accounts scanned.
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void forEachBalanceBlock(AccountFilter filter, T_Function function) const;
+
+    /**
+     * @brief Returns the allocation statistics of the accounts.
+     * 
+     * @return AccountAllocationStats The statistics.
+     */
+    AccountAllocationStats allocationStats() const;
+
+private:
+    /** The cold data of an account: the first and last name or the Y-tunnus and the company name. */
+    struct ColdRecord {
+        ColdRecord(const accountIdType& id, std::string_view name, std::string_view secondName);
+
+        accountIdType m_id;
+        std::string m_name;
+        std::string m_secondName;
+    };
+
+    typedef FlatHashMap<accountIdType, Handle, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > Index;
+
+    Handle insertAccount(const accountIdType& id, AccountKind kind, std::string_view name, std::string_view secondName);
+
+    Index m_index;
+    ChunkedArray<AtomicBalance> m_balances;
+    ChunkedArray<AccountKind> m_kinds;
+    ChunkedArray<ColdRecord> m_cold;
+    std::size_t m_personCount;
+};
+
+//IMPLEMENTATION
+template<typename T_OutputIt>
+T_OutputIt DataOrientedAccountStore::renderAccountDetails(Handle handle, T_OutputIt out, AccountDetailsFormat format) const {
+
+    const ColdRecord& cold = m_cold[handle];
+    return AccountDetailsWriter::write(out, format, m_kinds[handle], cold.m_id, cold.m_name, cold.m_secondName, m_balances[handle].value());
+}
+
+template<typename T_Function>
+void DataOrientedAccountStore::exportAccount(Handle handle, T_Function function) const {
+
+    const ColdRecord& cold = m_cold[handle];
+    function(cold.m_id, m_kinds[handle], cold.m_name, cold.m_secondName, m_balances[handle].value());
+}
+
+template<typename T_Function>
+void DataOrientedAccountStore::forEachAccount(T_Function function) const {
+
+    for (std::size_t i = 0; i < m_cold.size(); ++i) {
+        exportAccount(static_cast<Handle>(i), function);
+    }
+}
+
+template<typename T_Function>
+void DataOrientedAccountStore::forEachBalanceBlock(AccountFilter filter, T_Function function) const {
+
+    BalanceBlockBuffer<Handle, T_Function> buffer(function);
+    for (std::size_t c = 0; c < m_balances.chunkCount(); ++c) {
+        const AtomicBalance* balances = m_balances.chunk(c);
+        const AccountKind* kinds = m_kinds.chunk(c);
+        const std::size_t length = m_balances.chunkLength(c);
+        const Handle first = static_cast<Handle>(c * ChunkedArray<AtomicBalance>::chunkSize);
+        if (filter == AccountFilter::All) {
+            buffer.pushConsecutive(balances, first, length);
+            continue;
+        }
+        for (std::size_t i = 0; i < length; ++i) {
+            buffer.pushIf(matchesFilter(filter, kinds[i]), balances[i].value(), first + static_cast<Handle>(i));
+        }
+    }
+    buffer.flush();
+}
+
+#endif //H_DATA_ORIENTED_ACCOUNT_STORE
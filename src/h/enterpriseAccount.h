@@ -9,6 +9,7 @@ LICENSE file in the root directory of this source tree.
 #define H_ENTERPRISEACCOUNT
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include <account.h>
@@ -43,14 +44,14 @@ public:
      * 
      * @param _yTunnus The Y-tunnus.
      */
-    void setYTunnus(const std::string& _yTunnus);
+    void setYTunnus(std::string_view _yTunnus);
 
     /**
      * @brief Sets the Company Name of the account's owner.
      * 
      * @param _companyName The Company Name.
      */
-    void setCompanyName(const std::string& _companyName);
+    void setCompanyName(std::string_view _companyName);
 
     /**
      * @brief Returns the Y-tunnus.
@@ -117,13 +118,13 @@ EnterpriseAccount<T_Id>& EnterpriseAccount<T_Id>::operator=(const EnterpriseAcco
 }
 
 template <typename T_Id>
-void EnterpriseAccount<T_Id>::setYTunnus(const std::string& _yTunnus) {
+void EnterpriseAccount<T_Id>::setYTunnus(std::string_view _yTunnus) {
 
     m_yTunnus = _yTunnus;
 }
 
 template <typename T_Id>
-void EnterpriseAccount<T_Id>::setCompanyName(const std::string& _companyName) {
+void EnterpriseAccount<T_Id>::setCompanyName(std::string_view _companyName) {
 
     m_companyName = _companyName;
 }
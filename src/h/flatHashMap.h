@@ -0,0 +1,829 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_FLAT_HASH_MAP
+#define H_FLAT_HASH_MAP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <prefetch.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2
+#endif
+
+/**
+ * @brief An open addressing hash map in the style of SwissTable.
+ *
+ * The elements are stored inline in a single array of slots, next to an array of one control
+ * byte per slot. A control byte is either empty, deleted, or the low 7 bits of the hash of the
+ * element in the slot. Slots are probed in groups of 16: the 16 control bytes of a group are
+ * compared at once with SSE2 (with a portable fallback) and only the slots whose byte matches
+ * are compared with the key, so a lookup usually touches one control group and one slot.
+ *
+ * The interface is the subset of std::unordered_map used by the application. As in any open
+ * addressing table, inserting may move the elements, so iterators and references to elements
+ * are invalidated by insertions.
+ *
+ * findConcurrent() looks up a key while another thread inserts, for readers that validate
+ * what they read afterwards, e.g. with a SeqLock. The arrays are published with their
+ * capacity in a single pointer, and a map given a grace period function doesn't free the
+ * arrays it replaces until the readers are done with them.
+ *
+ * @tparam T_Key The key type.
+ * @tparam T_Value The mapped type.
+ * @tparam T_Hash The hash functor. Its low bits must be well distributed.
+ * @tparam T_Equal The key equality functor.
+ */
+template<typename T_Key, typename T_Value, typename T_Hash = std::hash<T_Key>, typename T_Equal = std::equal_to<T_Key> >
+class FlatHashMap {
+public:
+    typedef T_Key key_type;
+    typedef T_Value mapped_type;
+    typedef std::pair<const T_Key, T_Value> value_type;
+    typedef std::size_t size_type;
+
+    /** The map can be looked up while another thread inserts, see findConcurrent(). */
+    static constexpr bool concurrentLookups = true;
+
+    template<bool T_Const>
+    class Iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename FlatHashMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<T_Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<T_Const, const value_type&, value_type&>::type reference;
+
+        Iterator() : m_ctrl(nullptr), m_ctrlEnd(nullptr), m_slot(nullptr) {}
+        Iterator(const Iterator<false>& other) : m_ctrl(other.m_ctrl), m_ctrlEnd(other.m_ctrlEnd), m_slot(other.m_slot) {}
+
+        reference operator*() const { return *m_slot; }
+        pointer operator->() const { return m_slot; }
+        Iterator& operator++() { ++m_ctrl; ++m_slot; skipFree(); return *this; }
+        Iterator operator++(int) { Iterator tmp(*this); ++(*this); return tmp; }
+        bool operator==(const Iterator& rhs) const { return m_slot == rhs.m_slot; }
+        bool operator!=(const Iterator& rhs) const { return m_slot != rhs.m_slot; }
+
+    private:
+        friend class FlatHashMap;
+        template<bool> friend class Iterator;
+
+        Iterator(const std::int8_t* ctrl, const std::int8_t* ctrlEnd, value_type* slot) :
+            m_ctrl(ctrl), m_ctrlEnd(ctrlEnd), m_slot(slot)
+        {}
+
+        void skipFree() {
+            while ((m_ctrl != m_ctrlEnd) && (*m_ctrl < 0)) {
+                ++m_ctrl;
+                ++m_slot;
+            }
+        }
+
+        const std::int8_t* m_ctrl;
+        const std::int8_t* m_ctrlEnd;
+        value_type* m_slot;
+    };
+
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    /**
+     * @brief Construct an empty map. It doesn't allocate memory.
+     *
+     */
+    FlatHashMap();
+
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    /**
+     * @brief Move constructor. other is left empty.
+     *
+     * @param other The map to move the elements from.
+     */
+    FlatHashMap(FlatHashMap&& other) noexcept;
+
+    /**
+     * @brief Move assignment. rhs is left empty.
+     *
+     * @param rhs The map to move the elements from.
+     * @return FlatHashMap& This object.
+     */
+    FlatHashMap& operator=(FlatHashMap&& rhs) noexcept;
+
+    ~FlatHashMap();
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /**
+     * @brief Returns the number of elements.
+     *
+     * @return size_type The number of elements.
+     */
+    size_type size() const;
+
+    /**
+     * @brief Returns whether the map has no elements.
+     *
+     * @return true The map is empty.
+     * @return false The map has elements.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Returns the number of slots. It's 0 or a power of 2.
+     *
+     * @return size_type The number of slots.
+     */
+    size_type capacity() const;
+
+    /**
+     * @brief Returns the ratio between the elements and the slots.
+     *
+     * @return float The load factor.
+     */
+    float load_factor() const;
+
+    /**
+     * @brief Finds the element with the given key.
+     *
+     * @param key The key to find.
+     * @return iterator The element or end() if not found.
+     */
+    iterator find(const T_Key& key);
+    const_iterator find(const T_Key& key) const;
+
+    /**
+     * @brief Finds the element with the given key, whose hash was already computed.
+     *
+     * @param key The key to find.
+     * @param hash The hash of key, as returned by hash().
+     * @return iterator The element or end() if not found.
+     */
+    iterator find(const T_Key& key, size_type hash);
+    const_iterator find(const T_Key& key, size_type hash) const;
+
+    /**
+     * @brief Finds the element whose key is equal to a key of another type, e.g. a view of a
+     * key that is cheaper to build. Only available if T_Hash and T_Equal are transparent, i.e.
+     * they declare is_transparent and accept T_LookupKey, hashing it like the equal key.
+     *
+     * @param key The key to find.
+     * @return iterator The element or end() if not found.
+     */
+    template<typename T_LookupKey, typename T_H = T_Hash, typename T_E = T_Equal, typename = typename T_H::is_transparent, typename = typename T_E::is_transparent>
+    iterator find(const T_LookupKey& key);
+    template<typename T_LookupKey, typename T_H = T_Hash, typename T_E = T_Equal, typename = typename T_H::is_transparent, typename = typename T_E::is_transparent>
+    const_iterator find(const T_LookupKey& key) const;
+
+    /**
+     * @brief Finds the element whose key is equal to a key of another type, whose hash was
+     * already computed. See the other overloads.
+     *
+     * @param key The key to find.
+     * @param hash The hash of key computed with T_Hash.
+     * @return iterator The element or end() if not found.
+     */
+    template<typename T_LookupKey, typename T_H = T_Hash, typename T_E = T_Equal, typename = typename T_H::is_transparent, typename = typename T_E::is_transparent>
+    iterator find(const T_LookupKey& key, size_type hash);
+    template<typename T_LookupKey, typename T_H = T_Hash, typename T_E = T_Equal, typename = typename T_H::is_transparent, typename = typename T_E::is_transparent>
+    const_iterator find(const T_LookupKey& key, size_type hash) const;
+
+    /**
+     * @brief Looks up a key while another thread may be inserting, and copies its value. The
+     * result is only meaningful if no insertion ran meanwhile, which the caller must check.
+     * Memory is only safe to read if the keys and values are trivially copyable, and a reader
+     * running while the map grows must be covered by its grace period function.
+     *
+     * @param key The key to find, or a key of another type with transparent T_Hash and T_Equal.
+     * @param hash The hash of key, as returned by hash().
+     * @param value Receives a copy of the mapped value, if found.
+     * @return true The key was found.
+     * @return false The key wasn't found.
+     */
+    template<typename T_LookupKey>
+    bool findConcurrent(const T_LookupKey& key, size_type hash, T_Value& value) const;
+
+    /**
+     * @brief Sets a function called when the map grows, after it moved to the new arrays and
+     * before it frees the old ones, e.g. RcuDomain::synchronize() to let the readers of
+     * findConcurrent() finish with them.
+     *
+     * @param gracePeriod The function, nullptr to free the old arrays right away.
+     */
+    void setGracePeriod(void (*gracePeriod)());
+
+    /**
+     * @brief Returns the hash of a key, as computed by the map.
+     *
+     * @param key The key.
+     * @return size_type The hash.
+     */
+    size_type hash(const T_Key& key) const;
+
+    /**
+     * @brief Prefetches the first control group probed by a lookup of the given hash. Looking
+     * up a batch of keys is faster when the groups of the next keys are prefetched while the
+     * current one is looked up.
+     *
+     * @param hash The hash of the key, as returned by hash().
+     */
+    void prefetch(size_type hash) const;
+
+    /**
+     * @brief Prefetches the slots of the first control group of the given hash that may hold
+     * the key, i.e. whose control byte matches. Call it once the control group has arrived,
+     * some time after prefetch().
+     *
+     * @param hash The hash of the key, as returned by hash().
+     */
+    void prefetchCandidates(size_type hash) const;
+
+    /**
+     * @brief Inserts an element constructed from args if the key is not in the map.
+     *
+     * @param key The key of the element.
+     * @param args The arguments to construct the mapped value.
+     * @return std::pair<iterator, bool> The element with the key and whether it was inserted.
+     */
+    template<typename... T_Args>
+    std::pair<iterator, bool> try_emplace(const T_Key& key, T_Args&&... args);
+
+    /**
+     * @brief Inserts value if its key is not in the map.
+     *
+     * @param value The element to insert.
+     * @return std::pair<iterator, bool> The element with the key and whether it was inserted.
+     */
+    std::pair<iterator, bool> insert(value_type&& value);
+
+    /**
+     * @brief Returns the value mapped to key, inserting a default constructed one if the key
+     * is not in the map.
+     *
+     * @param key The key.
+     * @return T_Value& The mapped value.
+     */
+    T_Value& operator[](const T_Key& key);
+
+    /**
+     * @brief Removes the element with the given key.
+     *
+     * @param key The key.
+     * @return size_type The number of removed elements, 0 or 1.
+     */
+    size_type erase(const T_Key& key);
+
+    /**
+     * @brief Allocates enough slots to hold count elements without rehashing.
+     *
+     * @param count The number of elements.
+     */
+    void reserve(size_type count);
+
+    /**
+     * @brief Removes all the elements. The slots are kept.
+     *
+     */
+    void clear();
+
+private:
+    /** Stored in front of the control bytes, so a reader gets them and the slots at once. */
+    struct TableHeader {
+        value_type* m_slots;
+        size_type m_capacity;
+    };
+
+    static constexpr std::int8_t ctrlEmpty = -128;
+    static constexpr std::int8_t ctrlDeleted = -2;
+    static constexpr size_type groupWidth = 16;
+    static constexpr size_type headerSize = 16;
+    static_assert(sizeof(TableHeader) <= headerSize, "The table header doesn't fit");
+
+    static std::uint32_t matchByte(const std::int8_t* group, std::int8_t value);
+    static std::uint32_t matchFree(const std::int8_t* group);
+    static size_type maxLoad(size_type capacity);
+    static std::uint32_t lowestBit(std::uint32_t mask);
+    static std::int8_t* allocateCtrl(size_type capacity, value_type* slots);
+    static void freeCtrl(std::int8_t* ctrl);
+
+    template<typename T_LookupKey>
+    size_type findIndex(const T_LookupKey& key, size_type hash) const;
+    size_type findFreeIndex(size_type hash) const;
+    void rehash(size_type newCapacity);
+    void destroyAll();
+    void release();
+    iterator iteratorAt(size_type index);
+    const_iterator iteratorAt(size_type index) const;
+
+    std::int8_t* m_ctrl;
+    value_type* m_slots;
+    size_type m_capacity;
+    size_type m_size;
+    size_type m_growthLeft;
+    /** m_ctrl, once its header is written, for findConcurrent(). */
+    std::atomic<const std::int8_t*> m_published;
+    void (*m_gracePeriod)();
+    T_Hash m_hash;
+    T_Equal m_equal;
+};
+
+//IMPLEMENTATION
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::FlatHashMap() :
+    m_ctrl(nullptr),
+    m_slots(nullptr),
+    m_capacity(0),
+    m_size(0),
+    m_growthLeft(0),
+    m_published(nullptr),
+    m_gracePeriod(nullptr),
+    m_hash(),
+    m_equal()
+{}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::FlatHashMap(FlatHashMap&& other) noexcept :
+    m_ctrl(other.m_ctrl),
+    m_slots(other.m_slots),
+    m_capacity(other.m_capacity),
+    m_size(other.m_size),
+    m_growthLeft(other.m_growthLeft),
+    m_published(other.m_published.load(std::memory_order_relaxed)),
+    m_gracePeriod(other.m_gracePeriod),
+    m_hash(std::move(other.m_hash)),
+    m_equal(std::move(other.m_equal))
+{
+    other.m_ctrl = nullptr;
+    other.m_slots = nullptr;
+    other.m_capacity = 0;
+    other.m_size = 0;
+    other.m_growthLeft = 0;
+    other.m_published.store(nullptr, std::memory_order_relaxed);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>& FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::operator=(FlatHashMap&& rhs) noexcept {
+
+    if (this != &rhs) {
+        release();
+        m_ctrl = rhs.m_ctrl;
+        m_slots = rhs.m_slots;
+        m_capacity = rhs.m_capacity;
+        m_size = rhs.m_size;
+        m_growthLeft = rhs.m_growthLeft;
+        m_published.store(rhs.m_published.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_gracePeriod = rhs.m_gracePeriod;
+        m_hash = std::move(rhs.m_hash);
+        m_equal = std::move(rhs.m_equal);
+        rhs.m_ctrl = nullptr;
+        rhs.m_slots = nullptr;
+        rhs.m_capacity = 0;
+        rhs.m_size = 0;
+        rhs.m_growthLeft = 0;
+        rhs.m_published.store(nullptr, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::~FlatHashMap() {
+
+    release();
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::begin() {
+
+    iterator it(m_ctrl, m_ctrl + m_capacity, m_slots);
+    it.skipFree();
+    return it;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::end() {
+
+    return iteratorAt(m_capacity);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::begin() const {
+
+    return const_cast<FlatHashMap*>(this)->begin();
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::end() const {
+
+    return iteratorAt(m_capacity);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size() const {
+
+    return m_size;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+bool FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::empty() const {
+
+    return m_size == 0;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::capacity() const {
+
+    return m_capacity;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+float FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::load_factor() const {
+
+    return (m_capacity == 0) ? 0.0f : static_cast<float>(m_size) / static_cast<float>(m_capacity);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_Key& key) {
+
+    return iteratorAt(findIndex(key, m_hash(key)));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_Key& key) const {
+
+    return iteratorAt(findIndex(key, m_hash(key)));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_Key& key, size_type hash) {
+
+    return iteratorAt(findIndex(key, hash));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_Key& key, size_type hash) const {
+
+    return iteratorAt(findIndex(key, hash));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey, typename T_H, typename T_E, typename, typename>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_LookupKey& key) {
+
+    return iteratorAt(findIndex(key, m_hash(key)));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey, typename T_H, typename T_E, typename, typename>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_LookupKey& key) const {
+
+    return iteratorAt(findIndex(key, m_hash(key)));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey, typename T_H, typename T_E, typename, typename>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_LookupKey& key, size_type hash) {
+
+    return iteratorAt(findIndex(key, hash));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey, typename T_H, typename T_E, typename, typename>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_LookupKey& key, size_type hash) const {
+
+    return iteratorAt(findIndex(key, hash));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey>
+bool FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::findConcurrent(const T_LookupKey& key, size_type hash, T_Value& value) const {
+
+    //The control bytes and their header are read through one pointer, so the capacity always
+    //matches the arrays. Slots being written may be read half done: the caller validates.
+    const std::int8_t* ctrlBase = m_published.load(std::memory_order_acquire);
+    if (ctrlBase == nullptr) return false;
+
+    const TableHeader* table = reinterpret_cast<const TableHeader*>(ctrlBase - headerSize);
+    const value_type* slots = table->m_slots;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash & 0x7F);
+    const size_type groupMask = table->m_capacity / groupWidth - 1;
+    size_type group = (hash >> 7) & groupMask;
+    for (size_type probe = 1; probe <= groupMask + 1; ++probe) {
+        const std::int8_t* ctrl = ctrlBase + group * groupWidth;
+        for (std::uint32_t mask = matchByte(ctrl, h2); mask != 0; mask &= mask - 1) {
+            size_type index = group * groupWidth + lowestBit(mask);
+            if (m_equal(slots[index].first, key)) {
+                value = slots[index].second;
+                return true;
+            }
+        }
+        if (matchByte(ctrl, ctrlEmpty) != 0) {
+            break;
+        }
+        group = (group + probe) & groupMask;
+    }
+    return false;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::setGracePeriod(void (*gracePeriod)()) {
+
+    m_gracePeriod = gracePeriod;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::hash(const T_Key& key) const {
+
+    return m_hash(key);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::prefetch(size_type hash) const {
+
+    if (m_capacity == 0) return;
+
+    const size_type groupMask = m_capacity / groupWidth - 1;
+    prefetchForRead(m_ctrl + ((hash >> 7) & groupMask) * groupWidth);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::prefetchCandidates(size_type hash) const {
+
+    if (m_capacity == 0) return;
+
+    const size_type groupMask = m_capacity / groupWidth - 1;
+    const size_type group = (hash >> 7) & groupMask;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash & 0x7F);
+    for (std::uint32_t mask = matchByte(m_ctrl + group * groupWidth, h2); mask != 0; mask &= mask - 1) {
+        prefetchForRead(m_slots + group * groupWidth + lowestBit(mask));
+    }
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename... T_Args>
+std::pair<typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator, bool> FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::try_emplace(const T_Key& key, T_Args&&... args) {
+
+    size_type hash = m_hash(key);
+    size_type index = findIndex(key, hash);
+    if (index != m_capacity) {
+        return std::make_pair(iteratorAt(index), false);
+    }
+
+    if (m_growthLeft == 0) {
+        rehash((m_size + 1 > maxLoad(m_capacity) / 2) ? ((m_capacity == 0) ? groupWidth : m_capacity * 2) : m_capacity);
+    }
+
+    index = findFreeIndex(hash);
+    new (m_slots + index) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<T_Args>(args)...));
+    if (m_ctrl[index] == ctrlEmpty) {
+        --m_growthLeft;
+    }
+    m_ctrl[index] = static_cast<std::int8_t>(hash & 0x7F);
+    ++m_size;
+
+    return std::make_pair(iteratorAt(index), true);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+std::pair<typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator, bool> FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::insert(value_type&& value) {
+
+    return try_emplace(value.first, std::move(value.second));
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+T_Value& FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::operator[](const T_Key& key) {
+
+    return try_emplace(key).first->second;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::erase(const T_Key& key) {
+
+    size_type index = findIndex(key, m_hash(key));
+    if (index == m_capacity) return 0;
+
+    m_slots[index].~value_type();
+    m_ctrl[index] = ctrlDeleted;
+    --m_size;
+    return 1;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::reserve(size_type count) {
+
+    size_type newCapacity = groupWidth;
+    while (maxLoad(newCapacity) < count) {
+        newCapacity *= 2;
+    }
+    if (newCapacity > m_capacity) {
+        rehash(newCapacity);
+    }
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::clear() {
+
+    destroyAll();
+    for (size_type i = 0; i < m_capacity; ++i) {
+        m_ctrl[i] = ctrlEmpty;
+    }
+    m_size = 0;
+    m_growthLeft = maxLoad(m_capacity);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+std::uint32_t FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::matchByte(const std::int8_t* group, std::int8_t value) {
+
+#ifdef FLAT_HASH_MAP_SSE2
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+#else
+    std::uint32_t mask = 0;
+    for (size_type i = 0; i < groupWidth; ++i) {
+        mask |= static_cast<std::uint32_t>(group[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+std::uint32_t FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::matchFree(const std::int8_t* group) {
+
+    //Empty and deleted are the only control bytes with the sign bit set.
+#ifdef FLAT_HASH_MAP_SSE2
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+    std::uint32_t mask = 0;
+    for (size_type i = 0; i < groupWidth; ++i) {
+        mask |= static_cast<std::uint32_t>(group[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::maxLoad(size_type capacity) {
+
+    return capacity - capacity / 8;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+std::uint32_t FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::lowestBit(std::uint32_t mask) {
+
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::uint32_t>(__builtin_ctz(mask));
+#else
+    std::uint32_t bit = 0;
+    while ((mask & 1u) == 0) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+std::int8_t* FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::allocateCtrl(size_type capacity, value_type* slots) {
+
+    std::int8_t* base = new std::int8_t[headerSize + capacity];
+    new (base) TableHeader{slots, capacity};
+    return base + headerSize;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::freeCtrl(std::int8_t* ctrl) {
+
+    delete[] (ctrl - headerSize);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::findIndex(const T_LookupKey& key, size_type hash) const {
+
+    if (m_capacity == 0) return m_capacity;
+
+    const std::int8_t h2 = static_cast<std::int8_t>(hash & 0x7F);
+    const size_type groupMask = m_capacity / groupWidth - 1;
+    size_type group = (hash >> 7) & groupMask;
+    for (size_type probe = 1; probe <= groupMask + 1; ++probe) {
+        const std::int8_t* ctrl = m_ctrl + group * groupWidth;
+        for (std::uint32_t mask = matchByte(ctrl, h2); mask != 0; mask &= mask - 1) {
+            size_type index = group * groupWidth + lowestBit(mask);
+            if (m_equal(m_slots[index].first, key)) {
+                return index;
+            }
+        }
+        if (matchByte(ctrl, ctrlEmpty) != 0) {
+            break;
+        }
+        group = (group + probe) & groupMask;
+    }
+    return m_capacity;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::size_type FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::findFreeIndex(size_type hash) const {
+
+    //The load factor bound guarantees a free slot in the probe sequence.
+    const size_type groupMask = m_capacity / groupWidth - 1;
+    size_type group = (hash >> 7) & groupMask;
+    for (size_type probe = 1; ; ++probe) {
+        std::uint32_t mask = matchFree(m_ctrl + group * groupWidth);
+        if (mask != 0) {
+            return group * groupWidth + lowestBit(mask);
+        }
+        group = (group + probe) & groupMask;
+    }
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::rehash(size_type newCapacity) {
+
+    std::int8_t* oldCtrl = m_ctrl;
+    value_type* oldSlots = m_slots;
+    size_type oldCapacity = m_capacity;
+
+    m_slots = std::allocator<value_type>().allocate(newCapacity);
+    m_ctrl = allocateCtrl(newCapacity, m_slots);
+    m_capacity = newCapacity;
+    for (size_type i = 0; i < newCapacity; ++i) {
+        m_ctrl[i] = ctrlEmpty;
+    }
+
+    for (size_type i = 0; i < oldCapacity; ++i) {
+        if (oldCtrl[i] >= 0) {
+            size_type hash = m_hash(oldSlots[i].first);
+            size_type index = findFreeIndex(hash);
+            new (m_slots + index) value_type(std::move(oldSlots[i]));
+            m_ctrl[index] = static_cast<std::int8_t>(hash & 0x7F);
+            oldSlots[i].~value_type();
+        }
+    }
+    m_growthLeft = maxLoad(m_capacity) - m_size;
+    m_published.store(m_ctrl, std::memory_order_release);
+
+    if (oldCapacity != 0) {
+        if (m_gracePeriod != nullptr) {
+            m_gracePeriod();
+        }
+        std::allocator<value_type>().deallocate(oldSlots, oldCapacity);
+        freeCtrl(oldCtrl);
+    }
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::destroyAll() {
+
+    for (size_type i = 0; i < m_capacity; ++i) {
+        if (m_ctrl[i] >= 0) {
+            m_slots[i].~value_type();
+        }
+    }
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+void FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::release() {
+
+    if (m_capacity != 0) {
+        destroyAll();
+        std::allocator<value_type>().deallocate(m_slots, m_capacity);
+        freeCtrl(m_ctrl);
+    }
+    m_published.store(nullptr, std::memory_order_relaxed);
+    m_ctrl = nullptr;
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_size = 0;
+    m_growthLeft = 0;
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iteratorAt(size_type index) {
+
+    return iterator(m_ctrl + index, m_ctrl + m_capacity, m_slots + index);
+}
+
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+typename FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator FlatHashMap<T_Key, T_Value, T_Hash, T_Equal>::iteratorAt(size_type index) const {
+
+    return const_iterator(m_ctrl + index, m_ctrl + m_capacity, m_slots + index);
+}
+
+#endif //H_FLAT_HASH_MAP
\ No newline at end of file
@@ -0,0 +1,256 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_JOURNAL
+#define H_JOURNAL
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <accountTypes.h>
+
+/**
+ * @brief The types of the records of a Journal.
+ */
+enum class JournalRecordType : std::uint8_t {
+    /** A person account was created. */
+    PersonAccount = 1,
+    /** An enterprise account was created. */
+    EnterpriseAccount = 2,
+    /** The balance of an account changed by a signed amount. */
+    BalanceChange = 3,
+    /** An amount was moved between two accounts. */
+    Transfer = 4
+};
+
+/**
+ * @brief A record read from a journal file. The meaning of the fields depends on the type.
+ */
+struct JournalRecord {
+    JournalRecordType type;
+    /** The account created or changed, or the source of a transfer. */
+    accountIdType id;
+    /** The destination of a transfer. */
+    accountIdType toId;
+    /** The signed amount of a balance change or the amount of a transfer. */
+    int amount;
+    /** The first name or the Y-tunnus of a created account. */
+    std::string name;
+    /** The last name or the company name of a created account. */
+    std::string secondName;
+};
+
+/**
+ * @brief Reads the records of a journal file in order.
+ *
+ * Every record is framed by its length and a checksum. Reading stops at the end of the file
+ * or at the first incomplete or corrupt record, i.e. the tail torn by a crash in the middle
+ * of a write; validLength() tells where the good records end.
+ */
+class JournalReader {
+public:
+    /**
+     * @brief Opens a journal file for reading. A file that doesn't exist reads as an empty journal.
+     *
+     * @param path The path of the file.
+     */
+    explicit JournalReader(const std::string& path);
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    ~JournalReader();
+
+    /**
+     * @brief Reads the next record.
+     *
+     * @param record The record read.
+     * @return true A record was read.
+     * @return false There are no more valid records.
+     */
+    bool next(JournalRecord& record);
+
+    /**
+     * @brief Returns the length in bytes of the valid records read so far.
+     *
+     * @return std::uint64_t The length.
+     */
+    std::uint64_t validLength() const;
+
+private:
+    std::FILE* m_file;
+    std::vector<char> m_payload;
+    std::uint64_t m_validLength;
+};
+
+/**
+ * @brief Configuration of a Journal.
+ */
+struct JournalOptions {
+    /** How long the writer waits for more records before writing a batch. 0 writes as soon as
+     * the previous write finished: the records logged meanwhile already form a batch. */
+    std::chrono::microseconds maxDelay = std::chrono::microseconds(0);
+    /** A batch is written without waiting the delay once it reaches this size. */
+    std::size_t maxBatchBytes = 1 << 20;
+    /** Whether every batch is flushed to the disk. Without it the records survive a crash of
+     * the process, but not of the system. */
+    bool syncToDisk = true;
+};
+
+/**
+ * @brief Statistics of a Journal.
+ */
+struct JournalStats {
+    /** Records logged. */
+    std::uint64_t records = 0;
+    /** Batches written, each with a single write and flush to the disk. */
+    std::uint64_t batches = 0;
+    /** Bytes written. */
+    std::uint64_t bytes = 0;
+};
+
+/**
+ * @brief The outcome of replaying a journal, see BasicAccountMgr::replayJournal().
+ */
+struct JournalReplayStats {
+    /** Records replayed. */
+    std::size_t records = 0;
+    /** Accounts whose balance changes add up to a negative balance, which the journal of a
+     * run can't hold: some of their changes are missing. Their balance is left at 0. */
+    std::vector<accountIdType> negativeBalances;
+};
+
+/**
+ * @brief Append-only binary journal of the mutations of the accounts, with group commit.
+ *
+ * The log* methods only append the record to an in-memory buffer and return its sequence
+ * number. A dedicated writer thread writes the buffer with a single write and flush to the
+ * disk, so the mutations logged concurrently by many threads share one flush. waitDurable()
+ * blocks until a record is on the disk. The records are written in the order of their
+ * sequence numbers.
+ *
+ * A write error stops the journal: the pending and following records are discarded and
+ * waitDurable() returns false.
+ * All public methods are thread-safe.
+ */
+class Journal {
+public:
+    /**
+     * @brief Opens a journal file for appending, creating it if needed, and starts the writer.
+     * A torn tail left by a crash is cut off first, so the new records follow the valid ones.
+     *
+     * @param path The path of the file.
+     * @param options The group commit configuration.
+     * @throw std::system_error The file can't be opened.
+     */
+    explicit Journal(const std::string& path, const JournalOptions& options = JournalOptions());
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+     * @brief Writes the pending records and stops the writer.
+     *
+     */
+    ~Journal();
+
+    /**
+     * @brief Logs the creation of a person account.
+     *
+     * @param id The id of the account.
+     * @param firstName The first name of the account's owner.
+     * @param lastName The last name of the account's owner.
+     * @return std::uint64_t The sequence number of the record.
+     */
+    std::uint64_t logPersonAccount(const accountIdType& id, const std::string& firstName, const std::string& lastName);
+
+    /**
+     * @brief Logs the creation of an enterprise account.
+     *
+     * @param id The id of the account.
+     * @param yTunnus The Y-tunnus identifier of the enterprise.
+     * @param companyName The enterprise name.
+     * @return std::uint64_t The sequence number of the record.
+     */
+    std::uint64_t logEnterpriseAccount(const accountIdType& id, const std::string& yTunnus, const std::string& companyName);
+
+    /**
+     * @brief Logs a change of the balance of an account.
+     *
+     * @param id The id of the account.
+     * @param amount The signed amount added to the balance.
+     * @return std::uint64_t The sequence number of the record.
+     */
+    std::uint64_t logBalanceChange(const accountIdType& id, int amount);
+
+    /**
+     * @brief Logs a transfer between two accounts.
+     *
+     * @param from The id of the account the money was withdrawn from.
+     * @param to The id of the account the money was credited to.
+     * @param amount The amount moved.
+     * @return std::uint64_t The sequence number of the record.
+     */
+    std::uint64_t logTransfer(const accountIdType& from, const accountIdType& to, int amount);
+
+    /**
+     * @brief Blocks until the record with the given sequence number and all the previous ones
+     * are written.
+     *
+     * @param sequence The sequence number returned by a log* method.
+     * @return true The records are written.
+     * @return false The journal stopped because of a write error.
+     */
+    bool waitDurable(std::uint64_t sequence);
+
+    /**
+     * @brief Returns whether the journal stopped because of a write error.
+     *
+     * @return true A write failed, the records logged since then are not durable.
+     * @return false The journal works.
+     */
+    bool failed() const;
+
+    /**
+     * @brief Returns the statistics of the journal.
+     *
+     * @return JournalStats The statistics.
+     */
+    JournalStats stats() const;
+
+private:
+    void beginRecord(JournalRecordType type);
+    std::uint64_t endRecord();
+    void put(const void* data, std::size_t size);
+    void putId(const accountIdType& id);
+    void putString(const std::string& s);
+    void writerLoop();
+    bool writeBatch(const std::vector<char>& batch);
+
+    JournalOptions m_options;
+    int m_fd;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_hasWork;
+    std::condition_variable m_durable;
+    std::vector<char> m_buffer;
+    std::size_t m_recordStart;
+    std::uint64_t m_lastSequence;
+    std::uint64_t m_durableSequence;
+    bool m_stop;
+    bool m_failed;
+    JournalStats m_stats;
+    std::thread m_writer;
+};
+
+#endif //H_JOURNAL
\ No newline at end of file
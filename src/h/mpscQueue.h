@@ -0,0 +1,109 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_MPSC_QUEUE
+#define H_MPSC_QUEUE
+
+#include <atomic>
+
+/**
+ * @brief The link of an element of an MpscQueue. The elements derive from it.
+ */
+struct MpscNode {
+    std::atomic<MpscNode*> m_next{nullptr};
+};
+
+/**
+ * @brief An unbounded intrusive queue with many producers and a single consumer, after the
+ * one of Dmitry Vyukov. Pushing is a single atomic exchange and never waits for the other
+ * producers or the consumer, popping takes no atomic read-modify-write at all.
+ *
+ * The elements are linked through their MpscNode and aren't owned by the queue. A producer
+ * that was suspended between its exchange and its link hides the elements pushed after it
+ * until it resumes: pop() returns nullptr meanwhile, though empty() is false.
+ *
+ * @tparam T The type of the elements, derived from MpscNode.
+ */
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() :
+        m_head(&m_stub),
+        m_tail(&m_stub),
+        m_stub()
+    {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Appends an element. Called by any thread.
+     *
+     * @param element The element. It stays linked until it's popped.
+     */
+    void push(T* element) {
+
+        link(element);
+    }
+
+    /**
+     * @brief Takes the first element. Only called by the consumer.
+     *
+     * @return T* The element, or nullptr if there is none or a producer is halfway.
+     */
+    T* pop() {
+
+        MpscNode* tail = m_tail;
+        MpscNode* next = tail->m_next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (next == nullptr) return nullptr;
+            m_tail = next;
+            tail = next;
+            next = next->m_next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            m_tail = next;
+            return static_cast<T*>(tail);
+        }
+        //The tail is the last element linked: it can only be taken once the stub follows it.
+        if (tail != m_head.load(std::memory_order_acquire)) return nullptr;
+        link(&m_stub);
+        next = tail->m_next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            m_tail = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Returns whether no element was pushed that wasn't popped, counting the ones of
+     * the producers halfway. Only called by the consumer.
+     *
+     * @return true The queue is empty.
+     * @return false An element is there or coming.
+     */
+    bool empty() const {
+
+        return (m_tail == &m_stub) && (m_stub.m_next.load(std::memory_order_acquire) == nullptr) && (m_head.load(std::memory_order_seq_cst) == &m_stub);
+    }
+
+private:
+    void link(MpscNode* node) {
+
+        node->m_next.store(nullptr, std::memory_order_relaxed);
+        MpscNode* previous = m_head.exchange(node, std::memory_order_seq_cst);
+        previous->m_next.store(node, std::memory_order_release);
+    }
+
+    /** Written by the producers, on a cache line apart from the consumer's. */
+    alignas(64) std::atomic<MpscNode*> m_head;
+    alignas(64) MpscNode* m_tail;
+    MpscNode m_stub;
+};
+
+#endif //H_MPSC_QUEUE
\ No newline at end of file
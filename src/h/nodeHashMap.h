@@ -0,0 +1,122 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_NODE_HASH_MAP
+#define H_NODE_HASH_MAP
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+/**
+ * @brief A node based hash map: std::unordered_map behind the lookup interface of FlatHashMap
+ * that the account stores use.
+ *
+ * Every element lives in its own node, so inserting never moves the elements, but a lookup
+ * follows a pointer to a node per compared key. There are neither prefetches nor lookups while
+ * another thread inserts: concurrentLookups tells the users of the map to look it up under a
+ * lock. The precomputed hashes are accepted and ignored, std::unordered_map computes its own.
+ *
+ * @tparam T_Key The key type.
+ * @tparam T_Value The mapped type.
+ * @tparam T_Hash The hash functor.
+ * @tparam T_Equal The key equality functor.
+ */
+template<typename T_Key, typename T_Value, typename T_Hash = std::hash<T_Key>, typename T_Equal = std::equal_to<T_Key> >
+class NodeHashMap {
+    typedef std::unordered_map<T_Key, T_Value, T_Hash, T_Equal> Map;
+
+public:
+    typedef T_Key key_type;
+    typedef T_Value mapped_type;
+    typedef typename Map::value_type value_type;
+    typedef typename Map::size_type size_type;
+    typedef typename Map::iterator iterator;
+    typedef typename Map::const_iterator const_iterator;
+
+    /** The map can't be looked up while another thread inserts, see FlatHashMap::findConcurrent(). */
+    static constexpr bool concurrentLookups = false;
+
+    iterator begin() { return m_map.begin(); }
+    iterator end() { return m_map.end(); }
+    const_iterator begin() const { return m_map.begin(); }
+    const_iterator end() const { return m_map.end(); }
+
+    /**
+     * @brief Returns the number of elements.
+     *
+     * @return size_type The number of elements.
+     */
+    size_type size() const { return m_map.size(); }
+
+    /**
+     * @brief Returns the number of buckets.
+     *
+     * @return size_type The number of buckets.
+     */
+    size_type capacity() const { return m_map.bucket_count(); }
+
+    /**
+     * @brief Finds the element with the given key.
+     *
+     * @param key The key to find.
+     * @return const_iterator The element or end() if not found.
+     */
+    const_iterator find(const T_Key& key) const { return m_map.find(key); }
+
+    /**
+     * @brief Finds the element with the given key. The hash is ignored.
+     *
+     * @param key The key to find.
+     * @return const_iterator The element or end() if not found.
+     */
+    const_iterator find(const T_Key& key, size_type) const { return m_map.find(key); }
+
+    /**
+     * @brief Finds the element whose key is equal to a key of another type. std::unordered_map
+     * has no such lookups before C++20, so a T_Key is built from key, and the element found is
+     * compared again with key by T_Equal, which must be transparent. The hash is ignored.
+     *
+     * @param key The key to find.
+     * @return const_iterator The element or end() if not found.
+     */
+    template<typename T_LookupKey>
+    const_iterator find(const T_LookupKey& key, size_type hash) const;
+
+    /**
+     * @brief Returns the value mapped to key, inserting a default constructed one if the key
+     * is not in the map.
+     *
+     * @param key The key.
+     * @return T_Value& The mapped value.
+     */
+    T_Value& operator[](const T_Key& key) { return m_map[key]; }
+
+    /**
+     * @brief Allocates enough buckets to hold count elements without rehashing.
+     *
+     * @param count The number of elements.
+     */
+    void reserve(size_type count) { m_map.reserve(count); }
+
+private:
+    Map m_map;
+};
+
+//IMPLEMENTATION
+template<typename T_Key, typename T_Value, typename T_Hash, typename T_Equal>
+template<typename T_LookupKey>
+typename NodeHashMap<T_Key, T_Value, T_Hash, T_Equal>::const_iterator NodeHashMap<T_Key, T_Value, T_Hash, T_Equal>::find(const T_LookupKey& key, size_type) const {
+
+    const_iterator it = m_map.find(T_Key(key));
+    if (it != m_map.end() && m_map.key_eq()(it->first, key)) {
+        return it;
+    }
+    return m_map.end();
+}
+
+#endif //H_NODE_HASH_MAP
@@ -0,0 +1,404 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_OBJECT_ACCOUNT_STORE
+#define H_OBJECT_ACCOUNT_STORE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <accountDetails.h>
+#include <accountTypes.h>
+#include <balanceAggregates.h>
+#include <abstractAccount.h>
+#include <personAccount.h>
+#include <enterpriseAccount.h>
+#include <flatHashMap.h>
+#include <nodeHashMap.h>
+#include <objectPool.h>
+#include <prefetch.h>
+#include <visitor.h>
+
+/** The container used to index the accounts of an ObjectAccountStore: an open addressing hash
+ * map with the prefetches the batched operations use and the lookups of the lock-free reads. */
+typedef FlatHashMap<accountIdType, AbstractAccount<AccountId_IdPartType>*, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > AccountMgrMap;
+
+/** The container used to index the accounts of a NodeObjectAccountStore: std::unordered_map,
+ * with a node per account. */
+typedef NodeHashMap<accountIdType, AbstractAccount<AccountId_IdPartType>*, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > AccountMgrNodeMap;
+
+/**
+ * @brief Allocation statistics of the accounts of an account store, by account type.
+ */
+struct AccountAllocationStats {
+    /** Person account objects. */
+    PoolStats personAccounts;
+    /** Enterprise account objects. */
+    PoolStats enterpriseAccounts;
+    /** Per account columns shared by all the account types, e.g. the arrays of DataOrientedAccountStore. */
+    PoolStats columns;
+
+    AccountAllocationStats& operator+=(const AccountAllocationStats& rhs) {
+        personAccounts += rhs.personAccounts;
+        enterpriseAccounts += rhs.enterpriseAccounts;
+        columns += rhs.columns;
+        return *this;
+    }
+};
+
+/**
+ * @brief Account store that keeps every account as a PersonAccount or EnterpriseAccount object.
+ * 
+ * The objects are allocated from a pool of each type and indexed by AccountId in a T_Index,
+ * AccountMgrMap or AccountMgrNodeMap. Operations go through the virtual AbstractAccount interface.
+ * 
+ * An account store holds the accounts of one shard of a BasicAccountMgr, which provides the
+ * locking: the insertions need exclusive access, while the balance operations are lock-free
+ * and only need the store not to be modified concurrently.
+ * 
+ * @tparam T_Index The container indexing the accounts by AccountId.
+ */
+template<typename T_Index>
+class BasicObjectAccountStore {
+public:
+    /** The handle of an account inside the store, valid as long as the store lives. */
+    typedef AbstractAccount<AccountId_IdPartType>* Handle;
+
+    /** Whether findConcurrent() may run while another thread inserts. */
+    static constexpr bool concurrentLookups = T_Index::concurrentLookups;
+
+    /**
+     * @brief Returns the handle meaning "no account".
+     * 
+     * @return Handle The invalid handle.
+     */
+    static Handle invalidHandle() { return nullptr; }
+
+    /**
+     * @brief Construct an empty store.
+     * 
+     */
+    BasicObjectAccountStore();
+
+    /**
+     * @brief Finds an account.
+     * 
+     * @param id The id of the account.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdType& id) const;
+
+    /**
+     * @brief Finds an account whose hash was already computed.
+     * 
+     * @param id The id of the account.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdType& id, std::size_t hash) const;
+
+    /**
+     * @brief Finds an account by a view of its id, whose hash was already computed. Nothing
+     * is allocated and no AccountId is built.
+     * 
+     * @param id The view of the id of the account.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdViewType& id, std::size_t hash) const;
+
+    /**
+     * @brief Finds an account without the lock of the store, while another thread may be
+     * inserting into it, see FlatHashMap::findConcurrent(). The handle is only meaningful if
+     * no insertion ran meanwhile, which the caller must check. The index waits for
+     * RcuDomain::synchronize() before freeing the arrays it replaces, so the lookup must run
+     * in a RcuDomain::ReadSection. Without concurrentLookups it's a plain find(), which needs
+     * the lock.
+     * 
+     * @param id The id of the account, or a view of it.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it wasn't found.
+     */
+    Handle findConcurrent(const accountIdType& id, std::size_t hash) const;
+    Handle findConcurrent(const accountIdViewType& id, std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the index entries probed by a lookup of hash. See FlatHashMap::prefetch().
+     * Nothing is prefetched from an AccountMgrNodeMap.
+     * 
+     * @param hash The hash of the id computed with AccountIdHashFunctor.
+     */
+    void prefetch(std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the index slots that may hold hash. See FlatHashMap::prefetchCandidates().
+     * 
+     * @param hash The hash of the id computed with AccountIdHashFunctor.
+     */
+    void prefetchCandidates(std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the balance of an account before it's updated.
+     * 
+     * @param handle The handle of the account.
+     */
+    void prefetchBalance(Handle handle) const;
+
+    /**
+     * @brief Inserts a new person account. The names are copied once, straight from the views.
+     * 
+     * @param id The id of the account. It must not be in the store.
+     * @param firstName The first name of the account's owner.
+     * @param lastName The last name of the account's owner.
+     * @return Handle The handle of the new account.
+     */
+    Handle insertPersonAccount(const accountIdType& id, std::string_view firstName, std::string_view lastName);
+
+    /**
+     * @brief Inserts a new enterprise account. The names are copied once, straight from the views.
+     * 
+     * @param id The id of the account. It must not be in the store.
+     * @param yTunnus The Y-tunnus identifier of the enterprise.
+     * @param companyName The enterprise name.
+     * @return Handle The handle of the new account.
+     */
+    Handle insertEnterpriseAccount(const accountIdType& id, std::string_view yTunnus, std::string_view companyName);
+
+    /**
+     * @brief Returns the id of an account. The reference is valid as long as the store lives.
+     * 
+     * @param handle The handle of the account.
+     * @return const accountIdType& The id.
+     */
+    const accountIdType& id(Handle handle) const;
+
+    /**
+     * @brief Adds money to an account. See AbstractAccount::addToBalance().
+     * 
+     * @param handle The handle of the account.
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was added.
+     * @return false The amount is a negative number, or the balance would exceed INT_MAX.
+     */
+    bool addToBalance(Handle handle, int amount);
+
+    /**
+     * @brief Decreases money from an account. See AbstractAccount::decreaseFromBalance().
+     * 
+     * @param handle The handle of the account.
+     * @param amount The amount of money to decrease. It must be > 0 and less than the balance.
+     * @return true The amount was decreased.
+     * @return false The amount is a negative number or is larger than the balance.
+     */
+    bool decreaseFromBalance(Handle handle, int amount);
+
+    /**
+     * @brief Returns the balance of an account.
+     * 
+     * @param handle The handle of the account.
+     * @return int The balance.
+     */
+    int balance(Handle handle) const;
+
+    /**
+     * @brief Makes the balance of an account hot. See AtomicBalance::makeHot().
+     * 
+     * @param handle The handle of the account.
+     * @return true The balance is hot.
+     * @return false The pool of striped balances is full.
+     */
+    bool makeBalanceHot(Handle handle);
+
+    /**
+     * @brief Returns whether the balance of an account is hot.
+     * 
+     * @param handle The handle of the account.
+     * @return true The balance is hot.
+     * @return false The balance is a single integer.
+     */
+    bool balanceHot(Handle handle) const;
+
+    /**
+     * @brief Makes the visitor visit an account.
+     * 
+     * @param handle The handle of the account.
+     * @param visitor The visitor.
+     */
+    void accept(Handle handle, Visitor<AccountId_IdPartType>* visitor) const;
+
+    /**
+     * @brief Returns the details of an account as shown to the user. They're rendered with an
+     * AccountDetailsVisitor, through the virtual accept() of the account.
+     * 
+     * @param handle The handle of the account.
+     * @return std::string The details.
+     */
+    std::string accountDetails(Handle handle) const;
+
+    /**
+     * @brief Formats the details of an account into an output iterator of char, without
+     * allocating memory. See AccountDetailsWriter.
+     * 
+     * @param handle The handle of the account.
+     * @param out The output iterator.
+     * @param format The format.
+     * @return T_OutputIt The output iterator past the written chars.
+     */
+    template<typename T_OutputIt>
+    T_OutputIt renderAccountDetails(Handle handle, T_OutputIt out, AccountDetailsFormat format) const;
+
+    /**
+     * @brief Returns the number of accounts in the store.
+     * 
+     * @return std::size_t The number of accounts.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Returns the number of slots of the hash index of the store, whose load factor
+     * is size() / indexCapacity().
+     * 
+     * @return std::size_t The number of slots.
+     */
+    std::size_t indexCapacity() const;
+
+    /**
+     * @brief Returns the sum of the balances of all the accounts.
+     * 
+     * @return std::int64_t The sum of the balances.
+     */
+    std::int64_t totalBalance() const;
+
+    /**
+     * @brief Reserves room for count accounts in the index, so inserting them doesn't rehash it.
+     * 
+     * @param count The number of accounts.
+     */
+    void reserve(std::size_t count);
+
+    /**
+     * @brief Calls function for every account, in no particular order, with the arguments
+     * (const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance),
+     * name and secondName being the first and last name or the Y-tunnus and the company name.
+     * 
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void forEachAccount(T_Function function) const;
+
+    /**
+     * @brief Calls function for an account with the arguments of forEachAccount().
+     * 
+     * @param handle The handle of the account.
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void exportAccount(Handle handle, T_Function function) const;
+
+    /**
+     * @brief Calls function with blocks of up to balanceBlockSize balances of the accounts
+     * passing filter, in no particular order, with the arguments
+     * (const int* balances, const Handle* handles, std::size_t count). The kind of an account is
+     * only asked to its object when filtering.
+     * 
+     * @param filter The accounts scanned.
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void forEachBalanceBlock(AccountFilter filter, T_Function function) const;
+
+    /**
+     * @brief Returns the allocation statistics of the accounts.
+     * 
+     * @return AccountAllocationStats The statistics.
+     */
+    AccountAllocationStats allocationStats() const;
+
+private:
+    /** Gets the kind and the names of the visited account. */
+    class ExportVisitor : public Visitor<AccountId_IdPartType> {
+    public:
+        void VisitPersonAccount(const PersonAccount<AccountId_IdPartType>* account) override {
+            m_kind = AccountKind::Person;
+            m_name = &account->firstName();
+            m_secondName = &account->lastName();
+        }
+        void VisitEnterpriseAccount(const EnterpriseAccount<AccountId_IdPartType>* account) override {
+            m_kind = AccountKind::Enterprise;
+            m_name = &account->yTunnus();
+            m_secondName = &account->companyName();
+        }
+
+        AccountKind m_kind = AccountKind::Person;
+        const std::string* m_name = nullptr;
+        const std::string* m_secondName = nullptr;
+    };
+
+    PersonAccount<AccountId_IdPartType>* createNewPersonAccountPtr(const accountIdType& id, std::string_view firstName, std::string_view lastName);
+    EnterpriseAccount<AccountId_IdPartType>* createNewEnterpriseAccountPtr(const accountIdType& id, std::string_view yTunnus, std::string_view companyName);
+
+    T_Index m_actMgrDB;
+    ObjectPool<PersonAccount<AccountId_IdPartType>> m_personAccounts;
+    ObjectPool<EnterpriseAccount<AccountId_IdPartType>> m_enterpriseAccounts;
+};
+
+/** Account store indexing the account objects in an open addressing AccountMgrMap. */
+typedef BasicObjectAccountStore<AccountMgrMap> ObjectAccountStore;
+
+/** Account store indexing the account objects in a node based AccountMgrNodeMap. */
+typedef BasicObjectAccountStore<AccountMgrNodeMap> NodeObjectAccountStore;
+
+extern template class BasicObjectAccountStore<AccountMgrMap>;
+extern template class BasicObjectAccountStore<AccountMgrNodeMap>;
+
+//IMPLEMENTATION
+template<typename T_Index>
+template<typename T_OutputIt>
+T_OutputIt BasicObjectAccountStore<T_Index>::renderAccountDetails(Handle handle, T_OutputIt out, AccountDetailsFormat format) const {
+
+    ExportVisitor visitor;
+    handle->accept(&visitor);
+    return AccountDetailsWriter::write(out, format, visitor.m_kind, handle->id(), *visitor.m_name, *visitor.m_secondName, handle->balance());
+}
+
+template<typename T_Index>
+template<typename T_Function>
+void BasicObjectAccountStore<T_Index>::exportAccount(Handle handle, T_Function function) const {
+
+    ExportVisitor visitor;
+    handle->accept(&visitor);
+    function(handle->id(), visitor.m_kind, *visitor.m_name, *visitor.m_secondName, handle->balance());
+}
+
+template<typename T_Index>
+template<typename T_Function>
+void BasicObjectAccountStore<T_Index>::forEachAccount(T_Function function) const {
+
+    for (const auto& entry : m_actMgrDB) {
+        exportAccount(entry.second, function);
+    }
+}
+
+template<typename T_Index>
+template<typename T_Function>
+void BasicObjectAccountStore<T_Index>::forEachBalanceBlock(AccountFilter filter, T_Function function) const {
+
+    BalanceBlockBuffer<Handle, T_Function> buffer(function);
+    ExportVisitor visitor;
+    for (const auto& entry : m_actMgrDB) {
+        if (filter != AccountFilter::All) {
+            entry.second->accept(&visitor);
+            if (!matchesFilter(filter, visitor.m_kind)) continue;
+        }
+        buffer.push(entry.second->balance(), entry.second);
+    }
+    buffer.flush();
+}
+
+#endif //H_OBJECT_ACCOUNT_STORE
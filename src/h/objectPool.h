@@ -0,0 +1,242 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_OBJECT_POOL
+#define H_OBJECT_POOL
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Allocation statistics of an ObjectPool.
+ */
+struct PoolStats {
+    /** Objects currently alive in the pool. */
+    std::size_t liveObjects = 0;
+    /** Objects created since the pool was constructed, including the already destroyed ones. */
+    std::size_t createdObjects = 0;
+    /** Allocations requested to the system allocator, one per slab. */
+    std::size_t systemAllocations = 0;
+    /** Bytes requested to the system allocator. */
+    std::size_t bytesAllocated = 0;
+    /** Bytes used by the live objects. */
+    std::size_t bytesInUse = 0;
+
+    PoolStats& operator+=(const PoolStats& rhs) {
+        liveObjects += rhs.liveObjects;
+        createdObjects += rhs.createdObjects;
+        systemAllocations += rhs.systemAllocations;
+        bytesAllocated += rhs.bytesAllocated;
+        bytesInUse += rhs.bytesInUse;
+        return *this;
+    }
+};
+
+/**
+ * @brief A pool of objects of a single type, allocated from fixed size slabs.
+ *
+ * The objects never move, so their addresses are stable until they are destroyed. Destroyed
+ * slots are kept in a free list and reused by the next creations. The slabs are aligned to
+ * their size, so the slab of an object is found by masking its address, and each slab keeps a
+ * bitmap of its live slots: the pool destroys the objects still alive and releases all the
+ * slabs at once when it's destroyed. The pool is not thread-safe.
+ *
+ * @tparam T The type of the objects.
+ * @tparam T_SlabBytes The size of a slab. It must be a power of 2.
+ */
+template<typename T, std::size_t T_SlabBytes = 16384>
+class ObjectPool {
+public:
+    /**
+     * @brief Construct an empty pool. It doesn't allocate memory.
+     *
+     */
+    ObjectPool();
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * @brief Destroys the live objects and releases all the slabs.
+     *
+     */
+    ~ObjectPool();
+
+    /**
+     * @brief Creates an object in the pool.
+     *
+     * @param args The arguments passed to the constructor of T.
+     * @return T* The new object.
+     */
+    template<typename... T_Args>
+    T* create(T_Args&&... args);
+
+    /**
+     * @brief Destroys an object created by this pool. Its slot is reused by the next creation.
+     *
+     * @param object The object to destroy.
+     */
+    void destroy(T* object);
+
+    /**
+     * @brief Returns the allocation statistics of the pool.
+     *
+     * @return PoolStats The statistics.
+     */
+    PoolStats stats() const;
+
+    /** Number of objects that fit in a slab. */
+    static constexpr std::size_t objectsPerSlab();
+
+private:
+    union Slot {
+        Slot* m_next;
+        alignas(T) unsigned char m_storage[sizeof(T)];
+    };
+
+    static constexpr std::size_t maxSlots = T_SlabBytes / sizeof(Slot);
+    static constexpr std::size_t bitmapWords = (maxSlots + 63) / 64;
+
+    struct SlabHeader {
+        std::uint64_t m_live[bitmapWords];
+    };
+
+    static constexpr std::size_t slotsOffset = ((sizeof(SlabHeader) + alignof(Slot) - 1) / alignof(Slot)) * alignof(Slot);
+
+    static_assert((T_SlabBytes & (T_SlabBytes - 1)) == 0, "T_SlabBytes must be a power of 2");
+    static_assert(T_SlabBytes > slotsOffset + sizeof(Slot), "T_SlabBytes is too small for T");
+
+    static SlabHeader* slabOf(const void* object);
+    static Slot* slotsOf(SlabHeader* slab);
+    void newSlab();
+
+    std::vector<SlabHeader*> m_slabs;
+    Slot* m_freeList;
+    std::size_t m_unusedInLastSlab;
+    std::size_t m_liveObjects;
+    std::size_t m_createdObjects;
+};
+
+//IMPLEMENTATION
+template<typename T, std::size_t T_SlabBytes>
+constexpr std::size_t ObjectPool<T, T_SlabBytes>::objectsPerSlab() {
+
+    return (T_SlabBytes - slotsOffset) / sizeof(Slot);
+}
+
+template<typename T, std::size_t T_SlabBytes>
+ObjectPool<T, T_SlabBytes>::ObjectPool() :
+    m_slabs(),
+    m_freeList(nullptr),
+    m_unusedInLastSlab(0),
+    m_liveObjects(0),
+    m_createdObjects(0)
+{}
+
+template<typename T, std::size_t T_SlabBytes>
+ObjectPool<T, T_SlabBytes>::~ObjectPool() {
+
+    for (SlabHeader* slab : m_slabs) {
+        Slot* slots = slotsOf(slab);
+        for (std::size_t word = 0; word < bitmapWords; ++word) {
+            std::size_t bit = 0;
+            for (std::uint64_t live = slab->m_live[word]; live != 0; live >>= 1, ++bit) {
+                if ((live & 1u) != 0) {
+                    reinterpret_cast<T*>(slots[word * 64 + bit].m_storage)->~T();
+                }
+            }
+        }
+        ::operator delete(slab, std::align_val_t(T_SlabBytes));
+    }
+}
+
+template<typename T, std::size_t T_SlabBytes>
+template<typename... T_Args>
+T* ObjectPool<T, T_SlabBytes>::create(T_Args&&... args) {
+
+    Slot* slot;
+    if (m_freeList != nullptr) {
+        slot = m_freeList;
+        m_freeList = slot->m_next;
+    } else {
+        if (m_unusedInLastSlab == 0) {
+            newSlab();
+        }
+        slot = slotsOf(m_slabs.back()) + (objectsPerSlab() - m_unusedInLastSlab);
+        --m_unusedInLastSlab;
+    }
+
+    T* object;
+    try {
+        object = new (slot->m_storage) T(std::forward<T_Args>(args)...);
+    } catch (...) {
+        slot->m_next = m_freeList;
+        m_freeList = slot;
+        throw;
+    }
+
+    SlabHeader* slab = slabOf(slot);
+    std::size_t index = static_cast<std::size_t>(slot - slotsOf(slab));
+    slab->m_live[index / 64] |= std::uint64_t(1) << (index % 64);
+    ++m_liveObjects;
+    ++m_createdObjects;
+    return object;
+}
+
+template<typename T, std::size_t T_SlabBytes>
+void ObjectPool<T, T_SlabBytes>::destroy(T* object) {
+
+    if (object == nullptr) return;
+
+    SlabHeader* slab = slabOf(object);
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    std::size_t index = static_cast<std::size_t>(slot - slotsOf(slab));
+    slab->m_live[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+
+    object->~T();
+    slot->m_next = m_freeList;
+    m_freeList = slot;
+    --m_liveObjects;
+}
+
+template<typename T, std::size_t T_SlabBytes>
+PoolStats ObjectPool<T, T_SlabBytes>::stats() const {
+
+    PoolStats s;
+    s.liveObjects = m_liveObjects;
+    s.createdObjects = m_createdObjects;
+    s.systemAllocations = m_slabs.size();
+    s.bytesAllocated = m_slabs.size() * T_SlabBytes;
+    s.bytesInUse = m_liveObjects * sizeof(T);
+    return s;
+}
+
+template<typename T, std::size_t T_SlabBytes>
+typename ObjectPool<T, T_SlabBytes>::SlabHeader* ObjectPool<T, T_SlabBytes>::slabOf(const void* object) {
+
+    return reinterpret_cast<SlabHeader*>(reinterpret_cast<std::uintptr_t>(object) & ~static_cast<std::uintptr_t>(T_SlabBytes - 1));
+}
+
+template<typename T, std::size_t T_SlabBytes>
+typename ObjectPool<T, T_SlabBytes>::Slot* ObjectPool<T, T_SlabBytes>::slotsOf(SlabHeader* slab) {
+
+    return reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(slab) + slotsOffset);
+}
+
+template<typename T, std::size_t T_SlabBytes>
+void ObjectPool<T, T_SlabBytes>::newSlab() {
+
+    m_slabs.reserve(m_slabs.size() + 1);
+    SlabHeader* slab = new (::operator new(T_SlabBytes, std::align_val_t(T_SlabBytes))) SlabHeader();
+    m_slabs.push_back(slab);
+    m_unusedInLastSlab = objectsPerSlab();
+}
+
+#endif //H_OBJECT_POOL
\ No newline at end of file
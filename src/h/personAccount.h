@@ -9,6 +9,7 @@ LICENSE file in the root directory of this source tree.
 #define H_PERSONACCOUNT
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include <account.h>
@@ -43,14 +44,14 @@ public:
      * 
      * @param _firstName The first name.
      */
-    void setFirstName(const std::string& _firstName);
+    void setFirstName(std::string_view _firstName);
 
     /**
      * @brief Set the Last Name object of the account's owner.
      * 
      * @param _lastName The last name.
      */
-    void setLastName(const std::string& _lastName);
+    void setLastName(std::string_view _lastName);
 
     /**
      * @brief Returns the first name of the accoun't owner.
@@ -117,13 +118,13 @@ PersonAccount<T_Id>& PersonAccount<T_Id>::operator=(const PersonAccount<T_Id>& r
 }
 
 template <typename T_Id>
-void PersonAccount<T_Id>::setFirstName(const std::string& _firstName) {
+void PersonAccount<T_Id>::setFirstName(std::string_view _firstName) {
 
     m_firstName = _firstName;
 }
 
 template <typename T_Id>
-void PersonAccount<T_Id>::setLastName(const std::string& _lastName) {
+void PersonAccount<T_Id>::setLastName(std::string_view _lastName) {
 
     m_lastName = _lastName;
 }
@@ -0,0 +1,46 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_PREFETCH
+#define H_PREFETCH
+
+#if !defined(__GNUC__) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+/**
+ * @brief Asks the CPU to bring the cache line of address into the cache, without waiting for it.
+ * It's only a hint: it does nothing on the compilers without a prefetch intrinsic.
+ * 
+ * @param address Any address, it's never dereferenced.
+ */
+inline void prefetchForRead(const void* address) {
+
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_M_X64) || defined(_M_IX86)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+/**
+ * @brief Like prefetchForRead(), for a cache line that is going to be written.
+ * 
+ * @param address Any address, it's never dereferenced.
+ */
+inline void prefetchForWrite(const void* address) {
+
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 1, 3);
+#else
+    prefetchForRead(address);
+#endif
+}
+
+#endif //H_PREFETCH
@@ -0,0 +1,114 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_RCU_DOMAIN
+#define H_RCU_DOMAIN
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Process-wide read-copy-update domain: readers of a shared structure announce a read
+ * section instead of taking a lock, and a writer that unlinks memory calls synchronize() before
+ * freeing it, which waits until every reader that could still see that memory has left.
+ *
+ * Entering a section stores the current epoch in a slot of the thread, on a cache line of its
+ * own, and leaving it stores 0: a reader takes no lock and writes no shared cache line. A
+ * writer advances the epoch and waits for the slots holding an older one, so readers that
+ * entered afterwards, which already see the new memory, don't delay it. Read sections must
+ * be short and must not block.
+ */
+class RcuDomain {
+public:
+    /**
+     * @brief A read section of the calling thread, from construction to destruction. Sections
+     * may nest.
+     */
+    class ReadSection {
+    public:
+        ReadSection() {
+
+            RcuDomain::enter();
+        }
+
+        ~ReadSection() {
+
+            RcuDomain::leave();
+        }
+
+        ReadSection(const ReadSection&) = delete;
+        ReadSection& operator=(const ReadSection&) = delete;
+    };
+
+    RcuDomain(const RcuDomain&) = delete;
+    RcuDomain& operator=(const RcuDomain&) = delete;
+
+    /**
+     * @brief Waits until the read sections entered before the call have been left. Memory a
+     * writer unlinked before the call can be freed after it.
+     */
+    static void synchronize();
+
+    /**
+     * @brief Returns the number of threads with a slot, in a read section or not. The slots of
+     * the threads that ended are reused.
+     *
+     * @return std::size_t The number of slots in use.
+     */
+    static std::size_t readerCount();
+
+private:
+    struct alignas(64) Reader {
+        /** The epoch the thread entered its section in, 0 outside of sections. */
+        std::atomic<std::uint64_t> m_epoch{0};
+        /** The depth of the nested sections. Only used by the owning thread. */
+        std::uint32_t m_depth = 0;
+        bool m_inUse = false;
+    };
+
+    struct ThreadExit;
+
+    RcuDomain();
+
+    static RcuDomain& instance();
+    static Reader* registerThread();
+    static void unregisterThread();
+
+    static void enter() {
+
+        Reader* reader = t_reader;
+        if (reader == nullptr) {
+            reader = registerThread();
+        }
+        if (reader->m_depth++ == 0) {
+            reader->m_epoch.store(s_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            //Orders the announcement before the reads of the section, see synchronize().
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    static void leave() {
+
+        Reader* reader = t_reader;
+        if (--reader->m_depth == 0) {
+            reader->m_epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    static std::atomic<std::uint64_t> s_epoch;
+    /** The slot of the thread. Inline, so it's read without a TLS wrapper call. */
+    static inline thread_local Reader* t_reader = nullptr;
+
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Reader> > m_readers;
+};
+
+#endif //H_RCU_DOMAIN
\ No newline at end of file
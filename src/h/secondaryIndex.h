@@ -0,0 +1,211 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_SECONDARY_INDEX
+#define H_SECONDARY_INDEX
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <vector>
+
+#include <accountId.h>
+#include <accountTypes.h>
+#include <flatHashMap.h>
+
+/**
+ * @brief Memory and entries of the secondary indexes of an account manager.
+ */
+struct SecondaryIndexStats {
+    /** Distinct Y-tunnus indexed. */
+    std::size_t yTunnusEntries = 0;
+    /** Enterprise accounts refused because another account has their Y-tunnus. */
+    std::size_t duplicateYTunnus = 0;
+    /** Person accounts indexed by name. */
+    std::size_t personEntries = 0;
+    /** Bytes held by the Y-tunnus index: its table and its strings. */
+    std::size_t yTunnusBytes = 0;
+    /** Bytes held by the name index: its entries and its strings. */
+    std::size_t personBytes = 0;
+};
+
+/**
+ * @brief Append-only storage of strings in large blocks, so an index holds a view of every
+ * key instead of a std::string with its own allocation. The views stay valid while the
+ * arena lives.
+ */
+class StringArena {
+public:
+    /** The size of a block. Longer strings get a block of their own. */
+    static constexpr std::size_t blockSize = 1 << 20;
+
+    StringArena();
+
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    /**
+     * @brief Copies a string into the arena, optionally followed by a second one.
+     *
+     * @param text The string.
+     * @param more The string copied right after text.
+     * @return std::string_view The view of the copy of both.
+     */
+    std::string_view store(std::string_view text, std::string_view more = std::string_view());
+
+    /**
+     * @brief Returns the bytes allocated by the arena.
+     *
+     * @return std::size_t The bytes.
+     */
+    std::size_t bytes() const;
+
+private:
+    std::vector<std::unique_ptr<char[]> > m_blocks;
+    std::size_t m_allocated;
+    char* m_next;
+    std::size_t m_left;
+};
+
+/**
+ * @brief Hash index from the Y-tunnus of the enterprise accounts to their id.
+ *
+ * A Y-tunnus identifies one enterprise, so the index is unique: it refuses a Y-tunnus that is
+ * already indexed, and counts the refusals. The account manager doesn't insert the account
+ * it refuses.
+ * Lookups are O(1). Not thread-safe: the account manager locks it.
+ */
+class YTunnusIndex {
+public:
+    YTunnusIndex();
+
+    /**
+     * @brief Indexes an enterprise account.
+     *
+     * @param yTunnus The Y-tunnus.
+     * @param id The id of the account.
+     * @return true The account was indexed.
+     * @return false An account with this Y-tunnus was already indexed, the account is refused.
+     */
+    bool insert(std::string_view yTunnus, const accountIdType& id);
+
+    /**
+     * @brief Returns the account with a Y-tunnus.
+     *
+     * @param yTunnus The Y-tunnus.
+     * @return std::optional<accountIdType> The id of the account, if any.
+     */
+    std::optional<accountIdType> find(std::string_view yTunnus) const;
+
+    /**
+     * @brief Adds the entries and memory of the index to stats.
+     *
+     * @param stats The statistics.
+     */
+    void addStats(SecondaryIndexStats& stats) const;
+
+private:
+    typedef FlatHashMap<std::string_view, accountIdType, std::hash<std::string_view> > Map;
+
+    StringArena m_strings;
+    Map m_map;
+    std::size_t m_duplicates;
+};
+
+/**
+ * @brief Sorted index of the person accounts by last name, then first name.
+ *
+ * The entries are kept in a sorted array, plus a sorted set of the recent insertions that is
+ * merged into the array once it holds an eighth of it. Inserting is O(log n) amortized and
+ * searching O(log n + results), without a tree node per account. The names are stored once
+ * in a StringArena, so an entry takes 32 bytes plus the names.
+ * Not thread-safe: the account manager locks it.
+ */
+class PersonNameIndex {
+public:
+    /**
+     * @brief An indexed person: the last name followed by the first name, and the account.
+     */
+    struct Entry {
+        const char* m_names;
+        std::uint32_t m_lastNameLength;
+        std::uint32_t m_firstNameLength;
+        accountIdType m_id;
+
+        std::string_view lastName() const {
+
+            return std::string_view(m_names, m_lastNameLength);
+        }
+
+        std::string_view firstName() const {
+
+            return std::string_view(m_names + m_lastNameLength, m_firstNameLength);
+        }
+    };
+
+    PersonNameIndex();
+
+    /**
+     * @brief Indexes a person account.
+     *
+     * @param lastName The last name.
+     * @param firstName The first name.
+     * @param id The id of the account.
+     */
+    void insert(std::string_view lastName, std::string_view firstName, const accountIdType& id);
+
+    /**
+     * @brief Returns the accounts whose last name starts with a prefix, sorted by name.
+     *
+     * @param lastNamePrefix The prefix. Empty matches all the accounts.
+     * @param limit The greatest number of results.
+     * @return std::vector<accountIdType> The ids of the accounts.
+     */
+    std::vector<accountIdType> findByLastNamePrefix(std::string_view lastNamePrefix, std::size_t limit) const;
+
+    /**
+     * @brief Returns the accounts with a last name whose first name starts with a prefix, sorted by name.
+     *
+     * @param lastName The whole last name.
+     * @param firstNamePrefix The prefix of the first name. Empty matches the whole last name.
+     * @param limit The greatest number of results.
+     * @return std::vector<accountIdType> The ids of the accounts.
+     */
+    std::vector<accountIdType> findByName(std::string_view lastName, std::string_view firstNamePrefix, std::size_t limit) const;
+
+    /**
+     * @brief Adds the entries and memory of the index to stats.
+     *
+     * @param stats The statistics.
+     */
+    void addStats(SecondaryIndexStats& stats) const;
+
+private:
+    /** Orders the entries by last name, first name and id, and compares them with a (last name, first name) key. */
+    struct Less {
+        typedef void is_transparent;
+        typedef std::pair<std::string_view, std::string_view> Key;
+
+        bool operator()(const Entry& lhs, const Entry& rhs) const;
+        bool operator()(const Entry& lhs, const Key& rhs) const;
+        bool operator()(const Key& lhs, const Entry& rhs) const;
+    };
+
+    template<typename T_Match>
+    std::vector<accountIdType> collect(const Less::Key& from, T_Match match, std::size_t limit) const;
+    void mergeRecent();
+
+    StringArena m_strings;
+    std::vector<Entry> m_sorted;
+    std::set<Entry, Less> m_recent;
+};
+
+#endif //H_SECONDARY_INDEX
\ No newline at end of file
@@ -0,0 +1,104 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_SEQ_LOCK
+#define H_SEQ_LOCK
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief The sequence counter of a seqlock. The writers, serialized by a lock of their own,
+ * make it odd while they change the protected data and even again afterwards. A reader reads
+ * the data without a lock between readBegin() and readValid(), and only trusts what it read if
+ * the counter was even and didn't change meanwhile.
+ *
+ * The data read optimistically may be torn, so the reader must not follow pointers or trust
+ * sizes it read before readValid() confirms them, unless the memory they reach stays valid
+ * anyway (see RcuDomain).
+ */
+class SeqLock {
+public:
+    SeqLock() :
+        m_sequence(0)
+    {}
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    /**
+     * @brief Starts a read.
+     *
+     * @param sequence Receives the counter, to be passed to readValid().
+     * @return true No writer is active, the read can go on.
+     * @return false A writer is active: reading now is pointless.
+     */
+    bool readBegin(std::uint64_t& sequence) const {
+
+        sequence = m_sequence.load(std::memory_order_acquire);
+        return (sequence & 1) == 0;
+    }
+
+    /**
+     * @brief Ends a read.
+     *
+     * @param sequence The counter returned by readBegin().
+     * @return true No writer changed the data since readBegin().
+     * @return false The data read may be inconsistent.
+     */
+    bool readValid(std::uint64_t sequence) const {
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    /**
+     * @brief Starts a change. Called under the lock of the writers.
+     */
+    void writeBegin() {
+
+        m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /**
+     * @brief Ends a change. Called under the lock of the writers.
+     */
+    void writeEnd() {
+
+        m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief A change from construction to destruction, so the counter is even again even if
+     * the change throws.
+     */
+    class WriteGuard {
+    public:
+        explicit WriteGuard(SeqLock& lock) :
+            m_lock(lock)
+        {
+            m_lock.writeBegin();
+        }
+
+        ~WriteGuard() {
+
+            m_lock.writeEnd();
+        }
+
+        WriteGuard(const WriteGuard&) = delete;
+        WriteGuard& operator=(const WriteGuard&) = delete;
+
+    private:
+        SeqLock& m_lock;
+    };
+
+private:
+    std::atomic<std::uint64_t> m_sequence;
+};
+
+#endif //H_SEQ_LOCK
\ No newline at end of file
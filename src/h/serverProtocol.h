@@ -0,0 +1,181 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_SERVER_PROTOCOL
+#define H_SERVER_PROTOCOL
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <accountTypes.h>
+
+/*
+ * Binary protocol of the account server. All the integers are little endian.
+ *
+ * Every message is a frame: a u32 with the length of the rest of the frame, a u32 tag chosen
+ * by the client, a u8 with the request type or the response status, and the body.
+ *
+ * Request bodies:
+ * CreatePerson, CreateEnterprise: u16 length and name, u16 length and second name
+ * TopUp, Withdraw: i64 id, u32 date packed as YYYYMMDD, i32 amount
+ * Transfer: i64 from id, u32 from date, i64 to id, u32 to date, i32 amount
+ * Details: i64 id, u32 date
+ *
+ * Response bodies, only with the Ok status:
+ * CreatePerson, CreateEnterprise: i64 id, u32 date
+ * Details: the details as JSON text
+ *
+ * A client may send many requests without waiting for the responses. They are answered in
+ * the order they were sent, every response carrying the tag of its request.
+ */
+
+/** The size of the length, the tag and the type or status of a frame. */
+constexpr std::size_t frameHeaderSize = 9;
+
+/** The greatest length of a frame. A longer length closes the connection. */
+constexpr std::uint32_t maxFrameLength = 64 * 1024;
+
+/**
+ * @brief The types of the requests.
+ */
+enum class RequestType : std::uint8_t {
+    CreatePerson = 1,
+    CreateEnterprise = 2,
+    TopUp = 3,
+    Withdraw = 4,
+    Transfer = 5,
+    Details = 6
+};
+
+/**
+ * @brief The statuses of the responses.
+ */
+enum class ResponseStatus : std::uint8_t {
+    /** The request succeeded. */
+    Ok = 0,
+    /** The amount is invalid, the balance too low, or the Y-tunnus of a new enterprise taken. */
+    Rejected = 1,
+    /** The account doesn't exist. */
+    NotFound = 2,
+    /** The type is unknown or the body doesn't match it. */
+    Malformed = 3
+};
+
+/**
+ * @brief The outcome of decoding a frame.
+ */
+enum class FrameResult {
+    /** A whole frame was decoded. */
+    Complete,
+    /** More bytes are needed. */
+    Incomplete,
+    /** The length is out of range; the stream can't be resynchronized. */
+    Malformed
+};
+
+/**
+ * @brief A decoded request. The names point into the decoded bytes.
+ */
+struct Request {
+    std::uint32_t tag;
+    RequestType type;
+    /** The account of the balance changes and the details, or the source of a transfer. */
+    accountIdType id;
+    /** The destination of a transfer. */
+    accountIdType toId;
+    int amount;
+    std::string_view name;
+    std::string_view secondName;
+    /** Whether the body matches the type. Otherwise the request is answered as Malformed. */
+    bool valid;
+};
+
+/**
+ * @brief A decoded response. The details point into the decoded bytes.
+ */
+struct Response {
+    std::uint32_t tag;
+    ResponseStatus status;
+    /** The id of a created account. */
+    accountIdType id;
+    /** The JSON details of an account. */
+    std::string_view details;
+};
+
+/**
+ * @brief Decodes the request at the start of a buffer.
+ *
+ * @param data The bytes received.
+ * @param size The number of bytes.
+ * @param request The request decoded.
+ * @param frameSize The size of the frame decoded.
+ * @return FrameResult Whether a frame was decoded.
+ */
+FrameResult decodeRequest(const char* data, std::size_t size, Request& request, std::size_t& frameSize);
+
+/**
+ * @brief Decodes the response at the start of a buffer.
+ *
+ * @param data The bytes received.
+ * @param size The number of bytes.
+ * @param response The response decoded.
+ * @param frameSize The size of the frame decoded.
+ * @return FrameResult Whether a frame was decoded.
+ */
+FrameResult decodeResponse(const char* data, std::size_t size, Response& response, std::size_t& frameSize);
+
+/**
+ * @brief Appends the header of a frame whose length is set by endFrame.
+ *
+ * @param out The buffer.
+ * @param tag The tag.
+ * @param code The request type or the response status.
+ * @return std::size_t The offset of the frame in the buffer.
+ */
+std::size_t beginFrame(std::string& out, std::uint32_t tag, std::uint8_t code);
+
+/**
+ * @brief Sets the length of the frame started by beginFrame, once its body is appended.
+ *
+ * @param out The buffer.
+ * @param start The offset returned by beginFrame.
+ */
+void endFrame(std::string& out, std::size_t start);
+
+/**
+ * @brief Appends a CreatePerson or CreateEnterprise request.
+ */
+void encodeCreateRequest(std::string& out, std::uint32_t tag, RequestType type, std::string_view name, std::string_view secondName);
+
+/**
+ * @brief Appends a TopUp or Withdraw request.
+ */
+void encodeBalanceRequest(std::string& out, std::uint32_t tag, RequestType type, const accountIdType& id, int amount);
+
+/**
+ * @brief Appends a Transfer request.
+ */
+void encodeTransferRequest(std::string& out, std::uint32_t tag, const accountIdType& from, const accountIdType& to, int amount);
+
+/**
+ * @brief Appends a Details request.
+ */
+void encodeDetailsRequest(std::string& out, std::uint32_t tag, const accountIdType& id);
+
+/**
+ * @brief Appends a response without body.
+ */
+void encodeResponse(std::string& out, std::uint32_t tag, ResponseStatus status);
+
+/**
+ * @brief Appends the Ok response of a created account.
+ */
+void encodeIdResponse(std::string& out, std::uint32_t tag, const accountIdType& id);
+
+#endif //H_SERVER_PROTOCOL
\ No newline at end of file
@@ -5,26 +5,75 @@ All rights reserved.
 This source code is licensed under the BSD-style license found in the
 LICENSE file in the root directory of this source tree.
 **********************************************************************/
+#ifndef H_SINGLETON_UNIQUE_ID_GENERATOR
+#define H_SINGLETON_UNIQUE_ID_GENERATOR
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Generator of unique 64 bits ids, shared by the whole process.
+ * 
+ * Every thread reserves a block of consecutive ids from a global atomic counter and hands
+ * them out from a thread local cursor, so the common case doesn't write any shared memory.
+ * The global counter is only touched once per block.
+ */
 class SingletonUniqueIdGenerator {
 private:
     SingletonUniqueIdGenerator() :
-        n(0)
+        m_reserved(0),
+        m_generation(1)
     {}
 
 public:
+    /** The number of ids reserved by a thread each time its block runs out. */
+    static constexpr std::int64_t blockSize = 1024;
+
     SingletonUniqueIdGenerator(const SingletonUniqueIdGenerator&) = delete;
     SingletonUniqueIdGenerator& operator=(const SingletonUniqueIdGenerator &) = delete;
     SingletonUniqueIdGenerator(SingletonUniqueIdGenerator &&) = delete;
     SingletonUniqueIdGenerator& operator=(SingletonUniqueIdGenerator &&) = delete;
 
     /**
-     * @brief Increments and returns the counter of his object,
+     * @brief Returns a new id. It's safe to call it from several threads at the same time.
+     * Ids are unique and increasing within a thread, but not consecutive across threads.
+     * 
+     * @return std::int64_t The id. It's always different.
+     */
+    std::int64_t incrementAndReturn() {
+
+        ThreadBlock& block = threadBlock();
+        if ((block.m_next == block.m_end) || (block.m_generation != m_generation.load(std::memory_order_acquire))) {
+            refill(block);
+        }
+        return block.m_next++;
+    }
+
+    /**
+     * @brief Seeds the generator from persisted state, so the ids generated from now on are
+     * greater than lastUsedId. It never moves the generator backwards. It must be called at
+     * startup, before other threads request ids.
      * 
-     * @return int The value of the counter. It's always different.
+     * @param lastUsedId The greatest id already in use, e.g. the highWaterMark() persisted by a
+     * previous run.
      */
-    int incrementAndReturn() {
+    void seed(std::int64_t lastUsedId) {
 
-        return ++n;
+        std::int64_t current = m_reserved.load(std::memory_order_relaxed);
+        while ((current < lastUsedId) && !m_reserved.compare_exchange_weak(current, lastUsedId, std::memory_order_relaxed)) {
+        }
+        m_generation.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Returns the greatest id handed out or reserved so far. Persisting this value and
+     * passing it to seed() on the next run guarantees no id is ever reused.
+     * 
+     * @return std::int64_t The high water mark.
+     */
+    std::int64_t highWaterMark() const {
+
+        return m_reserved.load(std::memory_order_relaxed);
     }
 
     /**
@@ -39,5 +88,28 @@ public:
     }
 
 private:
-    int n;
-};
\ No newline at end of file
+    struct ThreadBlock {
+        std::int64_t m_next = 0;
+        std::int64_t m_end = 0;
+        std::uint64_t m_generation = 0;
+    };
+
+    static ThreadBlock& threadBlock() {
+        thread_local ThreadBlock block;
+
+        return block;
+    }
+
+    void refill(ThreadBlock& block) {
+
+        block.m_generation = m_generation.load(std::memory_order_acquire);
+        block.m_next = m_reserved.fetch_add(blockSize, std::memory_order_relaxed) + 1;
+        block.m_end = block.m_next + blockSize;
+    }
+
+    /** Only written when a block is reserved, keep it apart from the read-mostly generation. */
+    alignas(64) std::atomic<std::int64_t> m_reserved;
+    alignas(64) std::atomic<std::uint64_t> m_generation;
+};
+
+#endif //H_SINGLETON_UNIQUE_ID_GENERATOR
\ No newline at end of file
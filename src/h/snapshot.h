@@ -0,0 +1,236 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_SNAPSHOT
+#define H_SNAPSHOT
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <accountTypes.h>
+
+/*
+ * Snapshot file format, version 1. All the integers are stored in the byte order of the host.
+ *
+ * SnapshotHeader
+ * Block 0: SnapshotRecord[accountCount] followed by the string bytes of the block
+ * ...
+ * Block N-1
+ * SnapshotBlock[blockCount], the block table
+ *
+ * The names of an account are stored one after the other in the strings of its block,
+ * starting at stringOffset. Every block holds the accounts of a shard of the manager that
+ * wrote the snapshot.
+ */
+
+/** The magic number at the start of a snapshot file, "TTSNAP" and two zero bytes. */
+constexpr char snapshotMagic[8] = { 'T', 'T', 'S', 'N', 'A', 'P', 0, 0 };
+
+/** The version of the snapshot format written by SnapshotWriter. */
+constexpr std::uint32_t snapshotVersion = 1;
+
+/**
+ * @brief The header at the start of a snapshot file.
+ */
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t accountCount;
+    std::int64_t lastUsedId;
+    std::uint64_t blockCount;
+    std::uint64_t blockTableOffset;
+};
+
+/**
+ * @brief An account in a snapshot file.
+ */
+struct SnapshotRecord {
+    std::int64_t id;
+    std::uint64_t stringOffset;
+    std::uint32_t creationDate;
+    std::int32_t balance;
+    std::uint32_t nameLength;
+    std::uint32_t secondNameLength;
+    AccountKind kind;
+    std::uint8_t reserved[7];
+};
+
+/**
+ * @brief An entry of the block table of a snapshot file.
+ */
+struct SnapshotBlock {
+    std::uint64_t offset;
+    std::uint64_t accountCount;
+    std::uint64_t stringBytes;
+};
+
+static_assert(sizeof(SnapshotRecord) == 40, "SnapshotRecord must have no padding");
+
+/**
+ * @brief Writes a snapshot file block by block.
+ *
+ * The file is written with a temporary name and renamed when finished, so a crash while
+ * writing never leaves a partial snapshot under the final name.
+ */
+class SnapshotWriter {
+public:
+    /**
+     * @brief Creates the temporary file of a snapshot.
+     *
+     * @param path The final path of the snapshot.
+     */
+    explicit SnapshotWriter(const std::string& path);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    /**
+     * @brief Removes the temporary file if the snapshot wasn't finished.
+     *
+     */
+    ~SnapshotWriter();
+
+    /**
+     * @brief Adds an account to the current block.
+     *
+     * @param id The id of the account.
+     * @param kind The kind of the account.
+     * @param name The first name or the Y-tunnus.
+     * @param secondName The last name or the company name.
+     * @param balance The balance.
+     */
+    void addAccount(const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance);
+
+    /**
+     * @brief Writes the current block to the file and starts a new one.
+     *
+     * @return true The block was written.
+     * @return false A write failed.
+     */
+    bool flushBlock();
+
+    /**
+     * @brief Writes the block table and the header and gives the file its final name.
+     *
+     * @param lastUsedId The greatest id in use, to seed the unique id generator on load.
+     * @return true The snapshot was written.
+     * @return false A write failed.
+     */
+    bool finish(std::int64_t lastUsedId);
+
+private:
+    std::string m_path;
+    std::string m_tmpPath;
+    std::FILE* m_file;
+    bool m_ok;
+    std::uint64_t m_offset;
+    std::uint64_t m_accountCount;
+    std::vector<SnapshotRecord> m_records;
+    std::string m_strings;
+    std::vector<SnapshotBlock> m_blocks;
+};
+
+/**
+ * @brief Reads a snapshot file mapped in memory.
+ *
+ * Opening only validates the header and the block table; the records are read in place from
+ * the mapping, without copying or parsing them.
+ */
+class SnapshotReader {
+public:
+    /**
+     * @brief Maps a snapshot file in memory and validates it.
+     *
+     * @param path The path of the snapshot.
+     */
+    explicit SnapshotReader(const std::string& path);
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    /**
+     * @brief Unmaps the file.
+     *
+     */
+    ~SnapshotReader();
+
+    /**
+     * @brief Returns whether the file was mapped and is a valid snapshot.
+     *
+     * @return true The snapshot can be read.
+     * @return false The file doesn't exist, can't be mapped or isn't a valid snapshot.
+     */
+    bool valid() const;
+
+    /**
+     * @brief Returns the header of the snapshot. Only valid if valid() is true.
+     *
+     * @return const SnapshotHeader& The header.
+     */
+    const SnapshotHeader& header() const;
+
+    /**
+     * @brief Returns the number of blocks.
+     *
+     * @return std::size_t The number of blocks.
+     */
+    std::size_t blockCount() const;
+
+    /**
+     * @brief Returns the records of a block.
+     *
+     * @param block The index of the block.
+     * @return const SnapshotRecord* The first record of the block.
+     */
+    const SnapshotRecord* records(std::size_t block) const;
+
+    /**
+     * @brief Returns the number of records of a block.
+     *
+     * @param block The index of the block.
+     * @return std::size_t The number of records.
+     */
+    std::size_t recordCount(std::size_t block) const;
+
+    /**
+     * @brief Returns the first name or the Y-tunnus of an account, pointing into the mapping.
+     *
+     * @param block The index of the block of the account.
+     * @param record The record of the account.
+     * @return std::string_view The name.
+     */
+    std::string_view name(std::size_t block, const SnapshotRecord& record) const;
+
+    /**
+     * @brief Returns the last name or the company name of an account, pointing into the mapping.
+     *
+     * @param block The index of the block of the account.
+     * @param record The record of the account.
+     * @return std::string_view The name.
+     */
+    std::string_view secondName(std::size_t block, const SnapshotRecord& record) const;
+
+private:
+    bool validate();
+    void unmap();
+
+    const char* m_data;
+    std::size_t m_size;
+    const SnapshotBlock* m_blocks;
+    bool m_valid;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#endif
+};
+
+#endif //H_SNAPSHOT
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_STRIPED_BALANCE
+#define H_STRIPED_BALANCE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The balance of a hot account, split into sub-balances on their own cache lines.
+ *
+ * Every thread credits the stripe it was given, so concurrent top-ups don't share a cache
+ * line. A withdrawal takes from its thread's stripe when the stripe is enough, and otherwise
+ * borrows from the other stripes, one borrower at a time, so no stripe ever becomes negative
+ * and the account is never overdrawn. value() sums the stripes.
+ *
+ * Besides its money, every stripe holds a share of the headroom left below INT_MAX, and the
+ * money and the headroom of all the stripes always add up to INT_MAX. A credit spends the
+ * headroom of its stripe and a withdrawal gives it back, so the balance never exceeds INT_MAX.
+ * When its headroom runs out, a stripe gathers more from the others under the same lock as the
+ * borrowers.
+ */
+class StripedBalance {
+public:
+    /** The number of stripes. Threads are spread over them round robin. */
+    static constexpr std::size_t stripeCount = 16;
+
+    StripedBalance();
+
+    StripedBalance(const StripedBalance&) = delete;
+    StripedBalance& operator=(const StripedBalance&) = delete;
+
+    /**
+     * @brief Sets the balance, all of it in the first stripe. Only called while no other
+     * thread can reach the balance.
+     *
+     * @param value The balance.
+     */
+    void reset(int value);
+
+    /**
+     * @brief Adds to the stripe of the calling thread, gathering headroom from the other
+     * stripes if the one of the stripe isn't enough.
+     *
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was added.
+     * @return false The balance would exceed INT_MAX.
+     */
+    bool add(int amount);
+
+    /**
+     * @brief Decreases the balance, borrowing from the other stripes if the one of the calling
+     * thread isn't enough.
+     *
+     * @param amount The amount of money to decrease. It must be > 0.
+     * @return true The amount was decreased.
+     * @return false The stripes together don't hold the amount.
+     */
+    bool decrease(int amount);
+
+    /**
+     * @brief Returns the sum of the stripes, up to INT_MAX. While a withdrawal borrows, the
+     * sum may briefly miss the amount it's taking.
+     *
+     * @return int The balance.
+     */
+    int value() const;
+
+private:
+    /** The money of the stripe in the low 32 bits, its headroom in the high 32 bits. */
+    struct alignas(64) Stripe {
+        std::atomic<std::uint64_t> m_state{0};
+    };
+
+    static std::size_t threadStripe();
+
+    Stripe m_stripes[stripeCount];
+    std::mutex m_borrowMutex;
+};
+
+/**
+ * @brief Process-wide pool of the striped balances of the hot accounts. An AtomicBalance
+ * promoted to hot holds the index of its StripedBalance here. Released balances are reused.
+ *
+ * The balances are allocated in chunks whose addresses are published in a fixed directory,
+ * so at() needs no lock while other threads acquire balances.
+ */
+class StripedBalancePool {
+public:
+    /** The number of striped balances of a chunk, 64 KB. */
+    static constexpr std::size_t chunkSize = 64;
+    /** The most chunks, so the most hot accounts are chunkSize * maxChunks. */
+    static constexpr std::size_t maxChunks = 4096;
+
+    /**
+     * @brief Returns the pool.
+     *
+     * @return StripedBalancePool& The pool.
+     */
+    static StripedBalancePool& instance();
+
+    StripedBalancePool(const StripedBalancePool&) = delete;
+    StripedBalancePool& operator=(const StripedBalancePool&) = delete;
+
+    /**
+     * @brief Takes a free striped balance.
+     *
+     * @param value The balance it starts with.
+     * @param index The index of the striped balance.
+     * @return true A striped balance was taken.
+     * @return false The pool is full.
+     */
+    bool acquire(int value, std::uint32_t& index);
+
+    /**
+     * @brief Gives back a striped balance no account uses anymore.
+     *
+     * @param index The index of the striped balance.
+     */
+    void release(std::uint32_t index);
+
+    /**
+     * @brief Returns a striped balance. The reference is valid as long as the process lives.
+     *
+     * @param index The index of the striped balance, published to the calling thread with
+     * release and acquire order.
+     * @return StripedBalance& The striped balance.
+     */
+    StripedBalance& at(std::uint32_t index) {
+
+        return m_chunks[index / chunkSize].load(std::memory_order_relaxed)[index % chunkSize];
+    }
+
+    /**
+     * @brief Returns the number of striped balances in use.
+     *
+     * @return std::size_t The number of hot accounts.
+     */
+    std::size_t inUse() const;
+
+private:
+    StripedBalancePool();
+
+    std::atomic<StripedBalance*> m_chunks[maxChunks];
+    std::size_t m_size;
+    std::vector<std::uint32_t> m_free;
+    mutable std::mutex m_mutex;
+};
+
+#endif //H_STRIPED_BALANCE
\ No newline at end of file
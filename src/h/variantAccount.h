@@ -0,0 +1,291 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_VARIANT_ACCOUNT
+#define H_VARIANT_ACCOUNT
+
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include <accountDetails.h>
+#include <accountId.h>
+#include <atomicBalance.h>
+
+/**
+ * @brief The id and the balance shared by the account values of VariantAccount.
+ * 
+ * Unlike Account it has no virtual methods: the account values are stored by value in a
+ * closed variant and dispatched statically, so they carry no vtable pointer and every call
+ * can be inlined.
+ * 
+ * @tparam T_Id The type of the Id part of the class
+ * AccountId used to identify each individual account.
+ */
+template<typename T_Id>
+class AccountValue {
+public:
+    /**
+     * @brief Construct a new Account Value object with a balance of 0.
+     * 
+     * @param _id The id of the account.
+     */
+    explicit AccountValue(const AccountId<T_Id>& _id);
+
+    /**
+     * @brief Adds balance to the account. See Account::addToBalance().
+     * 
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was added to the account's balance.
+     * @return false The amount is a negative number, or the balance would exceed INT_MAX.
+     */
+    bool addToBalance(int amount);
+
+    /**
+     * @brief Decrease balance from the account. See Account::decreaseFromBalance().
+     * 
+     * @param amount The amount of money to decrease. It must be > 0 and less than the current balance of the account.
+     * @return true The amount was decreased from the account's balance.
+     * @return false The amount is a negative number or is larger than the current account's balance.
+     */
+    bool decreaseFromBalance(int amount);
+
+    /**
+     * @brief Returns the current balance of the account.
+     * 
+     * @return int The current balance.
+     */
+    int balance() const;
+
+    /**
+     * @brief Makes the balance hot. See Account::makeBalanceHot().
+     * 
+     * @return true The balance is hot.
+     * @return false The pool of striped balances is full.
+     */
+    bool makeBalanceHot();
+
+    /**
+     * @brief Returns whether the balance is hot.
+     * 
+     * @return true The balance is hot.
+     * @return false The balance is a single integer.
+     */
+    bool balanceHot() const;
+
+    /**
+     * @brief Returns the Id of the account.
+     * 
+     * @return const AccountId<T_Id>& The Id object of the account.
+     */
+    const AccountId<T_Id>& id() const;
+
+private:
+    AccountId<T_Id> m_id;
+    AtomicBalance m_balance;
+};
+
+/**
+ * @brief A person account stored by value in a VariantAccount.
+ * 
+ * @tparam T_Id The type of the Id part of the class AccountId.
+ */
+template<typename T_Id>
+class PersonAccountValue : public AccountValue<T_Id> {
+public:
+    /**
+     * @brief Construct a new Person Account Value object with a balance of 0.
+     * 
+     * @param _id The id of the account.
+     * @param _firstName The first name of the account's owner.
+     * @param _lastName The last name of the account's owner.
+     */
+    PersonAccountValue(const AccountId<T_Id>& _id, std::string_view _firstName, std::string_view _lastName);
+
+    /**
+     * @brief Returns the first name of the account's owner.
+     * 
+     * @return const std::string& The first name.
+     */
+    const std::string& firstName() const;
+
+    /**
+     * @brief Returns the last name of the account's owner.
+     * 
+     * @return const std::string& The last name.
+     */
+    const std::string& lastName() const;
+
+private:
+    std::string m_firstName;
+    std::string m_lastName;
+};
+
+/**
+ * @brief An enterprise account stored by value in a VariantAccount.
+ * 
+ * @tparam T_Id The type of the Id part of the class AccountId.
+ */
+template<typename T_Id>
+class EnterpriseAccountValue : public AccountValue<T_Id> {
+public:
+    /**
+     * @brief Construct a new Enterprise Account Value object with a balance of 0.
+     * 
+     * @param _id The id of the account.
+     * @param _yTunnus The Y-tunnus identifier of the enterprise.
+     * @param _companyName The enterprise name.
+     */
+    EnterpriseAccountValue(const AccountId<T_Id>& _id, std::string_view _yTunnus, std::string_view _companyName);
+
+    /**
+     * @brief Returns the Y-tunnus identifier of the enterprise.
+     * 
+     * @return const std::string& The Y-tunnus.
+     */
+    const std::string& yTunnus() const;
+
+    /**
+     * @brief Returns the enterprise name.
+     * 
+     * @return const std::string& The company name.
+     */
+    const std::string& companyName() const;
+
+private:
+    std::string m_yTunnus;
+    std::string m_companyName;
+};
+
+/**
+ * @brief The closed set of account kinds, as an alternative to the AbstractAccount hierarchy.
+ * Operations are dispatched with std::visit instead of virtual calls and the Visitor pattern.
+ */
+template<typename T_Id>
+using VariantAccount = std::variant<PersonAccountValue<T_Id>, EnterpriseAccountValue<T_Id> >;
+
+/**
+ * @brief Returns the shared part of a variant account, without knowing its kind.
+ * 
+ * @param account The account.
+ * @return AccountValue<T_Id>& The id and balance of the account.
+ */
+template<typename T_Id>
+AccountValue<T_Id>& accountValue(VariantAccount<T_Id>& account);
+
+/**
+ * @brief Returns the shared part of a variant account, without knowing its kind.
+ * 
+ * @param account The account.
+ * @return const AccountValue<T_Id>& The id and balance of the account.
+ */
+template<typename T_Id>
+const AccountValue<T_Id>& accountValue(const VariantAccount<T_Id>& account);
+
+/**
+ * @brief The static counterpart of AccountDetailsVisitor, to use with std::visit.
+ */
+template<typename T_Id>
+struct AccountDetailsRenderer {
+    std::string operator()(const PersonAccountValue<T_Id>& account) const { return personAccountDetails(account); }
+    std::string operator()(const EnterpriseAccountValue<T_Id>& account) const { return enterpriseAccountDetails(account); }
+};
+
+//IMPLEMENTATION
+template<typename T_Id>
+AccountValue<T_Id>::AccountValue(const AccountId<T_Id>& _id) :
+    m_id(_id),
+    m_balance(0)
+{}
+
+template<typename T_Id>
+bool AccountValue<T_Id>::addToBalance(int amount) {
+
+    return m_balance.add(amount);
+}
+
+template<typename T_Id>
+bool AccountValue<T_Id>::decreaseFromBalance(int amount) {
+
+    return m_balance.decrease(amount);
+}
+
+template<typename T_Id>
+int AccountValue<T_Id>::balance() const {
+
+    return m_balance.value();
+}
+
+template<typename T_Id>
+bool AccountValue<T_Id>::makeBalanceHot() {
+
+    return m_balance.makeHot();
+}
+
+template<typename T_Id>
+bool AccountValue<T_Id>::balanceHot() const {
+
+    return m_balance.hot();
+}
+
+template<typename T_Id>
+const AccountId<T_Id>& AccountValue<T_Id>::id() const {
+
+    return m_id;
+}
+
+template<typename T_Id>
+PersonAccountValue<T_Id>::PersonAccountValue(const AccountId<T_Id>& _id, std::string_view _firstName, std::string_view _lastName) :
+    AccountValue<T_Id>(_id),
+    m_firstName(_firstName),
+    m_lastName(_lastName)
+{}
+
+template<typename T_Id>
+const std::string& PersonAccountValue<T_Id>::firstName() const {
+
+    return m_firstName;
+}
+
+template<typename T_Id>
+const std::string& PersonAccountValue<T_Id>::lastName() const {
+
+    return m_lastName;
+}
+
+template<typename T_Id>
+EnterpriseAccountValue<T_Id>::EnterpriseAccountValue(const AccountId<T_Id>& _id, std::string_view _yTunnus, std::string_view _companyName) :
+    AccountValue<T_Id>(_id),
+    m_yTunnus(_yTunnus),
+    m_companyName(_companyName)
+{}
+
+template<typename T_Id>
+const std::string& EnterpriseAccountValue<T_Id>::yTunnus() const {
+
+    return m_yTunnus;
+}
+
+template<typename T_Id>
+const std::string& EnterpriseAccountValue<T_Id>::companyName() const {
+
+    return m_companyName;
+}
+
+template<typename T_Id>
+AccountValue<T_Id>& accountValue(VariantAccount<T_Id>& account) {
+
+    return std::visit([](auto& value) -> AccountValue<T_Id>& { return value; }, account);
+}
+
+template<typename T_Id>
+const AccountValue<T_Id>& accountValue(const VariantAccount<T_Id>& account) {
+
+    return std::visit([](const auto& value) -> const AccountValue<T_Id>& { return value; }, account);
+}
+
+#endif //H_VARIANT_ACCOUNT
\ No newline at end of file
@@ -0,0 +1,365 @@
+/*********************************************************************
+Copyright (c) 2023, Claudio Costagliola Fiedler
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+**********************************************************************/
+#ifndef H_VARIANT_ACCOUNT_STORE
+#define H_VARIANT_ACCOUNT_STORE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include <accountDetails.h>
+#include <accountTypes.h>
+#include <balanceAggregates.h>
+#include <chunkedArray.h>
+#include <flatHashMap.h>
+#include <objectAccountStore.h>
+#include <prefetch.h>
+#include <variantAccount.h>
+
+/**
+ * @brief Account store that keeps every account by value as a VariantAccount.
+ * 
+ * It's the statically dispatched counterpart of ObjectAccountStore: the accounts are stored
+ * inline in a chunked array instead of being pool objects behind AbstractAccount pointers, and
+ * the operations and the details rendering use std::visit instead of virtual calls and the
+ * Visitor pattern. The accounts carry no vtable pointer, a lookup reaches the account without
+ * an extra indirection and the compiler inlines the balance operations.
+ * 
+ * Every account gets a slot number, its handle; the index maps an AccountId to its slot. The
+ * array is chunked, so growing it never moves an account. Like every account store, it holds
+ * the accounts of one shard of a BasicAccountMgr, which provides the locking.
+ */
+class VariantAccountStore {
+public:
+    /** The slot of an account inside the store. */
+    typedef std::uint32_t Handle;
+
+    /**
+     * @brief Returns the handle meaning "no account".
+     * 
+     * @return Handle The invalid handle.
+     */
+    static Handle invalidHandle() { return UINT32_MAX; }
+
+    /** Whether findConcurrent() may run while another thread inserts, as the FlatHashMap index allows. */
+    static constexpr bool concurrentLookups = true;
+
+    /**
+     * @brief Construct an empty store.
+     * 
+     */
+    VariantAccountStore();
+
+    /**
+     * @brief Finds an account.
+     * 
+     * @param id The id of the account.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdType& id) const;
+
+    /**
+     * @brief Finds an account whose hash was already computed.
+     * 
+     * @param id The id of the account.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdType& id, std::size_t hash) const;
+
+    /**
+     * @brief Finds an account by a view of its id, whose hash was already computed. Nothing
+     * is allocated and no AccountId is built.
+     * 
+     * @param id The view of the id of the account.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it's not in the store.
+     */
+    Handle find(const accountIdViewType& id, std::size_t hash) const;
+
+    /**
+     * @brief Finds an account without the lock of the store, while another thread may be
+     * inserting into it, see FlatHashMap::findConcurrent(). The handle is only meaningful if
+     * no insertion ran meanwhile, which the caller must check. The index waits for
+     * RcuDomain::synchronize() before freeing the arrays it replaces, so the lookup must run
+     * in a RcuDomain::ReadSection.
+     * 
+     * @param id The id of the account, or a view of it.
+     * @param hash The hash of id computed with AccountIdHashFunctor.
+     * @return Handle The handle of the account, or invalidHandle() if it wasn't found.
+     */
+    Handle findConcurrent(const accountIdType& id, std::size_t hash) const;
+    Handle findConcurrent(const accountIdViewType& id, std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the index entries probed by a lookup of hash. See FlatHashMap::prefetch().
+     * 
+     * @param hash The hash of the id computed with AccountIdHashFunctor.
+     */
+    void prefetch(std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the index slots that may hold hash. See FlatHashMap::prefetchCandidates().
+     * 
+     * @param hash The hash of the id computed with AccountIdHashFunctor.
+     */
+    void prefetchCandidates(std::size_t hash) const;
+
+    /**
+     * @brief Prefetches the balance of an account before it's updated.
+     * 
+     * @param handle The handle of the account.
+     */
+    void prefetchBalance(Handle handle) const;
+
+    /**
+     * @brief Inserts a new person account. The names are copied once, straight from the views.
+     * 
+     * @param id The id of the account. It must not be in the store.
+     * @param firstName The first name of the account's owner.
+     * @param lastName The last name of the account's owner.
+     * @return Handle The handle of the new account.
+     */
+    Handle insertPersonAccount(const accountIdType& id, std::string_view firstName, std::string_view lastName);
+
+    /**
+     * @brief Inserts a new enterprise account. The names are copied once, straight from the views.
+     * 
+     * @param id The id of the account. It must not be in the store.
+     * @param yTunnus The Y-tunnus identifier of the enterprise.
+     * @param companyName The enterprise name.
+     * @return Handle The handle of the new account.
+     */
+    Handle insertEnterpriseAccount(const accountIdType& id, std::string_view yTunnus, std::string_view companyName);
+
+    /**
+     * @brief Returns the id of an account. The reference is valid as long as the store lives.
+     * 
+     * @param handle The handle of the account.
+     * @return const accountIdType& The id.
+     */
+    const accountIdType& id(Handle handle) const;
+
+    /**
+     * @brief Returns the kind of an account.
+     * 
+     * @param handle The handle of the account.
+     * @return AccountKind The kind.
+     */
+    AccountKind kind(Handle handle) const;
+
+    /**
+     * @brief Adds money to an account. See AccountValue::addToBalance().
+     * 
+     * @param handle The handle of the account.
+     * @param amount The amount of money to add. It must be > 0.
+     * @return true The amount was added.
+     * @return false The amount is a negative number, or the balance would exceed INT_MAX.
+     */
+    bool addToBalance(Handle handle, int amount);
+
+    /**
+     * @brief Decreases money from an account. See AccountValue::decreaseFromBalance().
+     * 
+     * @param handle The handle of the account.
+     * @param amount The amount of money to decrease. It must be > 0 and less than the balance.
+     * @return true The amount was decreased.
+     * @return false The amount is a negative number or is larger than the balance.
+     */
+    bool decreaseFromBalance(Handle handle, int amount);
+
+    /**
+     * @brief Returns the balance of an account.
+     * 
+     * @param handle The handle of the account.
+     * @return int The balance.
+     */
+    int balance(Handle handle) const;
+
+    /**
+     * @brief Makes the balance of an account hot. See AtomicBalance::makeHot().
+     * 
+     * @param handle The handle of the account.
+     * @return true The balance is hot.
+     * @return false The pool of striped balances is full.
+     */
+    bool makeBalanceHot(Handle handle);
+
+    /**
+     * @brief Returns whether the balance of an account is hot.
+     * 
+     * @param handle The handle of the account.
+     * @return true The balance is hot.
+     * @return false The balance is a single integer.
+     */
+    bool balanceHot(Handle handle) const;
+
+    /**
+     * @brief Calls function with the PersonAccountValue or EnterpriseAccountValue of an account,
+     * through std::visit.
+     * 
+     * @param handle The handle of the account.
+     * @param function The function, callable with both account values.
+     * @return auto What function returns.
+     */
+    template<typename T_Function>
+    decltype(auto) visit(Handle handle, T_Function&& function) const;
+
+    /**
+     * @brief Returns the details of an account as shown to the user. They're rendered with an
+     * AccountDetailsRenderer, through std::visit.
+     * 
+     * @param handle The handle of the account.
+     * @return std::string The details.
+     */
+    std::string accountDetails(Handle handle) const;
+
+    /**
+     * @brief Formats the details of an account into an output iterator of char, without
+     * allocating memory. See AccountDetailsWriter.
+     * 
+     * @param handle The handle of the account.
+     * @param out The output iterator.
+     * @param format The format.
+     * @return T_OutputIt The output iterator past the written chars.
+     */
+    template<typename T_OutputIt>
+    T_OutputIt renderAccountDetails(Handle handle, T_OutputIt out, AccountDetailsFormat format) const;
+
+    /**
+     * @brief Returns the number of accounts in the store.
+     * 
+     * @return std::size_t The number of accounts.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Returns the number of slots of the hash index of the store, whose load factor
+     * is size() / indexCapacity().
+     * 
+     * @return std::size_t The number of slots.
+     */
+    std::size_t indexCapacity() const;
+
+    /**
+     * @brief Returns the sum of the balances of all the accounts.
+     * 
+     * @return std::int64_t The sum of the balances.
+     */
+    std::int64_t totalBalance() const;
+
+    /**
+     * @brief Reserves room for count accounts in the index, so inserting them doesn't rehash it.
+     * 
+     * @param count The number of accounts.
+     */
+    void reserve(std::size_t count);
+
+    /**
+     * @brief Calls function for every account, in no particular order, with the arguments
+     * (const accountIdType& id, AccountKind kind, const std::string& name, const std::string& secondName, int balance),
+     * name and secondName being the first and last name or the Y-tunnus and the company name.
+     * 
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void forEachAccount(T_Function function) const;
+
+    /**
+     * @brief Calls function for an account with the arguments of forEachAccount().
+     * 
+     * @param handle The handle of the account.
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void exportAccount(Handle handle, T_Function function) const;
+
+    /**
+     * @brief Calls function with blocks of up to balanceBlockSize balances of the accounts
+     * passing filter, in no particular order, with the arguments
+     * (const int* balances, const Handle* handles, std::size_t count).
+     * 
+     * @param filter The accounts scanned.
+     * @param function The function.
+     */
+    template<typename T_Function>
+    void forEachBalanceBlock(AccountFilter filter, T_Function function) const;
+
+    /**
+     * @brief Returns the allocation statistics of the accounts.
+     * 
+     * @return AccountAllocationStats The statistics.
+     */
+    AccountAllocationStats allocationStats() const;
+
+private:
+    typedef VariantAccount<AccountId_IdPartType> Account;
+    typedef FlatHashMap<accountIdType, Handle, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > Index;
+
+    Index m_index;
+    ChunkedArray<Account> m_accounts;
+    std::size_t m_personCount;
+};
+
+//IMPLEMENTATION
+template<typename T_Function>
+decltype(auto) VariantAccountStore::visit(Handle handle, T_Function&& function) const {
+
+    return std::visit(std::forward<T_Function>(function), m_accounts[handle]);
+}
+
+template<typename T_OutputIt>
+T_OutputIt VariantAccountStore::renderAccountDetails(Handle handle, T_OutputIt out, AccountDetailsFormat format) const {
+
+    const Account& account = m_accounts[handle];
+    if (const PersonAccountValue<AccountId_IdPartType>* person = std::get_if<PersonAccountValue<AccountId_IdPartType> >(&account)) {
+        return AccountDetailsWriter::write(out, format, AccountKind::Person, person->id(), person->firstName(), person->lastName(), person->balance());
+    }
+    const EnterpriseAccountValue<AccountId_IdPartType>& enterprise = std::get<EnterpriseAccountValue<AccountId_IdPartType> >(account);
+    return AccountDetailsWriter::write(out, format, AccountKind::Enterprise, enterprise.id(), enterprise.yTunnus(), enterprise.companyName(), enterprise.balance());
+}
+
+template<typename T_Function>
+void VariantAccountStore::exportAccount(Handle handle, T_Function function) const {
+
+    const Account& account = m_accounts[handle];
+    if (const PersonAccountValue<AccountId_IdPartType>* person = std::get_if<PersonAccountValue<AccountId_IdPartType> >(&account)) {
+        function(person->id(), AccountKind::Person, person->firstName(), person->lastName(), person->balance());
+    } else {
+        const EnterpriseAccountValue<AccountId_IdPartType>& enterprise = std::get<EnterpriseAccountValue<AccountId_IdPartType> >(account);
+        function(enterprise.id(), AccountKind::Enterprise, enterprise.yTunnus(), enterprise.companyName(), enterprise.balance());
+    }
+}
+
+template<typename T_Function>
+void VariantAccountStore::forEachAccount(T_Function function) const {
+
+    for (std::size_t i = 0; i < m_accounts.size(); ++i) {
+        exportAccount(static_cast<Handle>(i), function);
+    }
+}
+
+template<typename T_Function>
+void VariantAccountStore::forEachBalanceBlock(AccountFilter filter, T_Function function) const {
+
+    BalanceBlockBuffer<Handle, T_Function> buffer(function);
+    for (std::size_t c = 0; c < m_accounts.chunkCount(); ++c) {
+        const Account* accounts = m_accounts.chunk(c);
+        const std::size_t length = m_accounts.chunkLength(c);
+        const Handle first = static_cast<Handle>(c * ChunkedArray<Account>::chunkSize);
+        for (std::size_t i = 0; i < length; ++i) {
+            const AccountKind kind = std::holds_alternative<PersonAccountValue<AccountId_IdPartType> >(accounts[i]) ? AccountKind::Person : AccountKind::Enterprise;
+            buffer.pushIf(matchesFilter(filter, kind), accountValue(accounts[i]).balance(), first + static_cast<Handle>(i));
+        }
+    }
+    buffer.flush();
+}
+
+#endif //H_VARIANT_ACCOUNT_STORE
\ No newline at end of file
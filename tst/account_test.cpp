@@ -7,11 +7,55 @@ LICENSE file in the root directory of this source tree.
 **********************************************************************/
 #include <personAccount.h>
 #include <enterpriseAccount.h>
+#include <accountExecutor.h>
 #include <accountMgr.h>
+#include <accountMetrics.h>
 #include <accountId.h>
+#include <atomicBalance.h>
+#include <balanceAggregates.h>
+#include <batchRunner.h>
+#include <chunkedArray.h>
+#include <csvImport.h>
+#include <flatHashMap.h>
+#include <journal.h>
+#include <mpscQueue.h>
+#include <nodeHashMap.h>
+#include <objectPool.h>
+#include <rcuDomain.h>
+#include <secondaryIndex.h>
+#include <serverProtocol.h>
+#include <singletonUniqueIdGenerator.h>
+#include <snapshot.h>
+#include <stripedBalance.h>
+#include <variantAccount.h>
+#ifdef __linux__
+#include <accountClient.h>
+#include <accountServer.h>
+#endif
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+//The tests of the account managers run for every account store.
+template<typename T_Mgr>
+class AccountMgrTest : public ::testing::Test {
+};
+
+typedef ::testing::Types<AccountMgr, DataOrientedAccountMgr, VariantAccountMgr, NodeAccountMgr> AccountMgrTypes;
+TYPED_TEST_SUITE(AccountMgrTest, AccountMgrTypes);
+
 //PersonAccount
 TEST(PersonAccount, ConstructionAndOperators) {
 
@@ -72,6 +116,31 @@ TEST(PersonAccount, BalanceOperations) {
   EXPECT_EQ(pa.balance(), 5);
 }
 
+TEST(PersonAccount, ConcurrentBalanceOperations) {
+
+  PersonAccount<AccountId_IdPartType> pa;
+  ASSERT_TRUE(pa.addToBalance(1000));
+
+  std::atomic<int> withdrawn(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&pa, &withdrawn]() {
+      for (int i = 0; i < 1000; ++i) {
+        if (pa.decreaseFromBalance(3)) {
+          withdrawn += 3;
+        }
+        EXPECT_GE(pa.balance(), 0);
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(withdrawn.load(), 999);
+  EXPECT_EQ(pa.balance(), 1);
+}
+
 //EnterpriseAccount
 TEST(EnterpriseAccount, ConstructionAndOperators) {
 
@@ -138,23 +207,293 @@ TEST(AccountId, ConstructionAndOperators) {
   ASSERT_EQ(id1.id(), 0);
   ASSERT_EQ(id1.creationDate(), "");
 
-  AccountId<AccountId_IdPartType> id2(100, "XXX");
+  AccountId<AccountId_IdPartType> id2(100, "20230115");
   ASSERT_EQ(id2.id(), 100);
-  ASSERT_EQ(id2.creationDate(), "XXX");
+  ASSERT_EQ(id2.creationDate(), "20230115");
 
   AccountId<AccountId_IdPartType> id3(id2);
   ASSERT_EQ(id3.id(), 100);
-  ASSERT_EQ(id3.creationDate(), "XXX");
+  ASSERT_EQ(id3.creationDate(), "20230115");
 
   id1 = id2;
   ASSERT_EQ(id1.id(), 100);
-  ASSERT_EQ(id1.creationDate(), "XXX");
+  ASSERT_EQ(id1.creationDate(), "20230115");
 
   ASSERT_TRUE(id2 == id3);
   AccountId<AccountId_IdPartType> id4;
   ASSERT_FALSE(id1 == id4);
 }
 
+TEST(AccountId, PackedCreationDate) {
+  AccountId<AccountId_IdPartType> id1(1, "20231231");
+  EXPECT_EQ(id1.packedCreationDate(), 20231231u);
+  AccountId<AccountId_IdPartType> id2(1, 20231231u);
+  EXPECT_TRUE(id1 == id2);
+  EXPECT_EQ(id2.creationDate(), "20231231");
+
+  EXPECT_EQ(accountIdType::parseCreationDate("XXX"), 0u);
+  EXPECT_EQ(accountIdType::parseCreationDate("2023123"), 0u);
+  EXPECT_EQ(accountIdType::parseCreationDate("202312311"), 0u);
+  EXPECT_EQ(accountIdType::parseCreationDate("2023123x"), 0u);
+  EXPECT_EQ(accountIdType::parseCreationDate("20231331"), 0u);
+  EXPECT_EQ(accountIdType::parseCreationDate("20231200"), 0u);
+  EXPECT_EQ(accountIdType::parseCreationDate("00010101"), 10101u);
+  EXPECT_EQ(AccountId<AccountId_IdPartType>(1, "00010101").creationDate(), "00010101");
+}
+
+TEST(AccountId, Hash) {
+  AccountIdHashFunctor<AccountId_IdPartType> hash;
+  EXPECT_EQ(hash(accountIdType(7, "20230101")), hash(accountIdType(7, 20230101u)));
+  EXPECT_NE(hash(accountIdType(7, "20230101")), hash(accountIdType(7, "20230102")));
+  EXPECT_NE(hash(accountIdType(7, "20230101")), hash(accountIdType(8, "20230101")));
+
+  //Low bits must be well distributed, they select the shard and the bucket.
+  std::vector<int> buckets(16, 0);
+  for (AccountId_IdPartType i = 0; i < 16000; ++i) {
+    ++buckets[hash(accountIdType(i, 20230101u)) % 16];
+  }
+  for (int count : buckets) {
+    EXPECT_GT(count, 800);
+    EXPECT_LT(count, 1200);
+  }
+}
+
+//FlatHashMap
+TEST(FlatHashMap, InsertFindErase) {
+  FlatHashMap<accountIdType, std::string, AccountIdHashFunctor<AccountId_IdPartType> > map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.find(accountIdType(1, 20230101u)), map.end());
+
+  const AccountId_IdPartType count = 10000;
+  for (AccountId_IdPartType i = 0; i < count; ++i) {
+    auto r = map.try_emplace(accountIdType(i, 20230101u), std::to_string(i));
+    EXPECT_TRUE(r.second);
+  }
+  EXPECT_EQ(map.size(), static_cast<std::size_t>(count));
+  EXPECT_LE(map.load_factor(), 0.875f);
+  EXPECT_FALSE(map.try_emplace(accountIdType(5, 20230101u), "X").second);
+  EXPECT_EQ(map[accountIdType(5, 20230101u)], "5");
+
+  for (AccountId_IdPartType i = 0; i < count; ++i) {
+    auto it = map.find(accountIdType(i, 20230101u));
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(it->second, std::to_string(i));
+    EXPECT_EQ(map.find(accountIdType(i, 20230102u)), map.end());
+  }
+
+  for (AccountId_IdPartType i = 0; i < count; i += 2) {
+    EXPECT_EQ(map.erase(accountIdType(i, 20230101u)), 1u);
+  }
+  EXPECT_EQ(map.erase(accountIdType(0, 20230101u)), 0u);
+  EXPECT_EQ(map.size(), static_cast<std::size_t>(count / 2));
+  for (AccountId_IdPartType i = 0; i < count; ++i) {
+    EXPECT_EQ(map.find(accountIdType(i, 20230101u)) != map.end(), (i % 2) == 1);
+  }
+
+  std::size_t iterated = 0;
+  for (const auto& entry : map) {
+    EXPECT_EQ(entry.first.id() % 2, 1);
+    ++iterated;
+  }
+  EXPECT_EQ(iterated, map.size());
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(FlatHashMap, ReserveAndMove) {
+  FlatHashMap<accountIdType, std::unique_ptr<int>, AccountIdHashFunctor<AccountId_IdPartType> > map;
+  map.reserve(1000);
+  std::size_t capacity = map.capacity();
+  EXPECT_GE(capacity, 1000u);
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    map[accountIdType(i, 20230101u)].reset(new int(static_cast<int>(i)));
+  }
+  EXPECT_EQ(map.capacity(), capacity);
+
+  FlatHashMap<accountIdType, std::unique_ptr<int>, AccountIdHashFunctor<AccountId_IdPartType> > other(std::move(map));
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(other.size(), 1000u);
+  EXPECT_EQ(*other.find(accountIdType(999, 20230101u))->second, 999);
+}
+
+TEST(FlatHashMap, FindByHash) {
+  FlatHashMap<accountIdType, int, AccountIdHashFunctor<AccountId_IdPartType> > map;
+  map.prefetch(map.hash(accountIdType(1, 20230101u)));
+  map.prefetchCandidates(map.hash(accountIdType(1, 20230101u)));
+
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    map[accountIdType(i, 20230101u)] = static_cast<int>(i);
+  }
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    accountIdType id(i, 20230101u);
+    EXPECT_EQ(map.hash(id), AccountIdHashFunctor<AccountId_IdPartType>()(id));
+    map.prefetch(map.hash(id));
+    map.prefetchCandidates(map.hash(id));
+    auto it = map.find(id, map.hash(id));
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(it->second, static_cast<int>(i));
+  }
+  EXPECT_EQ(map.find(accountIdType(1000, 20230101u), map.hash(accountIdType(1000, 20230101u))), map.end());
+}
+
+TEST(FlatHashMap, TransparentFind) {
+  FlatHashMap<accountIdType, int, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > map;
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    map[accountIdType(i, 20230101u)] = static_cast<int>(i);
+  }
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    auto it = map.find(accountIdViewType{i, "20230101"});
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(it->second, static_cast<int>(i));
+  }
+  EXPECT_EQ(map.find(accountIdViewType{1000, "20230101"}), map.end());
+  EXPECT_EQ(map.find(accountIdViewType{1, "20230102"}), map.end());
+  EXPECT_EQ(map.find(accountIdViewType{1, "2023-01-01"}), map.end());
+}
+
+TEST(FlatHashMap, FindConcurrent) {
+  static int gracePeriods = 0;
+  FlatHashMap<accountIdType, int, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > map;
+  map.setGracePeriod([]() { ++gracePeriods; });
+  int value = -1;
+  EXPECT_FALSE(map.findConcurrent(accountIdType(1, 20230101u), map.hash(accountIdType(1, 20230101u)), value));
+
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    map[accountIdType(i, 20230101u)] = static_cast<int>(i);
+  }
+  EXPECT_GT(gracePeriods, 0);
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    accountIdType id(i, 20230101u);
+    ASSERT_TRUE(map.findConcurrent(id, map.hash(id), value));
+    EXPECT_EQ(value, static_cast<int>(i));
+    ASSERT_TRUE(map.findConcurrent(accountIdViewType{i, "20230101"}, map.hash(id), value));
+    EXPECT_EQ(value, static_cast<int>(i));
+  }
+  EXPECT_FALSE(map.findConcurrent(accountIdType(1000, 20230101u), map.hash(accountIdType(1000, 20230101u)), value));
+
+  FlatHashMap<accountIdType, int, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > other(std::move(map));
+  EXPECT_FALSE(map.findConcurrent(accountIdType(1, 20230101u), map.hash(accountIdType(1, 20230101u)), value));
+  ASSERT_TRUE(other.findConcurrent(accountIdType(1, 20230101u), other.hash(accountIdType(1, 20230101u)), value));
+  EXPECT_EQ(value, 1);
+}
+
+//NodeHashMap
+TEST(NodeHashMap, Find) {
+  NodeHashMap<accountIdType, int, AccountIdHashFunctor<AccountId_IdPartType>, AccountIdEqualFunctor<AccountId_IdPartType> > map;
+  EXPECT_FALSE(decltype(map)::concurrentLookups);
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    map[accountIdType(i, 20230101u)] = static_cast<int>(i);
+  }
+  EXPECT_EQ(map.size(), 1000u);
+  EXPECT_GE(map.capacity(), 1000u);
+  for (AccountId_IdPartType i = 0; i < 1000; ++i) {
+    accountIdType id(i, 20230101u);
+    auto it = map.find(id, 0);
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(it->second, static_cast<int>(i));
+    it = map.find(accountIdViewType{i, "20230101"}, 0);
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(it->second, static_cast<int>(i));
+  }
+  EXPECT_EQ(map.find(accountIdType(1000, 20230101u)), map.end());
+  EXPECT_EQ(map.find(accountIdViewType{1, "20230102"}, 0), map.end());
+
+  //A malformed date builds an AccountId with no date, which the view must not match.
+  map[accountIdType(1, 0u)] = -1;
+  EXPECT_EQ(map.find(accountIdViewType{1, "2023-01-01"}, 0), map.end());
+}
+
+//ObjectPool
+namespace {
+
+struct PoolTracked {
+  static int alive;
+  explicit PoolTracked(int v) : value(v) { ++alive; }
+  ~PoolTracked() { --alive; }
+  int value;
+  std::string text = "a string long enough to need a heap allocation";
+};
+int PoolTracked::alive = 0;
+
+}
+
+TEST(ObjectPool, CreateDestroyAndReuse) {
+  {
+    ObjectPool<PoolTracked> pool;
+    EXPECT_EQ(pool.stats().systemAllocations, 0u);
+
+    std::vector<PoolTracked*> objects;
+    const std::size_t count = ObjectPool<PoolTracked>::objectsPerSlab() * 3 + 1;
+    for (std::size_t i = 0; i < count; ++i) {
+      objects.push_back(pool.create(static_cast<int>(i)));
+    }
+    EXPECT_EQ(PoolTracked::alive, static_cast<int>(count));
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(objects[i]->value, static_cast<int>(i));
+    }
+
+    PoolStats stats = pool.stats();
+    EXPECT_EQ(stats.liveObjects, count);
+    EXPECT_EQ(stats.createdObjects, count);
+    EXPECT_EQ(stats.systemAllocations, 4u);
+    EXPECT_EQ(stats.bytesInUse, count * sizeof(PoolTracked));
+    EXPECT_GE(stats.bytesAllocated, stats.bytesInUse);
+
+    PoolTracked* freed = objects[10];
+    pool.destroy(freed);
+    EXPECT_EQ(PoolTracked::alive, static_cast<int>(count - 1));
+    PoolTracked* reused = pool.create(-1);
+    EXPECT_EQ(reused, freed);
+    EXPECT_EQ(pool.stats().systemAllocations, 4u);
+    EXPECT_EQ(pool.stats().createdObjects, count + 1);
+  }
+  EXPECT_EQ(PoolTracked::alive, 0);
+}
+
+//SingletonUniqueIdGenerator
+TEST(SingletonUniqueIdGenerator, ConcurrentUniqueIds) {
+  SingletonUniqueIdGenerator& generator = SingletonUniqueIdGenerator::instance();
+
+  const int threadCount = 8;
+  const int idsPerThread = 5000;
+  std::vector<std::vector<std::int64_t>> ids(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&generator, &ids, t, idsPerThread]() {
+      for (int i = 0; i < idsPerThread; ++i) {
+        ids[t].push_back(generator.incrementAndReturn());
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  std::vector<std::int64_t> all;
+  for (const std::vector<std::int64_t>& v : ids) {
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+    all.insert(all.end(), v.begin(), v.end());
+  }
+  std::sort(all.begin(), all.end());
+  EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+  EXPECT_GE(generator.highWaterMark(), all.back());
+}
+
+TEST(SingletonUniqueIdGenerator, Seed) {
+  SingletonUniqueIdGenerator& generator = SingletonUniqueIdGenerator::instance();
+
+  const std::int64_t persisted = generator.highWaterMark() + (std::int64_t(1) << 40);
+  generator.seed(persisted);
+  std::int64_t id = generator.incrementAndReturn();
+  EXPECT_GT(id, persisted);
+  EXPECT_GE(generator.highWaterMark(), id);
+
+  generator.seed(1);
+  EXPECT_GT(generator.incrementAndReturn(), id);
+}
+
 TEST(AccountMgr, CreateAccount) {
   AccountMgr mgr;
 
@@ -209,6 +548,1871 @@ TEST(AccountMgr, GetDetails) {
   EXPECT_NE(mgr.getAccountDetails(idp2).find("<ACCOUNT NOT FOUND>"), std::string::npos);
 }
 
+TEST(AccountMgr, HasAccount) {
+  AccountMgr mgr(4);
+
+  accountIdType idp1 = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+  EXPECT_TRUE(mgr.hasAccount(idp1));
+  EXPECT_FALSE(mgr.hasAccount(accountIdType()));
+  EXPECT_FALSE(mgr.hasAccount(accountIdType(idp1.id() + 1, idp1.packedCreationDate())));
+}
+
+TEST(AccountMgr, ConcurrentBalanceOperations) {
+  AccountMgr mgr(16);
+  ASSERT_EQ(mgr.shardCount(), 16u);
+
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 64; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+  }
+
+  const int threadCount = 8;
+  const int rounds = 500;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&mgr, &ids, rounds]() {
+      for (int r = 0; r < rounds; ++r) {
+        for (const accountIdType& id : ids) {
+          EXPECT_TRUE(mgr.topUpAccount(id, 3));
+          EXPECT_TRUE(mgr.withdrawFromAccount(id, 1));
+        }
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  for (const accountIdType& id : ids) {
+    EXPECT_NE(mgr.getAccountDetails(id).find("Balance: " + std::to_string(threadCount * rounds * 2)), std::string::npos);
+  }
+}
+
+TEST(AccountMgr, ConcurrentCreateAccount) {
+  AccountMgr mgr(8);
+
+  const int threadCount = 8;
+  const int accountsPerThread = 200;
+  std::vector<std::vector<accountIdType>> ids(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&mgr, &ids, t, accountsPerThread]() {
+      for (int i = 0; i < accountsPerThread; ++i) {
+        ids[t].push_back(mgr.insertNewEnterpriseAccount("YTunnus" + std::to_string(t * accountsPerThread + i), "CompanyName"));
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  std::vector<AccountId_IdPartType> all;
+  for (const std::vector<accountIdType>& v : ids) {
+    for (const accountIdType& id : v) {
+      all.push_back(id.id());
+      EXPECT_TRUE(mgr.topUpAccount(id, 1));
+    }
+  }
+  std::sort(all.begin(), all.end());
+  EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+}
+
+TEST(AccountMgr, AllocationStats) {
+  AccountMgr mgr(4);
+
+  EXPECT_EQ(mgr.allocationStats().personAccounts.liveObjects, 0u);
+  for (int i = 0; i < 1000; ++i) {
+    mgr.insertNewPersonAccount("FirstName", "LastName");
+  }
+  for (int i = 0; i < 10; ++i) {
+    mgr.insertNewEnterpriseAccount("YTunnus" + std::to_string(i), "CompanyName");
+  }
+
+  AccountAllocationStats stats = mgr.allocationStats();
+  EXPECT_EQ(stats.personAccounts.liveObjects, 1000u);
+  EXPECT_EQ(stats.enterpriseAccounts.liveObjects, 10u);
+  EXPECT_LT(stats.personAccounts.systemAllocations, 100u);
+  EXPECT_LE(stats.enterpriseAccounts.systemAllocations, 4u);
+}
+
+TEST(AccountMgr, SizeAndTotalBalance) {
+  AccountMgr mgr(4);
+
+  const accountIdType& idp = mgr.insertNewPersonAccount("FirstName", "LastName");
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus", "CompanyName");
+  ASSERT_TRUE(mgr.topUpAccount(idp, 100));
+  ASSERT_TRUE(mgr.topUpAccount(ide, 50));
+  ASSERT_TRUE(mgr.withdrawFromAccount(ide, 20));
+
+  EXPECT_EQ(mgr.size(), 2u);
+  EXPECT_EQ(mgr.totalBalance(), 130);
+}
+
+TEST(AccountMgr, Transfer) {
+  AccountMgr mgr(4);
+
+  const accountIdType& id1 = mgr.insertNewPersonAccount("FirstName", "LastName");
+  const accountIdType& id2 = mgr.insertNewEnterpriseAccount("YTunnus", "CompanyName");
+  accountIdType missing(-1, "20230115");
+  ASSERT_TRUE(mgr.topUpAccount(id1, 100));
+
+  EXPECT_TRUE(mgr.transfer(id1, id2, 30));
+  EXPECT_FALSE(mgr.transfer(id1, id2, 71));
+  EXPECT_FALSE(mgr.transfer(id1, id2, -1));
+  EXPECT_FALSE(mgr.transfer(id1, id1, 1));
+  EXPECT_FALSE(mgr.transfer(id1, missing, 1));
+  EXPECT_FALSE(mgr.transfer(missing, id1, 1));
+  EXPECT_NE(mgr.getAccountDetails(id1).find("Balance: 70"), std::string::npos);
+  EXPECT_NE(mgr.getAccountDetails(id2).find("Balance: 30"), std::string::npos);
+
+  //A transfer the destination can't hold leaves both balances as they were.
+  ASSERT_TRUE(mgr.topUpAccount(id2, std::numeric_limits<int>::max() - 30));
+  EXPECT_FALSE(mgr.transfer(id1, id2, 1));
+  EXPECT_NE(mgr.getAccountDetails(id1).find("Balance: 70"), std::string::npos);
+  EXPECT_EQ(mgr.totalBalance(), static_cast<std::int64_t>(std::numeric_limits<int>::max()) + 70);
+}
+
+TEST(AccountMgr, ConcurrentTransfers) {
+  AccountMgr mgr(8);
+
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 32; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+    ASSERT_TRUE(mgr.topUpAccount(ids.back(), 100));
+  }
+
+  const int threadCount = 8;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&mgr, &ids, t]() {
+      for (int i = 0; i < 20000; ++i) {
+        const accountIdType& from = ids[(t * 7 + i * 13) % ids.size()];
+        const accountIdType& to = ids[(t * 5 + i * 11 + 1) % ids.size()];
+        mgr.transfer(from, to, 1 + i % 50);
+        mgr.transfer(to, from, 1 + i % 30);
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(mgr.totalBalance(), 3200);
+}
+
+TEST(AccountMgr, ApplyOperations) {
+  AccountMgr mgr(4);
+
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 100; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+  }
+  accountIdType missing(-1, "20230115");
+
+  std::vector<AccountOperation> operations;
+  for (const accountIdType& id : ids) {
+    operations.push_back({id, 10});
+  }
+  for (const accountIdType& id : ids) {
+    operations.push_back({id, -4});
+  }
+  operations.push_back({ids[0], -7});
+  operations.push_back({ids[1], std::numeric_limits<int>::min()});
+  operations.push_back({missing, 1});
+
+  std::vector<OperationResult> results = mgr.applyOperations(operations);
+  ASSERT_EQ(results.size(), operations.size());
+  for (std::size_t i = 0; i < 2 * ids.size(); ++i) {
+    EXPECT_EQ(results[i], OperationResult::Applied);
+  }
+  EXPECT_EQ(results[2 * ids.size()], OperationResult::Rejected);
+  EXPECT_EQ(results[2 * ids.size() + 1], OperationResult::Rejected);
+  EXPECT_EQ(results[2 * ids.size() + 2], OperationResult::AccountNotFound);
+  EXPECT_EQ(mgr.totalBalance(), 600);
+
+  EXPECT_TRUE(mgr.applyOperations(nullptr, 0).empty());
+}
+
+TEST(AccountMgr, LookupByView) {
+  AccountMgr mgr(4);
+  const accountIdType id = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+  const std::string date = id.creationDate();
+
+  EXPECT_EQ(AccountIdHashFunctor<AccountId_IdPartType>()(accountIdViewType{id.id(), date}), AccountIdHashFunctor<AccountId_IdPartType>()(id));
+  EXPECT_TRUE(AccountIdEqualFunctor<AccountId_IdPartType>()(id, accountIdViewType{id.id(), date}));
+  EXPECT_FALSE(AccountIdEqualFunctor<AccountId_IdPartType>()(id, accountIdViewType{id.id() + 1, date}));
+
+  EXPECT_TRUE(mgr.topUpAccount(accountIdViewType{id.id(), date}, 10));
+  EXPECT_TRUE(mgr.withdrawFromAccount(accountIdViewType{id.id(), date}, 4));
+  EXPECT_FALSE(mgr.withdrawFromAccount(accountIdViewType{id.id(), date}, 7));
+  EXPECT_EQ(mgr.getAccountDetails(accountIdViewType{id.id(), date}), mgr.getAccountDetails(id));
+  EXPECT_NE(mgr.getAccountDetails(id).find("Balance: 6"), std::string::npos);
+
+  EXPECT_FALSE(mgr.topUpAccount(accountIdViewType{id.id() + 1, date}, 1));
+  EXPECT_FALSE(mgr.topUpAccount(accountIdViewType{id.id(), "2023011"}, 1));
+  EXPECT_FALSE(mgr.topUpAccount(accountIdViewType{id.id(), "not a date"}, 1));
+  EXPECT_EQ(mgr.getAccountDetails(accountIdViewType{id.id(), "00000000"}), "<ACCOUNT NOT FOUND>");
+}
+
+TEST(DataOrientedAccountMgr, ApplyOperations) {
+  DataOrientedAccountMgr mgr(4);
+
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 1000; ++i) {
+    ids.push_back(mgr.insertNewEnterpriseAccount("YTunnus" + std::to_string(i), "CompanyName"));
+  }
+
+  std::vector<AccountOperation> operations;
+  for (int round = 0; round < 3; ++round) {
+    for (const accountIdType& id : ids) {
+      operations.push_back({id, 2});
+      operations.push_back({id, -1});
+    }
+  }
+  std::vector<OperationResult> results = mgr.applyOperations(operations);
+  EXPECT_EQ(std::count(results.begin(), results.end(), OperationResult::Applied), static_cast<std::ptrdiff_t>(operations.size()));
+  EXPECT_EQ(mgr.totalBalance(), 3000);
+  EXPECT_NE(mgr.getAccountDetails(ids[999]).find("Balance: 3"), std::string::npos);
+}
+
+//AtomicBalance
+TEST(AtomicBalance, Operations) {
+  AtomicBalance b;
+  EXPECT_EQ(b.value(), 0);
+  EXPECT_TRUE(b.add(10));
+  EXPECT_FALSE(b.add(-1));
+  EXPECT_FALSE(b.decrease(11));
+  EXPECT_FALSE(b.decrease(-1));
+  EXPECT_TRUE(b.decrease(10));
+  EXPECT_EQ(b.value(), 0);
+}
+
+TEST(AtomicBalance, NoOverflow) {
+  AtomicBalance b(std::numeric_limits<int>::max() - 1);
+  EXPECT_FALSE(b.add(2));
+  EXPECT_TRUE(b.add(1));
+  EXPECT_EQ(b.value(), std::numeric_limits<int>::max());
+  EXPECT_FALSE(b.hot());
+}
+
+TEST(AtomicBalance, HotBalance) {
+  const std::size_t inUse = StripedBalancePool::instance().inUse();
+  {
+    AtomicBalance b(100);
+    ASSERT_TRUE(b.makeHot());
+    EXPECT_TRUE(b.hot());
+    EXPECT_TRUE(b.makeHot());
+    EXPECT_EQ(StripedBalancePool::instance().inUse(), inUse + 1);
+    EXPECT_EQ(b.value(), 100);
+    EXPECT_TRUE(b.add(50));
+    EXPECT_FALSE(b.add(-1));
+    EXPECT_FALSE(b.decrease(151));
+    EXPECT_FALSE(b.decrease(-1));
+    EXPECT_EQ(b.value(), 150);
+
+    //Every thread gets its own stripe: the credits of one are borrowed by the withdrawals of
+    //the others, and the withdrawals never take more than the balance.
+    const int threadCount = 8;
+    std::atomic<int> withdrawn(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&b, &withdrawn, t]() {
+        for (int i = 0; i < 1000; ++i) {
+          if (t % 2 == 0) {
+            b.add(1);
+          } else if (b.decrease(3)) {
+            withdrawn += 3;
+          }
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(b.value(), 150 + 4000 - withdrawn.load());
+    EXPECT_GE(b.value(), 0);
+    while (b.decrease(1)) {}
+    EXPECT_EQ(b.value(), 0);
+  }
+  EXPECT_EQ(StripedBalancePool::instance().inUse(), inUse);
+}
+
+TEST(AtomicBalance, HotNoOverflow) {
+  AtomicBalance b(std::numeric_limits<int>::max() - 1000);
+  ASSERT_TRUE(b.makeHot());
+  EXPECT_FALSE(b.add(1001));
+  EXPECT_EQ(b.value(), std::numeric_limits<int>::max() - 1000);
+
+  //Every thread credits its own stripe, so the headroom must be gathered from the first one,
+  //and the credits stop exactly at INT_MAX.
+  const int threadCount = 8;
+  std::atomic<int> added(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&b, &added]() {
+      for (int i = 0; i < 200; ++i) {
+        if (b.add(1)) {
+          ++added;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(added.load(), 1000);
+  EXPECT_EQ(b.value(), std::numeric_limits<int>::max());
+  EXPECT_FALSE(b.add(1));
+  EXPECT_TRUE(b.decrease(10));
+  EXPECT_TRUE(b.add(10));
+  EXPECT_EQ(b.value(), std::numeric_limits<int>::max());
+}
+
+TEST(AtomicBalance, AutoPromotion) {
+  //Whether the balance is promoted depends on the cores, not the totals.
+  AtomicBalance::setAutoPromotion(true);
+  AtomicBalance b;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&b]() {
+      for (int i = 0; i < 100000; ++i) {
+        b.add(2);
+        b.decrease(1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  AtomicBalance::setAutoPromotion(false);
+  EXPECT_EQ(b.value(), 400000);
+}
+
+//ChunkedArray
+TEST(ChunkedArray, StableAddresses) {
+  ChunkedArray<int, 4> a;
+  EXPECT_EQ(a.size(), 0u);
+  EXPECT_EQ(a.chunkCount(), 0u);
+
+  EXPECT_EQ(a.emplace_back(0), 0u);
+  const int* first = &a[0];
+  for (int i = 1; i < 100; ++i) {
+    EXPECT_EQ(a.emplace_back(i), static_cast<std::size_t>(i));
+  }
+  EXPECT_EQ(&a[0], first);
+  EXPECT_EQ(a.size(), 100u);
+  EXPECT_EQ(a.chunkCount(), 7u);
+  EXPECT_EQ(a.chunkLength(0), 16u);
+  EXPECT_EQ(a.chunkLength(6), 4u);
+
+  int sum = 0;
+  for (std::size_t c = 0; c < a.chunkCount(); ++c) {
+    for (std::size_t i = 0; i < a.chunkLength(c); ++i) {
+      sum += a.chunk(c)[i];
+    }
+  }
+  EXPECT_EQ(sum, 4950);
+}
+
+//DataOrientedAccountMgr
+TEST(DataOrientedAccountMgr, BalanceAndDetails) {
+  DataOrientedAccountMgr mgr(4);
+
+  const accountIdType& idp = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus1", "CompanyName1");
+  accountIdType missing(-1, "20230115");
+
+  EXPECT_TRUE(mgr.topUpAccount(idp, 100));
+  EXPECT_FALSE(mgr.topUpAccount(idp, -1));
+  EXPECT_FALSE(mgr.withdrawFromAccount(idp, 101));
+  EXPECT_TRUE(mgr.withdrawFromAccount(idp, 40));
+  EXPECT_TRUE(mgr.topUpAccount(ide, 5));
+  EXPECT_FALSE(mgr.topUpAccount(missing, 1));
+  EXPECT_FALSE(mgr.withdrawFromAccount(missing, 1));
+
+  std::string details = mgr.getAccountDetails(idp);
+  EXPECT_NE(details.find("Account type: Person"), std::string::npos);
+  EXPECT_NE(details.find("First Name: FirstName1"), std::string::npos);
+  EXPECT_NE(details.find("Last Name: LastName1"), std::string::npos);
+  EXPECT_NE(details.find("Balance: 60"), std::string::npos);
+
+  details = mgr.getAccountDetails(ide);
+  EXPECT_NE(details.find("Account type: Enterprise"), std::string::npos);
+  EXPECT_NE(details.find("Company Name: CompanyName1"), std::string::npos);
+  EXPECT_NE(details.find("Balance: 5"), std::string::npos);
+
+  EXPECT_EQ(mgr.getAccountDetails(missing), "<ACCOUNT NOT FOUND>");
+  EXPECT_EQ(mgr.size(), 2u);
+  EXPECT_EQ(mgr.totalBalance(), 65);
+
+  AccountAllocationStats stats = mgr.allocationStats();
+  EXPECT_EQ(stats.personAccounts.liveObjects, 1u);
+  EXPECT_EQ(stats.enterpriseAccounts.liveObjects, 1u);
+  EXPECT_EQ(stats.columns.liveObjects, 2u);
+}
+
+TEST(DataOrientedAccountMgr, ConcurrentInsertAndBalanceOperations) {
+  DataOrientedAccountMgr mgr(8);
+
+  const int threadCount = 8;
+  const int accountsPerThread = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&mgr, accountsPerThread]() {
+      for (int i = 0; i < accountsPerThread; ++i) {
+        const accountIdType& id = mgr.insertNewPersonAccount("FirstName", "LastName");
+        EXPECT_TRUE(mgr.topUpAccount(id, 3));
+        EXPECT_TRUE(mgr.withdrawFromAccount(id, 1));
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(mgr.size(), static_cast<std::size_t>(threadCount * accountsPerThread));
+  EXPECT_EQ(mgr.totalBalance(), threadCount * accountsPerThread * 2);
+}
+
+//VariantAccount
+TEST(VariantAccount, DispatchAndDetails) {
+  accountIdType id(7, "20230115");
+  VariantAccount<AccountId_IdPartType> person(std::in_place_type<PersonAccountValue<AccountId_IdPartType> >, id, "FirstName1", "LastName1");
+  VariantAccount<AccountId_IdPartType> enterprise(std::in_place_type<EnterpriseAccountValue<AccountId_IdPartType> >, id, "YTunnus1", "CompanyName1");
+
+  EXPECT_TRUE(accountValue(person).addToBalance(10));
+  EXPECT_FALSE(accountValue(person).decreaseFromBalance(11));
+  EXPECT_TRUE(accountValue(person).decreaseFromBalance(4));
+  EXPECT_EQ(accountValue(person).balance(), 6);
+  EXPECT_EQ(accountValue(enterprise).id(), id);
+
+  //The static rendering matches the one of the Visitor.
+  PersonAccount<AccountId_IdPartType> virtualPerson;
+  virtualPerson.setId(id);
+  virtualPerson.setFirstName("FirstName1");
+  virtualPerson.setLastName("LastName1");
+  virtualPerson.addToBalance(6);
+  AccountDetailsVisitor<AccountId_IdPartType> visitor;
+  virtualPerson.accept(&visitor);
+  EXPECT_EQ(std::visit(AccountDetailsRenderer<AccountId_IdPartType>(), person), visitor.accountDetails());
+  EXPECT_NE(std::visit(AccountDetailsRenderer<AccountId_IdPartType>(), enterprise).find("Y-Tunnus: YTunnus1"), std::string::npos);
+}
+
+TEST(VariantAccountMgr, BalanceAndDetails) {
+  VariantAccountMgr mgr(4);
+
+  const accountIdType& idp = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus1", "CompanyName1");
+  accountIdType missing(-1, "20230115");
+
+  EXPECT_TRUE(mgr.topUpAccount(idp, 100));
+  EXPECT_FALSE(mgr.withdrawFromAccount(idp, 101));
+  EXPECT_TRUE(mgr.withdrawFromAccount(idp, 40));
+  EXPECT_TRUE(mgr.transfer(idp, ide, 10));
+  EXPECT_FALSE(mgr.topUpAccount(missing, 1));
+
+  std::string details = mgr.getAccountDetails(idp);
+  EXPECT_NE(details.find("Account type: Person"), std::string::npos);
+  EXPECT_NE(details.find("Last Name: LastName1"), std::string::npos);
+  EXPECT_NE(details.find("Balance: 50"), std::string::npos);
+
+  details = mgr.getAccountDetails(ide);
+  EXPECT_NE(details.find("Account type: Enterprise"), std::string::npos);
+  EXPECT_NE(details.find("Company Name: CompanyName1"), std::string::npos);
+  EXPECT_NE(details.find("Balance: 10"), std::string::npos);
+
+  EXPECT_EQ(mgr.getAccountDetails(missing), "<ACCOUNT NOT FOUND>");
+  EXPECT_EQ(mgr.size(), 2u);
+  EXPECT_EQ(mgr.totalBalance(), 60);
+
+  std::vector<AccountOperation> operations = { {idp, 5}, {ide, -20}, {missing, 1} };
+  std::vector<OperationResult> results = mgr.applyOperations(operations);
+  EXPECT_EQ(results[0], OperationResult::Applied);
+  EXPECT_EQ(results[1], OperationResult::Rejected);
+  EXPECT_EQ(results[2], OperationResult::AccountNotFound);
+
+  AccountAllocationStats stats = mgr.allocationStats();
+  EXPECT_EQ(stats.personAccounts.liveObjects, 1u);
+  EXPECT_EQ(stats.enterpriseAccounts.liveObjects, 1u);
+}
+
+TEST(NodeAccountMgr, BalanceAndDetails) {
+  NodeAccountMgr mgr(4);
+
+  const accountIdType& idp = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus1", "CompanyName1");
+  accountIdType missing(-1, "20230115");
+
+  EXPECT_TRUE(mgr.topUpAccount(idp, 100));
+  EXPECT_FALSE(mgr.withdrawFromAccount(idp, 101));
+  EXPECT_TRUE(mgr.withdrawFromAccount(idp, 40));
+  EXPECT_TRUE(mgr.transfer(idp, ide, 10));
+  EXPECT_FALSE(mgr.topUpAccount(missing, 1));
+
+  EXPECT_NE(mgr.getAccountDetails(idp).find("Balance: 50"), std::string::npos);
+  EXPECT_NE(mgr.getAccountDetails(accountIdViewType{ide.id(), ide.creationDate()}).find("Company Name: CompanyName1"), std::string::npos);
+  EXPECT_EQ(mgr.getAccountDetails(missing), "<ACCOUNT NOT FOUND>");
+  EXPECT_EQ(mgr.size(), 2u);
+  EXPECT_EQ(mgr.totalBalance(), 60);
+
+  std::vector<AccountOperation> operations = { {idp, 5}, {ide, -20}, {missing, 1} };
+  std::vector<OperationResult> results = mgr.applyOperations(operations);
+  EXPECT_EQ(results[0], OperationResult::Applied);
+  EXPECT_EQ(results[1], OperationResult::Rejected);
+  EXPECT_EQ(results[2], OperationResult::AccountNotFound);
+}
+
+//AccountDetails
+TYPED_TEST(AccountMgrTest, RenderAccountDetails) {
+  TypeParam mgr(4);
+  const accountIdType& idp = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus1", "Company \"One\"\\\n");
+  mgr.topUpAccount(idp, 1234);
+  const std::string id = std::to_string(idp.id());
+
+  //The text is the one of the former ostringstream rendering, byte for byte.
+  const std::string text = "Account type: Person\nAccount Id: id: " + id + ", creation date: \"" + idp.creationDate() + "\"\n"
+    "First Name: FirstName1\nLast Name: LastName1\nBalance: 1234\n";
+  EXPECT_EQ(mgr.getAccountDetails(idp), text);
+
+  char buffer[512];
+  std::optional<char*> end = mgr.renderAccountDetails(idp, buffer);
+  ASSERT_TRUE(end.has_value());
+  EXPECT_EQ(std::string(buffer, *end), text);
+  EXPECT_FALSE(mgr.renderAccountDetails(accountIdType(-1, "20230115"), buffer).has_value());
+
+  EXPECT_EQ(mgr.renderAccountDetails(idp, buffer, 10), text.size());
+  EXPECT_EQ(std::string(buffer, 10), text.substr(0, 10));
+  EXPECT_EQ(mgr.renderAccountDetails(accountIdType(-1, "20230115"), buffer, sizeof(buffer)), 0u);
+
+  std::string json;
+  mgr.renderAccountDetails(idp, std::back_inserter(json), AccountDetailsFormat::Json);
+  EXPECT_EQ(json, "{\"type\":\"person\",\"id\":" + id + ",\"creationDate\":\"" + idp.creationDate() + "\",\"firstName\":\"FirstName1\",\"lastName\":\"LastName1\",\"balance\":1234}");
+
+  json.clear();
+  mgr.renderAccountDetails(ide, std::back_inserter(json), AccountDetailsFormat::Json);
+  EXPECT_NE(json.find("\"type\":\"enterprise\""), std::string::npos);
+  EXPECT_NE(json.find("\"yTunnus\":\"YTunnus1\",\"companyName\":\"Company \\\"One\\\"\\\\\\u000a\""), std::string::npos);
+
+  //Details longer than the buffer on the stack of getAccountDetails().
+  const std::string longName(1000, 'x');
+  const accountIdType& idLong = mgr.insertNewPersonAccount(longName, "LastName");
+  EXPECT_NE(mgr.getAccountDetails(idLong).find("First Name: " + longName + "\n"), std::string::npos);
+}
+
+//Journal
+TEST(Journal, ReplayAfterRestart) {
+  const std::string path = ::testing::TempDir() + "account_test_replay.journal";
+  std::remove(path.c_str());
+
+  accountIdType idp;
+  accountIdType ide;
+  {
+    Journal journal(path);
+    AccountMgr mgr(4);
+    mgr.attachJournal(&journal);
+    idp = mgr.insertNewPersonAccount("FirstName1", "LastName1");
+    ide = mgr.insertNewEnterpriseAccount("YTunnus1", "CompanyName1");
+    ASSERT_TRUE(mgr.topUpAccount(idp, 100));
+    ASSERT_TRUE(mgr.withdrawFromAccount(idp, 30));
+    ASSERT_FALSE(mgr.withdrawFromAccount(idp, 1000));
+    ASSERT_TRUE(mgr.transfer(idp, ide, 20));
+    mgr.applyOperations({{ide, 5}, {ide, -1000}});
+    EXPECT_EQ(journal.stats().records, 6u);
+  }
+
+  AccountMgr recovered(2);
+  EXPECT_EQ(recovered.replayJournal(path).records, 6u);
+  EXPECT_EQ(recovered.size(), 2u);
+  EXPECT_EQ(recovered.totalBalance(), 75);
+  EXPECT_NE(recovered.getAccountDetails(idp).find("First Name: FirstName1"), std::string::npos);
+  EXPECT_NE(recovered.getAccountDetails(idp).find("Balance: 50"), std::string::npos);
+  EXPECT_NE(recovered.getAccountDetails(ide).find("Company Name: CompanyName1"), std::string::npos);
+  EXPECT_NE(recovered.getAccountDetails(ide).find("Balance: 25"), std::string::npos);
+  EXPECT_GT(recovered.insertNewPersonAccount("FirstName2", "LastName2").id(), std::max(idp.id(), ide.id()));
+
+  std::remove(path.c_str());
+}
+
+TEST(Journal, TornTail) {
+  const std::string path = ::testing::TempDir() + "account_test_torn.journal";
+  std::remove(path.c_str());
+
+  accountIdType id;
+  {
+    Journal journal(path);
+    AccountMgr mgr;
+    mgr.attachJournal(&journal);
+    id = mgr.insertNewPersonAccount("FirstName", "LastName");
+    ASSERT_TRUE(mgr.topUpAccount(id, 10));
+  }
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out.write("\x20\x00\x00\x00garbage", 11);
+  }
+  {
+    AccountMgr mgr;
+    EXPECT_EQ(mgr.replayJournal(path).records, 2u);
+    Journal journal(path);
+    mgr.attachJournal(&journal);
+    ASSERT_TRUE(mgr.topUpAccount(id, 5));
+  }
+
+  AccountMgr recovered;
+  EXPECT_EQ(recovered.replayJournal(path).records, 3u);
+  EXPECT_EQ(recovered.totalBalance(), 15);
+
+  std::remove(path.c_str());
+}
+
+TEST(Journal, GroupCommit) {
+  const std::string path = ::testing::TempDir() + "account_test_group.journal";
+  std::remove(path.c_str());
+
+  JournalOptions options;
+  options.maxDelay = std::chrono::milliseconds(2);
+  AccountMgr mgr(8);
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 8; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+  }
+  {
+    Journal journal(path, options);
+    mgr.attachJournal(&journal);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+      threads.emplace_back([&mgr, &ids, t]() {
+        for (int i = 0; i < 50; ++i) {
+          EXPECT_TRUE(mgr.topUpAccount(ids[t], 1));
+        }
+      });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    mgr.attachJournal(nullptr);
+
+    JournalStats stats = journal.stats();
+    EXPECT_EQ(stats.records, 400u);
+    EXPECT_LT(stats.batches, stats.records);
+    EXPECT_FALSE(journal.failed());
+  }
+
+  std::size_t records = 0;
+  JournalReader reader(path);
+  JournalRecord record;
+  while (reader.next(record)) {
+    EXPECT_EQ(record.type, JournalRecordType::BalanceChange);
+    EXPECT_EQ(record.amount, 1);
+    ++records;
+  }
+  EXPECT_EQ(records, 400u);
+
+  std::remove(path.c_str());
+}
+
+TEST(Journal, ChangesInOrderPerAccount) {
+  const std::string path = ::testing::TempDir() + "account_test_order.journal";
+  std::remove(path.c_str());
+
+  AccountMgr mgr(4);
+  const accountIdType id = mgr.insertNewPersonAccount("FirstName", "LastName");
+  {
+    Journal journal(path);
+    mgr.attachJournal(&journal);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&mgr, &id]() {
+        for (int i = 0; i < 200; ++i) {
+          EXPECT_TRUE(mgr.topUpAccount(id, 1));
+          EXPECT_TRUE(mgr.withdrawFromAccount(id, 1));
+        }
+      });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    mgr.attachJournal(nullptr);
+  }
+
+  //Every withdrawal is logged after the top-up it spends, so no prefix goes below 0.
+  std::int64_t balance = 0;
+  JournalReader reader(path);
+  JournalRecord record;
+  while (reader.next(record)) {
+    balance += record.amount;
+    ASSERT_GE(balance, 0);
+  }
+  EXPECT_EQ(balance, 0);
+
+  std::remove(path.c_str());
+}
+
+TEST(Journal, NegativeBalanceReported) {
+  const std::string path = ::testing::TempDir() + "account_test_negative.journal";
+  std::remove(path.c_str());
+
+  const accountIdType spent(1, 20230101u);
+  const accountIdType kept(2, 20230101u);
+  {
+    Journal journal(path);
+    journal.logPersonAccount(spent, "FirstName1", "LastName1");
+    journal.logPersonAccount(kept, "FirstName2", "LastName2");
+    journal.logBalanceChange(spent, -50);
+    journal.logBalanceChange(kept, 10);
+  }
+
+  AccountMgr recovered;
+  JournalReplayStats replay = recovered.replayJournal(path);
+  EXPECT_EQ(replay.records, 4u);
+  EXPECT_EQ(replay.negativeBalances, std::vector<accountIdType>{spent});
+  EXPECT_EQ(recovered.totalBalance(), 10);
+
+  std::remove(path.c_str());
+}
+
+//Snapshot
+TYPED_TEST(AccountMgrTest, SnapshotRoundTrip) {
+  const std::string path = ::testing::TempDir() + "account_test.snapshot";
+  TypeParam mgr(8);
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 500; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName" + std::to_string(i), "LastName"));
+    ASSERT_TRUE(mgr.topUpAccount(ids.back(), i));
+  }
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus1", "A company name longer than the small string buffer");
+  ASSERT_TRUE(mgr.topUpAccount(ide, 7));
+  ASSERT_TRUE(mgr.saveSnapshot(path));
+
+  TypeParam loaded(3);
+  ASSERT_TRUE(loaded.loadSnapshot(path, 2));
+  EXPECT_EQ(loaded.size(), mgr.size());
+  EXPECT_EQ(loaded.totalBalance(), mgr.totalBalance());
+  EXPECT_EQ(loaded.getAccountDetails(ids[123]), mgr.getAccountDetails(ids[123]));
+  EXPECT_EQ(loaded.getAccountDetails(ide), mgr.getAccountDetails(ide));
+  EXPECT_GT(loaded.insertNewPersonAccount("FirstName", "LastName").id(), ide.id());
+  std::remove(path.c_str());
+}
+
+TEST(Snapshot, InvalidFiles) {
+  const std::string path = ::testing::TempDir() + "account_test_invalid.snapshot";
+  std::remove(path.c_str());
+
+  AccountMgr mgr;
+  EXPECT_FALSE(mgr.loadSnapshot(path));
+
+  mgr.topUpAccount(mgr.insertNewPersonAccount("FirstName", "LastName"), 5);
+  ASSERT_TRUE(mgr.saveSnapshot(path));
+  {
+    SnapshotReader reader(path);
+    ASSERT_TRUE(reader.valid());
+    EXPECT_EQ(reader.header().version, snapshotVersion);
+    EXPECT_EQ(reader.header().accountCount, 1u);
+  }
+
+  std::string content;
+  {
+    std::ifstream in(path, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), static_cast<std::streamsize>(content.size() - 8));
+  }
+  AccountMgr truncated;
+  EXPECT_FALSE(truncated.loadSnapshot(path));
+  EXPECT_EQ(truncated.size(), 0u);
+
+  content[8] = 2;
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+  }
+  EXPECT_FALSE(truncated.loadSnapshot(path));
+
+  std::remove(path.c_str());
+}
+
+//CsvImport
+TEST(CsvImport, ImportFile) {
+  const std::string path = ::testing::TempDir() + "account_test_import.csv";
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << "type,name,second name\r\n"
+        << "person,FirstName1,LastName1\r\n"
+        << "enterprise,YTunnus1,\"Company \"\"One\"\", Oy\"\n"
+        << "\n"
+        << "person,OnlyName\n"
+        << "customer,Name,Name\n"
+        << "person,\"Unterminated,LastName\n"
+        << "enterprise,YTunnus2,CompanyName2";
+  }
+
+  for (std::size_t threadCount : {1, 3}) {
+    BasicAccountMgr<DataOrientedAccountStore> mgr(4);
+    CsvImportResult result = mgr.importCsv(path, threadCount);
+    ASSERT_TRUE(result.fileRead);
+    ASSERT_EQ(result.ids.size(), 6u);
+    EXPECT_EQ(mgr.size(), 3u);
+
+    EXPECT_NE(mgr.getAccountDetails(result.ids[0]).find("First Name: FirstName1"), std::string::npos);
+    EXPECT_NE(mgr.getAccountDetails(result.ids[1]).find("Company \"One\", Oy"), std::string::npos);
+    EXPECT_NE(mgr.getAccountDetails(result.ids[5]).find("Y-Tunnus: YTunnus2"), std::string::npos);
+    EXPECT_LT(result.ids[0].id(), result.ids[1].id());
+    EXPECT_LT(result.ids[1].id(), result.ids[5].id());
+    EXPECT_EQ(result.ids[2], accountIdType());
+
+    ASSERT_EQ(result.errors.size(), 3u);
+    EXPECT_EQ(result.errors[0].line, 5u);
+    EXPECT_EQ(result.errors[0].row, "person,OnlyName");
+    EXPECT_EQ(result.errors[1].line, 6u);
+    EXPECT_EQ(result.errors[2].line, 7u);
+    EXPECT_EQ(result.errors[2].row, "person,\"Unterminated,LastName");
+  }
+
+  AccountMgr mgr;
+  EXPECT_FALSE(mgr.importCsv(path + ".missing").fileRead);
+
+  std::remove(path.c_str());
+}
+
+TEST(CsvImport, BlocksAndChunks) {
+  const std::string path = ::testing::TempDir() + "account_test_blocks.csv";
+  std::string expected;
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    for (int i = 0; i < 100; ++i) {
+      const std::string line = "person,First" + std::to_string(i) + "," + std::string(static_cast<std::size_t>(i + 1), 'x') + "\n";
+      out << line;
+      expected += line;
+    }
+  }
+
+  //Blocks smaller than the lines grow to hold them and always end at a line end.
+  CsvBlockReader reader(path, 16);
+  ASSERT_TRUE(reader.isOpen());
+  std::string content;
+  char* begin;
+  char* end;
+  while (reader.next(begin, end)) {
+    EXPECT_EQ(end[-1], '\n');
+    content.append(begin, end);
+  }
+  EXPECT_EQ(content, expected);
+
+  std::vector<char*> limits = splitCsvBlock(&content[0], &content[0] + content.size(), 7);
+  ASSERT_EQ(limits.size(), 8u);
+  std::size_t rows = 0;
+  CsvChunkParser parser;
+  for (std::size_t c = 0; c < 7; ++c) {
+    EXPECT_TRUE((limits[c] == &content[0]) || (limits[c][-1] == '\n'));
+    parser.parse(limits[c], limits[c + 1], 1, false);
+    EXPECT_TRUE(parser.errors().empty());
+    rows += parser.rows().size();
+  }
+  EXPECT_EQ(rows, 100u);
+
+  std::remove(path.c_str());
+}
+
+//BatchRunner
+TEST(BatchRunner, Execute) {
+  AccountMgr mgr;
+  BatchRunner runner(mgr);
+
+  std::string out;
+  EXPECT_TRUE(runner.execute("P FirstName1 LastName1", out));
+  const std::string idLine = out.substr(0, out.size() - 1);
+  const std::string id = idLine.substr(0, idLine.find(' '));
+  const std::string date = idLine.substr(idLine.find(' ') + 1);
+  ASSERT_EQ(date.size(), 8u);
+  out.clear();
+  EXPECT_TRUE(runner.execute("E YTunnus1 CompanyName1", out));
+  const std::string otherLine = out.substr(0, out.size() - 1);
+
+  out.clear();
+  EXPECT_TRUE(runner.execute("", out));
+  EXPECT_TRUE(runner.execute("# comment", out));
+  EXPECT_TRUE(out.empty());
+
+  EXPECT_TRUE(runner.execute("T " + idLine + " 100", out));
+  EXPECT_TRUE(runner.execute("W\t" + idLine + "\t30", out));
+  EXPECT_FALSE(runner.execute("W " + idLine + " 1000", out));
+  EXPECT_TRUE(runner.execute("X " + idLine + " " + otherLine + " 20", out));
+  EXPECT_EQ(out, "OK\nOK\nERR rejected\nOK\n");
+
+  out.clear();
+  EXPECT_TRUE(runner.execute("D " + idLine, out));
+  EXPECT_NE(out.find("\"balance\":50"), std::string::npos);
+  EXPECT_EQ(out.find('\n'), out.size() - 1);
+
+  out.clear();
+  EXPECT_FALSE(runner.execute("T " + id + " 2023 10", out));
+  EXPECT_FALSE(runner.execute("T " + idLine + " -5", out));
+  EXPECT_FALSE(runner.execute("T " + idLine, out));
+  EXPECT_FALSE(runner.execute("D 999999999 " + date, out));
+  EXPECT_FALSE(runner.execute("Q", out));
+  EXPECT_FALSE(runner.execute("P OnlyName", out));
+  EXPECT_EQ(out, "ERR bad account id\nERR bad amount\nERR bad amount\nERR account not found\nERR unknown command\nERR missing name\n");
+
+  out.clear();
+  EXPECT_TRUE(runner.execute("M", out));
+  EXPECT_EQ(out.find("{\"enabled\":"), 0u);
+  EXPECT_NE(out.find("\"accounts\":2,"), std::string::npos);
+  EXPECT_EQ(out.find('\n'), out.size() - 1);
+}
+
+TEST(BatchRunner, RunFile) {
+  const std::string inPath = ::testing::TempDir() + "account_test_batch.txt";
+  const std::string outPath = ::testing::TempDir() + "account_test_batch.out";
+  {
+    std::ofstream in(inPath, std::ios::binary | std::ios::trunc);
+    in << "# accounts\r\n";
+    for (int i = 0; i < 1000; ++i) {
+      in << "P First" << i << " Last" << i << "\n";
+    }
+    in << "Q";
+  }
+
+  AccountMgr mgr;
+  std::FILE* in = std::fopen(inPath.c_str(), "rb");
+  std::FILE* out = std::fopen(outPath.c_str(), "wb");
+  ASSERT_NE(in, nullptr);
+  ASSERT_NE(out, nullptr);
+  BatchStats stats = BatchRunner(mgr).run(in, out);
+  std::fclose(in);
+  std::fclose(out);
+
+  EXPECT_EQ(stats.commands, 1001u);
+  EXPECT_EQ(stats.failed, 1u);
+  EXPECT_EQ(mgr.size(), 1000u);
+  std::ifstream results(outPath, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(results)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(std::count(content.begin(), content.end(), '\n'), 1001);
+  EXPECT_EQ(content.substr(content.size() - 20), "ERR unknown command\n");
+
+  std::remove(inPath.c_str());
+  std::remove(outPath.c_str());
+}
+
+//ServerProtocol
+TEST(ServerProtocol, RoundTrip) {
+  const accountIdType id(42, 20230115u);
+  const accountIdType to(43, 20230116u);
+  std::string frames;
+  encodeCreateRequest(frames, 1, RequestType::CreateEnterprise, "YTunnus1", "CompanyName1");
+  encodeBalanceRequest(frames, 2, RequestType::Withdraw, id, 250);
+  encodeTransferRequest(frames, 3, id, to, 7);
+  encodeDetailsRequest(frames, 4, id);
+
+  Request request;
+  std::size_t frameSize;
+  const char* p = frames.data();
+  std::size_t left = frames.size();
+  //Every prefix of a frame is incomplete.
+  for (std::size_t i = 0; i < 20; ++i) {
+    EXPECT_EQ(decodeRequest(p, i, request, frameSize), FrameResult::Incomplete);
+  }
+  ASSERT_EQ(decodeRequest(p, left, request, frameSize), FrameResult::Complete);
+  EXPECT_TRUE(request.valid);
+  EXPECT_EQ(request.tag, 1u);
+  EXPECT_EQ(request.type, RequestType::CreateEnterprise);
+  EXPECT_EQ(request.name, "YTunnus1");
+  EXPECT_EQ(request.secondName, "CompanyName1");
+  p += frameSize;
+  left -= frameSize;
+  ASSERT_EQ(decodeRequest(p, left, request, frameSize), FrameResult::Complete);
+  EXPECT_EQ(request.type, RequestType::Withdraw);
+  EXPECT_EQ(request.id, id);
+  EXPECT_EQ(request.amount, 250);
+  p += frameSize;
+  left -= frameSize;
+  ASSERT_EQ(decodeRequest(p, left, request, frameSize), FrameResult::Complete);
+  EXPECT_EQ(request.type, RequestType::Transfer);
+  EXPECT_EQ(request.toId, to);
+  EXPECT_EQ(request.amount, 7);
+  p += frameSize;
+  left -= frameSize;
+  ASSERT_EQ(decodeRequest(p, left, request, frameSize), FrameResult::Complete);
+  EXPECT_EQ(request.type, RequestType::Details);
+  EXPECT_TRUE(request.valid);
+  EXPECT_EQ(frameSize, left);
+
+  //A body that doesn't match its type is answered, a wrong length is not.
+  std::string bad;
+  endFrame(bad, beginFrame(bad, 5, static_cast<std::uint8_t>(RequestType::TopUp)));
+  ASSERT_EQ(decodeRequest(bad.data(), bad.size(), request, frameSize), FrameResult::Complete);
+  EXPECT_FALSE(request.valid);
+  bad.clear();
+  endFrame(bad, beginFrame(bad, 6, 99));
+  bad += 'x';
+  endFrame(bad, 0);
+  ASSERT_EQ(decodeRequest(bad.data(), bad.size(), request, frameSize), FrameResult::Complete);
+  EXPECT_FALSE(request.valid);
+  const std::string tooLong("\xff\xff\xff\x7f", 4);
+  EXPECT_EQ(decodeRequest(tooLong.data(), tooLong.size(), request, frameSize), FrameResult::Malformed);
+
+  std::string responses;
+  encodeIdResponse(responses, 9, id);
+  encodeResponse(responses, 10, ResponseStatus::Rejected);
+  Response response;
+  ASSERT_EQ(decodeResponse(responses.data(), responses.size(), response, frameSize), FrameResult::Complete);
+  EXPECT_EQ(response.tag, 9u);
+  EXPECT_EQ(response.status, ResponseStatus::Ok);
+  EXPECT_EQ(response.id, id);
+  ASSERT_EQ(decodeResponse(responses.data() + frameSize, responses.size() - frameSize, response, frameSize), FrameResult::Complete);
+  EXPECT_EQ(response.tag, 10u);
+  EXPECT_EQ(response.status, ResponseStatus::Rejected);
+}
+
+//SecondaryIndex
+TEST(SecondaryIndex, YTunnus) {
+  YTunnusIndex index;
+  const accountIdType first(1, 20230115u);
+  const accountIdType second(2, 20230115u);
+  EXPECT_TRUE(index.insert("1234567-8", first));
+  EXPECT_FALSE(index.insert("1234567-8", second));
+  EXPECT_TRUE(index.insert("7654321-0", second));
+  EXPECT_EQ(index.find("1234567-8"), first);
+  EXPECT_EQ(index.find("7654321-0"), second);
+  EXPECT_FALSE(index.find("1234567").has_value());
+
+  SecondaryIndexStats stats;
+  index.addStats(stats);
+  EXPECT_EQ(stats.yTunnusEntries, 2u);
+  EXPECT_EQ(stats.duplicateYTunnus, 1u);
+  EXPECT_GT(stats.yTunnusBytes, 0u);
+}
+
+TEST(SecondaryIndex, PersonNames) {
+  //Enough insertions in reverse order to merge the recent ones into the sorted array a few times.
+  PersonNameIndex index;
+  const int count = 5000;
+  for (int i = count - 1; i >= 0; --i) {
+    const std::string number = std::to_string(10000 + i);
+    index.insert("Last" + number.substr(0, 3), "First" + number, accountIdType(static_cast<AccountId_IdPartType>(i), 20230115u));
+  }
+  index.insert("Virtanen", "Matti", accountIdType(count, 20230115u));
+  index.insert("Virtanen", "Maija", accountIdType(count + 1, 20230115u));
+  index.insert("Virta", "Anna", accountIdType(count + 2, 20230115u));
+
+  std::vector<accountIdType> ids = index.findByLastNamePrefix("Last12", std::numeric_limits<std::size_t>::max());
+  ASSERT_EQ(ids.size(), 1000u);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(ids[i].id(), 2000 + i);
+  }
+  EXPECT_EQ(index.findByLastNamePrefix("Last", 10).size(), 10u);
+  EXPECT_EQ(index.findByLastNamePrefix("", std::numeric_limits<std::size_t>::max()).size(), static_cast<std::size_t>(count + 3));
+  EXPECT_TRUE(index.findByLastNamePrefix("Nobody", 10).empty());
+
+  ids = index.findByLastNamePrefix("Virta", 10);
+  ASSERT_EQ(ids.size(), 3u);
+  EXPECT_EQ(ids[0].id(), count + 2);
+  EXPECT_EQ(ids[1].id(), count + 1);
+  EXPECT_EQ(ids[2].id(), count);
+  ids = index.findByName("Virtanen", "Mat", 10);
+  ASSERT_EQ(ids.size(), 1u);
+  EXPECT_EQ(ids[0].id(), count);
+  EXPECT_EQ(index.findByName("Virtanen", "", 10).size(), 2u);
+  EXPECT_EQ(index.findByName("Virtanen", "", 1).size(), 1u);
+  EXPECT_TRUE(index.findByName("Virt", "", 10).empty());
+
+  SecondaryIndexStats stats;
+  index.addStats(stats);
+  EXPECT_EQ(stats.personEntries, static_cast<std::size_t>(count + 3));
+  EXPECT_GE(stats.personBytes, stats.personEntries * sizeof(PersonNameIndex::Entry));
+}
+
+TYPED_TEST(AccountMgrTest, SecondaryIndexes) {
+  TypeParam mgr(8);
+  const accountIdType& matti = mgr.insertNewPersonAccount("Matti", "Virtanen");
+  const accountIdType& company = mgr.insertNewEnterpriseAccount("1234567-8", "Company Oy");
+  //A Y-tunnus identifies one enterprise: a second account with it is refused.
+  EXPECT_EQ(mgr.insertNewEnterpriseAccount("1234567-8", "Copy Oy"), accountIdType());
+  EXPECT_EQ(mgr.findByYTunnus("1234567-8"), company);
+  EXPECT_FALSE(mgr.findByYTunnus("Matti").has_value());
+
+  const NewAccount accounts[] = {
+    {AccountKind::Person, "Maija", "Virtanen"},
+    {AccountKind::Enterprise, "7654321-0", "Other Oy"},
+    {AccountKind::Person, "Anna", "Korhonen"},
+    {AccountKind::Enterprise, "7654321-0", "Same Oy"},
+    {AccountKind::Enterprise, "1234567-8", "Copy Oy"}
+  };
+  std::vector<accountIdType> bulk(5);
+  mgr.insertNewAccounts(accounts, 5, bulk.data());
+  EXPECT_EQ(mgr.findByYTunnus("7654321-0"), bulk[1]);
+  EXPECT_EQ(bulk[3], accountIdType());
+  EXPECT_EQ(bulk[4], accountIdType());
+  EXPECT_EQ(mgr.size(), 5u);
+  EXPECT_EQ(mgr.findPersonsByName("Virtanen"), (std::vector<accountIdType>{bulk[0], matti}));
+  EXPECT_EQ(mgr.findPersonsByName("Virtanen", "Mat"), std::vector<accountIdType>{matti});
+  EXPECT_EQ(mgr.findPersonsByLastNamePrefix("K"), std::vector<accountIdType>{bulk[2]});
+  EXPECT_EQ(mgr.findPersonsByLastNamePrefix("", 2).size(), 2u);
+
+  const SecondaryIndexStats stats = mgr.indexStats();
+  EXPECT_EQ(stats.yTunnusEntries, 2u);
+  EXPECT_EQ(stats.duplicateYTunnus, 3u);
+  EXPECT_EQ(stats.personEntries, 3u);
+
+  const std::string path = ::testing::TempDir() + "account_test_index.snapshot";
+  ASSERT_TRUE(mgr.saveSnapshot(path));
+  TypeParam loaded(3);
+  ASSERT_TRUE(loaded.loadSnapshot(path, 2));
+  EXPECT_EQ(loaded.findByYTunnus("1234567-8"), company);
+  EXPECT_EQ(loaded.findByYTunnus("7654321-0"), bulk[1]);
+  EXPECT_EQ(loaded.findPersonsByName("Virtanen"), mgr.findPersonsByName("Virtanen"));
+  EXPECT_EQ(loaded.indexStats().personEntries, 3u);
+  EXPECT_EQ(loaded.size(), 5u);
+  std::remove(path.c_str());
+
+  //Of the accounts created concurrently with a Y-tunnus, exactly one is inserted and indexed.
+  std::vector<accountIdType> created(8);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < created.size(); ++t) {
+    threads.emplace_back([&mgr, &created, t]() {
+      created[t] = mgr.insertNewEnterpriseAccount("2222222-2", "Race Oy");
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(std::count(created.begin(), created.end(), accountIdType()), 7);
+  const std::optional<accountIdType> winner = mgr.findByYTunnus("2222222-2");
+  ASSERT_TRUE(winner.has_value());
+  EXPECT_NE(std::find(created.begin(), created.end(), *winner), created.end());
+  EXPECT_TRUE(mgr.hasAccount(*winner));
+  EXPECT_EQ(mgr.size(), 6u);
+}
+
+TEST(SecondaryIndex, ReplayJournal) {
+  const std::string path = ::testing::TempDir() + "account_test_index.journal";
+  std::remove(path.c_str());
+  accountIdType matti;
+  accountIdType company;
+  {
+    Journal journal(path);
+    AccountMgr mgr(4);
+    mgr.attachJournal(&journal);
+    matti = mgr.insertNewPersonAccount("Matti", "Virtanen");
+    company = mgr.insertNewEnterpriseAccount("1234567-8", "Company Oy");
+  }
+  AccountMgr recovered(4);
+  EXPECT_EQ(recovered.replayJournal(path).records, 2u);
+  EXPECT_EQ(recovered.findByYTunnus("1234567-8"), company);
+  EXPECT_EQ(recovered.findPersonsByLastNamePrefix("Virta"), std::vector<accountIdType>{matti});
+  std::remove(path.c_str());
+}
+
+//BalanceAggregates
+TEST(BalanceAggregates, Blocks) {
+  const int balances[] = {5, 0, 7, std::numeric_limits<int>::max(), 0, 3};
+  BalanceAggregates aggregates;
+  aggregates.add(balances, 6);
+  aggregates.add(balances, 6);
+  EXPECT_EQ(aggregates.accounts, 12u);
+  EXPECT_EQ(aggregates.zeroBalanceAccounts, 4u);
+  EXPECT_EQ(aggregates.total, 2 * (15 + static_cast<std::int64_t>(std::numeric_limits<int>::max())));
+  EXPECT_EQ(aggregates.minBalance, 0);
+  EXPECT_EQ(aggregates.maxBalance, std::numeric_limits<int>::max());
+
+  BalanceHistogram histogram({10, 1, 5, 5});
+  EXPECT_EQ(histogram.bounds(), (std::vector<int>{1, 5, 10}));
+  histogram.add(balances, 6);
+  EXPECT_EQ(histogram.counts(), (std::vector<std::uint64_t>{2, 1, 2, 1}));
+
+  //More bounds than the vectorized count take the binary search.
+  std::vector<int> bounds;
+  for (int i = 1; i <= 100; ++i) {
+    bounds.push_back(i);
+  }
+  BalanceHistogram fine(bounds);
+  fine.add(balances, 6);
+  EXPECT_EQ(fine.counts()[0], 2u);
+  EXPECT_EQ(fine.counts()[3], 1u);
+  EXPECT_EQ(fine.counts()[5], 1u);
+  EXPECT_EQ(fine.counts()[7], 1u);
+  EXPECT_EQ(fine.counts()[100], 1u);
+
+  TopBalances top(3);
+  for (int i = 0; i < 6; ++i) {
+    top.add(accountIdType(static_cast<AccountId_IdPartType>(i), 20230115u), balances[i]);
+  }
+  std::vector<AccountBalance> sorted = top.sorted();
+  ASSERT_EQ(sorted.size(), 3u);
+  EXPECT_EQ(sorted[0].id.id(), 3);
+  EXPECT_EQ(sorted[1].id.id(), 2);
+  EXPECT_EQ(sorted[2].id.id(), 0);
+  EXPECT_FALSE(top.wants(4));
+  EXPECT_TRUE(TopBalances(0).sorted().empty());
+  EXPECT_FALSE(TopBalances(0).wants(1));
+}
+
+TYPED_TEST(AccountMgrTest, BalanceAggregates) {
+  TypeParam mgr(16);
+  std::vector<accountIdType> persons;
+  std::vector<accountIdType> enterprises;
+  for (int i = 0; i < 3000; ++i) {
+    persons.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+    if (i % 3 != 0) {
+      ASSERT_TRUE(mgr.topUpAccount(persons.back(), i));
+    }
+  }
+  for (int i = 0; i < 100; ++i) {
+    enterprises.push_back(mgr.insertNewEnterpriseAccount("YTunnus" + std::to_string(i), "CompanyName"));
+    ASSERT_TRUE(mgr.topUpAccount(enterprises.back(), 100000 + i));
+  }
+
+  for (std::size_t threads : {1u, 3u, 0u}) {
+    const BalanceAggregates all = mgr.aggregateBalances(AccountFilter::All, threads);
+    EXPECT_EQ(all.accounts, 3100u);
+    EXPECT_EQ(all.zeroBalanceAccounts, 1000u);
+    EXPECT_EQ(all.total, mgr.totalBalance());
+    EXPECT_EQ(all.minBalance, 0);
+    EXPECT_EQ(all.maxBalance, 100099);
+
+    const BalanceAggregates companies = mgr.aggregateBalances(AccountFilter::Enterprises, threads);
+    EXPECT_EQ(companies.accounts, 100u);
+    EXPECT_EQ(companies.zeroBalanceAccounts, 0u);
+    EXPECT_EQ(companies.minBalance, 100000);
+    EXPECT_EQ(mgr.aggregateBalances(AccountFilter::Persons, threads).maxBalance, 2999);
+
+    const BalanceHistogram histogram = mgr.balanceHistogram({1, 1000, 100000}, AccountFilter::All, threads);
+    EXPECT_EQ(histogram.counts(), (std::vector<std::uint64_t>{1000, 666, 1334, 100}));
+
+    const std::vector<AccountBalance> top = mgr.topBalances(5, AccountFilter::Persons, threads);
+    ASSERT_EQ(top.size(), 5u);
+    EXPECT_TRUE(top[0].id == persons[2999]);
+    EXPECT_EQ(top[0].balance, 2999);
+    EXPECT_EQ(top[4].balance, 2993);
+    EXPECT_TRUE(mgr.topBalances(1, AccountFilter::All, threads)[0].id == enterprises[99]);
+  }
+  EXPECT_EQ(TypeParam(4).aggregateBalances().accounts, 0u);
+}
+
+//HotAccount
+TYPED_TEST(AccountMgrTest, HotAccount) {
+  TypeParam mgr(4);
+  const accountIdType& collector = mgr.insertNewEnterpriseAccount("YTunnus1", "Collector");
+  const accountIdType& payer = mgr.insertNewPersonAccount("FirstName", "LastName");
+  ASSERT_TRUE(mgr.topUpAccount(collector, 10));
+  EXPECT_FALSE(mgr.isHotAccount(collector));
+  EXPECT_TRUE(mgr.makeHotAccount(collector));
+  EXPECT_TRUE(mgr.isHotAccount(collector));
+  EXPECT_FALSE(mgr.isHotAccount(payer));
+  EXPECT_FALSE(mgr.makeHotAccount(accountIdType(collector.id() + 1000, collector.packedCreationDate())));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&mgr, &collector]() {
+      for (int i = 0; i < 1000; ++i) {
+        mgr.topUpAccount(collector, 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  ASSERT_TRUE(mgr.topUpAccount(payer, 5));
+  ASSERT_TRUE(mgr.transfer(payer, collector, 5));
+  EXPECT_FALSE(mgr.withdrawFromAccount(collector, 4016));
+  ASSERT_TRUE(mgr.withdrawFromAccount(collector, 4015));
+  ASSERT_TRUE(mgr.topUpAccount(collector, 7));
+  EXPECT_NE(mgr.getAccountDetails(collector).find("Balance: 7"), std::string::npos);
+  EXPECT_EQ(mgr.totalBalance(), 7);
+  EXPECT_EQ(mgr.aggregateBalances().maxBalance, 7);
+}
+
+//Metrics
+TEST(Metrics, LatencyHistogram) {
+  //Every latency falls in a bucket whose values are within 1/16 of it.
+  std::size_t previous = 0;
+  for (std::uint64_t nanos = 0; nanos < (std::uint64_t(1) << 41); nanos = nanos * 9 / 8 + 1) {
+    const std::size_t bucket = LatencyHistogram::bucketOf(nanos);
+    ASSERT_LT(bucket, LatencyHistogram::bucketCount);
+    ASSERT_GE(bucket, previous);
+    previous = bucket;
+    if (nanos < (std::uint64_t(1) << LatencyHistogram::maxBits)) {
+      ASSERT_GE(LatencyHistogram::bucketHighest(bucket), nanos);
+      ASSERT_LE(LatencyHistogram::bucketHighest(bucket) - nanos, nanos / 16);
+      ASSERT_EQ(LatencyHistogram::bucketOf(LatencyHistogram::bucketHighest(bucket)), bucket);
+    }
+  }
+  EXPECT_EQ(LatencyHistogram::bucketOf(std::numeric_limits<std::uint64_t>::max()), LatencyHistogram::bucketCount - 1);
+
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.percentile(50), 0u);
+  for (std::uint64_t nanos = 1; nanos <= 1000; ++nanos) {
+    histogram.record(nanos);
+  }
+  EXPECT_EQ(histogram.count(), 1000u);
+  EXPECT_NEAR(static_cast<double>(histogram.percentile(50)), 500.0, 500.0 / 16);
+  EXPECT_NEAR(static_cast<double>(histogram.percentile(99)), 990.0, 990.0 / 16);
+  EXPECT_GE(histogram.percentile(100), 1000u);
+  EXPECT_EQ(histogram.percentile(0), 1u);
+
+  LatencyHistogram other;
+  other.record(5000);
+  histogram += other;
+  EXPECT_EQ(histogram.count(), 1001u);
+  EXPECT_GE(histogram.percentile(100), 5000u);
+}
+
+TYPED_TEST(AccountMgrTest, Metrics) {
+  //Every call timed, so the histograms count them all, until the test returns.
+  AccountMetrics::setSamplePeriod(1);
+  struct RestoreSamplePeriod {
+    ~RestoreSamplePeriod() { AccountMetrics::setSamplePeriod(AccountMetrics::defaultSamplePeriod); }
+  } restoreSamplePeriod;
+  TypeParam mgr(4);
+  const accountIdType& id1 = mgr.insertNewPersonAccount("FirstName", "LastName");
+  const accountIdType& id2 = mgr.insertNewEnterpriseAccount("YTunnus", "CompanyName");
+  accountIdType missing(-1, "20230115");
+
+  ASSERT_TRUE(mgr.topUpAccount(id1, 100));
+  EXPECT_FALSE(mgr.topUpAccount(missing, 1));
+  EXPECT_FALSE(mgr.topUpAccount(id1, -1));
+  ASSERT_TRUE(mgr.topUpAccount(id2, std::numeric_limits<int>::max()));
+  EXPECT_FALSE(mgr.topUpAccount(id2, 1));
+  EXPECT_FALSE(mgr.withdrawFromAccount(id1, 101));
+  ASSERT_TRUE(mgr.withdrawFromAccount(id1, 10));
+  EXPECT_FALSE(mgr.transfer(id1, id1, 1));
+  EXPECT_FALSE(mgr.transfer(id1, missing, 1));
+  EXPECT_FALSE(mgr.transfer(id1, id2, 1));
+  mgr.getAccountDetails(id1);
+  mgr.getAccountDetails(missing);
+  std::string details;
+  ASSERT_TRUE(mgr.renderAccountDetails(id2, std::back_inserter(details), AccountDetailsFormat::Json));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&mgr, &id1]() {
+      for (int i = 0; i < 1000; ++i) {
+        mgr.topUpAccount(id1, 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  MetricsSnapshot snapshot = mgr.metricsSnapshot();
+  EXPECT_EQ(snapshot.shards, 4u);
+  EXPECT_EQ(snapshot.accounts, 2u);
+  EXPECT_GE(snapshot.largestShard, 1u);
+  EXPECT_EQ(snapshot.smallestShard, 0u);
+  EXPECT_GT(snapshot.loadFactor(), 0.0);
+  EXPECT_LE(snapshot.maxShardLoadFactor, 1.0);
+  EXPECT_NE(snapshot.toJson().find("\"gauges\":{\"shards\":4,\"accounts\":2,"), std::string::npos);
+  EXPECT_NE(snapshot.toText().find("accounts 2 in 4 shards"), std::string::npos);
+  EXPECT_EQ(snapshot.enabled, AccountMetrics::enabled);
+  if (!AccountMetrics::enabled) return;
+
+  const OperationMetrics& topUp = snapshot.operation(MetricOperation::TopUp);
+  EXPECT_EQ(topUp.calls(), 4005u);
+  EXPECT_EQ(topUp.outcomes[static_cast<std::size_t>(MetricOutcome::Succeeded)], 4002u);
+  EXPECT_EQ(topUp.outcomes[static_cast<std::size_t>(MetricOutcome::AccountNotFound)], 1u);
+  EXPECT_EQ(topUp.outcomes[static_cast<std::size_t>(MetricOutcome::InvalidRequest)], 1u);
+  EXPECT_EQ(topUp.outcomes[static_cast<std::size_t>(MetricOutcome::BalanceLimit)], 1u);
+  EXPECT_EQ(topUp.latency.count(), 4005u);
+  EXPECT_LE(topUp.percentileNanos(50), topUp.percentileNanos(99));
+  EXPECT_LE(topUp.percentileNanos(99), topUp.maxNanos);
+
+  const OperationMetrics& withdraw = snapshot.operation(MetricOperation::Withdraw);
+  EXPECT_EQ(withdraw.calls(), 2u);
+  EXPECT_EQ(withdraw.outcomes[static_cast<std::size_t>(MetricOutcome::InsufficientFunds)], 1u);
+
+  const OperationMetrics& transfer = snapshot.operation(MetricOperation::Transfer);
+  EXPECT_EQ(transfer.calls(), 3u);
+  EXPECT_EQ(transfer.failures(), 3u);
+  EXPECT_EQ(transfer.outcomes[static_cast<std::size_t>(MetricOutcome::InvalidRequest)], 1u);
+  EXPECT_EQ(transfer.outcomes[static_cast<std::size_t>(MetricOutcome::AccountNotFound)], 1u);
+  EXPECT_EQ(transfer.outcomes[static_cast<std::size_t>(MetricOutcome::BalanceLimit)], 1u);
+
+  EXPECT_EQ(snapshot.operation(MetricOperation::InsertAccount).calls(), 2u);
+  EXPECT_EQ(snapshot.operation(MetricOperation::AccountDetails).calls(), 3u);
+  EXPECT_EQ(snapshot.operation(MetricOperation::AccountDetails).failures(), 1u);
+
+  EXPECT_NE(snapshot.toJson().find("\"top_up\":{\"calls\":4005,\"outcomes\":{\"succeeded\":4002,\"account_not_found\":1,"), std::string::npos);
+  EXPECT_NE(snapshot.toText().find("transfer failures: account_not_found 1 invalid_request 1 balance_limit 1"), std::string::npos);
+
+  //Another manager counts its own calls.
+  TypeParam other;
+  other.topUpAccount(missing, 1);
+  EXPECT_EQ(other.metricsSnapshot().operation(MetricOperation::TopUp).calls(), 1u);
+  EXPECT_EQ(mgr.metricsSnapshot().operation(MetricOperation::TopUp).calls(), 4005u);
+}
+
+TEST(Metrics, Sampling) {
+  if (!AccountMetrics::enabled) return;
+
+  AccountMgr mgr;
+  const accountIdType& id = mgr.insertNewPersonAccount("FirstName", "LastName");
+  AccountMetrics::setSamplePeriod(1);
+  ASSERT_TRUE(mgr.topUpAccount(id, 1));
+  AccountMetrics::setSamplePeriod(4);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(mgr.topUpAccount(id, 1));
+  }
+  AccountMetrics::setSamplePeriod(AccountMetrics::defaultSamplePeriod);
+
+  const OperationMetrics& topUp = mgr.metricsSnapshot().operation(MetricOperation::TopUp);
+  EXPECT_EQ(topUp.calls(), 101u);
+  EXPECT_EQ(topUp.latency.count(), 26u);
+  EXPECT_GT(topUp.meanNanos(), 0.0);
+}
+
+#ifdef __linux__
+//ReadView
+template<typename T_View>
+std::map<AccountId_IdPartType, int> readViewBalances(const T_View& view) {
+  std::map<AccountId_IdPartType, int> balances;
+  view.forEachAccount([&balances](const accountIdType& id, AccountKind, const std::string&, const std::string&, int balance) {
+    balances[id.id()] = balance;
+  });
+  return balances;
+}
+
+TYPED_TEST(AccountMgrTest, ReadView) {
+  TypeParam mgr(4);
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 100; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+    ASSERT_TRUE(mgr.topUpAccount(ids.back(), i));
+  }
+  const accountIdType& ide = mgr.insertNewEnterpriseAccount("YTunnus1", "CompanyName");
+  ASSERT_TRUE(mgr.topUpAccount(ide, 1000));
+
+  typename TypeParam::ReadView first = mgr.openReadView();
+  EXPECT_EQ(mgr.readViewVersions(), 0u);
+  ASSERT_TRUE(mgr.topUpAccount(ids[1], 5));
+  ASSERT_TRUE(mgr.withdrawFromAccount(ids[2], 2));
+  ASSERT_TRUE(mgr.transfer(ids[3], ids[4], 3));
+  ASSERT_EQ(mgr.applyOperations({{ids[5], 10}})[0], OperationResult::Applied);
+  const accountIdType& added = mgr.insertNewPersonAccount("FirstName", "LastName");
+  ASSERT_TRUE(mgr.topUpAccount(added, 50));
+  ASSERT_TRUE(mgr.makeHotAccount(ids[6]));
+  ASSERT_TRUE(mgr.topUpAccount(ids[6], 1));
+  EXPECT_GT(mgr.readViewVersions(), 0u);
+
+  std::map<AccountId_IdPartType, int> balances = readViewBalances(first);
+  EXPECT_EQ(balances.size(), 101u);
+  EXPECT_EQ(balances.count(added.id()), 0u);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(balances[ids[i].id()], i);
+  }
+  EXPECT_EQ(balances[ide.id()], 1000);
+  EXPECT_EQ(mgr.totalBalance(), 5950 + 5 - 2 + 10 + 50 + 1);
+
+  typename TypeParam::ReadView second = mgr.openReadView();
+  ASSERT_TRUE(mgr.topUpAccount(ids[1], 5));
+  balances = readViewBalances(second);
+  EXPECT_EQ(balances.size(), 102u);
+  EXPECT_EQ(balances[ids[1].id()], 6);
+  EXPECT_EQ(balances[added.id()], 50);
+  EXPECT_EQ(readViewBalances(first)[ids[1].id()], 1);
+
+  //Closing the later view keeps the versions of the earlier one.
+  second.close();
+  EXPECT_FALSE(second.isOpen());
+  typename TypeParam::ReadView moved = std::move(first);
+  EXPECT_FALSE(first.isOpen());
+  ASSERT_TRUE(moved.isOpen());
+  balances = readViewBalances(moved);
+  EXPECT_EQ(balances[ids[1].id()], 1);
+  EXPECT_EQ(balances[ids[4].id()], 4);
+  EXPECT_EQ(balances.size(), 101u);
+  moved.close();
+  EXPECT_EQ(mgr.readViewVersions(), 0u);
+
+  //Without open views nothing is kept.
+  ASSERT_TRUE(mgr.topUpAccount(ids[1], 5));
+  EXPECT_EQ(mgr.readViewVersions(), 0u);
+  EXPECT_EQ(readViewBalances(mgr.openReadView())[ids[1].id()], 16);
+}
+
+TYPED_TEST(AccountMgrTest, ReadViewUnderTransfers) {
+  //The transfers keep the total, so every view must add up to it however they interleave.
+  TypeParam mgr(8);
+  std::vector<accountIdType> ids;
+  for (int i = 0; i < 200; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName", "LastName"));
+    ASSERT_TRUE(mgr.topUpAccount(ids.back(), 100));
+  }
+  ASSERT_TRUE(mgr.makeHotAccount(ids[0]));
+
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 3; ++t) {
+    threads.emplace_back([&mgr, &ids, &done, t]() {
+      std::uint32_t seed = t + 1;
+      while (!done.load()) {
+        seed = seed * 1664525u + 1013904223u;
+        const std::size_t from = (seed >> 8) % ids.size();
+        const std::size_t to = (seed >> 20) % ids.size();
+        mgr.transfer(ids[from], ids[to], static_cast<int>(seed % 7) + 1);
+      }
+    });
+  }
+  threads.emplace_back([&mgr, &done]() {
+    for (int i = 0; !done.load(); ++i) {
+      mgr.insertNewEnterpriseAccount("YTunnus" + std::to_string(i), "CompanyName");
+    }
+  });
+
+  for (int v = 0; v < 50; ++v) {
+    typename TypeParam::ReadView view = mgr.openReadView();
+    std::int64_t total = 0;
+    std::size_t persons = 0;
+    view.forEachAccount([&total, &persons](const accountIdType&, AccountKind kind, const std::string&, const std::string&, int balance) {
+      total += balance;
+      persons += (kind == AccountKind::Person);
+    });
+    ASSERT_EQ(total, 200 * 100);
+    ASSERT_EQ(persons, 200u);
+  }
+  done = true;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(mgr.readViewVersions(), 0u);
+  EXPECT_EQ(mgr.totalBalance(), 200 * 100);
+}
+
+//LockFreeReads
+TEST(LockFreeReads, SynchronizeWaitsForReaders) {
+  std::atomic<bool> inSection(false);
+  std::atomic<bool> leave(false);
+  std::atomic<bool> synchronized(false);
+  std::thread reader([&inSection, &leave]() {
+    RcuDomain::ReadSection section;
+    {
+      RcuDomain::ReadSection nested;
+    }
+    inSection = true;
+    while (!leave.load()) {
+      std::this_thread::yield();
+    }
+  });
+  while (!inSection.load()) {
+    std::this_thread::yield();
+  }
+  std::thread writer([&synchronized]() {
+    RcuDomain::synchronize();
+    synchronized = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(synchronized.load());
+  leave = true;
+  writer.join();
+  reader.join();
+  EXPECT_TRUE(synchronized.load());
+
+  //The slot of the thread that ended is reused.
+  {
+    RcuDomain::ReadSection section;
+  }
+  EXPECT_GE(RcuDomain::readerCount(), 1u);
+  RcuDomain::synchronize();
+}
+
+TYPED_TEST(AccountMgrTest, LockFreeReads) {
+  //Few shards, so the insertions keep growing the index and the arrays the readers go through.
+  TypeParam mgr(2);
+  std::vector<accountIdType> ids;
+  std::vector<std::string> details;
+  for (int i = 0; i < 100; ++i) {
+    ids.push_back(mgr.insertNewPersonAccount("FirstName" + std::to_string(i), "LastName"));
+    ASSERT_TRUE(mgr.topUpAccount(ids.back(), i));
+    details.push_back(mgr.getAccountDetails(ids.back()));
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int> mismatches(0);
+  std::atomic<std::uint64_t> reads(0);
+  std::vector<std::thread> readers;
+  for (unsigned t = 0; t < 2; ++t) {
+    readers.emplace_back([&mgr, &ids, &details, &done, &mismatches, &reads]() {
+      while (!done.load()) {
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+          if (mgr.getAccountDetails(ids[i]) != details[i]) ++mismatches;
+          if (!mgr.hasAccount(ids[i]) || mgr.isHotAccount(ids[i])) ++mismatches;
+          if (mgr.hasAccount(accountIdType(ids[i].id(), 19990101u))) ++mismatches;
+        }
+        reads += ids.size();
+      }
+    });
+  }
+
+  std::vector<NewAccount> batch(5000, NewAccount{AccountKind::Person, "FirstName", "LastName"});
+  for (int i = 0; i < 20000; ++i) {
+    mgr.insertNewEnterpriseAccount("YTunnus" + std::to_string(i), "CompanyName");
+  }
+  mgr.insertNewAccounts(batch);
+  //Let the readers run once more after the last insertion.
+  const std::uint64_t readsBefore = reads.load();
+  while (reads.load() == readsBefore) {
+    std::this_thread::yield();
+  }
+  done = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(mismatches.load(), 0);
+  EXPECT_EQ(mgr.size(), 25100u);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(mgr.getAccountDetails(ids[i]), details[i]);
+  }
+}
+
+//AccountExecutor
+namespace {
+
+struct TestNode : MpscNode {
+  unsigned producer = 0;
+  unsigned sequence = 0;
+};
+
+}
+
+TEST(MpscQueue, ManyProducers) {
+  const unsigned producers = 4;
+  const unsigned perProducer = 20000;
+  MpscQueue<TestNode> queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.pop(), nullptr);
+
+  std::vector<TestNode> nodes(producers * perProducer);
+  std::vector<std::thread> threads;
+  for (unsigned p = 0; p < producers; ++p) {
+    threads.emplace_back([&queue, &nodes, p]() {
+      for (unsigned i = 0; i < perProducer; ++i) {
+        TestNode& node = nodes[p * perProducer + i];
+        node.producer = p;
+        node.sequence = i;
+        queue.push(&node);
+      }
+    });
+  }
+  std::vector<unsigned> next(producers, 0);
+  unsigned popped = 0;
+  while (popped < producers * perProducer) {
+    TestNode* node = queue.pop();
+    if (node == nullptr) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(node->sequence, next[node->producer]);
+    ++next[node->producer];
+    ++popped;
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.pop(), nullptr);
+}
+
+TYPED_TEST(AccountMgrTest, Executor) {
+  TypeParam mgr(8);
+  std::atomic<int> completed(0);
+  {
+    BasicAccountExecutor<typename TypeParam::Store> executor(mgr, 3);
+    EXPECT_EQ(executor.workerCount(), 3u);
+    accountIdType idp = executor.insertNewPersonAccount("FirstName", "LastName");
+    accountIdType ide = executor.insertNewEnterpriseAccount("YTunnus1", "CompanyName");
+    EXPECT_TRUE(mgr.hasAccount(idp));
+    EXPECT_TRUE(mgr.hasAccount(ide));
+    EXPECT_EQ(mgr.size(), 2u);
+
+    EXPECT_TRUE(executor.topUpAccount(idp, 100));
+    EXPECT_TRUE(executor.withdrawFromAccount(idp, 30));
+    EXPECT_FALSE(executor.withdrawFromAccount(idp, 71));
+    //The amounts are checked like the manager does: 0 is applied, a negative one rejected.
+    EXPECT_TRUE(mgr.topUpAccount(idp, 0));
+    EXPECT_TRUE(executor.topUpAccount(idp, 0));
+    EXPECT_TRUE(mgr.withdrawFromAccount(idp, 0));
+    EXPECT_TRUE(executor.withdrawFromAccount(idp, 0));
+    EXPECT_FALSE(mgr.topUpAccount(idp, -5));
+    EXPECT_FALSE(executor.topUpAccount(idp, -5));
+    EXPECT_FALSE(mgr.withdrawFromAccount(idp, -5));
+    EXPECT_FALSE(executor.withdrawFromAccount(idp, -5));
+    EXPECT_EQ(executor.topUp(accountIdType(idp.id() + 1000, 20230101u), 5).get(), OperationResult::AccountNotFound);
+    EXPECT_EQ(executor.withdraw(idp, 1000).get(), OperationResult::Rejected);
+    EXPECT_EQ(executor.getAccountDetails(idp), mgr.getAccountDetails(idp));
+    EXPECT_EQ(executor.getAccountDetails(accountIdType(idp.id() + 1000, 20230101u)), "<ACCOUNT NOT FOUND>");
+    EXPECT_EQ(mgr.totalBalance(), 70);
+
+    //The details see the top-ups submitted before them, even without waiting for them.
+    for (int i = 0; i < 1000; ++i) {
+      executor.topUp(ide, 1, [&completed](OperationResult result) {
+        if (result == OperationResult::Applied) ++completed;
+      });
+    }
+    std::future<std::string> details = executor.details(ide);
+    const std::string text = details.get();
+    EXPECT_EQ(completed.load(), 1000);
+    EXPECT_EQ(text, mgr.getAccountDetails(ide));
+
+    std::vector<accountIdType> ids;
+    for (int i = 0; i < 64; ++i) {
+      ids.push_back(executor.createPersonAccount("FirstName", "LastName").get());
+    }
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; ++t) {
+      threads.emplace_back([&executor, &ids, &completed, t]() {
+        for (int i = 0; i < 2000; ++i) {
+          executor.topUp(ids[(i * 7 + t) % ids.size()], 1, [&completed](OperationResult result) {
+            if (result == OperationResult::Applied) ++completed;
+          });
+        }
+      });
+    }
+    threads.emplace_back([&executor, &completed]() {
+      for (int i = 0; i < 100; ++i) {
+        executor.createEnterpriseAccount("YTunnus" + std::to_string(i + 2), "CompanyName", [&completed](const accountIdType&) {
+          ++completed;
+        });
+      }
+    });
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    //Destroying the executor completes what was submitted.
+  }
+  EXPECT_EQ(mgr.totalBalance(), 70 + 1000 + 4 * 2000);
+  EXPECT_EQ(mgr.size(), 2u + 64u + 100u);
+  EXPECT_EQ(completed.load(), 1000 + 4 * 2000 + 100);
+  EXPECT_TRUE(mgr.findByYTunnus("YTunnus2").has_value());
+
+  //With an executor attached the manager hands its operations to the owners of the shards,
+  //and parks them for the transfers and the views.
+  {
+    BasicAccountExecutor<typename TypeParam::Store> executor(mgr, 3);
+    const accountIdType& from = mgr.insertNewPersonAccount("FirstName", "LastName");
+    const accountIdType& to = mgr.insertNewEnterpriseAccount("YTunnus200", "CompanyName");
+    EXPECT_TRUE(mgr.hasAccount(from));
+    EXPECT_TRUE(mgr.hasAccount(to));
+    EXPECT_EQ(mgr.insertNewEnterpriseAccount("YTunnus200", "CompanyName"), accountIdType());
+    EXPECT_TRUE(mgr.topUpAccount(from, 1000));
+    EXPECT_FALSE(mgr.withdrawFromAccount(to, 1));
+    const std::string date = from.creationDate();
+    EXPECT_TRUE(mgr.withdrawFromAccount(accountIdViewType{from.id(), date}, 0));
+    EXPECT_FALSE(mgr.withdrawFromAccount(accountIdViewType{from.id(), "2023"}, 0));
+
+    std::vector<NewAccount> accounts{{AccountKind::Person, "FirstName", "LastName"}, {AccountKind::Enterprise, "YTunnus201", "CompanyName"}, {AccountKind::Enterprise, "YTunnus200", "CompanyName"}};
+    const std::vector<accountIdType> ids = mgr.insertNewAccounts(accounts);
+    EXPECT_TRUE(mgr.hasAccount(ids[0]));
+    EXPECT_TRUE(mgr.hasAccount(ids[1]));
+    EXPECT_EQ(ids[2], accountIdType());
+    const std::vector<OperationResult> results = mgr.applyOperations({{ids[0], 50}, {ids[0], -20}, {ids[1], -1}, {ids[0], std::numeric_limits<int>::min()}});
+    EXPECT_EQ(results, (std::vector<OperationResult>{OperationResult::Applied, OperationResult::Applied, OperationResult::Rejected, OperationResult::Rejected}));
+
+    std::atomic<bool> done(false);
+    std::atomic<int> topUps(0);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 2; ++t) {
+      threads.emplace_back([&mgr, &from, &to, &done]() {
+        while (!done.load()) {
+          mgr.transfer(from, to, 3);
+          mgr.transfer(to, from, 2);
+        }
+      });
+    }
+    threads.emplace_back([&mgr, &ids, &done, &topUps]() {
+      while (!done.load()) {
+        if (mgr.topUpAccount(ids[0], 1)) ++topUps;
+      }
+    });
+    for (int v = 0; v < 20; ++v) {
+      typename TypeParam::ReadView view = mgr.openReadView();
+      int balances = 0;
+      view.forEachAccount([&balances, &from, &to](const accountIdType& id, AccountKind, const std::string&, const std::string&, int balance) {
+        if ((id == from) || (id == to)) balances += balance;
+      });
+      EXPECT_EQ(balances, 1000);
+    }
+    done = true;
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    //The transfers keep the total.
+    EXPECT_EQ(mgr.totalBalance(), 70 + 1000 + 4 * 2000 + 1000 + 30 + topUps.load());
+  }
+  EXPECT_EQ(mgr.size(), 2u + 64u + 100u + 4u);
+}
+
+//AccountServer
+TEST(AccountServer, Loopback) {
+  AccountMgr mgr(4);
+  ServerOptions options;
+  options.threadCount = 2;
+  AccountServer server(mgr, options);
+  server.start("127.0.0.1", 0);
+  ASSERT_NE(server.port(), 0);
+
+  AccountClient client;
+  ASSERT_TRUE(client.connect("127.0.0.1", server.port()));
+  Response response;
+  const std::uint32_t personTag = client.createPersonAccount("FirstName1", "LastName1");
+  client.createEnterpriseAccount("YTunnus1", "CompanyName1");
+  ASSERT_TRUE(client.flush());
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(response.tag, personTag);
+  const accountIdType person = response.id;
+  ASSERT_TRUE(client.receive(response));
+  const accountIdType enterprise = response.id;
+  EXPECT_TRUE(mgr.hasAccount(person));
+  EXPECT_TRUE(mgr.hasAccount(enterprise));
+
+  //Pipelined requests are answered in order.
+  const int count = 2000;
+  for (int i = 0; i < count; ++i) {
+    client.topUp(person, 3);
+  }
+  client.withdraw(person, 1000);
+  client.transfer(person, enterprise, 5000);
+  client.withdraw(enterprise, 1000000);
+  client.topUp(accountIdType(person.id() + 1000000, person.packedCreationDate()), 1);
+  const std::uint32_t detailsTag = client.details(person);
+  ASSERT_TRUE(client.flush());
+  std::uint32_t lastTag = personTag + 1;
+  for (int i = 0; i < count; ++i) {
+    ASSERT_TRUE(client.receive(response));
+    EXPECT_EQ(response.tag, ++lastTag);
+    EXPECT_EQ(response.status, ResponseStatus::Ok);
+  }
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(response.status, ResponseStatus::Ok);
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(response.status, ResponseStatus::Ok);
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(response.status, ResponseStatus::Rejected);
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(response.status, ResponseStatus::NotFound);
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(response.tag, detailsTag);
+  EXPECT_EQ(response.status, ResponseStatus::Ok);
+  EXPECT_NE(response.details.find("\"balance\":0"), std::string_view::npos);
+
+  //A second connection sees the same accounts.
+  AccountClient other;
+  ASSERT_TRUE(other.connect("127.0.0.1", server.port()));
+  other.details(enterprise);
+  ASSERT_TRUE(other.flush());
+  ASSERT_TRUE(other.receive(response));
+  EXPECT_NE(response.details.find("\"balance\":5000"), std::string_view::npos);
+
+  //A frame with an impossible length closes the connection.
+  other.queueRaw(std::string("\xff\xff\xff\x7f", 4));
+  ASSERT_TRUE(other.flush());
+  EXPECT_FALSE(other.receive(response));
+
+  EXPECT_EQ(server.requestCount(), static_cast<std::uint64_t>(count + 8));
+  server.stop();
+}
+#endif
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();